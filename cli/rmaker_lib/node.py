@@ -15,6 +15,7 @@
 import requests
 import json
 import socket
+import struct
 from rmaker_lib import serverconfig, configmanager
 from requests.exceptions import Timeout, ConnectionError,\
                                 RequestException, HTTPError
@@ -22,6 +23,148 @@ from rmaker_lib.exceptions import NetworkError, InvalidClassInput, SSLError,\
                                   RequestTimeoutError
 from rmaker_lib.logger import log
 
+# Major types and tags of CBOR (RFC 7049) data items
+CBOR_MAJOR_UINT = 0
+CBOR_MAJOR_NINT = 1
+CBOR_MAJOR_BYTES = 2
+CBOR_MAJOR_TEXT = 3
+CBOR_MAJOR_ARRAY = 4
+CBOR_MAJOR_MAP = 5
+CBOR_MAJOR_TAG = 6
+CBOR_MAJOR_SIMPLE = 7
+CBOR_TAG_EMBEDDED_JSON = 262
+CBOR_BREAK = 0xff
+
+
+def _cbor_decode_head(data, offset):
+    """
+    Decode the header of the CBOR data item at the given offset.
+
+    :return: Tuple of major type, additional information, argument
+             (None for indefinite length) and offset of the item's contents
+    :rtype: tuple
+    """
+    major = data[offset] >> 5
+    info = data[offset] & 0x1f
+    offset += 1
+    if info < 24:
+        return major, info, info, offset
+    if info == 31:
+        return major, info, None, offset
+    if info > 27:
+        raise ValueError('Invalid CBOR additional information ' + str(info))
+    length = 1 << (info - 24)
+    if offset + length > len(data):
+        raise ValueError('Truncated CBOR data')
+    arg = int.from_bytes(data[offset:offset + length], 'big')
+    return major, info, arg, offset + length
+
+
+def _cbor_decode_item(data, offset):
+    """
+    Decode the CBOR data item at the given offset.
+
+    :return: Tuple of the decoded value and offset of the next item
+    :rtype: tuple
+    """
+    major, info, arg, offset = _cbor_decode_head(data, offset)
+    if major == CBOR_MAJOR_UINT:
+        return arg, offset
+    if major == CBOR_MAJOR_NINT:
+        return -1 - arg, offset
+    if major in (CBOR_MAJOR_BYTES, CBOR_MAJOR_TEXT):
+        if arg is None:
+            chunks = []
+            while data[offset] != CBOR_BREAK:
+                chunk, offset = _cbor_decode_item(data, offset)
+                chunks.append(chunk)
+            value = ('' if major == CBOR_MAJOR_TEXT else b'').join(chunks)
+            return value, offset + 1
+        if offset + arg > len(data):
+            raise ValueError('Truncated CBOR data')
+        value = bytes(data[offset:offset + arg])
+        if major == CBOR_MAJOR_TEXT:
+            value = value.decode('utf-8')
+        return value, offset + arg
+    if major == CBOR_MAJOR_ARRAY:
+        value = []
+        while (len(value) < arg) if arg is not None \
+                else (data[offset] != CBOR_BREAK):
+            item, offset = _cbor_decode_item(data, offset)
+            value.append(item)
+        return value, offset if arg is not None else offset + 1
+    if major == CBOR_MAJOR_MAP:
+        value = {}
+        count = 0
+        while (count < arg) if arg is not None \
+                else (data[offset] != CBOR_BREAK):
+            key, offset = _cbor_decode_item(data, offset)
+            value[key], offset = _cbor_decode_item(data, offset)
+            count += 1
+        return value, offset if arg is not None else offset + 1
+    if major == CBOR_MAJOR_TAG:
+        value, offset = _cbor_decode_item(data, offset)
+        # Object and array params are sent as text strings with embedded JSON
+        if arg == CBOR_TAG_EMBEDDED_JSON and isinstance(value, str):
+            value = json.loads(value)
+        return value, offset
+    # Simple values and floats
+    if info == 20:
+        return False, offset
+    if info == 21:
+        return True, offset
+    if info in (22, 23):
+        return None, offset
+    if info == 25:
+        return struct.unpack('>e', arg.to_bytes(2, 'big'))[0], offset
+    if info == 26:
+        return struct.unpack('>f', arg.to_bytes(4, 'big'))[0], offset
+    if info == 27:
+        return struct.unpack('>d', arg.to_bytes(8, 'big'))[0], offset
+    raise ValueError('Unsupported CBOR simple value ' + str(info))
+
+
+def decode_cbor(data):
+    """
+    Decode CBOR data, as used by nodes for the params payloads.
+
+    :param data: CBOR encoded data
+    :type data: bytes
+
+    :raises ValueError: If the data is not valid CBOR
+
+    :return: Decoded value
+    :rtype: dict | list | str | int | float | bool | None
+    """
+    try:
+        value, offset = _cbor_decode_item(data, 0)
+    except IndexError:
+        raise ValueError('Truncated CBOR data')
+    if offset != len(data):
+        raise ValueError('Unexpected data after CBOR data item')
+    return value
+
+
+def decode_node_params(data):
+    """
+    Decode node params, which are either JSON or CBOR encoded, as per the
+    "params_encoding" attribute in the node config.
+
+    :param data: Node params received from the node or cloud
+    :type data: bytes | str
+
+    :raises ValueError: If the data is neither valid JSON nor CBOR
+
+    :return: Node params
+    :rtype: dict
+    """
+    if isinstance(data, (bytes, bytearray)) and len(data) and \
+            data[0] >> 5 == CBOR_MAJOR_MAP:
+        return decode_cbor(data)
+    if isinstance(data, (bytes, bytearray)):
+        data = data.decode('utf-8')
+    return json.loads(data)
+
 
 class Node:
     """
@@ -169,7 +312,7 @@ class Node:
             log.debug(get_nodes_params_err)
             raise get_nodes_params_err
 
-        response = json.loads(response.text)
+        response = decode_node_params(response.content)
         if 'status' in response and response['status'] == 'failure':
             return None
         log.info("Received node parameters successfully.")
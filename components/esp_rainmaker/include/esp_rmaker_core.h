@@ -169,6 +169,9 @@ typedef struct {
  * The callback should call the esp_rmaker_param_update_and_report() API if the new value is to be set
  * and reported back.
  *
+ * @note For string, object and array values, val.val.s points directly into the received data
+ * and is valid only till the callback returns. It should be copied if required later.
+ *
  * @param[in] device Device handle.
  * @param[in] param Parameter handle.
  * @param[in] param Pointer to \ref esp_rmaker_param_val_t. Use appropriate elements as per the value type.
@@ -507,6 +510,29 @@ esp_err_t esp_rmaker_node_remove_device(const esp_rmaker_node_t *node, const esp
  */
 esp_err_t esp_rmaker_device_add_attribute(const esp_rmaker_device_t *device, const char *attr_name, const char *val);
 
+/** Set the reporting interval for a device/service
+ *
+ * By default, every call to esp_rmaker_param_update_and_report() results in an immediate
+ * report to the cloud. For params which change frequently (Eg. sensor readings), this API
+ * can be used to rate limit the reports. Changes made within the interval are held back
+ * and reported together, in a single message, along with changes in other devices which
+ * are due at the same time. Only the latest value of a param is reported.
+ *
+ * @note The defaults are as per CONFIG_ESP_RMAKER_PARAM_REPORT_MIN_INTERVAL and
+ * CONFIG_ESP_RMAKER_PARAM_REPORT_MAX_LATENCY.
+ *
+ * @param[in] device Device handle.
+ * @param[in] min_interval_ms Minimum time (in milliseconds) between two reports for this device.
+ * Set to 0 to report changes immediately.
+ * @param[in] max_latency_ms Maximum time (in milliseconds) for which a change can be held back.
+ * This takes precedence over min_interval_ms. Set to 0 for no limit.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t esp_rmaker_device_set_report_interval(const esp_rmaker_device_t *device, uint32_t min_interval_ms,
+        uint32_t max_latency_ms);
+
 /** Get device name from handle
  *
  * @param[in] device Device handle.
@@ -637,6 +663,24 @@ esp_err_t esp_rmaker_param_add_ui_type(const esp_rmaker_param_t *param, const ch
 esp_err_t esp_rmaker_param_add_bounds(const esp_rmaker_param_t *param,
     esp_rmaker_param_val_t min, esp_rmaker_param_val_t max, esp_rmaker_param_val_t step);
 
+/**
+ * Add a deadband for a float parameter
+ *
+ * Updates to the parameter which differ from the current value by less than or equal to the
+ * deadband are ignored i.e. they are neither stored nor reported. This is useful for sensor
+ * readings which keep fluctuating slightly.
+ * Eg. esp_rmaker_param_add_deadband(temperature_param, 0.1);
+ *
+ * @note This is applicable only if CONFIG_ESP_RMAKER_PARAM_SKIP_UNCHANGED is enabled.
+ *
+ * @param[in] param Parameter handle.
+ * @param[in] deadband Maximum change in value to be ignored. Default is 0.
+ *
+ * @return ESP_OK on success.
+ * return error in case of failure.
+ */
+esp_err_t esp_rmaker_param_add_deadband(const esp_rmaker_param_t *param, float deadband);
+
 /**
  * Add a list of valid strings for a string parameter
  *
@@ -677,6 +721,9 @@ esp_err_t esp_rmaker_param_add_array_max_count(const esp_rmaker_param_t *param,
  * Calling this API will update the parameter and report it to ESP RainMaker cloud.
  * This should be used whenever there is any local change.
  *
+ * @note If CONFIG_ESP_RMAKER_PARAM_SKIP_UNCHANGED is enabled, the value is neither stored nor
+ * reported if it is same as the current value (or within the deadband for float params).
+ *
  * @param[in] param Parameter handle.
  * @param[in] val New value of the parameter.
  *
@@ -685,6 +732,23 @@ esp_err_t esp_rmaker_param_add_array_max_count(const esp_rmaker_param_t *param,
  */
 esp_err_t esp_rmaker_param_update_and_report(const esp_rmaker_param_t *param, esp_rmaker_param_val_t val);
 
+/** Get the current value of a parameter
+ *
+ * This can be called from any task, concurrently with updates of the same parameter.
+ * Boolean, integer and float values are read without taking any lock, and so, this
+ * never blocks for such parameters.
+ *
+ * @note For string, object and array parameters, val->val.s is set to a copy of the value,
+ * which should be freed by the caller using free(). It is NULL if the parameter has no value.
+ *
+ * @param[in] param Parameter handle.
+ * @param[out] val Pointer to a value structure which will be populated.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t esp_rmaker_param_get_val(const esp_rmaker_param_t *param, esp_rmaker_param_val_t *val);
+
 /** Get parameter name from handle
  *
  * @param[in] param Parameter handle.
@@ -709,6 +773,24 @@ char *esp_rmaker_param_get_type(const esp_rmaker_param_t *param);
  */
 typedef void (*esp_rmaker_work_fn_t)(void *priv_data);
 
+/** Lanes of the ESP RainMaker Work Queue
+ *
+ * Each lane has a queue of its own, so that work in one lane is never dropped because some other
+ * lane is full. Pending control work always runs before pending report work. Long running jobs
+ * run in a separate task if CONFIG_ESP_RMAKER_WORK_JOB_TASK is enabled, and after all the other
+ * pending work otherwise.
+ */
+typedef enum {
+    /** Work which needs to be done promptly, like triggering schedules */
+    ESP_RMAKER_WORK_LANE_CONTROL = 0,
+    /** Reporting and other general work. This is the lane used by esp_rmaker_queue_work() */
+    ESP_RMAKER_WORK_LANE_REPORT,
+    /** Long running work, like firmware downloads */
+    ESP_RMAKER_WORK_LANE_JOB,
+    /** Number of lanes. Not a valid lane */
+    ESP_RMAKER_WORK_LANE_MAX,
+} esp_rmaker_work_lane_t;
+
 /** Report the node details to the cloud
  *
  * This API reports node details i.e. the node configuration and values of all the parameters to the ESP RainMaker cloud.
@@ -735,6 +817,22 @@ esp_err_t esp_rmaker_report_node_details(void);
  */
 esp_err_t esp_rmaker_queue_work(esp_rmaker_work_fn_t work_fn, void *priv_data);
 
+/** Queue execution of a function in ESP RainMaker's context, in the given lane
+ *
+ * Same as esp_rmaker_queue_work(), but lets the work be queued in a lane as per its urgency.
+ * Work which can run for long, like a firmware download, should be queued in the
+ * \ref ESP_RMAKER_WORK_LANE_JOB lane, so that it does not hold back other work.
+ *
+ * @param[in] lane The lane in which the work should be queued.
+ * @param[in] work_fn The Work function to be queued.
+ * @param[in] priv_data Private data to be passed to the work function.
+ *
+ * @return ESP_OK on success.
+ * @return ESP_ERR_NO_MEM if the lane is full.
+ * @return error in case of other failures.
+ */
+esp_err_t esp_rmaker_queue_work_on_lane(esp_rmaker_work_lane_t lane, esp_rmaker_work_fn_t work_fn, void *priv_data);
+
 #ifdef __cplusplus
 }
 #endif
@@ -13,6 +13,7 @@
 // limitations under the License.
 #pragma once
 #include <stdint.h>
+#include <stdbool.h>
 #include <esp_err.h>
 
 #ifdef __cplusplus
@@ -34,6 +35,33 @@ typedef struct {
     char *server_cert;
 } esp_rmaker_mqtt_config_t;
 
+/** Priority classes for the published messages
+ *
+ * Higher priority messages are sent ahead of any lower priority ones waiting to be sent.
+ */
+typedef enum {
+    /** Control critical messages, like user node mapping */
+    ESP_RMAKER_MQTT_PRIO_CONTROL = 0,
+    /** User facing state reports, like param values. This is the default priority */
+    ESP_RMAKER_MQTT_PRIO_STATE,
+    /** Telemetry, like time series data */
+    ESP_RMAKER_MQTT_PRIO_TELEMETRY,
+    /** Bulk data, like the node configuration */
+    ESP_RMAKER_MQTT_PRIO_BULK,
+    /** Number of priority classes. Not to be used as a priority */
+    ESP_RMAKER_MQTT_PRIO_MAX,
+} esp_rmaker_mqtt_prio_t;
+
+/** Statistics of the messages published, but not yet acknowledged by the broker */
+typedef struct {
+    /** Number of QoS 1 messages sent, but awaiting acknowledgement from the broker */
+    uint32_t inflight;
+    /** Number of messages waiting to be sent, for each priority class */
+    uint32_t queued[ESP_RMAKER_MQTT_PRIO_MAX];
+    /** Total size of the data of all the messages waiting to be sent */
+    size_t queued_bytes;
+} esp_rmaker_mqtt_outbox_stats_t;
+
 /** ESP RainMaker MQTT Subscribe callback prototype
  *
  * @param[in] topic Topic on which the message was received
@@ -42,6 +70,22 @@ typedef struct {
  * @param[in] priv_data The private data passed during subscription
  */
 typedef void (*esp_rmaker_mqtt_subscribe_cb_t) (const char *topic, void *payload, size_t payload_len, void *priv_data);
+
+/** ESP RainMaker MQTT Streaming Subscribe callback prototype
+ *
+ * Messages longer than the MQTT buffer are received in fragments. This callback is invoked for
+ * each fragment, in order, as it is received.
+ *
+ * @param[in] topic Topic on which the message was received
+ * @param[in] data Data in this fragment. Valid only till the callback returns.
+ * @param[in] data_len Length of the data in this fragment
+ * @param[in] offset Offset of this fragment in the complete message
+ * @param[in] total_len Length of the complete message. The fragment with
+ * offset + data_len == total_len is the last one.
+ * @param[in] priv_data The private data passed during subscription
+ */
+typedef void (*esp_rmaker_mqtt_stream_cb_t) (const char *topic, void *data, size_t data_len, size_t offset,
+        size_t total_len, void *priv_data);
    
 /** Initialize ESP RainMaker MQTT
  *
@@ -73,17 +117,65 @@ esp_err_t esp_rmaker_mqtt_connect(void);
 esp_err_t esp_rmaker_mqtt_disconnect(void);
 
 /** Publish MQTT Message
+ *
+ * If MQTT is disconnected, and CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE is enabled, a copy of the
+ * message is queued, and published once MQTT reconnects.
  *
  * @param[in] topic The MQTT topic on which the message should be published.
  * @param[in] data Data to be published
  * @param[in] data_len Length of the data
  *
- * @return ESP_OK on success.
+ * @return ESP_OK on success (or if the message was queued).
  * @return error in case of any error.
  */
 esp_err_t esp_rmaker_mqtt_publish(const char *topic, void *data, size_t data_len);
 
+/** Publish MQTT Message with the given QoS and priority
+ *
+ * At most CONFIG_ESP_RMAKER_MQTT_MAX_INFLIGHT QoS 1 messages are kept awaiting acknowledgement from
+ * the broker. Messages published beyond that are copied and queued, and sent as the acknowledgements
+ * come in, highest priority first. esp_rmaker_mqtt_publish() uses QoS 1 and ESP_RMAKER_MQTT_PRIO_STATE.
+ *
+ * If MQTT is disconnected, QoS 1 messages are queued as in esp_rmaker_mqtt_publish(), but without
+ * the priority, and QoS 0 messages are dropped.
+ *
+ * @param[in] topic The MQTT topic on which the message should be published.
+ * @param[in] data Data to be published
+ * @param[in] data_len Length of the data
+ * @param[in] qos QoS for the message. 0 or 1.
+ * @param[in] prio Priority class of the message.
+ *
+ * @return ESP_OK on success (or if the message was queued).
+ * @return ESP_ERR_NO_MEM if the publish queue is full. The caller can then back off, and use
+ * esp_rmaker_mqtt_get_outbox_stats() to find when the queue has drained.
+ * @return error in case of any other error.
+ */
+esp_err_t esp_rmaker_mqtt_publish_with_prio(const char *topic, void *data, size_t data_len,
+        uint8_t qos, esp_rmaker_mqtt_prio_t prio);
+
+/** Get the statistics of the messages yet to be acknowledged by the broker
+ *
+ * This can be used for backpressure, Eg. to hold back telemetry while many messages are pending.
+ *
+ * @param[out] stats Pointer to a structure which will be populated with the statistics.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of any error.
+ */
+esp_err_t esp_rmaker_mqtt_get_outbox_stats(esp_rmaker_mqtt_outbox_stats_t *stats);
+
+/** Check if MQTT is connected
+ *
+ * @return true if MQTT is connected.
+ * @return false if MQTT is not connected, or not yet initialised.
+ */
+bool esp_rmaker_mqtt_is_connected(void);
+
 /** Subscribe to MQTT topic
+ *
+ * The topic can have the MQTT wildcards '+' (single level) and '#' (multi level). The callback
+ * gets the actual topic on which the message was received. The callbacks can subscribe/unsubscribe
+ * as well.
  *
  * @param[in] topic The topic to be subscribed to.
  * @param[in] cb The callback to be invoked when a message is received on the given topic.
@@ -94,7 +186,24 @@ esp_err_t esp_rmaker_mqtt_publish(const char *topic, void *data, size_t data_len
  */
 esp_err_t esp_rmaker_mqtt_subscribe(const char *topic, esp_rmaker_mqtt_subscribe_cb_t cb, void *priv_data);
 
+/** Subscribe to MQTT topic, for streaming delivery
+ *
+ * Same as esp_rmaker_mqtt_subscribe(), except that long messages are not reassembled, but passed
+ * on to the callback fragment by fragment. Useful for consumers which can process the data
+ * incrementally, since no buffer is required for the complete message.
+ *
+ * @param[in] topic The topic to be subscribed to.
+ * @param[in] cb The callback to be invoked for the fragments of the messages received on the given topic.
+ * @param[in] priv_data Optional private data to be passed to the callback
+ *
+ * @return ESP_OK on success.
+ * @return error in case of any error.
+ */
+esp_err_t esp_rmaker_mqtt_subscribe_stream(const char *topic, esp_rmaker_mqtt_stream_cb_t cb, void *priv_data);
+
 /** Unsubscribe from MQTT topic
+ *
+ * All the subscriptions made for exactly this topic are removed.
  *
  * @param[in] topic Topic from which to unsubscribe.
  *
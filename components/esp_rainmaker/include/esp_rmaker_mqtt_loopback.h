@@ -0,0 +1,114 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+#include <esp_rmaker_mqtt_transport.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** ESP RainMaker MQTT Loopback Transport
+ *
+ * An in-process stand-in for the MQTT broker, to run the ESP RainMaker core without a network
+ * connection, Eg. for tests and benchmarks. Set it using esp_rmaker_mqtt_set_transport() before
+ * initialising ESP RainMaker. The test then plays the role of the cloud, by observing the messages
+ * published by the node, and injecting messages for it.
+ *
+ * The connection is reported as soon as esp_rmaker_mqtt_connect() is called. All other events,
+ * like the received messages and the acknowledgements of the published ones, are delivered only
+ * when esp_rmaker_mqtt_loopback_process() is called, so that tests are deterministic.
+ */
+extern const esp_rmaker_mqtt_transport_t esp_rmaker_mqtt_loopback_transport;
+
+/** Callback for the messages published by the node
+ *
+ * This is invoked synchronously, from within the publish call of the node, and so, it should not
+ * call any ESP RainMaker APIs.
+ *
+ * @param[in] topic Topic of the message.
+ * @param[in] data Data of the message. Valid only till the callback returns.
+ * @param[in] data_len Length of the data.
+ * @param[in] qos QoS of the message.
+ * @param[in] priv_data The private data passed to esp_rmaker_mqtt_loopback_set_publish_cb().
+ */
+typedef void (*esp_rmaker_mqtt_loopback_publish_cb_t)(const char *topic, const void *data, size_t data_len,
+        int qos, void *priv_data);
+
+/** Set the callback for the messages published by the node
+ *
+ * @param[in] cb The callback. NULL to remove it.
+ * @param[in] priv_data Private data to be passed to the callback.
+ *
+ * @return ESP_OK on success.
+ */
+esp_err_t esp_rmaker_mqtt_loopback_set_publish_cb(esp_rmaker_mqtt_loopback_publish_cb_t cb, void *priv_data);
+
+/** Send a message to the node, as if it was received from the broker
+ *
+ * The message is delivered on the next call to esp_rmaker_mqtt_loopback_process().
+ *
+ * @param[in] topic Topic of the message.
+ * @param[in] data Data of the message. This is copied.
+ * @param[in] data_len Length of the data.
+ *
+ * @return ESP_OK on success.
+ * @return ESP_ERR_INVALID_STATE if not connected.
+ * @return ESP_ERR_NOT_FOUND if the node has not subscribed to the topic.
+ * @return error in case of any other error.
+ */
+esp_err_t esp_rmaker_mqtt_loopback_inject(const char *topic, const void *data, size_t data_len);
+
+/** Set the size of the fragments in which the received messages are delivered
+ *
+ * Messages longer than this are delivered in multiple fragments, like those longer than the
+ * buffer of a real MQTT client.
+ *
+ * @param[in] fragment_size Size of the fragments. 0 for delivering all messages in one go.
+ *
+ * @return ESP_OK on success.
+ */
+esp_err_t esp_rmaker_mqtt_loopback_set_fragment_size(size_t fragment_size);
+
+/** Deliver all the pending events to the node
+ *
+ * This includes any events generated while delivering the events, Eg. the acknowledgement for a
+ * message published by a callback.
+ *
+ * @return The number of events delivered.
+ */
+int esp_rmaker_mqtt_loopback_process(void);
+
+/** Simulate a loss of the connection to the broker
+ *
+ * Any pending events are discarded, and publishing fails until the connection is restored.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of any error.
+ */
+esp_err_t esp_rmaker_mqtt_loopback_drop_connection(void);
+
+/** Restore the connection after esp_rmaker_mqtt_loopback_drop_connection()
+ *
+ * @return ESP_OK on success.
+ * @return error in case of any error.
+ */
+esp_err_t esp_rmaker_mqtt_loopback_restore_connection(void);
+
+#ifdef __cplusplus
+}
+#endif
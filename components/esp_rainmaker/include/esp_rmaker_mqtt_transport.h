@@ -0,0 +1,93 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+#include <esp_rmaker_mqtt.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** ESP RainMaker MQTT Transport
+ *
+ * The MQTT client used by ESP RainMaker. By default, this is the ESP-MQTT client, connecting to the
+ * ESP RainMaker MQTT broker over TLS, but it can be replaced, Eg. by the loopback transport for
+ * running the core without a network connection.
+ *
+ * A transport reports the connection state and the received messages using the
+ * esp_rmaker_mqtt_transport_on_*() functions. The transport APIs can be called from within
+ * those, and so, a transport should not hold any non recursive lock while calling them.
+ */
+typedef struct {
+    /** Name of the transport, for logging */
+    const char *name;
+    /** Initialise the transport with the given configuration. Returns a handle for the other APIs, or NULL on error */
+    void *(*init)(esp_rmaker_mqtt_config_t *config);
+    /** Start connecting. The connection is reported using esp_rmaker_mqtt_transport_on_connected() */
+    esp_err_t (*connect)(void *handle);
+    /** Disconnect, and stop any further attempts to connect */
+    esp_err_t (*disconnect)(void *handle);
+    /** Publish a message. Returns the message id (0 for QoS 0), or -1 on error. The data is not
+     * referred to after this returns.
+     */
+    int (*publish)(void *handle, const char *topic, const void *data, size_t data_len, int qos);
+    /** Subscribe to a topic filter. Returns a message id, or -1 on error */
+    int (*subscribe)(void *handle, const char *topic, int qos);
+    /** Unsubscribe from a topic filter. Returns a message id, or -1 on error */
+    int (*unsubscribe)(void *handle, const char *topic);
+} esp_rmaker_mqtt_transport_t;
+
+/** The default transport, using the ESP-MQTT client */
+extern const esp_rmaker_mqtt_transport_t esp_rmaker_mqtt_esp_mqtt_transport;
+
+/** Set the MQTT transport
+ *
+ * This should be called before esp_rmaker_mqtt_init() (which is called internally by esp_rmaker_node_init()).
+ *
+ * @param[in] transport Pointer to the transport. This should remain valid for as long as MQTT is in use.
+ *
+ * @return ESP_OK on success.
+ * @return ESP_ERR_INVALID_STATE if MQTT has already been initialised.
+ * @return error in case of any other error.
+ */
+esp_err_t esp_rmaker_mqtt_set_transport(const esp_rmaker_mqtt_transport_t *transport);
+
+/** To be called by the transport once connected to the broker */
+void esp_rmaker_mqtt_transport_on_connected(void);
+
+/** To be called by the transport on getting disconnected from the broker */
+void esp_rmaker_mqtt_transport_on_disconnected(void);
+
+/** To be called by the transport on getting the acknowledgement for a published QoS 1 message */
+void esp_rmaker_mqtt_transport_on_published(int msg_id);
+
+/** To be called by the transport on receiving a message, or a fragment of it
+ *
+ * @param[in] msg_id Message id. This should be the same for all the fragments of a message.
+ * @param[in] topic Topic of the message. This is required only for the first fragment.
+ * @param[in] topic_len Length of the topic.
+ * @param[in] data Data in this fragment.
+ * @param[in] data_len Length of the data in this fragment.
+ * @param[in] offset Offset of this fragment in the complete message.
+ * @param[in] total_len Length of the complete message.
+ */
+void esp_rmaker_mqtt_transport_on_data(int msg_id, const char *topic, size_t topic_len,
+        const char *data, size_t data_len, size_t offset, size_t total_len);
+
+#ifdef __cplusplus
+}
+#endif
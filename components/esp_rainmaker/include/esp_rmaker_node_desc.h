@@ -0,0 +1,155 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_rmaker_core.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** Constant initialisers for \ref esp_rmaker_param_val_t, for use in descriptors.
+ * These are the compile time equivalents of esp_rmaker_bool(), esp_rmaker_int(), etc.
+ */
+#define ESP_RMAKER_VAL_BOOL(x)      { .type = RMAKER_VAL_TYPE_BOOLEAN, .val = { .b = (x) } }
+#define ESP_RMAKER_VAL_INT(x)       { .type = RMAKER_VAL_TYPE_INTEGER, .val = { .i = (x) } }
+#define ESP_RMAKER_VAL_FLOAT(x)     { .type = RMAKER_VAL_TYPE_FLOAT, .val = { .f = (x) } }
+#define ESP_RMAKER_VAL_STR(x)       { .type = RMAKER_VAL_TYPE_STRING, .val = { .s = (char *)(x) } }
+#define ESP_RMAKER_VAL_OBJ(x)       { .type = RMAKER_VAL_TYPE_OBJECT, .val = { .s = (char *)(x) } }
+#define ESP_RMAKER_VAL_ARRAY(x)     { .type = RMAKER_VAL_TYPE_ARRAY, .val = { .s = (char *)(x) } }
+
+/** Bounds of an integer/float parameter, or the max count of an array parameter (in max) */
+typedef struct {
+    /** Minimum allowed value */
+    esp_rmaker_param_val_t min;
+    /** Maximum allowed value */
+    esp_rmaker_param_val_t max;
+    /** Minimum stepping */
+    esp_rmaker_param_val_t step;
+} esp_rmaker_param_bounds_t;
+
+/** Valid values of a string parameter */
+typedef struct {
+    /** Number of strings in str_list */
+    uint8_t str_list_cnt;
+    /** Array of valid strings */
+    const char **str_list;
+} esp_rmaker_param_valid_str_list_t;
+
+/** Parameter Descriptor */
+typedef struct {
+    /** Name of the parameter. Should be unique in the device */
+    const char *name;
+    /** Optional parameter type. Can be NULL */
+    const char *type;
+    /** Optional UI type. Can be NULL */
+    const char *ui_type;
+    /** Initial value. This also specifies the value type of the parameter. Use the ESP_RMAKER_VAL_*() macros */
+    esp_rmaker_param_val_t val;
+    /** Properties, as a logical OR of flags in \ref esp_param_property_flags_t */
+    uint8_t properties;
+    /** Optional bounds. Can be NULL */
+    const esp_rmaker_param_bounds_t *bounds;
+    /** Optional list of valid strings, for string parameters. Can be NULL */
+    const esp_rmaker_param_valid_str_list_t *valid_strs;
+} esp_rmaker_param_desc_t;
+
+/** Device (or Service) Descriptor */
+typedef struct {
+    /** Name of the device. Should be unique in the node */
+    const char *name;
+    /** Optional device type. Can be NULL */
+    const char *type;
+    /** True for a service */
+    bool is_service;
+    /** Array of parameter descriptors */
+    const esp_rmaker_param_desc_t *params;
+    /** Number of entries in params */
+    uint8_t params_count;
+    /** Index of the primary parameter in params, or -1 if there is none */
+    int8_t primary_param;
+    /** Optional write callback. Can be NULL */
+    esp_rmaker_device_write_cb_t write_cb;
+    /** Optional read callback. Can be NULL */
+    esp_rmaker_device_read_cb_t read_cb;
+} esp_rmaker_device_desc_t;
+
+/** Initialiser for a \ref esp_rmaker_param_desc_t without bounds or valid strings */
+#define ESP_RMAKER_PARAM_DESC(_name, _type, _ui_type, _val, _properties) \
+    { .name = (_name), .type = (_type), .ui_type = (_ui_type), .val = _val, .properties = (_properties) }
+
+/** Initialiser for a \ref esp_rmaker_device_desc_t with a static array of parameter descriptors */
+#define ESP_RMAKER_DEVICE_DESC(_name, _type, _params, _primary_param, _write_cb) \
+    { .name = (_name), .type = (_type), .params = (_params), \
+      .params_count = sizeof(_params) / sizeof((_params)[0]), .primary_param = (_primary_param), \
+      .write_cb = (_write_cb) }
+
+/**
+ * Create a Device (or Service) from a const descriptor
+ *
+ * This creates the device and all its parameters in one go, from a descriptor which can be
+ * defined as const data, and so, stays in flash. The names, types, UI types, bounds and valid
+ * strings are referred to directly, rather than being copied to the heap, and the device with
+ * all its parameters takes a single allocation. Only the values are held in RAM.
+ *
+ * Eg.
+ * @code{c}
+ * static const esp_rmaker_param_bounds_t brightness_bounds = {
+ *     .min = ESP_RMAKER_VAL_INT(0), .max = ESP_RMAKER_VAL_INT(100), .step = ESP_RMAKER_VAL_INT(1),
+ * };
+ * static const esp_rmaker_param_desc_t light_params[] = {
+ *     ESP_RMAKER_PARAM_DESC(ESP_RMAKER_DEF_NAME_PARAM, ESP_RMAKER_PARAM_NAME, ESP_RMAKER_UI_TEXT,
+ *             ESP_RMAKER_VAL_STR("Light"), PROP_FLAG_READ | PROP_FLAG_WRITE | PROP_FLAG_PERSIST),
+ *     ESP_RMAKER_PARAM_DESC(ESP_RMAKER_DEF_POWER_NAME, ESP_RMAKER_PARAM_POWER, ESP_RMAKER_UI_TOGGLE,
+ *             ESP_RMAKER_VAL_BOOL(true), PROP_FLAG_READ | PROP_FLAG_WRITE),
+ *     {
+ *         .name = ESP_RMAKER_DEF_BRIGHTNESS_NAME, .type = ESP_RMAKER_PARAM_BRIGHTNESS,
+ *         .ui_type = ESP_RMAKER_UI_SLIDER, .val = ESP_RMAKER_VAL_INT(50),
+ *         .properties = PROP_FLAG_READ | PROP_FLAG_WRITE, .bounds = &brightness_bounds,
+ *     },
+ * };
+ * static const esp_rmaker_device_desc_t light_desc = ESP_RMAKER_DEVICE_DESC("Light",
+ *         ESP_RMAKER_DEVICE_LIGHTBULB, light_params, 1, write_cb);
+ *
+ * esp_rmaker_device_t *light = esp_rmaker_device_create_from_desc(&light_desc, NULL);
+ * esp_rmaker_node_add_device(node, light);
+ * @endcode
+ *
+ * @note The descriptor, and everything it points to, should stay valid throughout the lifetime of
+ * the device. Parameters created this way cannot have their UI type, bounds or valid strings changed
+ * using the esp_rmaker_param_add_*() APIs. Other parameters and attributes can be added to the device
+ * as usual.
+ * @note With CONFIG_ESP_RMAKER_MODEL_ARENA, the device is allocated from the arena only if it fits in
+ * a quarter of CONFIG_ESP_RMAKER_MODEL_ARENA_CHUNK_SIZE, which, with the default chunk size, is enough
+ * only for devices with one or two parameters. Larger devices are allocated from the heap directly,
+ * still as a single block.
+ * @note The write callback is registered before the parameters are added, so that it gets invoked
+ * with the values of persistent parameters restored from NVS, if any.
+ *
+ * @param[in] desc Pointer to the device descriptor.
+ * @param[in] priv_data (Optional) Private data associated with the device. This will be passed to callbacks.
+ * It should stay allocated throughout the lifetime of the device.
+ *
+ * @return Device handle on success.
+ * @return NULL in case of any error.
+ */
+esp_rmaker_device_t *esp_rmaker_device_create_from_desc(const esp_rmaker_device_desc_t *desc, void *priv_data);
+
+#ifdef __cplusplus
+}
+#endif
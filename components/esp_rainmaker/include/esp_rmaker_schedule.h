@@ -19,6 +19,11 @@ extern "C"
 {
 #endif
 
+/** Name of the node attribute with the location of the node, which is required for sunrise and sunset schedules.
+ * The value should be the latitude and longitude in degrees, separated by a comma. Eg. "18.52,73.85"
+ */
+#define ESP_RMAKER_SCHEDULE_LOCATION_ATTR "lat_long"
+
 /** Enable Schedules
  *
  * This API enables the scheduling service for the node. For more information,
@@ -26,7 +31,14 @@ extern "C"
  *
  * It is recommended to set the timezone while using schedules. Check [here](https://rainmaker.espressif.com/docs/time-service.html#time-zone) for more information on timezones
  *
+ * Apart from the time of the day, schedules can trigger at an offset from the sunrise or sunset, which are
+ * computed on the node from the location in the ESP_RMAKER_SCHEDULE_LOCATION_ATTR node attribute, or some minutes
+ * after another schedule triggers.
+ *
  * @note This API should be called after esp_rmaker_node_init() but before esp_rmaker_start().
+ * @note For sunrise and sunset schedules, the ESP_RMAKER_SCHEDULE_LOCATION_ATTR node attribute should be added
+ * before calling this API, since the schedules stored on the node are loaded here. Sunrise and sunset schedules
+ * found without a valid location are kept, but disabled, and can be enabled once the attribute is added.
  *
  * @return ESP_OK on success.
  * @return error in case of failure.
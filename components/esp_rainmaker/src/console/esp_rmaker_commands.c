@@ -36,6 +36,8 @@
 #include <esp_rmaker_utils.h>
 
 #include <esp_rmaker_console_internal.h>
+#include <esp_rmaker_internal.h>
+#include <esp_rmaker_mem.h>
 
 static const char *TAG = "esp_rmaker_commands";
 
@@ -102,6 +104,81 @@ static int mem_dump_cli_handler(int argc, char *argv[])
     return 0;
 }
 
+static int rmaker_mem_dump_cli_handler(int argc, char *argv[])
+{
+#ifdef CONFIG_ESP_RMAKER_MEM_STATS
+    if ((argc == 2) && (strcmp(argv[1], "reset") == 0)) {
+        esp_rmaker_mem_reset_peaks();
+        return 0;
+    }
+    printf("Subsystem\tCurrent\t\tPeak\t\tBlocks\t\tAllocs\t\tFailed\n");
+    for (int i = 0; i < ESP_RMAKER_MEM_TAG_MAX; i++) {
+        esp_rmaker_mem_stats_t stats;
+        esp_rmaker_mem_get_stats(i, &stats);
+        printf("%-10s\t%u\t\t%u\t\t%u\t\t%u\t\t%u\n", esp_rmaker_mem_tag_name(i), stats.cur_bytes,
+               stats.peak_bytes, stats.cur_allocs, stats.total_allocs, stats.failed_allocs);
+    }
+    return 0;
+#else
+    printf("%s: Enable CONFIG_ESP_RMAKER_MEM_STATS to get the RainMaker heap usage\n", TAG);
+    return -1;
+#endif /* !CONFIG_ESP_RMAKER_MEM_STATS */
+}
+
+static int work_queue_dump_cli_handler(int argc, char *argv[])
+{
+    if ((argc == 2) && (strcmp(argv[1], "reset") == 0)) {
+        if (esp_rmaker_work_queue_reset_stats() != ESP_OK) {
+            printf("%s: Failed to reset work queue stats\n", TAG);
+            return -1;
+        }
+        return 0;
+    }
+    esp_rmaker_work_queue_stats_t stats;
+    if (esp_rmaker_work_queue_get_stats(&stats) != ESP_OK) {
+        printf("%s: Failed to get work queue stats. Is RainMaker initialised?\n", TAG);
+        return -1;
+    }
+    const uint32_t bounds[] = ESP_RMAKER_WORK_LATENCY_BUCKET_BOUNDS;
+    esp_rmaker_work_lane_stats_t *lanes = stats.lanes;
+    int lane;
+    printf("%-20s", "Lane");
+    for (lane = 0; lane < ESP_RMAKER_WORK_LANE_MAX; lane++) {
+        printf("%10s", esp_rmaker_work_lane_to_str(lane));
+    }
+    printf("\n%-20s", "Queued");
+    for (lane = 0; lane < ESP_RMAKER_WORK_LANE_MAX; lane++) {
+        printf("%10u", lanes[lane].queued);
+    }
+    printf("\n%-20s", "Dropped");
+    for (lane = 0; lane < ESP_RMAKER_WORK_LANE_MAX; lane++) {
+        printf("%10u", lanes[lane].dropped);
+    }
+    printf("\n%-20s", "Executed");
+    for (lane = 0; lane < ESP_RMAKER_WORK_LANE_MAX; lane++) {
+        printf("%10u", lanes[lane].processed);
+    }
+    printf("\n%-20s", "Max. latency (us)");
+    for (lane = 0; lane < ESP_RMAKER_WORK_LANE_MAX; lane++) {
+        printf("%10u", lanes[lane].max_latency_us);
+    }
+    printf("\nQueue latency\n");
+    for (int i = 0; i < ESP_RMAKER_WORK_LATENCY_BUCKETS; i++) {
+        char bucket[20];
+        if (i < ESP_RMAKER_WORK_LATENCY_BUCKETS - 1) {
+            snprintf(bucket, sizeof(bucket), "< %u us", bounds[i]);
+        } else {
+            snprintf(bucket, sizeof(bucket), ">= %u us", bounds[i - 1]);
+        }
+        printf("%-20s", bucket);
+        for (lane = 0; lane < ESP_RMAKER_WORK_LANE_MAX; lane++) {
+            printf("%10u", lanes[lane].latency_hist[i]);
+        }
+        printf("\n");
+    }
+    return 0;
+}
+
 static int sock_dump_cli_handler(int argc, char *argv[])
 {
     int i, ret, used_sockets = 0;
@@ -235,6 +312,11 @@ static int register_generic_debug_commands()
             .help = "Get the available memory.",
             .func = mem_dump_cli_handler,
         },
+        {
+            .command = "rmaker-mem-dump",
+            .help = "Get the heap usage of each RainMaker subsystem. Usage: rmaker-mem-dump [reset]",
+            .func = rmaker_mem_dump_cli_handler,
+        },
         {
             .command = "task-dump",
             .help = "Get the list of all the running tasks.",
@@ -250,6 +332,11 @@ static int register_generic_debug_commands()
             .help = "Get the list of all the active sockets.",
             .func = sock_dump_cli_handler,
         },
+        {
+            .command = "work-queue-dump",
+            .help = "Get the RainMaker work queue statistics per lane. Usage: work-queue-dump [reset]",
+            .func = work_queue_dump_cli_handler,
+        },
         {
             .command = "heap-trace",
             .help = "Start or stop heap tracing. Usage: heap-trace <start|stop> <bufer_size>",
@@ -0,0 +1,188 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "esp_rmaker_internal.h"
+#include "esp_rmaker_arena.h"
+
+#define ARENA_CHUNK_SIZE        CONFIG_ESP_RMAKER_MODEL_ARENA_CHUNK_SIZE
+/* Larger allocations go to the heap, so that they do not waste the rest of a chunk */
+#define ARENA_MAX_ALLOC_SIZE    (ARENA_CHUNK_SIZE / 4)
+#define ARENA_ALIGN(x)          (((x) + 7) & ~7)
+
+static const char *TAG = "esp_rmaker_arena";
+
+typedef struct esp_rmaker_arena_chunk {
+    struct esp_rmaker_arena_chunk *next;
+    size_t used;
+} esp_rmaker_arena_chunk_t;
+
+#define ARENA_CHUNK_HDR_SIZE    ARENA_ALIGN(sizeof(esp_rmaker_arena_chunk_t))
+
+typedef struct esp_rmaker_arena_str {
+    struct esp_rmaker_arena_str *next;
+    uint32_t hash;
+    char str[];
+} esp_rmaker_arena_str_t;
+
+static SemaphoreHandle_t arena_lock;
+/* The chunk being allocated from is at the head */
+static esp_rmaker_arena_chunk_t *arena_chunks;
+static esp_rmaker_arena_str_t *arena_strs;
+static bool arena_frozen;
+
+static bool esp_rmaker_arena_lock(void)
+{
+    /* The model is normally built from a single task, before esp_rmaker_start(), but the lock
+     * makes it safe to create devices and params from multiple tasks as well.
+     */
+    if (!arena_lock) {
+        arena_lock = xSemaphoreCreateMutex();
+        if (!arena_lock) {
+            ESP_LOGE(TAG, "Failed to create arena lock");
+            return false;
+        }
+    }
+    xSemaphoreTake(arena_lock, portMAX_DELAY);
+    return true;
+}
+
+static void esp_rmaker_arena_unlock(void)
+{
+    xSemaphoreGive(arena_lock);
+}
+
+/* Should be called with the arena lock held */
+static void *esp_rmaker_arena_alloc(size_t size)
+{
+    if (arena_frozen || (size > ARENA_MAX_ALLOC_SIZE)) {
+        return NULL;
+    }
+    size = ARENA_ALIGN(size);
+    esp_rmaker_arena_chunk_t *chunk = arena_chunks;
+    if (!chunk || (chunk->used + size > ARENA_CHUNK_SIZE)) {
+        /* The rest of the current chunk, if any, is left unused */
+        chunk = esp_rmaker_mem_calloc(ESP_RMAKER_MEM_CORE, 1, ARENA_CHUNK_SIZE);
+        if (!chunk) {
+            return NULL;
+        }
+        chunk->used = ARENA_CHUNK_HDR_SIZE;
+        chunk->next = arena_chunks;
+        arena_chunks = chunk;
+    }
+    void *ptr = (uint8_t *)chunk + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+void *esp_rmaker_arena_calloc(esp_rmaker_mem_tag_t tag, size_t size)
+{
+    void *ptr = NULL;
+    if (esp_rmaker_arena_lock()) {
+        /* Arena memory is never reused, and so, is still zeroed */
+        ptr = esp_rmaker_arena_alloc(size);
+        esp_rmaker_arena_unlock();
+    }
+    return ptr ? ptr : esp_rmaker_mem_calloc(tag, 1, size);
+}
+
+char *esp_rmaker_arena_strdup(esp_rmaker_mem_tag_t tag, const char *str)
+{
+    size_t len = strlen(str) + 1;
+    char *copy = esp_rmaker_arena_calloc(tag, len);
+    if (copy) {
+        memcpy(copy, str, len);
+    }
+    return copy;
+}
+
+char *esp_rmaker_arena_intern(esp_rmaker_mem_tag_t tag, const char *str)
+{
+    if (!esp_rmaker_arena_lock()) {
+        return esp_rmaker_mem_strdup(tag, str);
+    }
+    size_t len = strlen(str);
+    uint32_t hash = esp_rmaker_name_hash(str, len);
+    esp_rmaker_arena_str_t *entry;
+    for (entry = arena_strs; entry; entry = entry->next) {
+        if ((entry->hash == hash) && (strcmp(entry->str, str) == 0)) {
+            break;
+        }
+    }
+    if (!entry) {
+        entry = esp_rmaker_arena_alloc(sizeof(esp_rmaker_arena_str_t) + len + 1);
+        if (entry) {
+            entry->hash = hash;
+            memcpy(entry->str, str, len + 1);
+            entry->next = arena_strs;
+            arena_strs = entry;
+        }
+    }
+    esp_rmaker_arena_unlock();
+    /* Once the arena is frozen, or full, new strings just get a copy of their own on the heap */
+    return entry ? entry->str : esp_rmaker_mem_strdup(tag, str);
+}
+
+static bool esp_rmaker_arena_owns(const void *ptr)
+{
+    for (esp_rmaker_arena_chunk_t *chunk = arena_chunks; chunk; chunk = chunk->next) {
+        if (((const uint8_t *)ptr >= (const uint8_t *)chunk) &&
+                ((const uint8_t *)ptr < (const uint8_t *)chunk + ARENA_CHUNK_SIZE)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void esp_rmaker_arena_free(esp_rmaker_mem_tag_t tag, void *ptr)
+{
+    if (!ptr) {
+        return;
+    }
+    bool owned = false;
+    if (esp_rmaker_arena_lock()) {
+        owned = esp_rmaker_arena_owns(ptr);
+        esp_rmaker_arena_unlock();
+    }
+    if (!owned) {
+        esp_rmaker_mem_free(tag, ptr);
+    }
+}
+
+void esp_rmaker_arena_freeze(void)
+{
+    if (!esp_rmaker_arena_lock()) {
+        return;
+    }
+    if (!arena_frozen) {
+        arena_frozen = true;
+        int chunks = 0, strs = 0;
+        size_t unused = 0;
+        for (esp_rmaker_arena_chunk_t *chunk = arena_chunks; chunk; chunk = chunk->next) {
+            chunks++;
+            unused += ARENA_CHUNK_SIZE - chunk->used;
+        }
+        for (esp_rmaker_arena_str_t *entry = arena_strs; entry; entry = entry->next) {
+            strs++;
+        }
+        ESP_LOGI(TAG, "Node model arena frozen: %d chunks of %d bytes, %d bytes unused, %d interned strings.",
+                chunks, ARENA_CHUNK_SIZE, (int)unused, strs);
+    }
+    esp_rmaker_arena_unlock();
+}
@@ -0,0 +1,45 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include <stdint.h>
+#include <sdkconfig.h>
+#include "esp_rmaker_mem.h"
+
+/* Allocations for the node model, i.e. the node, devices, params and attributes, which are
+ * typically created once during init and live till reboot.
+ *
+ * With CONFIG_ESP_RMAKER_MODEL_ARENA, these are bump allocated from a few large chunks instead of
+ * hundreds of small heap blocks, and the type strings, which repeat across devices and params,
+ * are interned. esp_rmaker_arena_freeze(), called from esp_rmaker_start(), stops allocating
+ * from the arena. Anything created after that (Eg. devices added at runtime by a bridge) goes
+ * to the heap, as without the arena.
+ *
+ * esp_rmaker_arena_free() ignores memory which is in the arena, so that deleting an object
+ * does not need to know where it came from. Such memory is not reused.
+ */
+#ifdef CONFIG_ESP_RMAKER_MODEL_ARENA
+/* Zero initialised, like calloc() */
+void *esp_rmaker_arena_calloc(esp_rmaker_mem_tag_t tag, size_t size);
+char *esp_rmaker_arena_strdup(esp_rmaker_mem_tag_t tag, const char *str);
+/* Returns a shared copy of the string, which must not be modified */
+char *esp_rmaker_arena_intern(esp_rmaker_mem_tag_t tag, const char *str);
+void esp_rmaker_arena_free(esp_rmaker_mem_tag_t tag, void *ptr);
+void esp_rmaker_arena_freeze(void);
+#else
+#define esp_rmaker_arena_calloc(tag, size)      esp_rmaker_mem_calloc(tag, 1, size)
+#define esp_rmaker_arena_strdup(tag, str)       esp_rmaker_mem_strdup(tag, str)
+#define esp_rmaker_arena_intern(tag, str)       esp_rmaker_mem_strdup(tag, str)
+#define esp_rmaker_arena_free(tag, ptr)         esp_rmaker_mem_free(tag, ptr)
+#define esp_rmaker_arena_freeze()
+#endif /* !CONFIG_ESP_RMAKER_MODEL_ARENA */
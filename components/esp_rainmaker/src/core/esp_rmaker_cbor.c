@@ -0,0 +1,389 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <string.h>
+#include <math.h>
+
+#include "esp_rmaker_cbor.h"
+
+#define CBOR_INFO_UINT8         24
+#define CBOR_INFO_UINT16        25
+#define CBOR_INFO_UINT32        26
+#define CBOR_INFO_UINT64        27
+#define CBOR_INFO_INDEFINITE    31
+
+#define CBOR_SIMPLE_FALSE       20
+#define CBOR_SIMPLE_TRUE        21
+#define CBOR_SIMPLE_NULL        22
+#define CBOR_BREAK              0xff
+
+/* Maximum nesting of arrays/maps/tags which will be skipped while decoding */
+#define CBOR_MAX_SKIP_DEPTH     16
+
+static void esp_rmaker_cbor_enc_bytes(esp_rmaker_cbor_enc_t *enc, const void *data, size_t len)
+{
+    if (enc->overflow || (len > enc->buf_len - enc->offset)) {
+        enc->overflow = true;
+        return;
+    }
+    memcpy(enc->buf + enc->offset, data, len);
+    enc->offset += len;
+}
+
+static void esp_rmaker_cbor_enc_head(esp_rmaker_cbor_enc_t *enc, uint8_t major, uint64_t arg)
+{
+    uint8_t head[9];
+    size_t len;
+    if (arg < CBOR_INFO_UINT8) {
+        head[0] = (major << 5) | arg;
+        len = 1;
+    } else if (arg <= UINT8_MAX) {
+        head[0] = (major << 5) | CBOR_INFO_UINT8;
+        len = 2;
+    } else if (arg <= UINT16_MAX) {
+        head[0] = (major << 5) | CBOR_INFO_UINT16;
+        len = 3;
+    } else if (arg <= UINT32_MAX) {
+        head[0] = (major << 5) | CBOR_INFO_UINT32;
+        len = 5;
+    } else {
+        head[0] = (major << 5) | CBOR_INFO_UINT64;
+        len = 9;
+    }
+    /* Argument in network byte order */
+    for (size_t i = len - 1; i > 0; i--) {
+        head[i] = arg & 0xff;
+        arg >>= 8;
+    }
+    esp_rmaker_cbor_enc_bytes(enc, head, len);
+}
+
+void esp_rmaker_cbor_enc_start(esp_rmaker_cbor_enc_t *enc, uint8_t *buf, size_t buf_len)
+{
+    memset(enc, 0, sizeof(esp_rmaker_cbor_enc_t));
+    enc->buf = buf;
+    enc->buf_len = buf_len;
+}
+
+void esp_rmaker_cbor_enc_start_map(esp_rmaker_cbor_enc_t *enc)
+{
+    uint8_t head = (CBOR_MAJOR_MAP << 5) | CBOR_INFO_INDEFINITE;
+    esp_rmaker_cbor_enc_bytes(enc, &head, 1);
+}
+
+void esp_rmaker_cbor_enc_end_map(esp_rmaker_cbor_enc_t *enc)
+{
+    uint8_t brk = CBOR_BREAK;
+    esp_rmaker_cbor_enc_bytes(enc, &brk, 1);
+}
+
+void esp_rmaker_cbor_enc_text(esp_rmaker_cbor_enc_t *enc, const char *str)
+{
+    size_t len = str ? strlen(str) : 0;
+    esp_rmaker_cbor_enc_head(enc, CBOR_MAJOR_TEXT, len);
+    esp_rmaker_cbor_enc_bytes(enc, str, len);
+}
+
+void esp_rmaker_cbor_enc_int(esp_rmaker_cbor_enc_t *enc, int64_t val)
+{
+    if (val < 0) {
+        /* Negative integers are encoded as -1 - n */
+        esp_rmaker_cbor_enc_head(enc, CBOR_MAJOR_NINT, (uint64_t)(-1 - val));
+    } else {
+        esp_rmaker_cbor_enc_head(enc, CBOR_MAJOR_UINT, (uint64_t)val);
+    }
+}
+
+void esp_rmaker_cbor_enc_float(esp_rmaker_cbor_enc_t *enc, float val)
+{
+    uint32_t bits;
+    memcpy(&bits, &val, sizeof(bits));
+    uint8_t data[5] = {
+        (CBOR_MAJOR_SIMPLE << 5) | CBOR_INFO_UINT32,
+        bits >> 24, bits >> 16, bits >> 8, bits
+    };
+    esp_rmaker_cbor_enc_bytes(enc, data, sizeof(data));
+}
+
+void esp_rmaker_cbor_enc_bool(esp_rmaker_cbor_enc_t *enc, bool val)
+{
+    esp_rmaker_cbor_enc_head(enc, CBOR_MAJOR_SIMPLE, val ? CBOR_SIMPLE_TRUE : CBOR_SIMPLE_FALSE);
+}
+
+void esp_rmaker_cbor_enc_null(esp_rmaker_cbor_enc_t *enc)
+{
+    esp_rmaker_cbor_enc_head(enc, CBOR_MAJOR_SIMPLE, CBOR_SIMPLE_NULL);
+}
+
+void esp_rmaker_cbor_enc_tag(esp_rmaker_cbor_enc_t *enc, uint64_t tag)
+{
+    esp_rmaker_cbor_enc_head(enc, CBOR_MAJOR_TAG, tag);
+}
+
+int esp_rmaker_cbor_enc_end(esp_rmaker_cbor_enc_t *enc)
+{
+    if (enc->overflow) {
+        return -1;
+    }
+    return enc->offset;
+}
+
+void esp_rmaker_cbor_dec_start(esp_rmaker_cbor_dec_t *dec, uint8_t *buf, size_t buf_len)
+{
+    dec->buf = buf;
+    dec->buf_len = buf_len;
+    dec->offset = 0;
+}
+
+/* Parse the header at the current offset and return its length, or 0 if invalid */
+static size_t esp_rmaker_cbor_parse_head(esp_rmaker_cbor_dec_t *dec, esp_rmaker_cbor_item_t *item)
+{
+    if (dec->offset >= dec->buf_len) {
+        return 0;
+    }
+    const uint8_t *data = dec->buf + dec->offset;
+    size_t avail = dec->buf_len - dec->offset;
+    item->major = data[0] >> 5;
+    item->info = data[0] & 0x1f;
+    item->indefinite = false;
+    item->arg = 0;
+    size_t len;
+    if (item->info < CBOR_INFO_UINT8) {
+        item->arg = item->info;
+        return 1;
+    } else if (item->info <= CBOR_INFO_UINT64) {
+        len = 1 << (item->info - CBOR_INFO_UINT8);
+    } else if (item->info == CBOR_INFO_INDEFINITE) {
+        if ((item->major == CBOR_MAJOR_UINT) || (item->major == CBOR_MAJOR_NINT) ||
+                (item->major == CBOR_MAJOR_TAG)) {
+            return 0;
+        }
+        item->indefinite = true;
+        return 1;
+    } else {
+        /* Reserved values */
+        return 0;
+    }
+    if (avail < len + 1) {
+        return 0;
+    }
+    for (size_t i = 1; i <= len; i++) {
+        item->arg = (item->arg << 8) | data[i];
+    }
+    return len + 1;
+}
+
+esp_err_t esp_rmaker_cbor_dec_peek(esp_rmaker_cbor_dec_t *dec, esp_rmaker_cbor_item_t *item)
+{
+    return esp_rmaker_cbor_parse_head(dec, item) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_rmaker_cbor_dec_item(esp_rmaker_cbor_dec_t *dec, esp_rmaker_cbor_item_t *item)
+{
+    size_t len = esp_rmaker_cbor_parse_head(dec, item);
+    if (!len) {
+        return ESP_FAIL;
+    }
+    dec->offset += len;
+    return ESP_OK;
+}
+
+bool esp_rmaker_cbor_dec_break(esp_rmaker_cbor_dec_t *dec)
+{
+    if ((dec->offset < dec->buf_len) && (dec->buf[dec->offset] == CBOR_BREAK)) {
+        dec->offset++;
+        return true;
+    }
+    return false;
+}
+
+esp_err_t esp_rmaker_cbor_dec_text(esp_rmaker_cbor_dec_t *dec, const char **str, size_t *len)
+{
+    esp_rmaker_cbor_item_t item;
+    size_t head_len = esp_rmaker_cbor_parse_head(dec, &item);
+    if (!head_len || (item.major != CBOR_MAJOR_TEXT) || item.indefinite ||
+            (item.arg > dec->buf_len - dec->offset - head_len)) {
+        return ESP_FAIL;
+    }
+    dec->offset += head_len;
+    *str = (const char *)dec->buf + dec->offset;
+    *len = item.arg;
+    dec->offset += item.arg;
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_cbor_dec_text_in_place(esp_rmaker_cbor_dec_t *dec, esp_rmaker_cbor_text_t *text)
+{
+    const char *str;
+    size_t len;
+    if (esp_rmaker_cbor_dec_text(dec, &str, &len) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    /* The header is at least one byte long, and has already been consumed */
+    char *dst = (char *)str - 1;
+    text->header_byte = (uint8_t)*dst;
+    memmove(dst, str, len);
+    dst[len] = '\0';
+    text->str = dst;
+    text->len = len;
+    return ESP_OK;
+}
+
+void esp_rmaker_cbor_text_restore(esp_rmaker_cbor_text_t *text)
+{
+    memmove(text->str + 1, text->str, text->len);
+    text->str[0] = (char)text->header_byte;
+}
+
+esp_err_t esp_rmaker_cbor_dec_int(esp_rmaker_cbor_dec_t *dec, int64_t *val)
+{
+    esp_rmaker_cbor_item_t item;
+    size_t head_len = esp_rmaker_cbor_parse_head(dec, &item);
+    if (!head_len || (item.arg > INT64_MAX)) {
+        return ESP_FAIL;
+    }
+    if (item.major == CBOR_MAJOR_UINT) {
+        *val = (int64_t)item.arg;
+    } else if (item.major == CBOR_MAJOR_NINT) {
+        *val = -1 - (int64_t)item.arg;
+    } else {
+        return ESP_FAIL;
+    }
+    dec->offset += head_len;
+    return ESP_OK;
+}
+
+static float esp_rmaker_cbor_half_to_float(uint16_t half)
+{
+    int exp = (half >> 10) & 0x1f;
+    int mant = half & 0x3ff;
+    float val;
+    if (exp == 0) {
+        val = ldexpf(mant, -24);
+    } else if (exp != 31) {
+        val = ldexpf(mant + 1024, exp - 25);
+    } else {
+        val = mant ? NAN : INFINITY;
+    }
+    return (half & 0x8000) ? -val : val;
+}
+
+esp_err_t esp_rmaker_cbor_dec_float(esp_rmaker_cbor_dec_t *dec, float *val)
+{
+    esp_rmaker_cbor_item_t item;
+    size_t head_len = esp_rmaker_cbor_parse_head(dec, &item);
+    if (!head_len) {
+        return ESP_FAIL;
+    }
+    if ((item.major == CBOR_MAJOR_UINT) || (item.major == CBOR_MAJOR_NINT)) {
+        int64_t i_val;
+        if (esp_rmaker_cbor_dec_int(dec, &i_val) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        *val = (float)i_val;
+        return ESP_OK;
+    }
+    if (item.major != CBOR_MAJOR_SIMPLE) {
+        return ESP_FAIL;
+    }
+    if (item.info == CBOR_INFO_UINT16) {
+        *val = esp_rmaker_cbor_half_to_float(item.arg);
+    } else if (item.info == CBOR_INFO_UINT32) {
+        uint32_t bits = item.arg;
+        memcpy(val, &bits, sizeof(*val));
+    } else if (item.info == CBOR_INFO_UINT64) {
+        double d_val;
+        memcpy(&d_val, &item.arg, sizeof(d_val));
+        *val = (float)d_val;
+    } else {
+        return ESP_FAIL;
+    }
+    dec->offset += head_len;
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_cbor_dec_bool(esp_rmaker_cbor_dec_t *dec, bool *val)
+{
+    esp_rmaker_cbor_item_t item;
+    size_t head_len = esp_rmaker_cbor_parse_head(dec, &item);
+    if (!head_len || (item.major != CBOR_MAJOR_SIMPLE) ||
+            ((item.info != CBOR_SIMPLE_TRUE) && (item.info != CBOR_SIMPLE_FALSE))) {
+        return ESP_FAIL;
+    }
+    *val = (item.info == CBOR_SIMPLE_TRUE);
+    dec->offset += head_len;
+    return ESP_OK;
+}
+
+static esp_err_t esp_rmaker_cbor_dec_skip_depth(esp_rmaker_cbor_dec_t *dec, int depth)
+{
+    esp_rmaker_cbor_item_t item;
+    if ((depth > CBOR_MAX_SKIP_DEPTH) || (esp_rmaker_cbor_dec_item(dec, &item) != ESP_OK)) {
+        return ESP_FAIL;
+    }
+    switch (item.major) {
+        case CBOR_MAJOR_BYTES:
+        case CBOR_MAJOR_TEXT:
+            if (item.indefinite) {
+                /* Sequence of definite length chunks, ended by a break */
+                while (!esp_rmaker_cbor_dec_break(dec)) {
+                    if (esp_rmaker_cbor_dec_skip_depth(dec, depth + 1) != ESP_OK) {
+                        return ESP_FAIL;
+                    }
+                }
+            } else if (item.arg > dec->buf_len - dec->offset) {
+                return ESP_FAIL;
+            } else {
+                dec->offset += item.arg;
+            }
+            break;
+        case CBOR_MAJOR_ARRAY:
+        case CBOR_MAJOR_MAP: {
+            if (item.indefinite) {
+                while (!esp_rmaker_cbor_dec_break(dec)) {
+                    if (esp_rmaker_cbor_dec_skip_depth(dec, depth + 1) != ESP_OK) {
+                        return ESP_FAIL;
+                    }
+                }
+                break;
+            }
+            /* Every entry in a map has a key and a value */
+            uint64_t count = (item.major == CBOR_MAJOR_MAP) ? item.arg * 2 : item.arg;
+            if (count > dec->buf_len - dec->offset) {
+                return ESP_FAIL;
+            }
+            for (uint64_t i = 0; i < count; i++) {
+                if (esp_rmaker_cbor_dec_skip_depth(dec, depth + 1) != ESP_OK) {
+                    return ESP_FAIL;
+                }
+            }
+            break;
+        }
+        case CBOR_MAJOR_TAG:
+            return esp_rmaker_cbor_dec_skip_depth(dec, depth + 1);
+        case CBOR_MAJOR_SIMPLE:
+            /* A stray break is not a valid data item */
+            if (item.indefinite) {
+                return ESP_FAIL;
+            }
+            break;
+        default:
+            break;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_cbor_dec_skip(esp_rmaker_cbor_dec_t *dec)
+{
+    return esp_rmaker_cbor_dec_skip_depth(dec, 0);
+}
@@ -0,0 +1,106 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <esp_err.h>
+
+/* Minimal CBOR (RFC 7049) encoder and decoder, covering just what is required for
+ * the node params payloads: maps with text string keys, and integer, float, boolean,
+ * null and text string values.
+ */
+
+/** CBOR major types */
+#define CBOR_MAJOR_UINT         0
+#define CBOR_MAJOR_NINT         1
+#define CBOR_MAJOR_BYTES        2
+#define CBOR_MAJOR_TEXT         3
+#define CBOR_MAJOR_ARRAY        4
+#define CBOR_MAJOR_MAP          5
+#define CBOR_MAJOR_TAG          6
+#define CBOR_MAJOR_SIMPLE       7
+
+/** Tag for a text string holding embedded JSON. Used for object and array params */
+#define CBOR_TAG_EMBEDDED_JSON  262
+
+typedef struct {
+    uint8_t *buf;
+    size_t buf_len;
+    size_t offset;
+    /* Set if the buffer was not sufficient for the data */
+    bool overflow;
+} esp_rmaker_cbor_enc_t;
+
+void esp_rmaker_cbor_enc_start(esp_rmaker_cbor_enc_t *enc, uint8_t *buf, size_t buf_len);
+/* Start a map of unknown length. Has to be ended with esp_rmaker_cbor_enc_end_map() */
+void esp_rmaker_cbor_enc_start_map(esp_rmaker_cbor_enc_t *enc);
+void esp_rmaker_cbor_enc_end_map(esp_rmaker_cbor_enc_t *enc);
+void esp_rmaker_cbor_enc_text(esp_rmaker_cbor_enc_t *enc, const char *str);
+void esp_rmaker_cbor_enc_int(esp_rmaker_cbor_enc_t *enc, int64_t val);
+void esp_rmaker_cbor_enc_float(esp_rmaker_cbor_enc_t *enc, float val);
+void esp_rmaker_cbor_enc_bool(esp_rmaker_cbor_enc_t *enc, bool val);
+void esp_rmaker_cbor_enc_null(esp_rmaker_cbor_enc_t *enc);
+void esp_rmaker_cbor_enc_tag(esp_rmaker_cbor_enc_t *enc, uint64_t tag);
+/* Returns the length of the encoded data, or -1 if the buffer was not sufficient */
+int esp_rmaker_cbor_enc_end(esp_rmaker_cbor_enc_t *enc);
+
+typedef struct {
+    uint8_t *buf;
+    size_t buf_len;
+    size_t offset;
+} esp_rmaker_cbor_dec_t;
+
+/** Header of a CBOR data item */
+typedef struct {
+    uint8_t major;
+    /* Raw additional information from the initial byte */
+    uint8_t info;
+    /* Length, count, tag or value, as per the major type. Not valid if indefinite is set */
+    uint64_t arg;
+    bool indefinite;
+} esp_rmaker_cbor_item_t;
+
+void esp_rmaker_cbor_dec_start(esp_rmaker_cbor_dec_t *dec, uint8_t *buf, size_t buf_len);
+/* Peek at the header of the next data item, without consuming it */
+esp_err_t esp_rmaker_cbor_dec_peek(esp_rmaker_cbor_dec_t *dec, esp_rmaker_cbor_item_t *item);
+/* Read the header of the next data item. For strings, the contents are not consumed */
+esp_err_t esp_rmaker_cbor_dec_item(esp_rmaker_cbor_dec_t *dec, esp_rmaker_cbor_item_t *item);
+/* Check for, and consume the "break" which ends an indefinite length item */
+bool esp_rmaker_cbor_dec_break(esp_rmaker_cbor_dec_t *dec);
+/* Get a definite length text string without copying it */
+esp_err_t esp_rmaker_cbor_dec_text(esp_rmaker_cbor_dec_t *dec, const char **str, size_t *len);
+/** A text string which was NULL terminated in place in the data being decoded */
+typedef struct {
+    char *str;
+    size_t len;
+    /* Last byte of the string's header, which gets overwritten */
+    uint8_t header_byte;
+} esp_rmaker_cbor_text_t;
+
+/* Get a definite length text string as a NULL terminated string. The string is moved
+ * one byte back, over its own header, to make room for the NULL termination. So, it
+ * is valid only till the underlying buffer is modified. The data must be put back
+ * using esp_rmaker_cbor_text_restore() once the string is no longer required.
+ */
+esp_err_t esp_rmaker_cbor_dec_text_in_place(esp_rmaker_cbor_dec_t *dec, esp_rmaker_cbor_text_t *text);
+/* Undo the changes made to the underlying buffer by esp_rmaker_cbor_dec_text_in_place() */
+void esp_rmaker_cbor_text_restore(esp_rmaker_cbor_text_t *text);
+/* Get an integer value */
+esp_err_t esp_rmaker_cbor_dec_int(esp_rmaker_cbor_dec_t *dec, int64_t *val);
+/* Get a floating point value. Integers are also accepted */
+esp_err_t esp_rmaker_cbor_dec_float(esp_rmaker_cbor_dec_t *dec, float *val);
+esp_err_t esp_rmaker_cbor_dec_bool(esp_rmaker_cbor_dec_t *dec, bool *val);
+/* Skip the next data item, along with all its contents */
+esp_err_t esp_rmaker_cbor_dec_skip(esp_rmaker_cbor_dec_t *dec);
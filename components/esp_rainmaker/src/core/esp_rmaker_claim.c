@@ -42,6 +42,7 @@
 #include "esp_rmaker_storage.h"
 #include "esp_rmaker_client_data.h"
 #include "esp_rmaker_claim.h"
+#include "esp_rmaker_mem.h"
 
 static const char *TAG = "esp_claim";
 
@@ -215,7 +216,7 @@ static esp_err_t handle_claim_verify_response(esp_rmaker_claim_data_t *claim_dat
         int required_len = 0;
         if (json_obj_get_strlen(&jctx, "certificate", &required_len) == 0) {
             required_len++; /* For NULL termination */
-            char *certificate =  calloc(1, required_len);
+            char *certificate =  esp_rmaker_mem_calloc(ESP_RMAKER_MEM_CLAIM, 1, required_len);
             if (!certificate) {
                 json_parse_end(&jctx);
                 ESP_LOGE(TAG, "Failed to allocate %d bytes for certificate.", required_len);
@@ -225,7 +226,7 @@ static esp_err_t handle_claim_verify_response(esp_rmaker_claim_data_t *claim_dat
             json_parse_end(&jctx);
             unescape_new_line(certificate);
             esp_err_t err = esp_rmaker_storage_set(ESP_RMAKER_CLIENT_CERT_NVS_KEY, certificate, strlen(certificate));
-            free(certificate);
+            esp_rmaker_mem_free(ESP_RMAKER_MEM_CLAIM, certificate);
             return err;
         } else {
             ESP_LOGE(TAG, "Claim Verify Response invalid.");
@@ -259,7 +260,7 @@ void esp_rmaker_claim_data_free(esp_rmaker_claim_data_t *claim_data)
 {
     if(claim_data) {
         mbedtls_pk_free(&claim_data->key);
-        free(claim_data);
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_CLAIM, claim_data);
     }
 }
 
@@ -843,7 +844,8 @@ void esp_rmaker_claim_task(void *args)
         ESP_LOGE(TAG, "Arguments for claiming task cannot be NULL");
         return;
     }
-    esp_rmaker_claim_data_t *claim_data = calloc(1, sizeof(esp_rmaker_claim_data_t));
+    esp_rmaker_claim_data_t *claim_data = esp_rmaker_mem_calloc(ESP_RMAKER_MEM_CLAIM,
+            1, sizeof(esp_rmaker_claim_data_t));
     if (!claim_data) {
         ESP_LOGE(TAG, "Failed to allocate memory for claim data.");
         return;
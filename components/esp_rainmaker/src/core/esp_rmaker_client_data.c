@@ -21,6 +21,7 @@
 #include "esp_rmaker_internal.h"
 #include "esp_rmaker_storage.h"
 #include "esp_rmaker_client_data.h"
+#include "esp_rmaker_mem.h"
 
 extern uint8_t mqtt_server_root_ca_pem_start[] asm("_binary_mqtt_server_crt_start");
 extern uint8_t mqtt_server_root_ca_pem_end[] asm("_binary_mqtt_server_crt_end");
@@ -53,7 +54,8 @@ char * esp_rmaker_get_client_csr()
 
 esp_rmaker_mqtt_config_t *esp_rmaker_get_mqtt_config()
 {
-    esp_rmaker_mqtt_config_t *mqtt_config = calloc(1, sizeof(esp_rmaker_mqtt_config_t));
+    esp_rmaker_mqtt_config_t *mqtt_config = esp_rmaker_mem_calloc(ESP_RMAKER_MEM_CORE,
+            1, sizeof(esp_rmaker_mqtt_config_t));
     if ((mqtt_config->client_key = esp_rmaker_get_client_key()) == NULL) {
         goto init_err;
     }
@@ -76,7 +78,7 @@ init_err:
     if (mqtt_config->client_key) {
         free(mqtt_config->client_key);
     }
-    free(mqtt_config);
+    esp_rmaker_mem_free(ESP_RMAKER_MEM_CORE, mqtt_config);
     return NULL;
 }
 
@@ -16,18 +16,24 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/queue.h>
+#include <freertos/semphr.h>
 #include <freertos/event_groups.h>
 #include <esp_log.h>
 #include <esp_wifi.h>
 #include <esp_event.h>
+#include <esp_timer.h>
 
 #include <esp_rmaker_core.h>
 #include <esp_rmaker_utils.h>
 #include "esp_rmaker_internal.h"
 #include "esp_rmaker_storage.h"
 #include "esp_rmaker_mqtt.h"
-#include "esp_rmaker_claim.h"
 #include "esp_rmaker_client_data.h"
+#if defined(CONFIG_ESP_RMAKER_SELF_CLAIM) || defined(CONFIG_ESP_RMAKER_ASSISTED_CLAIM)
+#include "esp_rmaker_claim.h"
+#endif
+#include "esp_rmaker_mem.h"
+#include "esp_rmaker_arena.h"
 
 static const int WIFI_CONNECTED_EVENT = BIT0;
 static EventGroupHandle_t wifi_event_group;
@@ -37,7 +43,14 @@ ESP_EVENT_DEFINE_BASE(RMAKER_EVENT);
 
 static const char *TAG = "esp_rmaker_core";
 
-#define ESP_RMAKER_TASK_QUEUE_SIZE           8
+/* Entries in each lane of the work queue */
+#define ESP_RMAKER_WORK_QUEUE_SIZE  CONFIG_ESP_RMAKER_WORK_QUEUE_SIZE
+/* Tasks serving the control and report lanes, i.e. the core task and the optional second worker */
+#ifdef CONFIG_ESP_RMAKER_WORK_SECOND_WORKER
+#define ESP_RMAKER_WORKERS          2
+#else
+#define ESP_RMAKER_WORKERS          1
+#endif /* CONFIG_ESP_RMAKER_WORK_SECOND_WORKER */
 
 #define ESP_RMAKER_TASK_STACK       CONFIG_ESP_RMAKER_TASK_STACK
 #define ESP_RMAKER_TASK_PRIORITY    CONFIG_ESP_RMAKER_TASK_PRIORITY
@@ -75,7 +88,16 @@ typedef struct {
     bool need_claim;
     esp_rmaker_claim_data_t *claim_data;
 #endif /* ESP_RMAKER_CLAIM_ENABLED */
-    QueueHandle_t work_queue;
+    QueueHandle_t work_queues[ESP_RMAKER_WORK_LANE_MAX];
+    /* Given once for every work queued, and for waking up the workers on stop */
+    SemaphoreHandle_t work_sem;
+    /* Given by the worker tasks other than the core task, when they exit */
+    SemaphoreHandle_t worker_exit_sem;
+    /* The lanes below this are served by the core task (and the second worker). The job lane is
+     * excluded when it has a task of its own.
+     */
+    esp_rmaker_work_lane_t worker_lanes;
+    esp_rmaker_work_queue_stats_t work_queue_stats;
 } esp_rmaker_priv_data_t;
 
 static esp_rmaker_priv_data_t *esp_rmaker_priv_data;
@@ -104,7 +126,7 @@ esp_err_t esp_rmaker_change_node_id(char *node_id, size_t len)
     if(esp_rmaker_priv_data) {
         char *new_node_id = strndup(node_id, len);
         if (!new_node_id) {
-            ESP_LOGE(TAG, "Failed to allocate %d bytes for new node_id.", len);
+            ESP_LOGE(TAG, "Failed to allocate %d bytes for new node_id.", (int)len);
             return ESP_ERR_NO_MEM;
         }
         if (esp_rmaker_priv_data->node_id) {
@@ -113,6 +135,8 @@ esp_err_t esp_rmaker_change_node_id(char *node_id, size_t len)
         esp_rmaker_priv_data->node_id = new_node_id;
         _esp_rmaker_node_t *node = (_esp_rmaker_node_t *)esp_rmaker_get_node();
         node->node_id = new_node_id;
+        /* The node id is a part of the node config */
+        esp_rmaker_node_config_invalidate();
         ESP_LOGI(TAG, "New Node ID ----- %s", new_node_id);
         return ESP_OK;
     }
@@ -120,6 +144,18 @@ esp_err_t esp_rmaker_change_node_id(char *node_id, size_t len)
 }
 
 
+#ifdef CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE
+static void esp_rmaker_report_pending_params(void *priv_data)
+{
+    esp_rmaker_report_param_internal();
+}
+#endif /* CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE */
+
+static void esp_rmaker_report_node_config_work(void *priv_data)
+{
+    esp_rmaker_report_node_config();
+}
+
 /* Event handler for catching system events */
 static void esp_rmaker_event_handler(void* arg, esp_event_base_t event_base,
                           int event_id, void* event_data)
@@ -134,6 +170,19 @@ static void esp_rmaker_event_handler(void* arg, esp_event_base_t event_base,
         /* Signal rmaker thread to continue execution */
         xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_EVENT);
     }
+    else if (event_base == RMAKER_EVENT &&
+            ((event_id == RMAKER_EVENT_MQTT_CONNECTED) || (event_id == RMAKER_EVENT_MQTT_PUBLISHED))) {
+#ifdef CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE
+        if (event_id == RMAKER_EVENT_MQTT_CONNECTED) {
+            /* Report the param changes held back while MQTT was disconnected */
+            esp_rmaker_queue_work(esp_rmaker_report_pending_params, NULL);
+        }
+#endif /* CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE */
+        /* Publishing the node config may have failed, Eg. due to a full publish queue, which might have room now */
+        if (esp_rmaker_node_config_take_report_pending()) {
+            esp_rmaker_queue_work(esp_rmaker_report_node_config_work, NULL);
+        }
+    }
 }
 
 static esp_err_t esp_rmaker_deinit_priv_data(esp_rmaker_priv_data_t *rmaker_priv_data)
@@ -141,8 +190,16 @@ static esp_err_t esp_rmaker_deinit_priv_data(esp_rmaker_priv_data_t *rmaker_priv
     if (!rmaker_priv_data) {
         return ESP_ERR_INVALID_ARG;
     }
-    if (rmaker_priv_data->work_queue) {
-        vQueueDelete(rmaker_priv_data->work_queue);
+    for (int i = 0; i < ESP_RMAKER_WORK_LANE_MAX; i++) {
+        if (rmaker_priv_data->work_queues[i]) {
+            vQueueDelete(rmaker_priv_data->work_queues[i]);
+        }
+    }
+    if (rmaker_priv_data->work_sem) {
+        vSemaphoreDelete(rmaker_priv_data->work_sem);
+    }
+    if (rmaker_priv_data->worker_exit_sem) {
+        vSemaphoreDelete(rmaker_priv_data->worker_exit_sem);
     }
 #ifndef CONFIG_ESP_RMAKER_DISABLE_USER_MAPPING_PROV
     esp_rmaker_user_mapping_prov_deinit();
@@ -154,12 +211,12 @@ static esp_err_t esp_rmaker_deinit_priv_data(esp_rmaker_priv_data_t *rmaker_priv
 #endif
     if (rmaker_priv_data->mqtt_config) {
         esp_rmaker_clean_mqtt_config(rmaker_priv_data->mqtt_config);
-        free(rmaker_priv_data->mqtt_config);
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_CORE, rmaker_priv_data->mqtt_config);
     }
     if (rmaker_priv_data->node_id) {
         free(rmaker_priv_data->node_id);
     }
-    free(rmaker_priv_data);
+    esp_rmaker_mem_free(ESP_RMAKER_MEM_CORE, rmaker_priv_data);
     return ESP_OK;
 }
 
@@ -215,6 +272,25 @@ static esp_err_t esp_rmaker_mqtt_data_init(esp_rmaker_priv_data_t *rmaker_priv_d
     return ESP_FAIL;
 }
 /* Initialize ESP RainMaker */
+static esp_err_t esp_rmaker_work_queue_init(void)
+{
+    for (int i = 0; i < ESP_RMAKER_WORK_LANE_MAX; i++) {
+        esp_rmaker_priv_data->work_queues[i] = xQueueCreate(ESP_RMAKER_WORK_QUEUE_SIZE,
+                sizeof(esp_rmaker_work_queue_entry_t));
+        if (!esp_rmaker_priv_data->work_queues[i]) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    esp_rmaker_priv_data->work_sem = xSemaphoreCreateCounting(ESP_RMAKER_WORK_QUEUE_SIZE * ESP_RMAKER_WORK_LANE_MAX
+                + ESP_RMAKER_WORKERS, 0);
+    esp_rmaker_priv_data->worker_exit_sem = xSemaphoreCreateCounting(ESP_RMAKER_WORKERS + 1, 0);
+    if (!esp_rmaker_priv_data->work_sem || !esp_rmaker_priv_data->worker_exit_sem) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_rmaker_priv_data->worker_lanes = ESP_RMAKER_WORK_LANE_MAX;
+    return ESP_OK;
+}
+
 static esp_err_t esp_rmaker_init(const esp_rmaker_config_t *config, bool use_claiming)
 {
     if (esp_rmaker_priv_data) {
@@ -229,7 +305,7 @@ static esp_err_t esp_rmaker_init(const esp_rmaker_config_t *config, bool use_cla
         ESP_LOGE(TAG, "Failed to initialise storage");
         return ESP_FAIL;
     }
-    esp_rmaker_priv_data = calloc(1, sizeof(esp_rmaker_priv_data_t));
+    esp_rmaker_priv_data = esp_rmaker_mem_calloc(ESP_RMAKER_MEM_CORE, 1, sizeof(esp_rmaker_priv_data_t));
     if (!esp_rmaker_priv_data) {
         ESP_LOGE(TAG, "Failed to allocate memory");
         return ESP_ERR_NO_MEM;
@@ -243,13 +319,24 @@ static esp_err_t esp_rmaker_init(const esp_rmaker_config_t *config, bool use_cla
         return ESP_ERR_NO_MEM;
     }
 
-    esp_rmaker_priv_data->work_queue = xQueueCreate(ESP_RMAKER_TASK_QUEUE_SIZE, sizeof(esp_rmaker_work_queue_entry_t));
-    if (!esp_rmaker_priv_data->work_queue) {
+    if (esp_rmaker_work_queue_init() != ESP_OK) {
         esp_rmaker_deinit_priv_data(esp_rmaker_priv_data);
         esp_rmaker_priv_data = NULL;
         ESP_LOGE(TAG, "ESP RainMaker Queue Creation Failed");
         return ESP_ERR_NO_MEM;
     }
+    if (esp_rmaker_node_config_init() != ESP_OK) {
+        esp_rmaker_deinit_priv_data(esp_rmaker_priv_data);
+        esp_rmaker_priv_data = NULL;
+        ESP_LOGE(TAG, "Failed to initialise Node Config");
+        return ESP_ERR_NO_MEM;
+    }
+    if (esp_rmaker_param_lock_init() != ESP_OK) {
+        esp_rmaker_deinit_priv_data(esp_rmaker_priv_data);
+        esp_rmaker_priv_data = NULL;
+        ESP_LOGE(TAG, "Failed to initialise param locks");
+        return ESP_ERR_NO_MEM;
+    }
 #ifndef CONFIG_ESP_RMAKER_DISABLE_USER_MAPPING_PROV
     if (esp_rmaker_user_mapping_prov_init()) {
         esp_rmaker_deinit_priv_data(esp_rmaker_priv_data);
@@ -310,7 +397,7 @@ esp_rmaker_node_t *esp_rmaker_node_init(const esp_rmaker_config_t *config, const
     }
     err = esp_rmaker_register_node(node);
     if (err != ESP_OK) {
-        free(node);
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_CORE, node);
         return NULL;
     }
     return node;
@@ -345,15 +432,145 @@ esp_err_t esp_rmaker_report_node_details()
     return esp_rmaker_queue_work(__esp_rmaker_report_node_config_and_state, NULL);
 }
 
-static void esp_rmaker_handle_work_queue()
+static const uint32_t work_latency_bucket_bounds[] = ESP_RMAKER_WORK_LATENCY_BUCKET_BOUNDS;
+
+static const char *work_lane_names[ESP_RMAKER_WORK_LANE_MAX] = {
+    [ESP_RMAKER_WORK_LANE_CONTROL] = "control",
+    [ESP_RMAKER_WORK_LANE_REPORT] = "report",
+    [ESP_RMAKER_WORK_LANE_JOB] = "job",
+};
+
+const char *esp_rmaker_work_lane_to_str(esp_rmaker_work_lane_t lane)
+{
+    if ((unsigned)lane < ESP_RMAKER_WORK_LANE_MAX) {
+        return work_lane_names[lane];
+    }
+    return NULL;
+}
+
+/* The stats are updated by all the workers and by the tasks queuing work, and so, atomically */
+static void esp_rmaker_work_queue_record_latency(esp_rmaker_work_lane_t lane, int64_t queued_at)
+{
+    esp_rmaker_work_lane_stats_t *stats = &esp_rmaker_priv_data->work_queue_stats.lanes[lane];
+    uint32_t latency_us = (uint32_t)(esp_timer_get_time() - queued_at);
+    int i;
+    for (i = 0; i < ESP_RMAKER_WORK_LATENCY_BUCKETS - 1; i++) {
+        if (latency_us < work_latency_bucket_bounds[i]) {
+            break;
+        }
+    }
+    __atomic_fetch_add(&stats->latency_hist[i], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->processed, 1, __ATOMIC_RELAXED);
+    uint32_t max_latency_us = __atomic_load_n(&stats->max_latency_us, __ATOMIC_RELAXED);
+    while ((latency_us > max_latency_us) && !__atomic_compare_exchange_n(&stats->max_latency_us,
+                &max_latency_us, latency_us, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static void esp_rmaker_run_work(esp_rmaker_work_lane_t lane, esp_rmaker_work_queue_entry_t *work_queue_entry)
+{
+    /* A NULL work function is queued by esp_rmaker_stop() just to wake up the job task */
+    if (work_queue_entry->work_fn) {
+        esp_rmaker_work_queue_record_latency(lane, work_queue_entry->queued_at);
+        work_queue_entry->work_fn(work_queue_entry->priv_data);
+    }
+}
+
+/* Run one pending work function, from the highest priority lane having any */
+static void esp_rmaker_handle_work_queue(TickType_t ticks_to_wait)
 {
     ESP_RMAKER_CHECK_HANDLE();
+    if (xSemaphoreTake(esp_rmaker_priv_data->work_sem, ticks_to_wait) != pdTRUE) {
+        return;
+    }
     esp_rmaker_work_queue_entry_t work_queue_entry;
-    BaseType_t ret = xQueueReceive(esp_rmaker_priv_data->work_queue, &work_queue_entry, 0);
-    while (ret == pdTRUE) {
-        work_queue_entry.work_fn(work_queue_entry.priv_data);
-        ret = xQueueReceive(esp_rmaker_priv_data->work_queue, &work_queue_entry, 0);
+    for (int lane = 0; lane < esp_rmaker_priv_data->worker_lanes; lane++) {
+        if (xQueueReceive(esp_rmaker_priv_data->work_queues[lane], &work_queue_entry, 0) == pdTRUE) {
+            esp_rmaker_run_work(lane, &work_queue_entry);
+            return;
+        }
+    }
+    /* Nothing pending. This was for waking up on stop, or for work in the job lane, which
+     * is being handled by the job task.
+     */
+}
+
+#ifdef CONFIG_ESP_RMAKER_WORK_SECOND_WORKER
+static void esp_rmaker_worker_task(void *param)
+{
+    while (esp_rmaker_priv_data->state != ESP_RMAKER_STATE_STOP_REQUESTED) {
+        esp_rmaker_handle_work_queue(portMAX_DELAY);
+    }
+    xSemaphoreGive(esp_rmaker_priv_data->worker_exit_sem);
+    vTaskDelete(NULL);
+}
+#endif /* CONFIG_ESP_RMAKER_WORK_SECOND_WORKER */
+
+#ifdef CONFIG_ESP_RMAKER_WORK_JOB_TASK
+static void esp_rmaker_job_task(void *param)
+{
+    esp_rmaker_work_queue_entry_t work_queue_entry;
+    while (esp_rmaker_priv_data->state != ESP_RMAKER_STATE_STOP_REQUESTED) {
+        if (xQueueReceive(esp_rmaker_priv_data->work_queues[ESP_RMAKER_WORK_LANE_JOB], &work_queue_entry,
+                    portMAX_DELAY) == pdTRUE) {
+            esp_rmaker_run_work(ESP_RMAKER_WORK_LANE_JOB, &work_queue_entry);
+        }
     }
+    xSemaphoreGive(esp_rmaker_priv_data->worker_exit_sem);
+    vTaskDelete(NULL);
+}
+#endif /* CONFIG_ESP_RMAKER_WORK_JOB_TASK */
+
+/* Start the worker tasks other than the core task itself. Returns the number of tasks started */
+static int esp_rmaker_start_workers(void)
+{
+    int workers = 0;
+#ifdef CONFIG_ESP_RMAKER_WORK_JOB_TASK
+    if (xTaskCreate(&esp_rmaker_job_task, "esp_rmaker_job", ESP_RMAKER_TASK_STACK,
+                NULL, ESP_RMAKER_TASK_PRIORITY, NULL) == pdPASS) {
+        esp_rmaker_priv_data->worker_lanes = ESP_RMAKER_WORK_LANE_JOB;
+        workers++;
+    } else {
+        ESP_LOGW(TAG, "Couldn't create RainMaker job task. Running jobs in the core task.");
+        esp_rmaker_priv_data->worker_lanes = ESP_RMAKER_WORK_LANE_MAX;
+    }
+#endif /* CONFIG_ESP_RMAKER_WORK_JOB_TASK */
+#ifdef CONFIG_ESP_RMAKER_WORK_SECOND_WORKER
+    if (xTaskCreate(&esp_rmaker_worker_task, "esp_rmaker_work", ESP_RMAKER_TASK_STACK,
+                NULL, ESP_RMAKER_TASK_PRIORITY, NULL) == pdPASS) {
+        workers++;
+    } else {
+        ESP_LOGW(TAG, "Couldn't create RainMaker second worker task.");
+    }
+#endif /* CONFIG_ESP_RMAKER_WORK_SECOND_WORKER */
+    return workers;
+}
+
+/* Wait for the worker tasks to exit, after a stop has been requested */
+static void esp_rmaker_wait_for_workers(int workers)
+{
+    while (workers--) {
+        xSemaphoreTake(esp_rmaker_priv_data->worker_exit_sem, portMAX_DELAY);
+    }
+    /* Any jobs queued from now on should be handled by the core task, if it gets started again */
+    esp_rmaker_priv_data->worker_lanes = ESP_RMAKER_WORK_LANE_MAX;
+}
+
+esp_err_t esp_rmaker_work_queue_get_stats(esp_rmaker_work_queue_stats_t *stats)
+{
+    ESP_RMAKER_CHECK_HANDLE(ESP_ERR_INVALID_STATE);
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *stats = esp_rmaker_priv_data->work_queue_stats;
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_work_queue_reset_stats(void)
+{
+    ESP_RMAKER_CHECK_HANDLE(ESP_ERR_INVALID_STATE);
+    memset(&esp_rmaker_priv_data->work_queue_stats, 0, sizeof(esp_rmaker_work_queue_stats_t));
+    return ESP_OK;
 }
 
 static void esp_rmaker_task(void *param)
@@ -447,12 +664,16 @@ static void esp_rmaker_task(void *param)
         ESP_LOGE(TAG, "Aborting!!!");
         goto rmaker_end;
     }
+    esp_event_handler_register(RMAKER_EVENT, RMAKER_EVENT_MQTT_CONNECTED, &esp_rmaker_event_handler, esp_rmaker_priv_data);
+    esp_event_handler_register(RMAKER_EVENT, RMAKER_EVENT_MQTT_PUBLISHED, &esp_rmaker_event_handler, esp_rmaker_priv_data);
+    int workers = esp_rmaker_start_workers();
     while (esp_rmaker_priv_data->state != ESP_RMAKER_STATE_STOP_REQUESTED) {
-        esp_rmaker_handle_work_queue(esp_rmaker_priv_data);
-        /* 2 sec delay to prevent spinning */
-        vTaskDelay(2000 / portTICK_RATE_MS);
+        esp_rmaker_handle_work_queue(portMAX_DELAY);
     }
+    esp_rmaker_wait_for_workers(workers);
 rmaker_end:
+    esp_event_handler_unregister(RMAKER_EVENT, RMAKER_EVENT_MQTT_CONNECTED, &esp_rmaker_event_handler);
+    esp_event_handler_unregister(RMAKER_EVENT, RMAKER_EVENT_MQTT_PUBLISHED, &esp_rmaker_event_handler);
     esp_rmaker_mqtt_disconnect();
     esp_rmaker_priv_data->mqtt_connected = false;
 rmaker_err:
@@ -464,23 +685,40 @@ rmaker_err:
     vTaskDelete(NULL);
 }
 
-esp_err_t esp_rmaker_queue_work(esp_rmaker_work_fn_t work_fn, void *priv_data)
+esp_err_t esp_rmaker_queue_work_on_lane(esp_rmaker_work_lane_t lane, esp_rmaker_work_fn_t work_fn, void *priv_data)
 {
     ESP_RMAKER_CHECK_HANDLE(ESP_ERR_INVALID_STATE);
+    if (!work_fn || ((unsigned)lane >= ESP_RMAKER_WORK_LANE_MAX)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_rmaker_work_lane_stats_t *stats = &esp_rmaker_priv_data->work_queue_stats.lanes[lane];
     esp_rmaker_work_queue_entry_t work_queue_entry = {
         .work_fn = work_fn,
         .priv_data = priv_data,
+        .queued_at = esp_timer_get_time(),
     };
-    if (xQueueSend(esp_rmaker_priv_data->work_queue, &work_queue_entry, 0) == pdTRUE) {
-        return ESP_OK;
+    if (xQueueSend(esp_rmaker_priv_data->work_queues[lane], &work_queue_entry, 0) != pdTRUE) {
+        __atomic_fetch_add(&stats->dropped, 1, __ATOMIC_RELAXED);
+        ESP_LOGW(TAG, "Work queue lane %s full. Dropping work.", work_lane_names[lane]);
+        return ESP_ERR_NO_MEM;
     }
-    return ESP_FAIL;
+    __atomic_fetch_add(&stats->queued, 1, __ATOMIC_RELAXED);
+    /* Given even for the job lane, since that is served by the core task if the job task isn't running */
+    xSemaphoreGive(esp_rmaker_priv_data->work_sem);
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_queue_work(esp_rmaker_work_fn_t work_fn, void *priv_data)
+{
+    return esp_rmaker_queue_work_on_lane(ESP_RMAKER_WORK_LANE_REPORT, work_fn, priv_data);
 }
 
 /* Start the ESP RainMaker Core Task */
 esp_err_t esp_rmaker_start()
 {
     ESP_RMAKER_CHECK_HANDLE(ESP_ERR_INVALID_STATE);
+    /* The node model is expected to be in place by now. Anything added later is allocated from the heap */
+    esp_rmaker_arena_freeze();
     if (esp_rmaker_priv_data->enable_time_sync) {
         esp_rmaker_time_sync_init(NULL);
     }
@@ -497,6 +735,19 @@ esp_err_t esp_rmaker_stop()
 {
     ESP_RMAKER_CHECK_HANDLE(ESP_ERR_INVALID_STATE);
     esp_rmaker_priv_data->state = ESP_RMAKER_STATE_STOP_REQUESTED;
+    /* Wake up the workers, which may be blocked on the work queue. If the semaphore or queue
+     * is full, they are anyways going to wake up to handle the pending work.
+     */
+    for (int i = 0; i < ESP_RMAKER_WORKERS; i++) {
+        xSemaphoreGive(esp_rmaker_priv_data->work_sem);
+    }
+#ifdef CONFIG_ESP_RMAKER_WORK_JOB_TASK
+    esp_rmaker_work_queue_entry_t work_queue_entry = {
+        .work_fn = NULL,
+        .queued_at = esp_timer_get_time(),
+    };
+    xQueueSend(esp_rmaker_priv_data->work_queues[ESP_RMAKER_WORK_LANE_JOB], &work_queue_entry, 0);
+#endif /* CONFIG_ESP_RMAKER_WORK_JOB_TASK */
     return ESP_OK;
 }
 
@@ -19,6 +19,8 @@
 #include <esp_rmaker_standard_types.h>
 
 #include "esp_rmaker_internal.h"
+#include "esp_rmaker_mem.h"
+#include "esp_rmaker_arena.h"
 
 static const char *TAG = "esp_rmaker_device";
 
@@ -42,12 +44,16 @@ esp_err_t esp_rmaker_device_delete(const esp_rmaker_device_t *device)
             esp_rmaker_param_delete((esp_rmaker_param_t *)param);
             param = next_param;
         }
-        if (_device->name) {
-            free(_device->name);
-        }
-        if (_device->type) {
-            free(_device->type);
+        esp_rmaker_name_index_clear(&_device->param_index);
+        if (!_device->is_static) {
+            if (_device->name) {
+                esp_rmaker_arena_free(ESP_RMAKER_MEM_CORE, _device->name);
+            }
+            if (_device->type) {
+                esp_rmaker_arena_free(ESP_RMAKER_MEM_CORE, _device->type);
+            }
         }
+        esp_rmaker_arena_free(ESP_RMAKER_MEM_CORE, _device);
         return ESP_OK;
     }
     return ESP_ERR_INVALID_ARG;
@@ -59,18 +65,18 @@ static esp_rmaker_device_t *__esp_rmaker_device_create(const char *name, const c
         ESP_LOGE(TAG, "%s name is mandatory", is_service ? "Service":"Device");
         return NULL;
     }
-    _esp_rmaker_device_t *_device = calloc(1, sizeof(_esp_rmaker_device_t));
+    _esp_rmaker_device_t *_device = esp_rmaker_arena_calloc(ESP_RMAKER_MEM_CORE, sizeof(_esp_rmaker_device_t));
     if (!_device) {
         ESP_LOGE(TAG, "Failed to allocate memory for %s %s", is_service ? "Service":"Device", name);
         return NULL;
     }
-    _device->name = strdup(name);
+    _device->name = esp_rmaker_arena_strdup(ESP_RMAKER_MEM_CORE, name);
     if (!_device->name) {
         ESP_LOGE(TAG, "Failed to allocate memory for name for %s %s", is_service ? "Service":"Device", name);
         goto device_create_err;
     }
     if (type) {
-        _device->type = strdup(type);
+        _device->type = esp_rmaker_arena_intern(ESP_RMAKER_MEM_CORE, type);
         if (!_device->type) {
             ESP_LOGE(TAG, "Failed to allocate memory for type for %s %s", is_service ? "Service":"Device", name);
             goto device_create_err;
@@ -78,6 +84,8 @@ static esp_rmaker_device_t *__esp_rmaker_device_create(const char *name, const c
     }
     _device->priv_data = priv;
     _device->is_service = is_service;
+    _device->report_min_interval_ms = CONFIG_ESP_RMAKER_PARAM_REPORT_MIN_INTERVAL;
+    _device->report_max_latency_ms = CONFIG_ESP_RMAKER_PARAM_REPORT_MAX_LATENCY;
 
     return (esp_rmaker_device_t *)_device;
 
@@ -95,6 +103,67 @@ esp_rmaker_device_t *esp_rmaker_service_create(const char *name, const char *typ
     return __esp_rmaker_device_create(name, type, priv, true);
 }
 
+esp_rmaker_device_t *esp_rmaker_device_create_from_desc(const esp_rmaker_device_desc_t *desc, void *priv_data)
+{
+    if (!desc || !desc->name) {
+        ESP_LOGE(TAG, "Device descriptor and name are mandatory");
+        return NULL;
+    }
+    if ((desc->params_count && !desc->params) || (desc->primary_param >= desc->params_count)) {
+        ESP_LOGE(TAG, "Invalid params in descriptor of %s", desc->name);
+        return NULL;
+    }
+    for (int i = 0; i < desc->params_count; i++) {
+        if (esp_rmaker_param_desc_validate(&desc->params[i]) != ESP_OK) {
+            ESP_LOGE(TAG, "Invalid descriptor for param %d of %s", i, desc->name);
+            return NULL;
+        }
+    }
+    /* The params follow the device, in the same allocation. They are still complete _esp_rmaker_param_t's,
+     * with the name, type, bounds, etc. pointing into the descriptor, rather than slimmer structures with
+     * just the value, flags and a pointer to the descriptor. This saves the allocations per param, but not
+     * the space for the duplicated fields, so that the rest of the core can handle all the params alike.
+     */
+    _esp_rmaker_device_t *_device = esp_rmaker_arena_calloc(ESP_RMAKER_MEM_CORE,
+            sizeof(_esp_rmaker_device_t) + desc->params_count * sizeof(_esp_rmaker_param_t));
+    if (!_device) {
+        ESP_LOGE(TAG, "Failed to allocate memory for %s %s", desc->is_service ? "Service":"Device", desc->name);
+        return NULL;
+    }
+    _esp_rmaker_param_t *params = (_esp_rmaker_param_t *)(_device + 1);
+    _device->name = (char *)desc->name;
+    _device->type = (char *)desc->type;
+    _device->is_static = true;
+    _device->is_service = desc->is_service;
+    _device->priv_data = priv_data;
+    _device->write_cb = desc->write_cb;
+    _device->read_cb = desc->read_cb;
+    _device->report_min_interval_ms = CONFIG_ESP_RMAKER_PARAM_REPORT_MIN_INTERVAL;
+    _device->report_max_latency_ms = CONFIG_ESP_RMAKER_PARAM_REPORT_MAX_LATENCY;
+    for (int i = 0; i < desc->params_count; i++) {
+        /* A param which failed to initialise is not in the device's list yet, and so, needs to be
+         * cleaned up separately. Being static, only its value buffer gets freed, since the param
+         * itself is a part of the device's allocation.
+         */
+        if (esp_rmaker_param_init_from_desc(&params[i], &desc->params[i]) != ESP_OK) {
+            esp_rmaker_param_delete((esp_rmaker_param_t *)&params[i]);
+            goto device_create_err;
+        }
+        if (esp_rmaker_device_add_param((esp_rmaker_device_t *)_device, (esp_rmaker_param_t *)&params[i]) != ESP_OK) {
+            esp_rmaker_param_delete((esp_rmaker_param_t *)&params[i]);
+            goto device_create_err;
+        }
+    }
+    if (desc->primary_param >= 0) {
+        _device->primary = &params[desc->primary_param];
+    }
+    return (esp_rmaker_device_t *)_device;
+
+device_create_err:
+    esp_rmaker_device_delete((esp_rmaker_device_t *)_device);
+    return NULL;
+}
+
 esp_err_t esp_rmaker_device_add_param(const esp_rmaker_device_t *device, const esp_rmaker_param_t *param)
 {
     if (!device || !param) {
@@ -104,9 +173,12 @@ esp_err_t esp_rmaker_device_add_param(const esp_rmaker_device_t *device, const e
     _esp_rmaker_device_t *_device = (_esp_rmaker_device_t *)device;
     _esp_rmaker_param_t *_new_param = (_esp_rmaker_param_t *)param;
 
+    /* The param list and index are also used by the reporting and remote write paths */
+    esp_rmaker_param_lock();
     _esp_rmaker_param_t *_param = _device->params;
     while(_param) {
         if (strcmp(_param->name, _new_param->name) == 0) {
+            esp_rmaker_param_unlock();
             ESP_LOGE(TAG, "Parameter with name %s already exists in Device %s", _new_param->name, _device->name);
             return ESP_ERR_INVALID_ARG;
         }
@@ -116,12 +188,18 @@ esp_err_t esp_rmaker_device_add_param(const esp_rmaker_device_t *device, const e
             break;
         }
     }
+    if (esp_rmaker_name_index_add(&_device->param_index, _new_param->name, _new_param) != ESP_OK) {
+        esp_rmaker_param_unlock();
+        ESP_LOGE(TAG, "Failed to index Parameter %s in Device %s", _new_param->name, _device->name);
+        return ESP_ERR_NO_MEM;
+    }
     _new_param->parent = _device;
     if (_param) {
         _param->next = _new_param;
     } else {
         _device->params = _new_param;
     }
+    esp_rmaker_param_unlock();
     /* We check the stored value here, and not during param creation, because a parameter
      * in itself isn't unique. However, it is unique within a given device and hence can
      * be uniquely represented in storage only when added to a device.
@@ -130,13 +208,10 @@ esp_err_t esp_rmaker_device_add_param(const esp_rmaker_device_t *device, const e
     stored_val.type = _new_param->val.type;
     if (_new_param->prop_flags & PROP_FLAG_PERSIST) {
         if (esp_rmaker_param_get_stored_value(_new_param, &stored_val) == ESP_OK) {
-            if ((_new_param->val.type == RMAKER_VAL_TYPE_STRING) || (_new_param->val.type == RMAKER_VAL_TYPE_OBJECT)
-                    || (_new_param->val.type == RMAKER_VAL_TYPE_ARRAY)) {
-                if (_new_param->val.val.s) {
-                    free(_new_param->val.val.s);
-                }
-            }
-            _new_param->val = stored_val;
+            /* The param can already be read through the device, so this goes through the param store */
+            esp_rmaker_param_lock();
+            esp_rmaker_param_set_stored_val(_new_param, &stored_val);
+            esp_rmaker_param_unlock();
             /* The device callback should be invoked once with the stored value, so
              * that applications can do initialisations as required.
              */
@@ -156,6 +231,7 @@ esp_err_t esp_rmaker_device_add_param(const esp_rmaker_device_t *device, const e
         }
     }
     ESP_LOGD(TAG, "Param %s added in %s", _new_param->name, _device->name);
+    esp_rmaker_node_config_invalidate();
     return ESP_OK;
 }
 
@@ -183,13 +259,13 @@ esp_err_t esp_rmaker_device_add_attribute(const esp_rmaker_device_t *device, con
             break;
         }
     }
-    esp_rmaker_attr_t *new_attr = calloc(1, sizeof(esp_rmaker_attr_t));
+    esp_rmaker_attr_t *new_attr = esp_rmaker_arena_calloc(ESP_RMAKER_MEM_CORE, sizeof(esp_rmaker_attr_t));
     if (!new_attr) {
         ESP_LOGE(TAG, "Failed to allocate memory for device attribute");
         return ESP_ERR_NO_MEM;
     }
-    new_attr->name = strdup(attr_name);
-    new_attr->value = strdup(val);
+    new_attr->name = esp_rmaker_arena_intern(ESP_RMAKER_MEM_CORE, attr_name);
+    new_attr->value = esp_rmaker_arena_strdup(ESP_RMAKER_MEM_CORE, val);
     if (!new_attr->name || !new_attr->value) {
         ESP_LOGE(TAG, "Failed to allocate memory for device attribute name or value");
         esp_rmaker_attribute_delete(new_attr);
@@ -201,6 +277,7 @@ esp_err_t esp_rmaker_device_add_attribute(const esp_rmaker_device_t *device, con
         _device->attributes = new_attr;
     }
     ESP_LOGD(TAG, "Device attribute %s.%s added", _device->name, attr_name);
+    esp_rmaker_node_config_invalidate();
     return ESP_OK;
 }
 
@@ -211,6 +288,7 @@ esp_err_t esp_rmaker_device_assign_primary_param(const esp_rmaker_device_t *devi
         return ESP_ERR_INVALID_ARG;
     }
     ((_esp_rmaker_device_t *)device)->primary = (_esp_rmaker_param_t *)param;
+    esp_rmaker_node_config_invalidate();
     return ESP_OK;
 }
 
@@ -226,6 +304,19 @@ esp_err_t esp_rmaker_device_add_cb(const esp_rmaker_device_t *device, esp_rmaker
     return ESP_OK;
 }
 
+esp_err_t esp_rmaker_device_set_report_interval(const esp_rmaker_device_t *device, uint32_t min_interval_ms,
+        uint32_t max_latency_ms)
+{
+    if (!device) {
+        ESP_LOGE(TAG, "Device handle cannot be NULL");
+        return ESP_ERR_INVALID_ARG;
+    }
+    _esp_rmaker_device_t *_device = (_esp_rmaker_device_t *)device;
+    _device->report_min_interval_ms = min_interval_ms;
+    _device->report_max_latency_ms = max_latency_ms;
+    return ESP_OK;
+}
+
 char *esp_rmaker_device_get_name(const esp_rmaker_device_t *device)
 {
     if (!device) {
@@ -266,12 +357,6 @@ esp_rmaker_param_t *esp_rmaker_device_get_param_by_name(const esp_rmaker_device_
         ESP_LOGE(TAG, "Device handle or param name cannot be NULL");
         return NULL;
     }
-    _esp_rmaker_param_t *param = ((_esp_rmaker_device_t *)device)->params;
-    while(param) {
-        if (strcmp(param->name, param_name) == 0) {
-            break;
-        }
-        param = param->next;
-    }
-    return (esp_rmaker_param_t *)param;
+    return (esp_rmaker_param_t *)esp_rmaker_name_index_find(&((_esp_rmaker_device_t *)device)->param_index,
+            param_name, strlen(param_name));
 }
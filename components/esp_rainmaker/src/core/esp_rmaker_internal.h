@@ -17,17 +17,26 @@
 #include <freertos/queue.h>
 #include <json_generator.h>
 #include <esp_rmaker_core.h>
+#include <esp_rmaker_node_desc.h>
 #define RMAKER_PARAM_FLAG_VALUE_CHANGE   0x01
+#define RMAKER_PARAM_FLAG_STORE_PENDING  0x02
+/* Name, type, UI type, bounds and valid strings point to a const descriptor, and the param itself is
+ * a part of its device's allocation.
+ */
+#define RMAKER_PARAM_FLAG_STATIC         0x04
+
 typedef struct {
-    esp_rmaker_param_val_t min;
-    esp_rmaker_param_val_t max;
-    esp_rmaker_param_val_t step;
-} esp_rmaker_param_bounds_t;
+    uint32_t hash;
+    const char *name;
+    void *item;
+} esp_rmaker_name_index_entry_t;
 
+/* Hash index for looking up devices/params by name */
 typedef struct {
-    uint8_t str_list_cnt;
-    const char **str_list;
-} esp_rmaker_param_valid_str_list_t;
+    esp_rmaker_name_index_entry_t *entries;
+    uint16_t size;
+    uint16_t count;
+} esp_rmaker_name_index_t;
 
 struct esp_rmaker_param {
     char *name;
@@ -36,10 +45,22 @@ struct esp_rmaker_param {
     uint8_t prop_flags;
     char *ui_type;
     esp_rmaker_param_val_t val;
+    /* Sequence counter for val, for lock free reads of boolean, integer and float values. Odd while an update
+     * is in progress.
+     */
+    uint32_t val_seq;
+    /* Size of the buffer allocated for val.val.s, for string, object and array params */
+    size_t val_buf_size;
+    /* Changes in a float value smaller than or equal to this are ignored */
+    float deadband;
     esp_rmaker_param_bounds_t *bounds;
     esp_rmaker_param_valid_str_list_t *valid_str_list;
     struct esp_rmaker_device *parent;
     struct esp_rmaker_param * next;
+    /* Next param in the parent device's list of changed params */
+    struct esp_rmaker_param *next_changed;
+    /* Next param in the parent device's list of params to be written to NVS */
+    struct esp_rmaker_param *next_store_pending;
 };
 typedef struct esp_rmaker_param _esp_rmaker_param_t;
 
@@ -58,9 +79,27 @@ struct esp_rmaker_device {
     esp_rmaker_device_read_cb_t read_cb;
     void *priv_data;
     bool is_service;
+    /* Created from a const descriptor. The name and type are not owned, and the params follow the device in
+     * the same allocation.
+     */
+    bool is_static;
     esp_rmaker_attr_t *attributes;
     _esp_rmaker_param_t *params;
+    esp_rmaker_name_index_t param_index;
     _esp_rmaker_param_t *primary;
+    /* Minimum gap (in milliseconds) between two reports of this device's params */
+    uint32_t report_min_interval_ms;
+    /* Maximum time (in milliseconds) for which a changed param can be held back. 0 means no limit */
+    uint32_t report_max_latency_ms;
+    /* esp_timer time of the last report and of the oldest unreported change (0 if none) */
+    int64_t last_report_time;
+    int64_t first_change_time;
+    /* Params changed since the last report, and the next device having changed params */
+    _esp_rmaker_param_t *changed_params;
+    struct esp_rmaker_device *next_changed;
+    /* Params to be written to NVS, and the next device having such params */
+    _esp_rmaker_param_t *store_pending_params;
+    struct esp_rmaker_device *next_store_pending;
     const esp_rmaker_node_t *parent;
     struct esp_rmaker_device *next;
 };
@@ -69,15 +108,45 @@ typedef struct esp_rmaker_device _esp_rmaker_device_t;
 typedef struct {
     esp_rmaker_work_fn_t work_fn;
     void *priv_data;
+    /* esp_timer time (in microseconds) at which the work was queued */
+    int64_t queued_at;
 } esp_rmaker_work_queue_entry_t;
 
+/* Upper bounds (in microseconds) of the work queue latency histogram buckets.
+ * The last bucket collects everything above the highest bound.
+ */
+#define ESP_RMAKER_WORK_LATENCY_BUCKET_BOUNDS   {100, 1000, 10000, 100000, 1000000}
+#define ESP_RMAKER_WORK_LATENCY_BUCKETS         6
+
+typedef struct {
+    /* Number of work functions queued */
+    uint32_t queued;
+    /* Number of work functions dropped since the lane was full */
+    uint32_t dropped;
+    /* Number of work functions executed */
+    uint32_t processed;
+    /* Maximum time (in microseconds) a work function waited in the queue */
+    uint32_t max_latency_us;
+    /* Histogram of time spent in the queue, as per ESP_RMAKER_WORK_LATENCY_BUCKET_BOUNDS */
+    uint32_t latency_hist[ESP_RMAKER_WORK_LATENCY_BUCKETS];
+} esp_rmaker_work_lane_stats_t;
+
+typedef struct {
+    esp_rmaker_work_lane_stats_t lanes[ESP_RMAKER_WORK_LANE_MAX];
+} esp_rmaker_work_queue_stats_t;
+
 typedef struct {
     char *node_id;
     esp_rmaker_node_info_t *info;
     esp_rmaker_attr_t *attributes;
     _esp_rmaker_device_t *devices;
+    esp_rmaker_name_index_t device_index;
 } _esp_rmaker_node_t;
 
+uint32_t esp_rmaker_name_hash(const char *name, size_t len);
+esp_err_t esp_rmaker_name_index_add(esp_rmaker_name_index_t *index, const char *name, void *item);
+void *esp_rmaker_name_index_find(const esp_rmaker_name_index_t *index, const char *name, size_t len);
+void esp_rmaker_name_index_clear(esp_rmaker_name_index_t *index);
 esp_rmaker_node_t *esp_rmaker_node_create(const char *name, const char *type);
 esp_err_t esp_rmaker_change_node_id(char *node_id, size_t len);
 esp_err_t esp_rmaker_report_value(const esp_rmaker_param_val_t *val, char *key, json_gen_str_t *jptr);
@@ -91,15 +160,53 @@ esp_err_t esp_rmaker_report_param_internal(void);
 esp_err_t esp_rmaker_queue_report_param(esp_rmaker_work_fn_t work_fn, void *priv_data);
 esp_err_t esp_rmaker_param_get_stored_value(_esp_rmaker_param_t *param, esp_rmaker_param_val_t *val);
 esp_err_t esp_rmaker_param_store_value(_esp_rmaker_param_t *param);
+void esp_rmaker_device_discard_changes(_esp_rmaker_device_t *device);
+esp_err_t esp_rmaker_device_flush_pending_store(_esp_rmaker_device_t *device);
+esp_err_t esp_rmaker_param_store_flush(void);
+void esp_rmaker_param_store_discard(void);
+esp_err_t esp_rmaker_param_lock_init(void);
+/* Lock for the param values, the lists of devices/params and the changed/store pending lists.
+ * Should not be held across anything which blocks, like an MQTT publish, NVS write or application callback.
+ */
+void esp_rmaker_param_lock(void);
+void esp_rmaker_param_unlock(void);
 esp_err_t esp_rmaker_node_delete(const esp_rmaker_node_t *node);
 esp_err_t esp_rmaker_param_delete(const esp_rmaker_param_t *param);
 esp_err_t esp_rmaker_attribute_delete(esp_rmaker_attr_t *attr);
+esp_err_t esp_rmaker_param_desc_validate(const esp_rmaker_param_desc_t *desc);
+/* Set the value read from NVS, taking over its string buffer, if any. Should be called with the param lock
+ * held. Safe against the lock free readers of esp_rmaker_param_get_val().
+ */
+void esp_rmaker_param_set_stored_val(_esp_rmaker_param_t *param, esp_rmaker_param_val_t *val);
+/* Initialise a param, embedded in a device created from a descriptor. The param is marked static even on
+ * failure, so esp_rmaker_param_delete() then frees only its value buffer.
+ */
+esp_err_t esp_rmaker_param_init_from_desc(_esp_rmaker_param_t *param, const esp_rmaker_param_desc_t *desc);
+/* Get the complete node config in a single allocation. None of the consumers (MQTT publish and the local control
+ * response) can take it in chunks, so this needs as much memory as the size of the node config.
+ */
 char *esp_rmaker_get_node_config(void);
-char *esp_rmaker_get_node_params(void);
+/* Generate the node config, passing it on in NULL terminated chunks to flush_cb. Only the chunk buffer is
+ * allocated here.
+ */
+esp_err_t esp_rmaker_node_config_stream(json_gen_flush_cb_t flush_cb, void *priv);
+esp_err_t esp_rmaker_node_config_init(void);
+/* To be called whenever anything which is a part of the node config changes, so that
+ * the cached node config gets regenerated.
+ */
+void esp_rmaker_node_config_invalidate(void);
+/* Check if the node config has to be reported again, since publishing it failed, and clear the check. Reporting
+ * it again sets it back, if that fails too.
+ */
+bool esp_rmaker_node_config_take_report_pending(void);
+char *esp_rmaker_get_node_params(size_t *len);
 esp_err_t esp_rmaker_handle_set_params(char *data, size_t data_len, esp_rmaker_req_src_t src);
 esp_err_t esp_rmaker_user_mapping_prov_init(void);
 esp_err_t esp_rmaker_user_mapping_prov_deinit(void);
 esp_err_t esp_rmaker_start_local_ctrl_service(const char *serv_name);
+esp_err_t esp_rmaker_work_queue_get_stats(esp_rmaker_work_queue_stats_t *stats);
+esp_err_t esp_rmaker_work_queue_reset_stats(void);
+const char *esp_rmaker_work_lane_to_str(esp_rmaker_work_lane_t lane);
 static inline esp_err_t esp_rmaker_post_event(esp_rmaker_event_t event_id, void* data, size_t data_size)
 {
     return esp_event_post(RMAKER_EVENT, event_id, data, data_size, portMAX_DELAY);
@@ -16,6 +16,7 @@
 #include <esp_log.h>
 #include <esp_local_ctrl.h>
 #include <esp_rmaker_internal.h>
+#include <esp_rmaker_mem.h>
 #include <esp_https_server.h>
 #include <mdns.h>
 
@@ -39,6 +40,11 @@ enum property_flags {
 
 /********* Handler functions for responding to control requests / commands *********/
 
+static void free_prop_value(void *data)
+{
+    esp_rmaker_mem_free(ESP_RMAKER_MEM_LOCAL_CTRL, data);
+}
+
 static esp_err_t get_property_values(size_t props_count,
                                      const esp_local_ctrl_prop_t props[],
                                      esp_local_ctrl_prop_val_t prop_values[],
@@ -57,19 +63,22 @@ static esp_err_t get_property_values(size_t props_count,
                 } else {
                     prop_values[i].size = strlen(node_config);
                     prop_values[i].data = node_config;
-                    prop_values[i].free_fn = free;
+                    esp_rmaker_mem_transfer(ESP_RMAKER_MEM_CORE, ESP_RMAKER_MEM_LOCAL_CTRL, node_config);
+                    prop_values[i].free_fn = free_prop_value;
                 }
                 break;
             }
             case PROP_TYPE_NODE_PARAMS: {
-                char *node_params = esp_rmaker_get_node_params();
+                size_t node_params_len = 0;
+                char *node_params = esp_rmaker_get_node_params(&node_params_len);
                 if (!node_params) {
                     ESP_LOGE(TAG, "Failed to allocate memory for %s", props[i].name);
                     ret = ESP_ERR_NO_MEM;
                 } else {
-                    prop_values[i].size = strlen(node_params);
+                    prop_values[i].size = node_params_len;
                     prop_values[i].data = node_params;
-                    prop_values[i].free_fn = free;
+                    esp_rmaker_mem_transfer(ESP_RMAKER_MEM_PARAM, ESP_RMAKER_MEM_LOCAL_CTRL, node_params);
+                    prop_values[i].free_fn = free_prop_value;
                 }
                 break;
             }
@@ -0,0 +1,172 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <esp_heap_caps.h>
+#include <esp_idf_version.h>
+#include "esp_rmaker_mem.h"
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+#define esp_rmaker_mem_block_size(ptr)  heap_caps_get_allocated_size(ptr)
+#else
+#warning "heap_caps_get_allocated_size() not available in idf versions below 5.1. Only counting the allocations."
+#define esp_rmaker_mem_block_size(ptr)  0
+#endif
+
+/* The counters are updated using atomics, rather than under a lock, since allocations happen from
+ * multiple tasks, and they should not add any contention.
+ */
+static esp_rmaker_mem_stats_t mem_stats[ESP_RMAKER_MEM_TAG_MAX];
+
+static const char *mem_tag_names[ESP_RMAKER_MEM_TAG_MAX] = {
+    [ESP_RMAKER_MEM_CORE] = "core",
+    [ESP_RMAKER_MEM_PARAM] = "param",
+    [ESP_RMAKER_MEM_MQTT] = "mqtt",
+    [ESP_RMAKER_MEM_SCHEDULE] = "schedule",
+    [ESP_RMAKER_MEM_OTA] = "ota",
+    [ESP_RMAKER_MEM_CLAIM] = "claim",
+    [ESP_RMAKER_MEM_LOCAL_CTRL] = "local_ctrl",
+};
+
+static void esp_rmaker_mem_account(esp_rmaker_mem_tag_t tag, void *ptr)
+{
+    esp_rmaker_mem_stats_t *stats = &mem_stats[tag];
+    if (!ptr) {
+        __atomic_fetch_add(&stats->failed_allocs, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    uint32_t size = esp_rmaker_mem_block_size(ptr);
+    uint32_t cur = __atomic_add_fetch(&stats->cur_bytes, size, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->cur_allocs, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->total_allocs, 1, __ATOMIC_RELAXED);
+    uint32_t peak = __atomic_load_n(&stats->peak_bytes, __ATOMIC_RELAXED);
+    while ((cur > peak) && !__atomic_compare_exchange_n(&stats->peak_bytes, &peak, cur, true,
+                __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static void esp_rmaker_mem_release_size(esp_rmaker_mem_tag_t tag, uint32_t size)
+{
+    __atomic_fetch_sub(&mem_stats[tag].cur_bytes, size, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&mem_stats[tag].cur_allocs, 1, __ATOMIC_RELAXED);
+}
+
+static void esp_rmaker_mem_release(esp_rmaker_mem_tag_t tag, void *ptr)
+{
+    if (ptr) {
+        esp_rmaker_mem_release_size(tag, esp_rmaker_mem_block_size(ptr));
+    }
+}
+
+void *esp_rmaker_mem_malloc(esp_rmaker_mem_tag_t tag, size_t size)
+{
+    void *ptr = malloc(size);
+    esp_rmaker_mem_account(tag, ptr);
+    return ptr;
+}
+
+void *esp_rmaker_mem_calloc(esp_rmaker_mem_tag_t tag, size_t n, size_t size)
+{
+    void *ptr = calloc(n, size);
+    esp_rmaker_mem_account(tag, ptr);
+    return ptr;
+}
+
+void *esp_rmaker_mem_realloc(esp_rmaker_mem_tag_t tag, void *ptr, size_t size)
+{
+    if (!ptr) {
+        return esp_rmaker_mem_malloc(tag, size);
+    }
+    if (size == 0) {
+        esp_rmaker_mem_free(tag, ptr);
+        return NULL;
+    }
+    /* The size of the old block cannot be queried once realloc() has moved it */
+    uint32_t old_size = esp_rmaker_mem_block_size(ptr);
+    void *new_ptr = realloc(ptr, size);
+    if (!new_ptr) {
+        /* The old block is still allocated */
+        __atomic_fetch_add(&mem_stats[tag].failed_allocs, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    esp_rmaker_mem_release_size(tag, old_size);
+    esp_rmaker_mem_account(tag, new_ptr);
+    return new_ptr;
+}
+
+char *esp_rmaker_mem_strdup(esp_rmaker_mem_tag_t tag, const char *str)
+{
+    return esp_rmaker_mem_strndup(tag, str, strlen(str));
+}
+
+char *esp_rmaker_mem_strndup(esp_rmaker_mem_tag_t tag, const char *str, size_t n)
+{
+    size_t len = strnlen(str, n);
+    char *copy = esp_rmaker_mem_malloc(tag, len + 1);
+    if (copy) {
+        memcpy(copy, str, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+void esp_rmaker_mem_free(esp_rmaker_mem_tag_t tag, void *ptr)
+{
+    esp_rmaker_mem_release(tag, ptr);
+    free(ptr);
+}
+
+void esp_rmaker_mem_transfer(esp_rmaker_mem_tag_t from, esp_rmaker_mem_tag_t to, void *ptr)
+{
+    if (ptr && (from != to)) {
+        esp_rmaker_mem_release(from, ptr);
+        esp_rmaker_mem_account(to, ptr);
+        __atomic_fetch_sub(&mem_stats[to].total_allocs, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void esp_rmaker_mem_untrack(esp_rmaker_mem_tag_t tag, void *ptr)
+{
+    esp_rmaker_mem_release(tag, ptr);
+}
+
+esp_err_t esp_rmaker_mem_get_stats(esp_rmaker_mem_tag_t tag, esp_rmaker_mem_stats_t *stats)
+{
+    if ((tag >= ESP_RMAKER_MEM_TAG_MAX) || !stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    stats->cur_bytes = __atomic_load_n(&mem_stats[tag].cur_bytes, __ATOMIC_RELAXED);
+    stats->peak_bytes = __atomic_load_n(&mem_stats[tag].peak_bytes, __ATOMIC_RELAXED);
+    stats->cur_allocs = __atomic_load_n(&mem_stats[tag].cur_allocs, __ATOMIC_RELAXED);
+    stats->total_allocs = __atomic_load_n(&mem_stats[tag].total_allocs, __ATOMIC_RELAXED);
+    stats->failed_allocs = __atomic_load_n(&mem_stats[tag].failed_allocs, __ATOMIC_RELAXED);
+    return ESP_OK;
+}
+
+void esp_rmaker_mem_reset_peaks(void)
+{
+    for (int i = 0; i < ESP_RMAKER_MEM_TAG_MAX; i++) {
+        __atomic_store_n(&mem_stats[i].peak_bytes, __atomic_load_n(&mem_stats[i].cur_bytes, __ATOMIC_RELAXED),
+                __ATOMIC_RELAXED);
+    }
+}
+
+const char *esp_rmaker_mem_tag_name(esp_rmaker_mem_tag_t tag)
+{
+    if (tag >= ESP_RMAKER_MEM_TAG_MAX) {
+        return "unknown";
+    }
+    return mem_tag_names[tag];
+}
@@ -0,0 +1,80 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sdkconfig.h>
+#include <esp_err.h>
+
+/* Subsystems to which the heap allocations of ESP RainMaker are attributed */
+typedef enum {
+    /* Node, devices, node config and other core data */
+    ESP_RMAKER_MEM_CORE = 0,
+    ESP_RMAKER_MEM_PARAM,
+    ESP_RMAKER_MEM_MQTT,
+    ESP_RMAKER_MEM_SCHEDULE,
+    ESP_RMAKER_MEM_OTA,
+    ESP_RMAKER_MEM_CLAIM,
+    ESP_RMAKER_MEM_LOCAL_CTRL,
+    ESP_RMAKER_MEM_TAG_MAX,
+} esp_rmaker_mem_tag_t;
+
+typedef struct {
+    /* Bytes currently allocated, as per the heap allocator, i.e. including any padding. Always 0 for
+     * ESP-IDF versions below 5.1, which cannot report the size of an allocated block.
+     */
+    uint32_t cur_bytes;
+    /* Highest value of cur_bytes since boot, or since the last reset */
+    uint32_t peak_bytes;
+    /* Number of blocks currently allocated */
+    uint32_t cur_allocs;
+    /* Total number of allocations */
+    uint32_t total_allocs;
+    /* Number of allocations which failed */
+    uint32_t failed_allocs;
+} esp_rmaker_mem_stats_t;
+
+#ifdef CONFIG_ESP_RMAKER_MEM_STATS
+/* Allocation functions which account the memory to the given subsystem. Memory allocated using these
+ * should be freed using esp_rmaker_mem_free() with the same tag. Since the sizes are obtained from the
+ * heap allocator, a mismatch only skews the statistics, and can never corrupt the heap.
+ * Memory handed over to code outside ESP RainMaker, which frees it using free(), should not be
+ * allocated using these, or should be accounted back using esp_rmaker_mem_untrack() first.
+ */
+void *esp_rmaker_mem_malloc(esp_rmaker_mem_tag_t tag, size_t size);
+void *esp_rmaker_mem_calloc(esp_rmaker_mem_tag_t tag, size_t n, size_t size);
+void *esp_rmaker_mem_realloc(esp_rmaker_mem_tag_t tag, void *ptr, size_t size);
+char *esp_rmaker_mem_strdup(esp_rmaker_mem_tag_t tag, const char *str);
+char *esp_rmaker_mem_strndup(esp_rmaker_mem_tag_t tag, const char *str, size_t n);
+void esp_rmaker_mem_free(esp_rmaker_mem_tag_t tag, void *ptr);
+/* Move the accounting of an allocated block from one subsystem to another */
+void esp_rmaker_mem_transfer(esp_rmaker_mem_tag_t from, esp_rmaker_mem_tag_t to, void *ptr);
+/* Stop accounting an allocated block, which will now be freed using free() */
+void esp_rmaker_mem_untrack(esp_rmaker_mem_tag_t tag, void *ptr);
+
+esp_err_t esp_rmaker_mem_get_stats(esp_rmaker_mem_tag_t tag, esp_rmaker_mem_stats_t *stats);
+/* Reset the peaks to the current usage */
+void esp_rmaker_mem_reset_peaks(void);
+const char *esp_rmaker_mem_tag_name(esp_rmaker_mem_tag_t tag);
+#else
+#define esp_rmaker_mem_malloc(tag, size)            malloc(size)
+#define esp_rmaker_mem_calloc(tag, n, size)         calloc(n, size)
+#define esp_rmaker_mem_realloc(tag, ptr, size)      realloc(ptr, size)
+#define esp_rmaker_mem_strdup(tag, str)             strdup(str)
+#define esp_rmaker_mem_strndup(tag, str, n)         strndup(str, n)
+#define esp_rmaker_mem_free(tag, ptr)               free(ptr)
+#define esp_rmaker_mem_transfer(from, to, ptr)
+#define esp_rmaker_mem_untrack(tag, ptr)
+#endif /* !CONFIG_ESP_RMAKER_MEM_STATS */
@@ -0,0 +1,113 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <string.h>
+#include <esp_log.h>
+
+#include "esp_rmaker_internal.h"
+#include "esp_rmaker_mem.h"
+
+/* Open addressing hash table (with linear probing) mapping names to device/param handles.
+ * Entries are never removed individually. The owner clears and rebuilds the index instead,
+ * which is fine since removals (Eg. esp_rmaker_node_remove_device()) are rare.
+ */
+
+#define NAME_INDEX_INITIAL_SIZE     8
+
+static const char *TAG = "esp_rmaker_name_index";
+
+uint32_t esp_rmaker_name_hash(const char *name, size_t len)
+{
+    /* 32 bit FNV-1a */
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+static void esp_rmaker_name_index_insert(esp_rmaker_name_index_entry_t *entries, uint16_t size,
+        uint32_t hash, const char *name, void *item)
+{
+    uint16_t i = hash & (size - 1);
+    while (entries[i].item) {
+        i = (i + 1) & (size - 1);
+    }
+    entries[i].hash = hash;
+    entries[i].name = name;
+    entries[i].item = item;
+}
+
+esp_err_t esp_rmaker_name_index_add(esp_rmaker_name_index_t *index, const char *name, void *item)
+{
+    if (!index || !name || !item) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    /* Keep the load factor below 3/4 */
+    if ((index->count + 1) * 4 > index->size * 3) {
+        uint16_t new_size = index->size ? index->size * 2 : NAME_INDEX_INITIAL_SIZE;
+        if (new_size < index->size) {
+            ESP_LOGE(TAG, "Name index cannot grow any further.");
+            return ESP_ERR_NO_MEM;
+        }
+        esp_rmaker_name_index_entry_t *new_entries = esp_rmaker_mem_calloc(ESP_RMAKER_MEM_CORE,
+                new_size, sizeof(esp_rmaker_name_index_entry_t));
+        if (!new_entries) {
+            ESP_LOGE(TAG, "Failed to allocate memory for name index.");
+            return ESP_ERR_NO_MEM;
+        }
+        for (uint16_t i = 0; i < index->size; i++) {
+            if (index->entries[i].item) {
+                esp_rmaker_name_index_insert(new_entries, new_size, index->entries[i].hash,
+                        index->entries[i].name, index->entries[i].item);
+            }
+        }
+        if (index->entries) {
+            esp_rmaker_mem_free(ESP_RMAKER_MEM_CORE, index->entries);
+        }
+        index->entries = new_entries;
+        index->size = new_size;
+    }
+    esp_rmaker_name_index_insert(index->entries, index->size, esp_rmaker_name_hash(name, strlen(name)),
+            name, item);
+    index->count++;
+    return ESP_OK;
+}
+
+void *esp_rmaker_name_index_find(const esp_rmaker_name_index_t *index, const char *name, size_t len)
+{
+    if (!index || !index->count || !name) {
+        return NULL;
+    }
+    uint32_t hash = esp_rmaker_name_hash(name, len);
+    uint16_t i = hash & (index->size - 1);
+    while (index->entries[i].item) {
+        if ((index->entries[i].hash == hash) && (strncmp(index->entries[i].name, name, len) == 0)
+                && (index->entries[i].name[len] == '\0')) {
+            return index->entries[i].item;
+        }
+        i = (i + 1) & (index->size - 1);
+    }
+    return NULL;
+}
+
+void esp_rmaker_name_index_clear(esp_rmaker_name_index_t *index)
+{
+    if (index) {
+        if (index->entries) {
+            esp_rmaker_mem_free(ESP_RMAKER_MEM_CORE, index->entries);
+        }
+        memset(index, 0, sizeof(esp_rmaker_name_index_t));
+    }
+}
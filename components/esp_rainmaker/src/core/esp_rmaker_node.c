@@ -20,6 +20,8 @@
 #include <esp_rmaker_core.h>
 
 #include "esp_rmaker_internal.h"
+#include "esp_rmaker_mem.h"
+#include "esp_rmaker_arena.h"
 
 static const char *TAG = "esp_rmaker_node";
 
@@ -27,18 +29,18 @@ static void esp_rmaker_node_info_free(esp_rmaker_node_info_t *info)
 {
     if (info) {
         if (info->name) {
-            free(info->name);
+            esp_rmaker_arena_free(ESP_RMAKER_MEM_CORE, info->name);
         }
         if (info->type) {
-            free(info->type);
+            esp_rmaker_arena_free(ESP_RMAKER_MEM_CORE, info->type);
         }
         if (info->model) {
-            free(info->model);
+            esp_rmaker_arena_free(ESP_RMAKER_MEM_CORE, info->model);
         }
         if (info->fw_version) {
-            free(info->fw_version);
+            esp_rmaker_arena_free(ESP_RMAKER_MEM_CORE, info->fw_version);
         }
-        free(info);
+        esp_rmaker_arena_free(ESP_RMAKER_MEM_CORE, info);
     }
 }
 
@@ -46,12 +48,12 @@ esp_err_t esp_rmaker_attribute_delete(esp_rmaker_attr_t *attr)
 {
     if (attr) {
         if (attr->name) {
-            free(attr->name);
+            esp_rmaker_arena_free(ESP_RMAKER_MEM_CORE, attr->name);
         }
         if (attr->value) {
-            free(attr->value);
+            esp_rmaker_arena_free(ESP_RMAKER_MEM_CORE, attr->value);
         }
-        free(attr);
+        esp_rmaker_arena_free(ESP_RMAKER_MEM_CORE, attr);
         return ESP_OK;
     }
     return ESP_ERR_INVALID_ARG;
@@ -74,6 +76,7 @@ esp_err_t esp_rmaker_node_delete(const esp_rmaker_node_t *node)
             esp_rmaker_device_delete((esp_rmaker_device_t *)device);
             device = next_device;
         }
+        esp_rmaker_name_index_clear(&_node->device_index);
         /* Node ID is created in the context of esp_rmaker_init and just assigned
          * here. So, we would not free it here.
          */
@@ -83,6 +86,7 @@ esp_err_t esp_rmaker_node_delete(const esp_rmaker_node_t *node)
         if (_node->info) {
             esp_rmaker_node_info_free(_node->info);
         }
+        esp_rmaker_node_config_invalidate();
         return ESP_OK;
     }
     return ESP_ERR_INVALID_ARG;
@@ -99,7 +103,7 @@ esp_rmaker_node_t *esp_rmaker_node_create(const char *name, const char *type)
         ESP_LOGE(TAG, "Node Name and Type are mandatory.");
         return NULL;
     }
-    _esp_rmaker_node_t *node = calloc(1, sizeof(_esp_rmaker_node_t));
+    _esp_rmaker_node_t *node = esp_rmaker_arena_calloc(ESP_RMAKER_MEM_CORE, sizeof(_esp_rmaker_node_t));
     if (!node) {
         ESP_LOGE(TAG, "Failed to allocate memory for node.");
         return NULL;
@@ -111,16 +115,16 @@ esp_rmaker_node_t *esp_rmaker_node_create(const char *name, const char *type)
     }
     ESP_LOGI(TAG, "Node ID ----- %s", node->node_id);
 
-    node->info = calloc(1, sizeof(esp_rmaker_node_info_t));
+    node->info = esp_rmaker_arena_calloc(ESP_RMAKER_MEM_CORE, sizeof(esp_rmaker_node_info_t));
     if (!node->info) {
         ESP_LOGE(TAG, "Failed to allocate memory for node info.");
         goto node_create_err;
     }
-    node->info->name = strdup(name);
-    node->info->type = strdup(type);
+    node->info->name = esp_rmaker_arena_strdup(ESP_RMAKER_MEM_CORE, name);
+    node->info->type = esp_rmaker_arena_strdup(ESP_RMAKER_MEM_CORE, type);
     const esp_app_desc_t *app_desc = esp_ota_get_app_description();
-    node->info->fw_version = strdup(app_desc->version);
-    node->info->model = strdup(app_desc->project_name);
+    node->info->fw_version = esp_rmaker_arena_strdup(ESP_RMAKER_MEM_CORE, app_desc->version);
+    node->info->model = esp_rmaker_arena_strdup(ESP_RMAKER_MEM_CORE, app_desc->project_name);
     if (!node->info->name || !node->info->type
             || !node->info->fw_version || !node->info->model) {
         ESP_LOGE(TAG, "Failed to allocate memory for node info.");
@@ -145,12 +149,13 @@ esp_err_t esp_rmaker_node_add_fw_version(const esp_rmaker_node_t *node, const ch
         return ESP_ERR_INVALID_ARG;
     }
     if (info->fw_version) {
-        free(info->fw_version);
+        esp_rmaker_arena_free(ESP_RMAKER_MEM_CORE, info->fw_version);
     }
-    info->fw_version = strdup(fw_version);
+    info->fw_version = esp_rmaker_arena_strdup(ESP_RMAKER_MEM_CORE, fw_version);
     if (!info->fw_version) {
         ESP_LOGE(TAG, "Failed to allocate memory for fw version.");
     }
+    esp_rmaker_node_config_invalidate();
     return ESP_OK;
 }
 
@@ -166,12 +171,13 @@ esp_err_t esp_rmaker_node_add_model(const esp_rmaker_node_t *node, const char *m
         return ESP_ERR_INVALID_ARG;
     }
     if (info->model) {
-        free(info->model);
+        esp_rmaker_arena_free(ESP_RMAKER_MEM_CORE, info->model);
     }
-    info->model = strdup(model);
+    info->model = esp_rmaker_arena_strdup(ESP_RMAKER_MEM_CORE, model);
     if (!info->model) {
         ESP_LOGE(TAG, "Failed to allocate memory for node model.");
     }
+    esp_rmaker_node_config_invalidate();
     return ESP_OK;
 }
 
@@ -189,13 +195,13 @@ esp_err_t esp_rmaker_node_add_attribute(const esp_rmaker_node_t *node, const cha
         }
         attr = attr->next;
     }
-    esp_rmaker_attr_t *new_attr = calloc(1, sizeof(esp_rmaker_attr_t));
+    esp_rmaker_attr_t *new_attr = esp_rmaker_arena_calloc(ESP_RMAKER_MEM_CORE, sizeof(esp_rmaker_attr_t));
     if (!new_attr) {
         ESP_LOGE(TAG, "Failed to create node attribute %s.", attr_name);
         return ESP_ERR_NO_MEM;
     }
-    new_attr->name = strdup(attr_name);
-    new_attr->value = strdup(value);
+    new_attr->name = esp_rmaker_arena_intern(ESP_RMAKER_MEM_CORE, attr_name);
+    new_attr->value = esp_rmaker_arena_strdup(ESP_RMAKER_MEM_CORE, value);
     if (!new_attr->name || !new_attr->value) {
         ESP_LOGE(TAG, "Failed to allocate memory for name/value for attribute %s.", attr_name);
         esp_rmaker_attribute_delete(new_attr);
@@ -208,6 +214,7 @@ esp_err_t esp_rmaker_node_add_attribute(const esp_rmaker_node_t *node, const cha
         ((_esp_rmaker_node_t *)node)->attributes = new_attr;
     }
     ESP_LOGI(TAG, "Node attribute %s created", attr_name);
+    esp_rmaker_node_config_invalidate();
     return ESP_OK;
 }
 
@@ -219,9 +226,12 @@ esp_err_t esp_rmaker_node_add_device(const esp_rmaker_node_t *node, const esp_rm
     }
     _esp_rmaker_node_t *_node = (_esp_rmaker_node_t *)node;
     _esp_rmaker_device_t *_new_device = (_esp_rmaker_device_t *)device;
+    /* The device list and index are also used by the reporting and remote write paths */
+    esp_rmaker_param_lock();
     _esp_rmaker_device_t *_device = _node->devices;
     while(_device) {
         if (strcmp(_device->name, _new_device->name) == 0) {
+            esp_rmaker_param_unlock();
             ESP_LOGE(TAG, "%s with name %s already exists", _new_device->is_service ? "Service":"Device", _new_device->name);
             return ESP_ERR_INVALID_ARG;
         }
@@ -231,12 +241,19 @@ esp_err_t esp_rmaker_node_add_device(const esp_rmaker_node_t *node, const esp_rm
             break;
         }
     }
+    if (esp_rmaker_name_index_add(&_node->device_index, _new_device->name, _new_device) != ESP_OK) {
+        esp_rmaker_param_unlock();
+        ESP_LOGE(TAG, "Failed to index %s %s", _new_device->is_service ? "Service":"Device", _new_device->name);
+        return ESP_ERR_NO_MEM;
+    }
     if (_device) {
         _device->next = _new_device;
     } else {
         _node->devices = _new_device;
     }
     _new_device->parent = node;
+    esp_rmaker_param_unlock();
+    esp_rmaker_node_config_invalidate();
     return ESP_OK;
 }
 
@@ -249,6 +266,7 @@ esp_err_t esp_rmaker_node_remove_device(const esp_rmaker_node_t *node, const esp
     _esp_rmaker_node_t *_node = (_esp_rmaker_node_t *)node;
     _esp_rmaker_device_t *_device = (_esp_rmaker_device_t *)device;
 
+    esp_rmaker_param_lock();
     _esp_rmaker_device_t *tmp_device = _node->devices;
     _esp_rmaker_device_t *prev_device = NULL;
     while(tmp_device) {
@@ -259,6 +277,7 @@ esp_err_t esp_rmaker_node_remove_device(const esp_rmaker_node_t *node, const esp
         tmp_device = tmp_device->next;
     }
     if (!tmp_device) {
+         esp_rmaker_param_unlock();
          ESP_LOGE(TAG, "Device %s not found in node %s", _device->name, _node->info->name);
          return ESP_ERR_INVALID_ARG;
     }
@@ -267,7 +286,19 @@ esp_err_t esp_rmaker_node_remove_device(const esp_rmaker_node_t *node, const esp
     } else {
         prev_device->next = tmp_device->next;
     }
+    /* Entries cannot be removed from the name index. So, just rebuild it */
+    esp_rmaker_name_index_clear(&_node->device_index);
+    for (_esp_rmaker_device_t *dev = _node->devices; dev; dev = dev->next) {
+        if (esp_rmaker_name_index_add(&_node->device_index, dev->name, dev) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to re-index %s", dev->name);
+        }
+    }
+    /* Cleared with the lock held, so that no new changes get queued for reporting after they are discarded */
     tmp_device->parent = NULL;
+    esp_rmaker_param_unlock();
+    esp_rmaker_device_discard_changes(tmp_device);
+    esp_rmaker_device_flush_pending_store(tmp_device);
+    esp_rmaker_node_config_invalidate();
     return ESP_OK;
 }
 
@@ -12,15 +12,38 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 #include <sdkconfig.h>
+#include <stdlib.h>
 #include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <esp_log.h>
+#include <nvs.h>
 #include <json_generator.h>
 #include <esp_rmaker_core.h>
 #include "esp_rmaker_internal.h"
 #include "esp_rmaker_mqtt.h"
+#include "esp_rmaker_mem.h"
 
 #define NODE_CONFIG_TOPIC_SUFFIX        "config"
-#define MAX_NODE_CONFIG_SIZE            CONFIG_ESP_RMAKER_MAX_NODE_CONFIG_SIZE
+#define NODE_CONFIG_CHUNK_SIZE          CONFIG_ESP_RMAKER_NODE_CONFIG_CHUNK_SIZE
+#define PARAMS_ENCODING_ATTR_NAME       "params_encoding"
+
+#define ESP_RMAKER_NVS_PART_NAME                "nvs"
+#define ESP_RMAKER_NVS_CORE_NAMESPACE           "rmaker_core"
+#define ESP_RMAKER_NODE_CONFIG_HASH_NVS_NAME    "config_hash"
+
+/* Bumped whenever anything which is a part of the node config changes */
+static uint32_t node_config_generation = 1;
+/* The node config, as generated for the generation indicated */
+static struct {
+    char *data;
+    size_t len;
+    uint32_t generation;
+    uint32_t hash;
+} node_config_cache;
+static SemaphoreHandle_t node_config_lock;
+/* Set if publishing the node config failed, Eg. since the publish queue was full, so that it gets reported again */
+static bool node_config_report_pending;
 
 static const char *TAG = "esp_rmaker_node_config";
 static esp_err_t esp_rmaker_report_info(json_gen_str_t *jptr)
@@ -49,6 +72,15 @@ static void esp_rmaker_report_attribute(esp_rmaker_attr_t *attr, json_gen_str_t
 static esp_err_t esp_rmaker_report_node_attributes(json_gen_str_t *jptr)
 {
     esp_rmaker_attr_t *attr = esp_rmaker_node_get_first_attribute(esp_rmaker_get_node());
+#ifdef CONFIG_ESP_RMAKER_PARAM_CBOR
+    /* Let the cloud know that the params payloads will be CBOR encoded */
+    esp_rmaker_attr_t encoding_attr = {
+        .name = (char *)PARAMS_ENCODING_ATTR_NAME,
+        .value = (char *)"cbor",
+        .next = attr,
+    };
+    attr = &encoding_attr;
+#endif /* CONFIG_ESP_RMAKER_PARAM_CBOR */
     if (!attr) {
         return ESP_OK;
     }
@@ -214,41 +246,203 @@ static esp_err_t esp_rmaker_report_devices_or_services(json_gen_str_t *jptr, cha
     return ESP_OK;
 }
 
-char *esp_rmaker_get_node_config(void)
+esp_err_t esp_rmaker_node_config_stream(json_gen_flush_cb_t flush_cb, void *priv)
 {
-    char *node_config = calloc(1, MAX_NODE_CONFIG_SIZE);
-    if (!node_config) {
-        ESP_LOGE(TAG, "Failed to allocate %d bytes for node config", MAX_NODE_CONFIG_SIZE);
-        return NULL;
+    if (!flush_cb) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    /* The generator flushes the chunks to the callback whenever this buffer gets full */
+    char *chunk = esp_rmaker_mem_malloc(ESP_RMAKER_MEM_CORE, NODE_CONFIG_CHUNK_SIZE);
+    if (!chunk) {
+        ESP_LOGE(TAG, "Failed to allocate %d bytes for node config chunk", NODE_CONFIG_CHUNK_SIZE);
+        return ESP_ERR_NO_MEM;
     }
     json_gen_str_t jstr;
-    json_gen_str_start(&jstr, node_config, MAX_NODE_CONFIG_SIZE, NULL, NULL);
+    json_gen_str_start(&jstr, chunk, NODE_CONFIG_CHUNK_SIZE, flush_cb, priv);
     json_gen_start_object(&jstr);
     esp_rmaker_report_info(&jstr);
     esp_rmaker_report_node_attributes(&jstr);
     esp_rmaker_report_devices_or_services(&jstr, "devices");
     esp_rmaker_report_devices_or_services(&jstr, "services");
-    if (json_gen_end_object(&jstr) < 0) {
-        free(node_config);
-        ESP_LOGE(TAG, "Buffer size %d not sufficient for Node Config.", MAX_NODE_CONFIG_SIZE);
+    json_gen_end_object(&jstr);
+    json_gen_str_end(&jstr);
+    esp_rmaker_mem_free(ESP_RMAKER_MEM_CORE, chunk);
+    return ESP_OK;
+}
+
+void esp_rmaker_node_config_invalidate(void)
+{
+    /* Called from the application as well as the RainMaker tasks, without the node config lock */
+    __atomic_add_fetch(&node_config_generation, 1, __ATOMIC_SEQ_CST);
+}
+
+esp_err_t esp_rmaker_node_config_init(void)
+{
+    if (!node_config_lock) {
+        node_config_lock = xSemaphoreCreateMutex();
+        if (!node_config_lock) {
+            ESP_LOGE(TAG, "Failed to create node config lock");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return ESP_OK;
+}
+
+static void esp_rmaker_node_config_len_cb(char *buf, void *priv)
+{
+    *(size_t *)priv += strlen(buf);
+}
+
+typedef struct {
+    char *buf;
+    size_t offset;
+    size_t buf_len;
+    uint32_t hash;
+} esp_rmaker_node_config_copy_t;
+
+static void esp_rmaker_node_config_copy_cb(char *buf, void *priv)
+{
+    esp_rmaker_node_config_copy_t *copy = (esp_rmaker_node_config_copy_t *)priv;
+    size_t len = strlen(buf);
+    /* The node config can't change between the two passes, but be safe anyway */
+    if (len > copy->buf_len - copy->offset) {
+        len = copy->buf_len - copy->offset;
+    }
+    memcpy(copy->buf + copy->offset, buf, len);
+    copy->offset += len;
+    /* 32 bit FNV-1a */
+    for (size_t i = 0; i < len; i++) {
+        copy->hash ^= (uint8_t)buf[i];
+        copy->hash *= 16777619U;
+    }
+}
+
+/* Regenerate the cached node config, if it has changed since it was last generated.
+ * Should be called with the node config lock held.
+ */
+static esp_err_t esp_rmaker_node_config_update_cache(void)
+{
+    uint32_t generation = __atomic_load_n(&node_config_generation, __ATOMIC_SEQ_CST);
+    if (node_config_cache.data && (node_config_cache.generation == generation)) {
+        return ESP_OK;
+    }
+    /* Find the length first, so that exactly as much memory as required is allocated,
+     * irrespective of the size of the node.
+     */
+    size_t len = 0;
+    if (esp_rmaker_node_config_stream(esp_rmaker_node_config_len_cb, &len) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    esp_rmaker_node_config_copy_t copy = {
+        .buf = esp_rmaker_mem_calloc(ESP_RMAKER_MEM_CORE, 1, len + 1),
+        .buf_len = len,
+        .hash = 2166136261U,
+    };
+    if (!copy.buf) {
+        ESP_LOGE(TAG, "Failed to allocate %d bytes for node config", (int)len + 1);
+        return ESP_ERR_NO_MEM;
+    }
+    if (esp_rmaker_node_config_stream(esp_rmaker_node_config_copy_cb, &copy) != ESP_OK) {
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_CORE, copy.buf);
+        return ESP_FAIL;
+    }
+    if (node_config_cache.data) {
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_CORE, node_config_cache.data);
+    }
+    node_config_cache.data = copy.buf;
+    node_config_cache.len = copy.offset;
+    node_config_cache.hash = copy.hash;
+    /* If the config was changed while it was being generated, it will just be generated again */
+    node_config_cache.generation = generation;
+    return ESP_OK;
+}
+
+char *esp_rmaker_get_node_config(void)
+{
+    if (!node_config_lock) {
+        ESP_LOGE(TAG, "Node config not initialised");
         return NULL;
     }
-    json_gen_str_end(&jstr);
+    char *node_config = NULL;
+    xSemaphoreTake(node_config_lock, portMAX_DELAY);
+    if (esp_rmaker_node_config_update_cache() == ESP_OK) {
+        /* Callers own the returned copy, since the cache can get regenerated any time */
+        node_config = esp_rmaker_mem_malloc(ESP_RMAKER_MEM_CORE, node_config_cache.len + 1);
+        if (node_config) {
+            memcpy(node_config, node_config_cache.data, node_config_cache.len + 1);
+        } else {
+            ESP_LOGE(TAG, "Failed to allocate %d bytes for node config", (int)node_config_cache.len + 1);
+        }
+    }
+    xSemaphoreGive(node_config_lock);
     return node_config;
 }
 
+#ifdef CONFIG_ESP_RMAKER_SKIP_UNCHANGED_NODE_CONFIG
+static uint32_t esp_rmaker_node_config_get_reported_hash(void)
+{
+    uint32_t hash = 0;
+    nvs_handle handle;
+    if (nvs_open_from_partition(ESP_RMAKER_NVS_PART_NAME, ESP_RMAKER_NVS_CORE_NAMESPACE,
+                NVS_READONLY, &handle) == ESP_OK) {
+        nvs_get_u32(handle, ESP_RMAKER_NODE_CONFIG_HASH_NVS_NAME, &hash);
+        nvs_close(handle);
+    }
+    return hash;
+}
+
+static void esp_rmaker_node_config_set_reported_hash(uint32_t hash)
+{
+    nvs_handle handle;
+    if (nvs_open_from_partition(ESP_RMAKER_NVS_PART_NAME, ESP_RMAKER_NVS_CORE_NAMESPACE,
+                NVS_READWRITE, &handle) == ESP_OK) {
+        nvs_set_u32(handle, ESP_RMAKER_NODE_CONFIG_HASH_NVS_NAME, hash);
+        nvs_commit(handle);
+        nvs_close(handle);
+    }
+}
+#endif /* CONFIG_ESP_RMAKER_SKIP_UNCHANGED_NODE_CONFIG */
+
+bool esp_rmaker_node_config_take_report_pending(void)
+{
+    return __atomic_exchange_n(&node_config_report_pending, false, __ATOMIC_SEQ_CST);
+}
+
 esp_err_t esp_rmaker_report_node_config()
 {
-    char *publish_payload = esp_rmaker_get_node_config();
-    if (!publish_payload) {
+    if (!node_config_lock) {
+        ESP_LOGE(TAG, "Node config not initialised");
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(node_config_lock, portMAX_DELAY);
+    esp_err_t ret = esp_rmaker_node_config_update_cache();
+    if (ret != ESP_OK) {
+        xSemaphoreGive(node_config_lock);
         ESP_LOGE(TAG, "Could not get node configuration for reporting to cloud");
         return ESP_FAIL;
     }
-
+#ifdef CONFIG_ESP_RMAKER_SKIP_UNCHANGED_NODE_CONFIG
+    if (node_config_cache.hash == esp_rmaker_node_config_get_reported_hash()) {
+        xSemaphoreGive(node_config_lock);
+        ESP_LOGI(TAG, "Node Configuration unchanged. Not reporting.");
+        return ESP_OK;
+    }
+#endif /* CONFIG_ESP_RMAKER_SKIP_UNCHANGED_NODE_CONFIG */
     char publish_topic[100];
     snprintf(publish_topic, sizeof(publish_topic), "node/%s/%s", esp_rmaker_get_node_id(), NODE_CONFIG_TOPIC_SUFFIX);
     ESP_LOGI(TAG, "Reporting Node Configuration");
-    esp_err_t ret = esp_rmaker_mqtt_publish(publish_topic, publish_payload, strlen(publish_payload));
-    free(publish_payload);
+    /* The MQTT client copies the data, so the cache can be published directly */
+    ret = esp_rmaker_mqtt_publish_with_prio(publish_topic, node_config_cache.data, node_config_cache.len,
+            1, ESP_RMAKER_MQTT_PRIO_BULK);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to publish Node Configuration. Will retry.");
+    }
+    __atomic_store_n(&node_config_report_pending, ret != ESP_OK, __ATOMIC_SEQ_CST);
+#ifdef CONFIG_ESP_RMAKER_SKIP_UNCHANGED_NODE_CONFIG
+    if (ret == ESP_OK) {
+        esp_rmaker_node_config_set_reported_hash(node_config_cache.hash);
+    }
+#endif /* CONFIG_ESP_RMAKER_SKIP_UNCHANGED_NODE_CONFIG */
+    xSemaphoreGive(node_config_lock);
     return ret;
 }
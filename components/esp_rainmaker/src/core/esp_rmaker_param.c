@@ -12,10 +12,14 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 #include <sdkconfig.h>
+#include <stdlib.h>
 #include <string.h>
 #include <esp_log.h>
 #include <esp_err.h>
+#include <esp_timer.h>
 #include <nvs.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 
 #include <json_parser.h>
 #include <json_generator.h>
@@ -25,6 +29,11 @@
 #include <esp_rmaker_mqtt.h>
 
 #include "esp_rmaker_internal.h"
+#ifdef CONFIG_ESP_RMAKER_PARAM_CBOR
+#include "esp_rmaker_cbor.h"
+#endif /* CONFIG_ESP_RMAKER_PARAM_CBOR */
+#include "esp_rmaker_mem.h"
+#include "esp_rmaker_arena.h"
 
 #define NODE_PARAMS_LOCAL_TOPIC_SUFFIX          "params/local"
 #define NODE_PARAMS_LOCAL_INIT_TOPIC_SUFFIX     "params/local/init"
@@ -35,8 +44,39 @@
 #define MAX_PUBLISH_TOPIC_LEN           64
 
 #define MAX_NODE_PARAMS_SIZE           CONFIG_ESP_RMAKER_MAX_PARAM_DATA_SIZE
+/* Length of the params payload with no params, in either of the encodings */
+#define ESP_RMAKER_EMPTY_PARAMS_LEN     2
+/* Concurrency model for the param store.
+ *
+ * Params are updated from the application tasks, the MQTT task (remote writes), the local control
+ * server and the RainMaker work queue (schedules, timers). All the writers go through param_lock,
+ * which protects the values, the changed/store pending lists and the device/param lists. It is held
+ * only for updating values and encoding payloads, never across an MQTT publish or an NVS write.
+ *
+ * Boolean, integer and float values are additionally protected by a per param sequence counter, so
+ * that esp_rmaker_param_get_val() reads them without taking any lock.
+ *
+ * publish_payload and publish_topic are owned by whoever holds publish_lock. A report which finds
+ * publish_lock busy is handed off to the RainMaker task instead of waiting for it, so that the MQTT
+ * task never blocks on a publish from some other task, which may itself be waiting for the MQTT task.
+ * The lock order is publish_lock, then param_lock.
+ */
+static SemaphoreHandle_t param_lock;
+static SemaphoreHandle_t publish_lock;
 static char publish_payload[MAX_NODE_PARAMS_SIZE];
 static char publish_topic[MAX_PUBLISH_TOPIC_LEN];
+static esp_timer_handle_t report_timer;
+/* Devices having params which have changed, but not yet reported */
+static _esp_rmaker_device_t *changed_devices;
+/* A report has been handed off to the RainMaker task, and has not yet started */
+static bool report_work_queued;
+
+#define PARAM_STORE_DELAY_US        ((int64_t)CONFIG_ESP_RMAKER_PARAM_STORE_DELAY * 1000)
+#define PARAM_STORE_MAX_DELAY_US    (PARAM_STORE_DELAY_US * 10)
+static esp_timer_handle_t store_timer;
+/* Devices having params whose values are yet to be written to NVS */
+static _esp_rmaker_device_t *store_pending_devices;
+static int64_t store_first_pending_time;
 
 static const char *TAG = "esp_rmaker_param";
 
@@ -110,201 +150,827 @@ esp_rmaker_param_val_t esp_rmaker_array(const char *val)
     return param_val;
 }
 
-static esp_err_t esp_rmaker_populate_params(char *buf, size_t buf_len, uint8_t flags, bool reset_flags)
+esp_err_t esp_rmaker_param_lock_init(void)
 {
+    if (!param_lock) {
+        param_lock = xSemaphoreCreateMutex();
+        if (!param_lock) {
+            ESP_LOGE(TAG, "Failed to create param lock");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (!publish_lock) {
+        publish_lock = xSemaphoreCreateMutex();
+        if (!publish_lock) {
+            ESP_LOGE(TAG, "Failed to create param publish lock");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return ESP_OK;
+}
+
+/* The locks are created by esp_rmaker_node_init(). Till then, there is just the application task
+ * setting up the node and so, nothing to lock against.
+ */
+void esp_rmaker_param_lock(void)
+{
+    if (param_lock) {
+        xSemaphoreTake(param_lock, portMAX_DELAY);
+    }
+}
+
+void esp_rmaker_param_unlock(void)
+{
+    if (param_lock) {
+        xSemaphoreGive(param_lock);
+    }
+}
+
+static bool esp_rmaker_publish_lock(TickType_t wait)
+{
+    if (publish_lock) {
+        return xSemaphoreTake(publish_lock, wait) == pdTRUE;
+    }
+    return true;
+}
+
+static void esp_rmaker_publish_unlock(void)
+{
+    if (publish_lock) {
+        xSemaphoreGive(publish_lock);
+    }
+}
+
+static bool esp_rmaker_val_type_is_str(esp_rmaker_val_type_t type)
+{
+    return (type == RMAKER_VAL_TYPE_STRING) || (type == RMAKER_VAL_TYPE_OBJECT) || (type == RMAKER_VAL_TYPE_ARRAY);
+}
+
+/* Set the value of a boolean, integer or float param. Should be called with the param lock held.
+ * The sequence counter is odd while the value is being written, which makes the lock free readers retry.
+ */
+static void esp_rmaker_param_set_scalar_val(_esp_rmaker_param_t *param, esp_rmaker_param_val_t *val)
+{
+    uint32_t seq = param->val_seq;
+    __atomic_store_n(&param->val_seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    param->val.val = val->val;
+    __atomic_store_n(&param->val_seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+void esp_rmaker_param_set_stored_val(_esp_rmaker_param_t *param, esp_rmaker_param_val_t *val)
+{
+    if (esp_rmaker_val_type_is_str(param->val.type)) {
+        /* String values are read only with the param lock held, so the buffer can just be swapped */
+        if (param->val.val.s) {
+            esp_rmaker_mem_free(ESP_RMAKER_MEM_PARAM, param->val.val.s);
+        }
+        param->val.val.s = val->val.s;
+        param->val_buf_size = val->val.s ? strlen(val->val.s) + 1 : 0;
+    } else {
+        esp_rmaker_param_set_scalar_val(param, val);
+    }
+}
+
+/* Get a copy of the value of a param. String values are duplicated, and should be freed using
+ * esp_rmaker_mem_free(ESP_RMAKER_MEM_PARAM, ...). Should be called with the param lock held.
+ */
+static esp_err_t esp_rmaker_param_copy_val(_esp_rmaker_param_t *param, esp_rmaker_param_val_t *val)
+{
+    *val = param->val;
+    if (esp_rmaker_val_type_is_str(param->val.type) && param->val.val.s) {
+        val->val.s = esp_rmaker_mem_strdup(ESP_RMAKER_MEM_PARAM, param->val.val.s);
+        if (!val->val.s) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return ESP_OK;
+}
+
+static void esp_rmaker_param_free_val_copy(esp_rmaker_param_val_t *val)
+{
+    if (esp_rmaker_val_type_is_str(val->type) && val->val.s) {
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_PARAM, val->val.s);
+        val->val.s = NULL;
+    }
+}
+
+esp_err_t esp_rmaker_param_get_val(const esp_rmaker_param_t *param, esp_rmaker_param_val_t *val)
+{
+    if (!param || !val) {
+        ESP_LOGE(TAG, "Param handle or value cannot be NULL.");
+        return ESP_ERR_INVALID_ARG;
+    }
+    _esp_rmaker_param_t *_param = (_esp_rmaker_param_t *)param;
+    if (esp_rmaker_val_type_is_str(_param->val.type)) {
+        esp_rmaker_param_lock();
+        esp_err_t err = esp_rmaker_param_copy_val(_param, val);
+        esp_rmaker_param_unlock();
+        if (err == ESP_OK && val->val.s) {
+            /* The copy is freed by the application, using free() */
+            esp_rmaker_mem_untrack(ESP_RMAKER_MEM_PARAM, val->val.s);
+        }
+        return err;
+    }
+    uint32_t seq;
+    do {
+        seq = __atomic_load_n(&_param->val_seq, __ATOMIC_ACQUIRE);
+        *val = _param->val;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || (seq != __atomic_load_n(&_param->val_seq, __ATOMIC_RELAXED)));
+    return ESP_OK;
+}
+
+/* Time at which the pending changes of a device should be reported, or INT64_MAX if there are none */
+static int64_t esp_rmaker_device_get_report_time(_esp_rmaker_device_t *device)
+{
+    if (!device->first_change_time) {
+        return INT64_MAX;
+    }
+    int64_t report_time = device->last_report_time + (int64_t)device->report_min_interval_ms * 1000;
+    if (device->report_max_latency_ms) {
+        int64_t latest_report_time = device->first_change_time + (int64_t)device->report_max_latency_ms * 1000;
+        if (latest_report_time < report_time) {
+            report_time = latest_report_time;
+        }
+    }
+    return report_time;
+}
+
+/* Encoder for the node params payloads. The params are encoded as CBOR if
+ * CONFIG_ESP_RMAKER_PARAM_CBOR is enabled, and as JSON otherwise.
+ */
+typedef struct {
+#ifdef CONFIG_ESP_RMAKER_PARAM_CBOR
+    esp_rmaker_cbor_enc_t cbor;
+#else
     json_gen_str_t jstr;
-    json_gen_str_start(&jstr, buf, buf_len, NULL, NULL);
-    json_gen_start_object(&jstr);
+    char *buf;
+#endif /* CONFIG_ESP_RMAKER_PARAM_CBOR */
+} esp_rmaker_params_enc_t;
+
+#ifdef CONFIG_ESP_RMAKER_PARAM_CBOR
+static void esp_rmaker_params_enc_start(esp_rmaker_params_enc_t *enc, char *buf, size_t buf_len)
+{
+    esp_rmaker_cbor_enc_start(&enc->cbor, (uint8_t *)buf, buf_len);
+    esp_rmaker_cbor_enc_start_map(&enc->cbor);
+}
+
+static void esp_rmaker_params_enc_push_device(esp_rmaker_params_enc_t *enc, const char *name)
+{
+    esp_rmaker_cbor_enc_text(&enc->cbor, name);
+    esp_rmaker_cbor_enc_start_map(&enc->cbor);
+}
+
+static void esp_rmaker_params_enc_pop_device(esp_rmaker_params_enc_t *enc)
+{
+    esp_rmaker_cbor_enc_end_map(&enc->cbor);
+}
+
+static void esp_rmaker_params_enc_value(esp_rmaker_params_enc_t *enc, _esp_rmaker_param_t *param)
+{
+    esp_rmaker_cbor_enc_text(&enc->cbor, param->name);
+    switch (param->val.type) {
+        case RMAKER_VAL_TYPE_BOOLEAN:
+            esp_rmaker_cbor_enc_bool(&enc->cbor, param->val.val.b);
+            break;
+        case RMAKER_VAL_TYPE_INTEGER:
+            esp_rmaker_cbor_enc_int(&enc->cbor, param->val.val.i);
+            break;
+        case RMAKER_VAL_TYPE_FLOAT:
+            esp_rmaker_cbor_enc_float(&enc->cbor, param->val.val.f);
+            break;
+        case RMAKER_VAL_TYPE_OBJECT:
+        case RMAKER_VAL_TYPE_ARRAY:
+            /* Objects and arrays are held as JSON strings and so, are reported as is */
+            esp_rmaker_cbor_enc_tag(&enc->cbor, CBOR_TAG_EMBEDDED_JSON);
+            /* Fall through */
+        case RMAKER_VAL_TYPE_STRING:
+            esp_rmaker_cbor_enc_text(&enc->cbor, param->val.val.s);
+            break;
+        default:
+            esp_rmaker_cbor_enc_null(&enc->cbor);
+            break;
+    }
+}
+
+/* Returns the length of the encoded data, or -1 if the buffer was not sufficient */
+static int esp_rmaker_params_enc_end(esp_rmaker_params_enc_t *enc)
+{
+    esp_rmaker_cbor_enc_end_map(&enc->cbor);
+    return esp_rmaker_cbor_enc_end(&enc->cbor);
+}
+
+static void esp_rmaker_params_log(const char *msg, const char *data, int len)
+{
+    ESP_LOGI(TAG, "%s: %d bytes of CBOR data", msg, len);
+}
+#else
+static void esp_rmaker_params_enc_start(esp_rmaker_params_enc_t *enc, char *buf, size_t buf_len)
+{
+    enc->buf = buf;
+    json_gen_str_start(&enc->jstr, buf, buf_len, NULL, NULL);
+    json_gen_start_object(&enc->jstr);
+}
+
+static void esp_rmaker_params_enc_push_device(esp_rmaker_params_enc_t *enc, const char *name)
+{
+    json_gen_push_object(&enc->jstr, (char *)name);
+}
+
+static void esp_rmaker_params_enc_pop_device(esp_rmaker_params_enc_t *enc)
+{
+    json_gen_pop_object(&enc->jstr);
+}
+
+static void esp_rmaker_params_enc_value(esp_rmaker_params_enc_t *enc, _esp_rmaker_param_t *param)
+{
+    esp_rmaker_report_value(&param->val, param->name, &enc->jstr);
+}
+
+/* Returns the length of the encoded data, or -1 if the buffer was not sufficient */
+static int esp_rmaker_params_enc_end(esp_rmaker_params_enc_t *enc)
+{
+    if (json_gen_end_object(&enc->jstr) < 0) {
+        return -1;
+    }
+    json_gen_str_end(&enc->jstr);
+    return strlen(enc->buf);
+}
+
+static void esp_rmaker_params_log(const char *msg, const char *data, int len)
+{
+    ESP_LOGI(TAG, "%s: %.*s", msg, len, data);
+}
+#endif /* CONFIG_ESP_RMAKER_PARAM_CBOR */
+
+static esp_err_t esp_rmaker_populate_params(char *buf, size_t buf_len, int *data_len)
+{
+    esp_rmaker_params_enc_t enc;
+    esp_rmaker_params_enc_start(&enc, buf, buf_len);
     _esp_rmaker_device_t *device = esp_rmaker_node_get_first_device(esp_rmaker_get_node());
     while (device) {
-        bool device_added = false;
-        _esp_rmaker_param_t *param = device->params;
-        while (param) {
-            if (!flags || (param->flags & flags)) {
-                if (!device_added) {
-                    json_gen_push_object(&jstr, device->name);
-                    device_added = true;
-                }
-                esp_rmaker_report_value(&param->val, param->name, &jstr);
-                if (reset_flags) {
-                    param->flags &= ~flags;
-                }
+        if (device->params) {
+            esp_rmaker_params_enc_push_device(&enc, device->name);
+            _esp_rmaker_param_t *param = device->params;
+            while (param) {
+                esp_rmaker_params_enc_value(&enc, param);
+                param = param->next;
             }
-            param = param->next;
-        }
-        if (device_added) {
-            json_gen_pop_object(&jstr);
+            esp_rmaker_params_enc_pop_device(&enc);
         }
         device = device->next;
     }
-    if (json_gen_end_object(&jstr) < 0) {
+    *data_len = esp_rmaker_params_enc_end(&enc);
+    if (*data_len < 0) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+/* Populate only the changed params of the devices whose changes are due for reporting by
+ * report_time, and remove them from the list of changed devices. Only the changed params
+ * are visited, rather than all the params of the node.
+ */
+static esp_err_t esp_rmaker_populate_changed_params(char *buf, size_t buf_len, int64_t report_time,
+        int *data_len)
+{
+    esp_rmaker_params_enc_t enc;
+    esp_rmaker_params_enc_start(&enc, buf, buf_len);
+    _esp_rmaker_device_t **prev_next = &changed_devices;
+    while (*prev_next) {
+        _esp_rmaker_device_t *device = *prev_next;
+        if (esp_rmaker_device_get_report_time(device) > report_time) {
+            prev_next = &device->next_changed;
+            continue;
+        }
+        *prev_next = device->next_changed;
+        device->next_changed = NULL;
+        device->last_report_time = report_time;
+        device->first_change_time = 0;
+        esp_rmaker_params_enc_push_device(&enc, device->name);
+        _esp_rmaker_param_t *param = device->changed_params;
+        while (param) {
+            _esp_rmaker_param_t *next_param = param->next_changed;
+            esp_rmaker_params_enc_value(&enc, param);
+            param->flags &= ~RMAKER_PARAM_FLAG_VALUE_CHANGE;
+            param->next_changed = NULL;
+            param = next_param;
+        }
+        device->changed_params = NULL;
+        esp_rmaker_params_enc_pop_device(&enc);
+    }
+    *data_len = esp_rmaker_params_enc_end(&enc);
+    if (*data_len < 0) {
         return ESP_ERR_NO_MEM;
     }
-    json_gen_str_end(&jstr);
     return ESP_OK;
 }
 
-char *esp_rmaker_get_node_params(void)
+/* Should be called with the param lock held */
+static void __esp_rmaker_device_discard_changes(_esp_rmaker_device_t *device)
 {
-    char *node_params = calloc(1, MAX_NODE_PARAMS_SIZE);
+    _esp_rmaker_device_t **prev_next = &changed_devices;
+    while (*prev_next) {
+        if (*prev_next == device) {
+            *prev_next = device->next_changed;
+            break;
+        }
+        prev_next = &(*prev_next)->next_changed;
+    }
+    _esp_rmaker_param_t *param = device->changed_params;
+    while (param) {
+        _esp_rmaker_param_t *next_param = param->next_changed;
+        param->flags &= ~RMAKER_PARAM_FLAG_VALUE_CHANGE;
+        param->next_changed = NULL;
+        param = next_param;
+    }
+    device->changed_params = NULL;
+    device->next_changed = NULL;
+    device->first_change_time = 0;
+}
+
+void esp_rmaker_device_discard_changes(_esp_rmaker_device_t *device)
+{
+    esp_rmaker_param_lock();
+    __esp_rmaker_device_discard_changes(device);
+    esp_rmaker_param_unlock();
+}
+
+char *esp_rmaker_get_node_params(size_t *len)
+{
+    char *node_params = esp_rmaker_mem_calloc(ESP_RMAKER_MEM_PARAM, 1, MAX_NODE_PARAMS_SIZE);
     if (!node_params) {
         ESP_LOGE(TAG, "Failed to allocate %d bytes for Node params.", MAX_NODE_PARAMS_SIZE);
         return NULL;
     }
-    if (esp_rmaker_populate_params(node_params, MAX_NODE_PARAMS_SIZE, 0, false) == ESP_OK) {
+    int data_len;
+    esp_rmaker_param_lock();
+    esp_err_t err = esp_rmaker_populate_params(node_params, MAX_NODE_PARAMS_SIZE, &data_len);
+    esp_rmaker_param_unlock();
+    if (err == ESP_OK) {
+        *len = data_len;
         return node_params;
     }
+    esp_rmaker_mem_free(ESP_RMAKER_MEM_PARAM, node_params);
     return NULL;
 }
 
-esp_err_t esp_rmaker_report_param_internal(void)
+static void esp_rmaker_report_param_work(void *priv_data)
 {
-    esp_err_t err = esp_rmaker_populate_params(publish_payload, sizeof(publish_payload),
-                RMAKER_PARAM_FLAG_VALUE_CHANGE, true);
-    if (err == ESP_OK) {
-        /* Just checking if there are indeed any params to report by comparing with a decent enough
-         * length as even the smallest possible data, Eg. '{"d":{"p":0}}' will be > 10 bytes.
-         */
-        if (strlen(publish_payload) > 10) {
-            snprintf(publish_topic, sizeof(publish_topic), "node/%s/%s",
-                    esp_rmaker_get_node_id(), NODE_PARAMS_LOCAL_TOPIC_SUFFIX);
-            ESP_LOGI(TAG, "Reporting params: %s", publish_payload);
-            esp_rmaker_mqtt_publish(publish_topic, publish_payload, strlen(publish_payload));
+    /* Cleared before reporting, so that any change after this either gets included in this report,
+     * or queues another one.
+     */
+    __atomic_store_n(&report_work_queued, false, __ATOMIC_SEQ_CST);
+    esp_rmaker_report_param_internal();
+}
+
+/* Queue a report in the RainMaker task's context, unless one is already queued */
+static esp_err_t esp_rmaker_queue_report(void)
+{
+    if (__atomic_exchange_n(&report_work_queued, true, __ATOMIC_SEQ_CST)) {
+        return ESP_OK;
+    }
+    if (esp_rmaker_queue_work(esp_rmaker_report_param_work, NULL) != ESP_OK) {
+        __atomic_store_n(&report_work_queued, false, __ATOMIC_SEQ_CST);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static void esp_rmaker_report_timer_cb(void *priv)
+{
+    /* Do the actual reporting in the RainMaker task's context */
+    if (esp_rmaker_queue_report() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to queue param report.");
+    }
+}
+
+/* Arm the report timer for the earliest time at which any held back changes are due.
+ * Should be called with the param lock held.
+ */
+static esp_err_t esp_rmaker_report_timer_rearm(void)
+{
+    int64_t next_report_time = INT64_MAX;
+    _esp_rmaker_device_t *device = changed_devices;
+    while (device) {
+        int64_t report_time = esp_rmaker_device_get_report_time(device);
+        if (report_time < next_report_time) {
+            next_report_time = report_time;
         }
+        device = device->next_changed;
+    }
+    if (!report_timer) {
+        if (next_report_time == INT64_MAX) {
+            return ESP_OK;
+        }
+        esp_timer_create_args_t report_timer_conf = {
+            .callback = esp_rmaker_report_timer_cb,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "rmaker_report_tm"
+        };
+        if (esp_timer_create(&report_timer_conf, &report_timer) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create param report timer.");
+            return ESP_FAIL;
+        }
+    }
+    /* Returns an error if the timer isn't running, which can be ignored */
+    esp_timer_stop(report_timer);
+    if (next_report_time == INT64_MAX) {
         return ESP_OK;
     }
+    int64_t timeout = next_report_time - esp_timer_get_time();
+    return esp_timer_start_once(report_timer, timeout > 0 ? timeout : 0);
+}
+
+/* Report the changes which are due. Should be called with the publish lock held, which gets released */
+static esp_err_t esp_rmaker_report_param_locked(void)
+{
+    int data_len;
+    esp_rmaker_param_lock();
+    esp_err_t err = esp_rmaker_populate_changed_params(publish_payload, sizeof(publish_payload),
+                esp_timer_get_time(), &data_len);
+    esp_rmaker_report_timer_rearm();
+    esp_rmaker_param_unlock();
+    /* Just checking if there are indeed any params to report by comparing with the length
+     * of an empty object/map, Eg. '{}' in JSON, or 0xbf 0xff in CBOR.
+     */
+    if ((err == ESP_OK) && (data_len > ESP_RMAKER_EMPTY_PARAMS_LEN)) {
+        snprintf(publish_topic, sizeof(publish_topic), "node/%s/%s",
+                esp_rmaker_get_node_id(), NODE_PARAMS_LOCAL_TOPIC_SUFFIX);
+        esp_rmaker_params_log("Reporting params", publish_payload, data_len);
+        esp_rmaker_mqtt_publish(publish_topic, publish_payload, data_len);
+    }
+    esp_rmaker_publish_unlock();
     return err;
 }
 
+/* Report the changes which are due. If wait is false and some other task is already publishing,
+ * the report is handed off to the RainMaker task, instead of waiting for that publish to complete.
+ */
+static esp_err_t esp_rmaker_report_params(bool wait)
+{
+#ifdef CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE
+    /* While MQTT is disconnected, just leave the changes pending, so that any further changes to the
+     * same params get merged into them. They get reported once MQTT reconnects.
+     */
+    if (!esp_rmaker_mqtt_is_connected()) {
+        ESP_LOGD(TAG, "MQTT not connected. Holding back param changes.");
+        return ESP_OK;
+    }
+#endif /* CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE */
+    if (esp_rmaker_publish_lock(wait ? portMAX_DELAY : 0)) {
+        return esp_rmaker_report_param_locked();
+    }
+    if (esp_rmaker_queue_report() != ESP_OK) {
+        /* Let the report timer retry, since the changes are anyways due */
+        ESP_LOGW(TAG, "Failed to queue param report. Retrying.");
+        esp_rmaker_param_lock();
+        esp_rmaker_report_timer_rearm();
+        esp_rmaker_param_unlock();
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_report_param_internal(void)
+{
+    return esp_rmaker_report_params(true);
+}
+
 esp_err_t esp_rmaker_report_node_state(void)
 {
-    esp_err_t err = esp_rmaker_populate_params(publish_payload, sizeof(publish_payload), 0, false);
-    if (err == ESP_OK) {
-        /* Just checking if there are indeed any params to report by comparing with a decent enough
-         * length as even the smallest possible data, Eg. '{"d":{"p":0}}' will be > 10 bytes.
+    int data_len;
+    esp_rmaker_publish_lock(portMAX_DELAY);
+    esp_rmaker_param_lock();
+    esp_err_t err = esp_rmaker_populate_params(publish_payload, sizeof(publish_payload), &data_len);
+    /* Just checking if there are indeed any params to report */
+    if ((err == ESP_OK) && (data_len > ESP_RMAKER_EMPTY_PARAMS_LEN)) {
+        /* All the values are being reported, so any pending changes need not be. These are dropped
+         * right away, since any changes after this would not be a part of the payload.
          */
-        if (strlen(publish_payload) > 10) {
-            snprintf(publish_topic, sizeof(publish_topic), "node/%s/%s",
-                    esp_rmaker_get_node_id(), NODE_PARAMS_LOCAL_INIT_TOPIC_SUFFIX);
-            ESP_LOGI(TAG, "Reporting params (init): %s", publish_payload);
-            esp_rmaker_mqtt_publish(publish_topic, publish_payload, strlen(publish_payload));
+        while (changed_devices) {
+            __esp_rmaker_device_discard_changes(changed_devices);
         }
-        return ESP_OK;
+        esp_rmaker_report_timer_rearm();
+        esp_rmaker_param_unlock();
+        snprintf(publish_topic, sizeof(publish_topic), "node/%s/%s",
+                esp_rmaker_get_node_id(), NODE_PARAMS_LOCAL_INIT_TOPIC_SUFFIX);
+        esp_rmaker_params_log("Reporting params (init)", publish_payload, data_len);
+        esp_rmaker_mqtt_publish(publish_topic, publish_payload, data_len);
+    } else {
+        esp_rmaker_param_unlock();
     }
+    esp_rmaker_publish_unlock();
     return err;
 }
 
-static esp_err_t esp_rmaker_device_set_params(_esp_rmaker_device_t *device, jparse_ctx_t *jptr, esp_rmaker_req_src_t src)
+/* Get the index of the token following the given token and all its children */
+static int esp_rmaker_json_skip_token(jparse_ctx_t *jctx, int index)
 {
-    _esp_rmaker_param_t *param = device->params;
-    while (param) {
+    int end = jctx->tokens[index].end;
+    index++;
+    /* All the children of a token lie within its start and end offsets */
+    while ((index < jctx->num_tokens) && (jctx->tokens[index].start < end)) {
+        index++;
+    }
+    return index;
+}
+
+/* Get the value of a param from the given token, as per the param's value type.
+ * For string, object and array types, the value is NULL terminated in place.
+ */
+static esp_err_t esp_rmaker_json_token_to_val(jparse_ctx_t *jctx, json_tok_t *tok, esp_rmaker_val_type_t type,
+        esp_rmaker_param_val_t *val)
+{
+    char *start = jctx->js + tok->start;
+    int len = tok->end - tok->start;
+    char *end = start;
+    switch (type) {
+        case RMAKER_VAL_TYPE_BOOLEAN:
+            if (tok->type != JSMN_PRIMITIVE) {
+                return ESP_FAIL;
+            }
+            if ((len == 4) && (strncmp(start, "true", 4) == 0)) {
+                val->val.b = true;
+            } else if ((len == 5) && (strncmp(start, "false", 5) == 0)) {
+                val->val.b = false;
+            } else {
+                return ESP_FAIL;
+            }
+            break;
+        case RMAKER_VAL_TYPE_INTEGER:
+            if (tok->type != JSMN_PRIMITIVE) {
+                return ESP_FAIL;
+            }
+            val->val.i = strtol(start, &end, 10);
+            if (end == start) {
+                return ESP_FAIL;
+            }
+            break;
+        case RMAKER_VAL_TYPE_FLOAT:
+            if (tok->type != JSMN_PRIMITIVE) {
+                return ESP_FAIL;
+            }
+            val->val.f = strtof(start, &end);
+            if (end == start) {
+                return ESP_FAIL;
+            }
+            break;
+        case RMAKER_VAL_TYPE_STRING:
+        case RMAKER_VAL_TYPE_OBJECT:
+        case RMAKER_VAL_TYPE_ARRAY:
+            if (((type == RMAKER_VAL_TYPE_STRING) && (tok->type != JSMN_STRING)) ||
+                    ((type == RMAKER_VAL_TYPE_OBJECT) && (tok->type != JSMN_OBJECT)) ||
+                    ((type == RMAKER_VAL_TYPE_ARRAY) && (tok->type != JSMN_ARRAY))) {
+                return ESP_FAIL;
+            }
+            /* Borrow the value directly from the received data, instead of copying it.
+             * The character following the value is restored by the caller.
+             */
+            start[len] = '\0';
+            val->val.s = start;
+            break;
+        default:
+            return ESP_FAIL;
+    }
+    val->type = type;
+    return ESP_OK;
+}
+
+/* Look up a device or param by name, while the devices/params may be getting added or removed */
+static void *esp_rmaker_name_index_find_locked(const esp_rmaker_name_index_t *index, const char *name, size_t len)
+{
+    esp_rmaker_param_lock();
+    void *item = esp_rmaker_name_index_find(index, name, len);
+    esp_rmaker_param_unlock();
+    return item;
+}
+
+static void esp_rmaker_device_write_param(_esp_rmaker_device_t *device, _esp_rmaker_param_t *param,
+        esp_rmaker_param_val_t new_val, esp_rmaker_req_src_t src)
+{
+    /* Special handling for ESP_RMAKER_PARAM_NAME. Just update the name instead
+     * of calling the registered callback.
+     */
+    if (param->type && (strcmp(param->type, ESP_RMAKER_PARAM_NAME) == 0)) {
+        esp_rmaker_param_update_and_report((esp_rmaker_param_t *)param, new_val);
+    } else if (device->write_cb) {
+        esp_rmaker_write_ctx_t ctx = {
+            .src = src,
+        };
+        if (device->write_cb((esp_rmaker_device_t *)device, (esp_rmaker_param_t *)param,
+                    new_val, device->priv_data, &ctx) != ESP_OK) {
+            ESP_LOGE(TAG, "Remote update to param %s - %s failed", device->name, param->name);
+        }
+    }
+}
+
+/* Handle the device object at the given token index. Every key in the object is resolved to
+ * a param using the device's name index, instead of probing the JSON once per param.
+ * String values passed to the callbacks point into the received data itself and so, are
+ * valid only till the callback returns.
+ * Returns the index of the token following the device object.
+ */
+static int esp_rmaker_device_set_params(_esp_rmaker_device_t *device, jparse_ctx_t *jctx, int index,
+        esp_rmaker_req_src_t src)
+{
+    int num_keys = jctx->tokens[index].size;
+    index++;
+    for (int i = 0; (i < num_keys) && (index < jctx->num_tokens - 1); i++) {
+        json_tok_t *key = &jctx->tokens[index];
+        json_tok_t *value = &jctx->tokens[index + 1];
+        index = esp_rmaker_json_skip_token(jctx, index + 1);
+        _esp_rmaker_param_t *param = esp_rmaker_name_index_find_locked(&device->param_index,
+                jctx->js + key->start, key->end - key->start);
+        if (!param) {
+            continue;
+        }
         esp_rmaker_param_val_t new_val = {0};
-        bool param_found = false;
-        switch(param->val.type) {
-            case RMAKER_VAL_TYPE_BOOLEAN:
-                if (json_obj_get_bool(jptr, param->name, &new_val.val.b) == 0) {
-                    new_val.type = RMAKER_VAL_TYPE_BOOLEAN;
-                    param_found = true;
-                }
-                break;
-            case RMAKER_VAL_TYPE_INTEGER:
-                if (json_obj_get_int(jptr, param->name, &new_val.val.i) == 0) {
-                    new_val.type = RMAKER_VAL_TYPE_INTEGER;
-                    param_found = true;
-                }
-                break;
-            case RMAKER_VAL_TYPE_FLOAT:
-                if (json_obj_get_float(jptr, param->name, &new_val.val.f) == 0) {
-                    new_val.type = RMAKER_VAL_TYPE_FLOAT;
-                    param_found = true;
-                }
-                break;
-            case RMAKER_VAL_TYPE_STRING: {
-                int val_size = 0;
-                if (json_obj_get_strlen(jptr, param->name, &val_size) == 0) {
-                    val_size++; /* For NULL termination */
-                    new_val.val.s = calloc(1, val_size);
-                    if (!new_val.val.s) {
-                        return ESP_ERR_NO_MEM;
-                    }
-                    json_obj_get_string(jptr, param->name, new_val.val.s, val_size);
-                    new_val.type = RMAKER_VAL_TYPE_STRING;
-                    param_found = true;
-                }
-                break;
+        char *val_end = jctx->js + value->end;
+        char val_end_char = *val_end;
+        if (esp_rmaker_json_token_to_val(jctx, value, param->val.type, &new_val) != ESP_OK) {
+            ESP_LOGW(TAG, "Invalid value received for %s - %s", device->name, param->name);
+            continue;
+        }
+        esp_rmaker_device_write_param(device, param, new_val, src);
+        /* Restore the data which was overwritten for NULL terminating a string value */
+        *val_end = val_end_char;
+    }
+    return index;
+}
+
+#ifdef CONFIG_ESP_RMAKER_PARAM_CBOR
+/* Get the value of a param from the next CBOR data item, as per the param's value type.
+ * For string, object and array types, the value is NULL terminated in place, and text->str
+ * is set, so that the data can be restored later. It is left NULL for other types.
+ */
+static esp_err_t esp_rmaker_cbor_to_val(esp_rmaker_cbor_dec_t *dec, esp_rmaker_val_type_t type,
+        esp_rmaker_param_val_t *val, esp_rmaker_cbor_text_t *text)
+{
+    esp_rmaker_cbor_item_t item;
+    int64_t i_val;
+    switch (type) {
+        case RMAKER_VAL_TYPE_BOOLEAN:
+            if (esp_rmaker_cbor_dec_bool(dec, &val->val.b) != ESP_OK) {
+                return ESP_FAIL;
             }
-            case RMAKER_VAL_TYPE_OBJECT: {
-                int val_size = 0;
-                if (json_obj_get_object_strlen(jptr, param->name, &val_size) == 0) {
-                    val_size++; /* For NULL termination */
-                    new_val.val.s = calloc(1, val_size);
-                    if (!new_val.val.s) {
-                        return ESP_ERR_NO_MEM;
-                    }
-                    json_obj_get_object_str(jptr, param->name, new_val.val.s, val_size);
-                    new_val.type = RMAKER_VAL_TYPE_OBJECT;
-                    param_found = true;
-                }
-                break;
+            break;
+        case RMAKER_VAL_TYPE_INTEGER:
+            if ((esp_rmaker_cbor_dec_int(dec, &i_val) != ESP_OK) || (i_val < INT32_MIN) || (i_val > INT32_MAX)) {
+                return ESP_FAIL;
             }
-            case RMAKER_VAL_TYPE_ARRAY: {
-                int val_size = 0;
-                if (json_obj_get_array_strlen(jptr, param->name, &val_size) == 0) {
-                    val_size++; /* For NULL termination */
-                    new_val.val.s = calloc(1, val_size);
-                    if (!new_val.val.s) {
-                        return ESP_ERR_NO_MEM;
-                    }
-                    json_obj_get_array_str(jptr, param->name, new_val.val.s, val_size);
-                    new_val.type = RMAKER_VAL_TYPE_ARRAY;
-                    param_found = true;
+            val->val.i = i_val;
+            break;
+        case RMAKER_VAL_TYPE_FLOAT:
+            if (esp_rmaker_cbor_dec_float(dec, &val->val.f) != ESP_OK) {
+                return ESP_FAIL;
+            }
+            break;
+        case RMAKER_VAL_TYPE_OBJECT:
+        case RMAKER_VAL_TYPE_ARRAY:
+            /* Objects and arrays are accepted only as (optionally tagged) embedded JSON */
+            if ((esp_rmaker_cbor_dec_peek(dec, &item) == ESP_OK) && (item.major == CBOR_MAJOR_TAG)) {
+                if (item.arg != CBOR_TAG_EMBEDDED_JSON) {
+                    return ESP_FAIL;
                 }
-                break;
+                esp_rmaker_cbor_dec_item(dec, &item);
+            }
+            /* Fall through */
+        case RMAKER_VAL_TYPE_STRING:
+            if (esp_rmaker_cbor_dec_text_in_place(dec, text) != ESP_OK) {
+                return ESP_FAIL;
+            }
+            val->val.s = text->str;
+            break;
+        default:
+            return ESP_FAIL;
+    }
+    val->type = type;
+    return ESP_OK;
+}
+
+/* Check if there are any more entries in a map, as per its header and the entries read so far */
+static bool esp_rmaker_cbor_map_has_next(esp_rmaker_cbor_dec_t *dec, esp_rmaker_cbor_item_t *map,
+        uint64_t *count)
+{
+    if (map->indefinite) {
+        return !esp_rmaker_cbor_dec_break(dec);
+    }
+    return (*count)++ < map->arg;
+}
+
+/* Handle the device map which follows. Returns ESP_FAIL if the data is malformed */
+static esp_err_t esp_rmaker_device_set_params_cbor(_esp_rmaker_device_t *device, esp_rmaker_cbor_dec_t *dec,
+        esp_rmaker_req_src_t src)
+{
+    esp_rmaker_cbor_item_t map;
+    if ((esp_rmaker_cbor_dec_item(dec, &map) != ESP_OK) || (map.major != CBOR_MAJOR_MAP)) {
+        return ESP_FAIL;
+    }
+    uint64_t count = 0;
+    while (esp_rmaker_cbor_map_has_next(dec, &map, &count)) {
+        const char *key;
+        size_t key_len;
+        _esp_rmaker_param_t *param = NULL;
+        if (esp_rmaker_cbor_dec_text(dec, &key, &key_len) == ESP_OK) {
+            param = esp_rmaker_name_index_find_locked(&device->param_index, key, key_len);
+        } else if (esp_rmaker_cbor_dec_skip(dec) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        if (!param) {
+            if (esp_rmaker_cbor_dec_skip(dec) != ESP_OK) {
+                return ESP_FAIL;
             }
-            default:
-                break;
+            continue;
         }
-        if (param_found) {
-            /* Special handling for ESP_RMAKER_PARAM_NAME. Just update the name instead
-             * of calling the registered callback.
-             */
-            if (param->type && (strcmp(param->type, ESP_RMAKER_PARAM_NAME) == 0)) {
-                esp_rmaker_param_update_and_report((esp_rmaker_param_t *)param, new_val);
-            } else if (device->write_cb) {
-                esp_rmaker_write_ctx_t ctx = {
-                    .src = src,
-                };
-                if (device->write_cb((esp_rmaker_device_t *)device, (esp_rmaker_param_t *)param,
-                            new_val, device->priv_data, &ctx) != ESP_OK) {
-                    ESP_LOGE(TAG, "Remote update to param %s - %s failed", device->name, param->name);
-                }
+        esp_rmaker_param_val_t new_val = {0};
+        esp_rmaker_cbor_text_t text = {0};
+        size_t val_offset = dec->offset;
+        if (esp_rmaker_cbor_to_val(dec, param->val.type, &new_val, &text) != ESP_OK) {
+            ESP_LOGW(TAG, "Invalid value received for %s - %s", device->name, param->name);
+            dec->offset = val_offset;
+            if (esp_rmaker_cbor_dec_skip(dec) != ESP_OK) {
+                return ESP_FAIL;
             }
-            if ((new_val.type == RMAKER_VAL_TYPE_STRING) || (new_val.type == RMAKER_VAL_TYPE_OBJECT ||
-                        (new_val.type == RMAKER_VAL_TYPE_ARRAY))) {
-                if (new_val.val.s) {
-                    free(new_val.val.s);
-                }
+            continue;
+        }
+        esp_rmaker_device_write_param(device, param, new_val, src);
+        /* Restore the data which was moved for NULL terminating a string value */
+        if (text.str) {
+            esp_rmaker_cbor_text_restore(&text);
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t esp_rmaker_handle_set_params_cbor(char *data, size_t data_len, esp_rmaker_req_src_t src)
+{
+    ESP_LOGI(TAG, "Received params: %d bytes of CBOR data", (int)data_len);
+    esp_rmaker_cbor_dec_t dec;
+    esp_rmaker_cbor_item_t map;
+    esp_rmaker_cbor_dec_start(&dec, (uint8_t *)data, data_len);
+    if ((esp_rmaker_cbor_dec_item(&dec, &map) != ESP_OK) || (map.major != CBOR_MAJOR_MAP)) {
+        return ESP_FAIL;
+    }
+    _esp_rmaker_node_t *node = (_esp_rmaker_node_t *)esp_rmaker_get_node();
+    uint64_t count = 0;
+    while (esp_rmaker_cbor_map_has_next(&dec, &map, &count)) {
+        const char *key;
+        size_t key_len;
+        _esp_rmaker_device_t *device = NULL;
+        esp_rmaker_cbor_item_t value;
+        if (esp_rmaker_cbor_dec_text(&dec, &key, &key_len) == ESP_OK) {
+            if (node) {
+                device = esp_rmaker_name_index_find_locked(&node->device_index, key, key_len);
+            }
+        } else if (esp_rmaker_cbor_dec_skip(&dec) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        if (device && (esp_rmaker_cbor_dec_peek(&dec, &value) == ESP_OK) && (value.major == CBOR_MAJOR_MAP)) {
+            if (esp_rmaker_device_set_params_cbor(device, &dec, src) != ESP_OK) {
+                return ESP_FAIL;
             }
+        } else if (esp_rmaker_cbor_dec_skip(&dec) != ESP_OK) {
+            return ESP_FAIL;
         }
-        param = param->next;
     }
     return ESP_OK;
 }
+#endif /* CONFIG_ESP_RMAKER_PARAM_CBOR */
 
 esp_err_t esp_rmaker_handle_set_params(char *data, size_t data_len, esp_rmaker_req_src_t src)
 {
-    ESP_LOGI(TAG, "Received params: %.*s", data_len, data);
+#ifdef CONFIG_ESP_RMAKER_PARAM_CBOR
+    /* A JSON object starts with '{' (or whitespace), which can never be the initial byte of a CBOR map */
+    if (data && data_len && ((((uint8_t)data[0]) >> 5) == CBOR_MAJOR_MAP)) {
+        return esp_rmaker_handle_set_params_cbor(data, data_len, src);
+    }
+#endif /* CONFIG_ESP_RMAKER_PARAM_CBOR */
+    ESP_LOGI(TAG, "Received params: %.*s", (int)data_len, data);
     jparse_ctx_t jctx;
     if (json_parse_start(&jctx, data, data_len) != 0) {
         return ESP_FAIL;
     }
-    _esp_rmaker_device_t *device = esp_rmaker_node_get_first_device(esp_rmaker_get_node());
-    while (device) {
-        if (json_obj_get_object(&jctx, device->name) == 0) {
-            esp_rmaker_device_set_params(device, &jctx, src);
-            json_obj_leave_object(&jctx);
+    if (jctx.tokens[0].type != JSMN_OBJECT) {
+        json_parse_end(&jctx);
+        return ESP_FAIL;
+    }
+    _esp_rmaker_node_t *node = (_esp_rmaker_node_t *)esp_rmaker_get_node();
+    /* Walk the received JSON just once, resolving each device name using the node's name index */
+    int num_keys = jctx.tokens[0].size;
+    int index = 1;
+    for (int i = 0; (i < num_keys) && (index < jctx.num_tokens - 1); i++) {
+        json_tok_t *key = &jctx.tokens[index];
+        _esp_rmaker_device_t *device = NULL;
+        if (node) {
+            device = esp_rmaker_name_index_find_locked(&node->device_index, jctx.js + key->start,
+                    key->end - key->start);
+        }
+        if (device && (jctx.tokens[index + 1].type == JSMN_OBJECT)) {
+            index = esp_rmaker_device_set_params(device, &jctx, index + 1, src);
+        } else {
+            index = esp_rmaker_json_skip_token(&jctx, index + 1);
         }
-        device = device->next;
     }
     json_parse_end(&jctx);
     return ESP_OK;
@@ -342,7 +1008,7 @@ esp_err_t esp_rmaker_param_get_stored_value(_esp_rmaker_param_t *param, esp_rmak
                 (param->val.type == RMAKER_VAL_TYPE_ARRAY)) {
         size_t len = 0;
         if ((err = nvs_get_str(handle, param->name, NULL, &len)) == ESP_OK) {
-            char *s_val = calloc(1, len);
+            char *s_val = esp_rmaker_mem_calloc(ESP_RMAKER_MEM_PARAM, 1, len);
             if (!s_val) {
                 err = ESP_ERR_NO_MEM;
             } else {
@@ -359,52 +1025,284 @@ esp_err_t esp_rmaker_param_get_stored_value(_esp_rmaker_param_t *param, esp_rmak
     return err;
 }
 
+/* Write a value of a param using an already open handle. The caller should commit */
+static esp_err_t esp_rmaker_param_write_value(nvs_handle handle, _esp_rmaker_param_t *param,
+        esp_rmaker_param_val_t *val)
+{
+    if (esp_rmaker_val_type_is_str(val->type)) {
+        /* Store only if value is not NULL */
+        if (val->val.s) {
+            return nvs_set_str(handle, param->name, val->val.s);
+        }
+        return ESP_OK;
+    }
+    return nvs_set_blob(handle, param->name, val, sizeof(esp_rmaker_param_val_t));
+}
+
 esp_err_t esp_rmaker_param_store_value(_esp_rmaker_param_t *param)
 {
     if (!param || !param->parent) {
         return ESP_FAIL;
     }
-    nvs_handle handle;
-    esp_err_t err = nvs_open_from_partition(ESP_RMAKER_NVS_PART_NAME, param->parent->name, NVS_READWRITE, &handle);
+    /* The value is copied, so that the param lock need not be held while writing to NVS */
+    esp_rmaker_param_val_t val;
+    esp_rmaker_param_lock();
+    esp_err_t err = esp_rmaker_param_copy_val(param, &val);
+    esp_rmaker_param_unlock();
     if (err != ESP_OK) {
         return err;
     }
-    if ((param->val.type == RMAKER_VAL_TYPE_STRING) || (param->val.type == RMAKER_VAL_TYPE_OBJECT) ||
-                (param->val.type == RMAKER_VAL_TYPE_ARRAY)) {
-        /* Store only if value is not NULL */
-        if (param->val.val.s) {
-            err = nvs_set_str(handle, param->name, param->val.val.s);
-            nvs_commit(handle);
-        } else {
-            err = ESP_OK;
+    nvs_handle handle;
+    err = nvs_open_from_partition(ESP_RMAKER_NVS_PART_NAME, param->parent->name, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = esp_rmaker_param_write_value(handle, param, &val);
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
         }
-    } else {
-        err = nvs_set_blob(handle, param->name, &param->val, sizeof(esp_rmaker_param_val_t));
-        nvs_commit(handle);
+        nvs_close(handle);
     }
-    nvs_close(handle);
+    esp_rmaker_param_free_val_copy(&val);
+    return err;
+}
+
+/* Remove a device from the list of devices having params pending to be stored.
+ * Returns the list of such params, detached from the device. The params still have
+ * RMAKER_PARAM_FLAG_STORE_PENDING set, so that further updates do not link them again
+ * till esp_rmaker_param_take_pending_val() is called for them.
+ * Should be called with the param lock held.
+ */
+static _esp_rmaker_param_t *esp_rmaker_device_take_pending_store(_esp_rmaker_device_t *device)
+{
+    _esp_rmaker_device_t **prev_next = &store_pending_devices;
+    while (*prev_next) {
+        if (*prev_next == device) {
+            *prev_next = device->next_store_pending;
+            break;
+        }
+        prev_next = &(*prev_next)->next_store_pending;
+    }
+    device->next_store_pending = NULL;
+    _esp_rmaker_param_t *params = device->store_pending_params;
+    device->store_pending_params = NULL;
+    return params;
+}
+
+/* Get a copy of the value of a param taken from the pending store list, and unlink it.
+ * Any update after this links the param again, so that the new value also gets stored.
+ * Returns the next param in the list.
+ */
+static _esp_rmaker_param_t *esp_rmaker_param_take_pending_val(_esp_rmaker_param_t *param,
+        esp_rmaker_param_val_t *val, esp_err_t *err)
+{
+    esp_rmaker_param_lock();
+    _esp_rmaker_param_t *next_param = param->next_store_pending;
+    param->flags &= ~RMAKER_PARAM_FLAG_STORE_PENDING;
+    param->next_store_pending = NULL;
+    *err = val ? esp_rmaker_param_copy_val(param, val) : ESP_OK;
+    esp_rmaker_param_unlock();
+    return next_param;
+}
+
+/* Write all the given params of a device in a single NVS transaction */
+static esp_err_t esp_rmaker_device_store_params(_esp_rmaker_device_t *device, _esp_rmaker_param_t *param)
+{
+    if (!param) {
+        return ESP_OK;
+    }
+    nvs_handle handle;
+    esp_err_t err = nvs_open_from_partition(ESP_RMAKER_NVS_PART_NAME, device->name, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS namespace %s for storing params. Error %d", device->name, err);
+    }
+    while (param) {
+        esp_rmaker_param_val_t val;
+        esp_err_t copy_err;
+        _esp_rmaker_param_t *next_param = esp_rmaker_param_take_pending_val(param,
+                (err == ESP_OK) ? &val : NULL, &copy_err);
+        if ((err == ESP_OK) && (copy_err == ESP_OK)) {
+            if (esp_rmaker_param_write_value(handle, param, &val) != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to store the value of %s - %s", device->name, param->name);
+            }
+            esp_rmaker_param_free_val_copy(&val);
+        }
+        param = next_param;
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+        nvs_close(handle);
+    }
+    return err;
+}
+
+esp_err_t esp_rmaker_device_flush_pending_store(_esp_rmaker_device_t *device)
+{
+    if (!device) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_rmaker_param_lock();
+    _esp_rmaker_param_t *params = esp_rmaker_device_take_pending_store(device);
+    esp_rmaker_param_unlock();
+    return esp_rmaker_device_store_params(device, params);
+}
+
+esp_err_t esp_rmaker_param_store_flush(void)
+{
+    esp_err_t err = ESP_OK;
+    esp_rmaker_param_lock();
+    store_first_pending_time = 0;
+    while (store_pending_devices) {
+        _esp_rmaker_device_t *device = store_pending_devices;
+        _esp_rmaker_param_t *params = esp_rmaker_device_take_pending_store(device);
+        esp_rmaker_param_unlock();
+        if (esp_rmaker_device_store_params(device, params) != ESP_OK) {
+            err = ESP_FAIL;
+        }
+        esp_rmaker_param_lock();
+    }
+    esp_rmaker_param_unlock();
     return err;
 }
 
+void esp_rmaker_param_store_discard(void)
+{
+    esp_rmaker_param_lock();
+    if (store_timer) {
+        esp_timer_stop(store_timer);
+    }
+    while (store_pending_devices) {
+        _esp_rmaker_param_t *param = esp_rmaker_device_take_pending_store(store_pending_devices);
+        while (param) {
+            _esp_rmaker_param_t *next_param = param->next_store_pending;
+            param->flags &= ~RMAKER_PARAM_FLAG_STORE_PENDING;
+            param->next_store_pending = NULL;
+            param = next_param;
+        }
+    }
+    store_first_pending_time = 0;
+    esp_rmaker_param_unlock();
+}
+
+static void esp_rmaker_param_store_work(void *priv_data)
+{
+    esp_rmaker_param_store_flush();
+}
+
+static void esp_rmaker_store_timer_cb(void *priv)
+{
+    /* Write to NVS in the RainMaker task's context, if possible */
+    if (esp_rmaker_queue_work(esp_rmaker_param_store_work, NULL) != ESP_OK) {
+        esp_rmaker_param_store_flush();
+    }
+}
+
+/* Queue the value of a param for writing to NVS, after the quiet period.
+ * Should be called with the param lock held. Returns ESP_ERR_NOT_SUPPORTED if the store timer
+ * could not be created, in which case, the value should be stored synchronously.
+ */
+static esp_err_t esp_rmaker_param_store_value_deferred(_esp_rmaker_param_t *param)
+{
+    if (!param->parent) {
+        return ESP_FAIL;
+    }
+    if (!store_timer) {
+        esp_timer_create_args_t store_timer_conf = {
+            .callback = esp_rmaker_store_timer_cb,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "rmaker_store_tm"
+        };
+        if (esp_timer_create(&store_timer_conf, &store_timer) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to create param store timer. Storing synchronously.");
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+    }
+    if (!(param->flags & RMAKER_PARAM_FLAG_STORE_PENDING)) {
+        _esp_rmaker_device_t *device = param->parent;
+        param->flags |= RMAKER_PARAM_FLAG_STORE_PENDING;
+        if (!device->store_pending_params) {
+            device->next_store_pending = store_pending_devices;
+            store_pending_devices = device;
+        }
+        param->next_store_pending = device->store_pending_params;
+        device->store_pending_params = param;
+    }
+    /* Restart the quiet period, but do not hold back the writes for too long */
+    int64_t now = esp_timer_get_time();
+    if (!store_first_pending_time) {
+        store_first_pending_time = now;
+    }
+    int64_t store_time = now + PARAM_STORE_DELAY_US;
+    if (store_time > store_first_pending_time + PARAM_STORE_MAX_DELAY_US) {
+        store_time = store_first_pending_time + PARAM_STORE_MAX_DELAY_US;
+    }
+    esp_timer_stop(store_timer);
+    return esp_timer_start_once(store_timer, store_time > now ? store_time - now : 0);
+}
+
 esp_err_t esp_rmaker_param_delete(const esp_rmaker_param_t *param)
 {
     _esp_rmaker_param_t *_param = (_esp_rmaker_param_t *)param;
     if (_param) {
+        if (((_param->val.type == RMAKER_VAL_TYPE_STRING) || (_param->val.type == RMAKER_VAL_TYPE_OBJECT) ||
+                    (_param->val.type == RMAKER_VAL_TYPE_ARRAY)) && _param->val.val.s) {
+            esp_rmaker_mem_free(ESP_RMAKER_MEM_PARAM, _param->val.val.s);
+        }
+        /* A static param is freed along with its device */
+        if (_param->flags & RMAKER_PARAM_FLAG_STATIC) {
+            return ESP_OK;
+        }
         if (_param->name) {
-            free(_param->name);
+            esp_rmaker_arena_free(ESP_RMAKER_MEM_PARAM, _param->name);
         }
         if (_param->type) {
-            free(_param->type);
+            esp_rmaker_arena_free(ESP_RMAKER_MEM_PARAM, _param->type);
         }
         if (_param->ui_type) {
-            free(_param->ui_type);
+            esp_rmaker_arena_free(ESP_RMAKER_MEM_PARAM, _param->ui_type);
         }
-        free(_param);
+        if (_param->bounds) {
+            esp_rmaker_arena_free(ESP_RMAKER_MEM_PARAM, _param->bounds);
+        }
+        if (_param->valid_str_list) {
+            esp_rmaker_arena_free(ESP_RMAKER_MEM_PARAM, _param->valid_str_list);
+        }
+        esp_rmaker_arena_free(ESP_RMAKER_MEM_PARAM, _param);
         return ESP_OK;
     }
     return ESP_ERR_INVALID_ARG;
 }
 
+/* Set the value of a string, object or array param. The buffer allocated for the value is
+ * reused as long as the new value fits in it, and is reallocated only if it needs to grow.
+ */
+static esp_err_t esp_rmaker_param_set_str_val(_esp_rmaker_param_t *param, const char *s_val)
+{
+    if (!s_val) {
+        if (param->val.val.s) {
+            esp_rmaker_mem_free(ESP_RMAKER_MEM_PARAM, param->val.val.s);
+        }
+        param->val.val.s = NULL;
+        param->val_buf_size = 0;
+        return ESP_OK;
+    }
+    size_t len = strlen(s_val) + 1;
+    if (len > param->val_buf_size) {
+        /* Not using realloc() since the new value could be (a part of) the current value */
+        char *buf = esp_rmaker_mem_malloc(ESP_RMAKER_MEM_PARAM, len);
+        if (!buf) {
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(buf, s_val, len);
+        if (param->val.val.s) {
+            esp_rmaker_mem_free(ESP_RMAKER_MEM_PARAM, param->val.val.s);
+        }
+        param->val.val.s = buf;
+        param->val_buf_size = len;
+    } else {
+        memmove(param->val.val.s, s_val, len);
+    }
+    return ESP_OK;
+}
+
 esp_rmaker_param_t *esp_rmaker_param_create(const char *param_name, const char *type,
         esp_rmaker_param_val_t val, uint8_t properties)
 {
@@ -412,18 +1310,18 @@ esp_rmaker_param_t *esp_rmaker_param_create(const char *param_name, const char *
         ESP_LOGE(TAG, "Param name is mandatory");
         return NULL;
     }
-    _esp_rmaker_param_t *param = calloc(1, sizeof(_esp_rmaker_param_t));
+    _esp_rmaker_param_t *param = esp_rmaker_arena_calloc(ESP_RMAKER_MEM_PARAM, sizeof(_esp_rmaker_param_t));
     if (!param) {
         ESP_LOGE(TAG, "Failed to allocate memory for param %s", param_name);
         return NULL;
     }
-    param->name = strdup(param_name);
+    param->name = esp_rmaker_arena_intern(ESP_RMAKER_MEM_PARAM, param_name);
     if (!param->name) {
         ESP_LOGE(TAG, "Failed to allocate memory for name for param %s.", param_name);
         goto param_create_err;
     }
     if (type) {
-        param->type = strdup(type);
+        param->type = esp_rmaker_arena_intern(ESP_RMAKER_MEM_PARAM, type);
         if (!param->type) {
             ESP_LOGE(TAG, "Failed to allocate memory for type for param %s.", param_name);
             goto param_create_err;
@@ -433,11 +1331,8 @@ esp_rmaker_param_t *esp_rmaker_param_create(const char *param_name, const char *
     param->prop_flags = properties;
     if ((val.type == RMAKER_VAL_TYPE_STRING) || (val.type == RMAKER_VAL_TYPE_OBJECT) ||
                 (val.type == RMAKER_VAL_TYPE_ARRAY)) {
-        if (val.val.s) {
-             param->val.val.s = strdup(val.val.s);
-             if (!param->val.val.s) {
-                 ESP_LOGE(TAG, "Failed to allocate memory for the value of param %s.", param_name);
-             }
+        if (esp_rmaker_param_set_str_val(param, val.val.s) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to allocate memory for the value of param %s.", param_name);
         }
     } else {
         param->val.val = val.val;
@@ -449,6 +1344,52 @@ param_create_err:
     return NULL;
 }
 
+esp_err_t esp_rmaker_param_desc_validate(const esp_rmaker_param_desc_t *desc)
+{
+    if (!desc->name) {
+        ESP_LOGE(TAG, "Param name is mandatory");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (desc->bounds && (desc->val.type != RMAKER_VAL_TYPE_INTEGER) && (desc->val.type != RMAKER_VAL_TYPE_FLOAT)
+            && (desc->val.type != RMAKER_VAL_TYPE_ARRAY)) {
+        ESP_LOGE(TAG, "Only integer, float and array params can have bounds.");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (desc->valid_strs && (desc->val.type != RMAKER_VAL_TYPE_STRING)) {
+        ESP_LOGE(TAG, "Only string params can have valid strings array.");
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_param_init_from_desc(_esp_rmaker_param_t *param, const esp_rmaker_param_desc_t *desc)
+{
+    /* Set first, so that esp_rmaker_param_delete() frees just the value buffer even if this fails */
+    param->flags = RMAKER_PARAM_FLAG_STATIC;
+    esp_err_t err = esp_rmaker_param_desc_validate(desc);
+    if (err != ESP_OK) {
+        return err;
+    }
+    /* The descriptor is const data, which is never written to, or freed */
+    param->name = (char *)desc->name;
+    param->type = (char *)desc->type;
+    param->ui_type = (char *)desc->ui_type;
+    param->bounds = (esp_rmaker_param_bounds_t *)desc->bounds;
+    param->valid_str_list = (esp_rmaker_param_valid_str_list_t *)desc->valid_strs;
+    param->prop_flags = desc->properties;
+    param->val.type = desc->val.type;
+    if ((desc->val.type == RMAKER_VAL_TYPE_STRING) || (desc->val.type == RMAKER_VAL_TYPE_OBJECT) ||
+                (desc->val.type == RMAKER_VAL_TYPE_ARRAY)) {
+        if (esp_rmaker_param_set_str_val(param, desc->val.val.s) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to allocate memory for the value of param %s.", desc->name);
+            return ESP_ERR_NO_MEM;
+        }
+    } else {
+        param->val.val = desc->val.val;
+    }
+    return ESP_OK;
+}
+
 esp_err_t esp_rmaker_param_add_bounds(const esp_rmaker_param_t *param,
     esp_rmaker_param_val_t min, esp_rmaker_param_val_t max, esp_rmaker_param_val_t step)
 {
@@ -457,6 +1398,10 @@ esp_err_t esp_rmaker_param_add_bounds(const esp_rmaker_param_t *param,
         return ESP_ERR_INVALID_ARG;
     }
     _esp_rmaker_param_t *_param = (_esp_rmaker_param_t *)param;
+    if (_param->flags & RMAKER_PARAM_FLAG_STATIC) {
+        ESP_LOGE(TAG, "Cannot change the metadata of %s, as it is created from a descriptor.", _param->name);
+        return ESP_ERR_INVALID_STATE;
+    }
     if ((_param->val.type != RMAKER_VAL_TYPE_INTEGER) && (_param->val.type != RMAKER_VAL_TYPE_FLOAT)) {
         ESP_LOGE(TAG, "Only integer and float params can have bounds.");
         return ESP_ERR_INVALID_ARG;
@@ -465,7 +1410,7 @@ esp_err_t esp_rmaker_param_add_bounds(const esp_rmaker_param_t *param,
         ESP_LOGE(TAG, "Cannot set bounds for %s because of value type mismatch.", _param->name);
         return ESP_ERR_INVALID_ARG;
     }
-    esp_rmaker_param_bounds_t *bounds = calloc(1, sizeof(esp_rmaker_param_bounds_t));
+    esp_rmaker_param_bounds_t *bounds = esp_rmaker_arena_calloc(ESP_RMAKER_MEM_PARAM, sizeof(esp_rmaker_param_bounds_t));
     if (!bounds) {
         ESP_LOGE(TAG, "Failed to allocate memory for parameter bounds.");
         return ESP_ERR_NO_MEM;
@@ -474,9 +1419,29 @@ esp_err_t esp_rmaker_param_add_bounds(const esp_rmaker_param_t *param,
     bounds->max = max;
     bounds->step = step;
     if (_param->bounds) {
-        free(_param->bounds);
+        esp_rmaker_arena_free(ESP_RMAKER_MEM_PARAM, _param->bounds);
     }
     _param->bounds = bounds;
+    esp_rmaker_node_config_invalidate();
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_param_add_deadband(const esp_rmaker_param_t *param, float deadband)
+{
+    if (!param) {
+        ESP_LOGE(TAG, "Param handle cannot be NULL.");
+        return ESP_ERR_INVALID_ARG;
+    }
+    _esp_rmaker_param_t *_param = (_esp_rmaker_param_t *)param;
+    if (_param->val.type != RMAKER_VAL_TYPE_FLOAT) {
+        ESP_LOGE(TAG, "Only float params can have a deadband.");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!(deadband >= 0)) {
+        ESP_LOGE(TAG, "Deadband cannot be negative.");
+        return ESP_ERR_INVALID_ARG;
+    }
+    _param->deadband = deadband;
     return ESP_OK;
 }
 
@@ -487,11 +1452,16 @@ esp_err_t esp_rmaker_param_add_valid_str_list(const esp_rmaker_param_t *param, c
         return ESP_ERR_INVALID_ARG;
     }
     _esp_rmaker_param_t *_param = (_esp_rmaker_param_t *)param;
+    if (_param->flags & RMAKER_PARAM_FLAG_STATIC) {
+        ESP_LOGE(TAG, "Cannot change the metadata of %s, as it is created from a descriptor.", _param->name);
+        return ESP_ERR_INVALID_STATE;
+    }
     if (_param->val.type != RMAKER_VAL_TYPE_STRING) {
         ESP_LOGE(TAG, "Only string params can have valid strings array.");
         return ESP_ERR_INVALID_ARG;
     }
-    esp_rmaker_param_valid_str_list_t *valid_str_list = calloc(1, sizeof(esp_rmaker_param_valid_str_list_t));
+    esp_rmaker_param_valid_str_list_t *valid_str_list = esp_rmaker_arena_calloc(ESP_RMAKER_MEM_PARAM,
+            sizeof(esp_rmaker_param_valid_str_list_t));
     if (!valid_str_list) {
         ESP_LOGE(TAG, "Failed to allocate memory for valid strings array.");
         return ESP_ERR_NO_MEM;
@@ -499,9 +1469,10 @@ esp_err_t esp_rmaker_param_add_valid_str_list(const esp_rmaker_param_t *param, c
     valid_str_list->str_list = strs;
     valid_str_list->str_list_cnt = count;
     if (_param->valid_str_list) {
-        free(_param->valid_str_list);
+        esp_rmaker_arena_free(ESP_RMAKER_MEM_PARAM, _param->valid_str_list);
     }
     _param->valid_str_list = valid_str_list;
+  esp_rmaker_node_config_invalidate();
   return ESP_OK;
 }
 
@@ -512,20 +1483,25 @@ esp_err_t esp_rmaker_param_add_array_max_count(const esp_rmaker_param_t *param,
         return ESP_ERR_INVALID_ARG;
     }
     _esp_rmaker_param_t *_param = (_esp_rmaker_param_t *)param;
+    if (_param->flags & RMAKER_PARAM_FLAG_STATIC) {
+        ESP_LOGE(TAG, "Cannot change the metadata of %s, as it is created from a descriptor.", _param->name);
+        return ESP_ERR_INVALID_STATE;
+    }
     if (_param->val.type != RMAKER_VAL_TYPE_ARRAY) {
         ESP_LOGE(TAG, "Only array params can have max count.");
         return ESP_ERR_INVALID_ARG;
     }
-    esp_rmaker_param_bounds_t *bounds = calloc(1, sizeof(esp_rmaker_param_bounds_t));
+    esp_rmaker_param_bounds_t *bounds = esp_rmaker_arena_calloc(ESP_RMAKER_MEM_PARAM, sizeof(esp_rmaker_param_bounds_t));
     if (!bounds) {
         ESP_LOGE(TAG, "Failed to allocate memory for parameter bounds.");
         return ESP_ERR_NO_MEM;
     }
     bounds->max = esp_rmaker_int(count);
     if (_param->bounds) {
-        free(_param->bounds);
+        esp_rmaker_arena_free(ESP_RMAKER_MEM_PARAM, _param->bounds);
     }
     _param->bounds = bounds;
+    esp_rmaker_node_config_invalidate();
     return ESP_OK;
 }
 
@@ -536,17 +1512,48 @@ esp_err_t esp_rmaker_param_add_ui_type(const esp_rmaker_param_t *param, const ch
         return ESP_ERR_INVALID_ARG;
     }
     _esp_rmaker_param_t *_param = (_esp_rmaker_param_t *)param;
+    if (_param->flags & RMAKER_PARAM_FLAG_STATIC) {
+        ESP_LOGE(TAG, "Cannot change the metadata of %s, as it is created from a descriptor.", _param->name);
+        return ESP_ERR_INVALID_STATE;
+    }
     if (_param->ui_type) {
-        free(_param->ui_type);
+        esp_rmaker_arena_free(ESP_RMAKER_MEM_PARAM, _param->ui_type);
     }
-    if ((_param->ui_type = strdup(ui_type)) != NULL ){
+    esp_rmaker_node_config_invalidate();
+    if ((_param->ui_type = esp_rmaker_arena_intern(ESP_RMAKER_MEM_PARAM, ui_type)) != NULL ){
         return ESP_OK;
     } else {
         return ESP_ERR_NO_MEM;
     }
 }
 
-esp_err_t esp_rmaker_param_update(const esp_rmaker_param_t *param, esp_rmaker_param_val_t val)
+#ifdef CONFIG_ESP_RMAKER_PARAM_SKIP_UNCHANGED
+static bool esp_rmaker_param_val_changed(_esp_rmaker_param_t *param, esp_rmaker_param_val_t *val)
+{
+    switch (param->val.type) {
+        case RMAKER_VAL_TYPE_BOOLEAN:
+            return param->val.val.b != val->val.b;
+        case RMAKER_VAL_TYPE_INTEGER:
+            return param->val.val.i != val->val.i;
+        case RMAKER_VAL_TYPE_FLOAT: {
+            /* Written this way so that NaN is always treated as a change */
+            float diff = val->val.f - param->val.val.f;
+            return !((diff <= param->deadband) && (diff >= -param->deadband));
+        }
+        case RMAKER_VAL_TYPE_STRING:
+        case RMAKER_VAL_TYPE_OBJECT:
+        case RMAKER_VAL_TYPE_ARRAY:
+            if (!param->val.val.s || !val->val.s) {
+                return param->val.val.s != val->val.s;
+            }
+            return strcmp(param->val.val.s, val->val.s) != 0;
+        default:
+            return true;
+    }
+}
+#endif /* CONFIG_ESP_RMAKER_PARAM_SKIP_UNCHANGED */
+
+static esp_err_t __esp_rmaker_param_update(const esp_rmaker_param_t *param, esp_rmaker_param_val_t val, bool *changed)
 {
     if (!param) {
         ESP_LOGE(TAG, "Param handle cannot be NULL.");
@@ -557,51 +1564,106 @@ esp_err_t esp_rmaker_param_update(const esp_rmaker_param_t *param, esp_rmaker_pa
         ESP_LOGE(TAG, "New param value type not same as the existing one.");
         return ESP_ERR_INVALID_ARG;
     }
+    esp_rmaker_param_lock();
+#ifdef CONFIG_ESP_RMAKER_PARAM_SKIP_UNCHANGED
+    /* Nothing to store or report if the value has not changed */
+    if (!esp_rmaker_param_val_changed(_param, &val)) {
+        esp_rmaker_param_unlock();
+        ESP_LOGD(TAG, "Value of %s unchanged.", _param->name);
+        *changed = false;
+        return ESP_OK;
+    }
+#endif /* CONFIG_ESP_RMAKER_PARAM_SKIP_UNCHANGED */
+    esp_err_t err = ESP_OK;
     switch (_param->val.type) {
         case RMAKER_VAL_TYPE_STRING:
         case RMAKER_VAL_TYPE_OBJECT:
-        case RMAKER_VAL_TYPE_ARRAY: {
-            char *new_val = NULL;
-            if (val.val.s) {
-                new_val = strdup(val.val.s);
-                if (!new_val) {
-                    return ESP_FAIL;
-                }
+        case RMAKER_VAL_TYPE_ARRAY:
+            if (esp_rmaker_param_set_str_val(_param, val.val.s) != ESP_OK) {
+                err = ESP_FAIL;
             }
-            if (_param->val.val.s) {
-                free(_param->val.val.s);
-            }
-            _param->val.val.s = new_val;
             break;
-        }
         case RMAKER_VAL_TYPE_BOOLEAN:
         case RMAKER_VAL_TYPE_INTEGER:
         case RMAKER_VAL_TYPE_FLOAT:
-            _param->val.val = val.val;
+            esp_rmaker_param_set_scalar_val(_param, &val);
             break;
         default:
-            return ESP_ERR_INVALID_ARG;
+            err = ESP_ERR_INVALID_ARG;
+            break;
+    }
+    bool store_now = false;
+    if ((err == ESP_OK) && (_param->prop_flags & PROP_FLAG_PERSIST)) {
+#if CONFIG_ESP_RMAKER_PARAM_STORE_DELAY > 0
+        store_now = (esp_rmaker_param_store_value_deferred(_param) == ESP_ERR_NOT_SUPPORTED);
+#else
+        store_now = true;
+#endif
+    }
+    esp_rmaker_param_unlock();
+    if (err != ESP_OK) {
+        return err;
     }
-    if (_param->prop_flags & PROP_FLAG_PERSIST) {
+    /* Written after releasing the lock, so that other updates do not wait for NVS */
+    if (store_now) {
         esp_rmaker_param_store_value(_param);
     }
+    *changed = true;
     return ESP_OK;
 }
 
+esp_err_t esp_rmaker_param_update(const esp_rmaker_param_t *param, esp_rmaker_param_val_t val)
+{
+    bool changed;
+    return __esp_rmaker_param_update(param, val, &changed);
+}
+
 esp_err_t esp_rmaker_param_report(const esp_rmaker_param_t *param)
 {
     if (!param) {
         ESP_LOGE(TAG, "Param handle cannot be NULL.");
         return ESP_ERR_INVALID_ARG;
     }
-    ((_esp_rmaker_param_t *)param)->flags |= RMAKER_PARAM_FLAG_VALUE_CHANGE;
-    return esp_rmaker_report_param_internal();
+    _esp_rmaker_param_t *_param = (_esp_rmaker_param_t *)param;
+    _esp_rmaker_device_t *device = _param->parent;
+    if (!device) {
+        return ESP_OK;
+    }
+    esp_rmaker_param_lock();
+    if (!device->parent) {
+        /* Not part of the node yet, or removed from it. Its values go out with the node params once it is added. */
+        esp_rmaker_param_unlock();
+        return ESP_OK;
+    }
+    int64_t now = esp_timer_get_time();
+    if (!(_param->flags & RMAKER_PARAM_FLAG_VALUE_CHANGE)) {
+        _param->flags |= RMAKER_PARAM_FLAG_VALUE_CHANGE;
+        if (!device->changed_params) {
+            device->first_change_time = now;
+            device->next_changed = changed_devices;
+            changed_devices = device;
+        }
+        _param->next_changed = device->changed_params;
+        device->changed_params = _param;
+    }
+    /* If the device's report interval has not yet elapsed, just let the report timer
+     * pick up this change, along with any other changes that may happen in the meantime.
+     */
+    if (esp_rmaker_device_get_report_time(device) > now) {
+        esp_err_t err = esp_rmaker_report_timer_rearm();
+        esp_rmaker_param_unlock();
+        return err;
+    }
+    esp_rmaker_param_unlock();
+    /* Not waiting for any ongoing publish, since this could be the MQTT task itself (remote writes) */
+    return esp_rmaker_report_params(false);
 }
 
 esp_err_t esp_rmaker_param_update_and_report(const esp_rmaker_param_t *param, esp_rmaker_param_val_t val)
 {
-    esp_err_t err = esp_rmaker_param_update(param, val);
-    if (err == ESP_OK) {
+    bool changed = false;
+    esp_err_t err = __esp_rmaker_param_update(param, val, &changed);
+    if ((err == ESP_OK) && changed) {
         err = esp_rmaker_param_report(param);
     }
     return err;
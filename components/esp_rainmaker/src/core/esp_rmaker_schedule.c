@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include <time.h>
+#include <stdlib.h>
 #include <string.h>
 #include <esp_log.h>
 #include <esp_err.h>
@@ -25,6 +26,7 @@
 #include <esp_rmaker_standard_services.h>
 #include <esp_rmaker_standard_types.h>
 #include <esp_rmaker_schedule.h>
+#include <esp_rmaker_mem.h>
 #include <esp_schedule.h>
 
 
@@ -32,6 +34,7 @@
 #define MAX_NAME_LEN 32
 #define MAX_OPERATION_LEN 10
 #define TIME_SYNC_DELAY 10          /* 10 seconds */
+#define MAX_SOLAR_OFFSET_MINUTES 1440   /* A day, either way */
 #define MAX_SCHEDULES CONFIG_ESP_RMAKER_SCHEDULING_MAX_SCHEDULES
 #define MAX_SCHEDULE_REPORT_SIZE (CONFIG_ESP_RMAKER_MAX_PARAM_DATA_SIZE - 100)      /* '100' is a (random) margin
                                                     for overhead as this will be encapsulated in another object */
@@ -42,14 +45,17 @@ typedef enum trigger_type {
     TRIGGER_TYPE_INVALID = 0,
     TRIGGER_TYPE_DAYS_OF_WEEK,
     TRIGGER_TYPE_DATE,
+    TRIGGER_TYPE_SUNRISE,
+    TRIGGER_TYPE_SUNSET,
+    TRIGGER_TYPE_RELATIVE,
 } trigger_type_t;
 
 typedef struct esp_rmaker_schedule_trigger {
     trigger_type_t type;
-    /* Minutes from 12am */
+    /* Minutes from 12am. For relative triggers, minutes after the other schedule triggers. */
     uint16_t minutes;
     struct {
-        /* 'OR' list of days or the week. Eg. Monday = 0b1, Tuesday = 0b10 */
+        /* 'OR' list of days or the week. Eg. Monday = 0b1, Tuesday = 0b10. Also used for sunrise and sunset. */
         uint8_t repeat_days;
     } day;
     struct {
@@ -61,6 +67,14 @@ typedef struct esp_rmaker_schedule_trigger {
         uint16_t year;
         bool repeat_every_year;
     } date;
+    struct {
+        /* Minutes after the sunrise or sunset. Negative for before. */
+        int16_t offset_minutes;
+    } solar;
+    struct {
+        /* Id of the schedule after which this one triggers */
+        char id[MAX_ID_LEN + 1];
+    } relative;
     /* Used for non repeating schedules */
     int64_t next_timestamp;
 } esp_rmaker_schedule_trigger_t;
@@ -121,9 +135,9 @@ static void esp_rmaker_schedule_free(esp_rmaker_schedule_t *schedule)
         return;
     }
     if (schedule->action.data) {
-        free(schedule->action.data);
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_SCHEDULE, schedule->action.data);
     }
-    free(schedule);
+    esp_rmaker_mem_free(ESP_RMAKER_MEM_SCHEDULE, schedule);
 }
 
 static esp_rmaker_schedule_t *esp_rmaker_schedule_get_schedule_from_id(const char *id)
@@ -229,7 +243,8 @@ static bool esp_rmaker_schedule_is_expired(esp_rmaker_schedule_t *schedule)
     time(&current_timestamp);
     localtime_r(&current_timestamp, &current_time);
 
-    if (schedule->trigger.type == TRIGGER_TYPE_DAYS_OF_WEEK) {
+    if (schedule->trigger.type == TRIGGER_TYPE_DAYS_OF_WEEK || schedule->trigger.type == TRIGGER_TYPE_SUNRISE
+            || schedule->trigger.type == TRIGGER_TYPE_SUNSET) {
         if (schedule->trigger.day.repeat_days == 0) {
             if (schedule->trigger.next_timestamp > 0 && schedule->trigger.next_timestamp <= current_timestamp) {
                 /* One time schedule has expired */
@@ -276,7 +291,7 @@ static esp_err_t esp_rmaker_schedule_process_action(esp_rmaker_schedule_action_t
 
 static void esp_rmaker_schedule_trigger_work_cb(void *priv_data)
 {
-    int32_t index = (int32_t)priv_data;
+    int32_t index = (int32_t)(intptr_t)priv_data;
     esp_rmaker_schedule_t *schedule = esp_rmaker_schedule_get_schedule_from_index(index);
     if (!schedule) {
         ESP_LOGE(TAG, "Schedule with index %d not found for trigger work callback", index);
@@ -293,12 +308,12 @@ static void esp_rmaker_schedule_trigger_work_cb(void *priv_data)
 static void esp_rmaker_schedule_trigger_common_cb(esp_schedule_handle_t handle, void *priv_data)
 {
     /* Adding to work queue to change the context from timer's task. */
-    esp_rmaker_queue_work(esp_rmaker_schedule_trigger_work_cb, priv_data);
+    esp_rmaker_queue_work_on_lane(ESP_RMAKER_WORK_LANE_CONTROL, esp_rmaker_schedule_trigger_work_cb, priv_data);
 }
 
 static void esp_rmaker_schedule_timestamp_common_cb(esp_schedule_handle_t handle, uint32_t next_timestamp, void *priv_data)
 {
-    int32_t index = (int32_t)priv_data;
+    int32_t index = (int32_t)(intptr_t)priv_data;
     esp_rmaker_schedule_t *schedule = esp_rmaker_schedule_get_schedule_from_index(index);
     if (!schedule) {
         ESP_LOGE(TAG, "Schedule with index %d not found for timestamp callback", index);
@@ -307,6 +322,51 @@ static void esp_rmaker_schedule_timestamp_common_cb(esp_schedule_handle_t handle
     schedule->trigger.next_timestamp = next_timestamp;
 }
 
+static esp_err_t esp_rmaker_schedule_get_location(float *latitude, float *longitude)
+{
+    esp_rmaker_attr_t *attr = esp_rmaker_node_get_first_attribute(esp_rmaker_get_node());
+    while (attr) {
+        if (strcmp(attr->name, ESP_RMAKER_SCHEDULE_LOCATION_ATTR) == 0) {
+            break;
+        }
+        attr = attr->next;
+    }
+    if (!attr) {
+        ESP_LOGE(TAG, "Node attribute %s not found. It is required for sunrise and sunset schedules.",
+                ESP_RMAKER_SCHEDULE_LOCATION_ATTR);
+        return ESP_ERR_NOT_FOUND;
+    }
+    char *end = NULL;
+    *latitude = strtof(attr->value, &end);
+    if (end == attr->value || *end != ',') {
+        goto invalid;
+    }
+    const char *longitude_str = end + 1;
+    *longitude = strtof(longitude_str, &end);
+    if (end == longitude_str || *latitude < -90 || *latitude > 90 || *longitude < -180 || *longitude > 180) {
+        goto invalid;
+    }
+    return ESP_OK;
+
+invalid:
+    ESP_LOGE(TAG, "Invalid value \"%s\" for node attribute %s. Expected \"<latitude>,<longitude>\" in degrees.",
+            attr->value, ESP_RMAKER_SCHEDULE_LOCATION_ATTR);
+    return ESP_ERR_INVALID_ARG;
+}
+
+/* Sunrise and sunset schedules need the location from the node attribute. Such schedules are kept, but without
+ * an esp_schedule handle, while the location is not available. The location is looked up again when they get
+ * enabled or edited.
+ */
+static bool esp_rmaker_schedule_location_missing(esp_rmaker_schedule_t *schedule)
+{
+    float latitude, longitude;
+    if (schedule->trigger.type != TRIGGER_TYPE_SUNRISE && schedule->trigger.type != TRIGGER_TYPE_SUNSET) {
+        return false;
+    }
+    return esp_rmaker_schedule_get_location(&latitude, &longitude) != ESP_OK;
+}
+
 static esp_err_t esp_rmaker_schedule_prepare_config(esp_rmaker_schedule_t *schedule, esp_schedule_config_t *schedule_config)
 {
     if (!schedule || !schedule_config) {
@@ -335,6 +395,25 @@ static esp_err_t esp_rmaker_schedule_prepare_config(esp_rmaker_schedule_t *sched
         if (schedule->trigger.date.repeat_months == 0) {
             schedule_config->timestamp_cb = esp_rmaker_schedule_timestamp_common_cb;
         }
+    } else if (schedule->trigger.type == TRIGGER_TYPE_SUNRISE || schedule->trigger.type == TRIGGER_TYPE_SUNSET) {
+        esp_err_t err = esp_rmaker_schedule_get_location(&schedule_config->trigger.solar.latitude,
+                &schedule_config->trigger.solar.longitude);
+        if (err != ESP_OK) {
+            return err;
+        }
+        schedule_config->trigger.type = (schedule->trigger.type == TRIGGER_TYPE_SUNRISE) ?
+                ESP_SCHEDULE_TYPE_SUNRISE : ESP_SCHEDULE_TYPE_SUNSET;
+        schedule_config->trigger.day.repeat_days = schedule->trigger.day.repeat_days;
+        schedule_config->trigger.solar.offset_minutes = schedule->trigger.solar.offset_minutes;
+        if (schedule->trigger.day.repeat_days == 0) {
+            schedule_config->timestamp_cb = esp_rmaker_schedule_timestamp_common_cb;
+        }
+    } else if (schedule->trigger.type == TRIGGER_TYPE_RELATIVE) {
+        schedule_config->trigger.type = ESP_SCHEDULE_TYPE_RELATIVE;
+        /* The id of the schedule is its name in esp_schedule */
+        strlcpy(schedule_config->trigger.relative.name, schedule->trigger.relative.id,
+                sizeof(schedule_config->trigger.relative.name));
+        schedule_config->trigger.relative.delay_minutes = schedule->trigger.minutes;
     }
 
     /* In esp_schedule, name should be unique and is used as the primary key.
@@ -342,14 +421,17 @@ static esp_err_t esp_rmaker_schedule_prepare_config(esp_rmaker_schedule_t *sched
     strlcpy(schedule_config->name, schedule->id, sizeof(schedule_config->name));
     /* Just passing the schedule pointer as priv_data could create a race condition between the schedule getting a
     callback and the schedule getting removed. Using this unique index as the priv_data solves it to some extent. */
-    schedule_config->priv_data = (void *)schedule->index;
+    schedule_config->priv_data = (void *)(intptr_t)schedule->index;
     return ESP_OK;
 }
 
 static esp_err_t esp_rmaker_schedule_add(esp_rmaker_schedule_t *schedule)
 {
     esp_schedule_config_t schedule_config = {0};
-    esp_rmaker_schedule_prepare_config(schedule, &schedule_config);
+    esp_err_t err = esp_rmaker_schedule_prepare_config(schedule, &schedule_config);
+    if (err != ESP_OK) {
+        return err;
+    }
 
     schedule->handle = esp_schedule_create(&schedule_config);
     if (schedule->handle == NULL) {
@@ -360,6 +442,11 @@ static esp_err_t esp_rmaker_schedule_add(esp_rmaker_schedule_t *schedule)
 
 static esp_err_t esp_rmaker_schedule_operation_add(esp_rmaker_schedule_t *schedule)
 {
+    if (esp_rmaker_schedule_location_missing(schedule)) {
+        /* Not dropping the schedule, so that it stays in the params */
+        ESP_LOGE(TAG, "Schedule with id %s will remain disabled till the location is available.", schedule->id);
+        return esp_rmaker_schedule_add_to_list(schedule);
+    }
     esp_err_t ret = esp_rmaker_schedule_add(schedule);
     if (ret != ESP_OK) {
         return ret;
@@ -371,9 +458,17 @@ static esp_err_t esp_rmaker_schedule_operation_add(esp_rmaker_schedule_t *schedu
 static esp_err_t esp_rmaker_schedule_operation_edit(esp_rmaker_schedule_t *schedule)
 {
     esp_schedule_config_t schedule_config = {0};
-    esp_rmaker_schedule_prepare_config(schedule, &schedule_config);
+    esp_err_t ret = esp_rmaker_schedule_prepare_config(schedule, &schedule_config);
+    if (ret != ESP_OK) {
+        return ret;
+    }
 
-    esp_err_t ret = esp_schedule_edit(schedule->handle, &schedule_config);
+    if (schedule->handle) {
+        ret = esp_schedule_edit(schedule->handle, &schedule_config);
+    } else {
+        /* Added without the location earlier */
+        ret = esp_rmaker_schedule_add(schedule);
+    }
     if (schedule->enabled == true) {
         /* If the schedule is already enabled, disable it and enable it again so that the new changes after the
         edit are reflected. */
@@ -385,6 +480,9 @@ static esp_err_t esp_rmaker_schedule_operation_edit(esp_rmaker_schedule_t *sched
 
 static esp_err_t esp_rmaker_schedule_remove(esp_rmaker_schedule_t *schedule)
 {
+    if (!schedule->handle) {
+        return ESP_OK;
+    }
     return esp_schedule_delete(schedule->handle);
 }
 
@@ -418,7 +516,7 @@ static void esp_rmaker_schedule_timesync_timer_work_cb(void *priv_data)
 
 static void esp_rmaker_schedule_timesync_timer_cb(TimerHandle_t timer)
 {
-    esp_rmaker_queue_work(esp_rmaker_schedule_timesync_timer_work_cb, NULL);
+    esp_rmaker_queue_work_on_lane(ESP_RMAKER_WORK_LANE_CONTROL, esp_rmaker_schedule_timesync_timer_work_cb, NULL);
 }
 
 static esp_err_t esp_rmaker_schedule_timesync_timer_init(void)
@@ -446,6 +544,15 @@ static esp_err_t esp_rmaker_schedule_timesync_timer_start(void)
 
 static esp_err_t esp_rmaker_schedule_operation_enable(esp_rmaker_schedule_t *schedule)
 {
+    if (!schedule->handle) {
+        /* Added without the location earlier. Try again. */
+        esp_err_t err = esp_rmaker_schedule_add(schedule);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Schedule with id %s cannot be enabled without the location.", schedule->id);
+            schedule->enabled = false;
+            return err;
+        }
+    }
     /* Setting enabled to true even if time is not synced yet. This reports the correct enabled state when reporting the schedules.*/
     schedule->enabled = true;
 
@@ -474,12 +581,18 @@ static esp_err_t esp_rmaker_schedule_operation_enable(esp_rmaker_schedule_t *sch
     }
 
     /* Time is synced. Enable the schedule */
-    return esp_schedule_enable(schedule->handle);
+    esp_err_t err = esp_schedule_enable(schedule->handle);
+    if (err == ESP_ERR_INVALID_ARG) {
+        /* Eg. a relative schedule following one which follows it */
+        ESP_LOGE(TAG, "Schedule with id %s cannot be enabled.", schedule->id);
+        schedule->enabled = false;
+    }
+    return err;
 }
 
 static esp_err_t esp_rmaker_schedule_operation_disable(esp_rmaker_schedule_t *schedule)
 {
-    esp_err_t ret = esp_schedule_disable(schedule->handle);
+    esp_err_t ret = schedule->handle ? esp_schedule_disable(schedule->handle) : ESP_OK;
     schedule->trigger.next_timestamp = 0;
     schedule->enabled = false;
     return ret;
@@ -538,9 +651,9 @@ static esp_err_t esp_rmaker_schedule_parse_action(jparse_ctx_t *jctx, esp_rmaker
     action->data_len = data_len + 1;
 
     if (action->data) {
-        free(action->data);
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_SCHEDULE, action->data);
     }
-    action->data = (void *)calloc(1, action->data_len);
+    action->data = (void *)esp_rmaker_mem_calloc(ESP_RMAKER_MEM_SCHEDULE, 1, action->data_len);
     if (!action->data) {
         ESP_LOGE(TAG, "Could not allocate action");
         return ESP_ERR_NO_MEM;
@@ -549,11 +662,13 @@ static esp_err_t esp_rmaker_schedule_parse_action(jparse_ctx_t *jctx, esp_rmaker
     return ESP_OK;
 }
 
-static esp_err_t esp_rmaker_schedule_parse_trigger(jparse_ctx_t *jctx, esp_rmaker_schedule_trigger_t *trigger)
+static esp_err_t esp_rmaker_schedule_parse_trigger(jparse_ctx_t *jctx, esp_rmaker_schedule_trigger_t *trigger,
+        esp_rmaker_req_src_t src)
 {
     int total_triggers = 0;
-    int minutes = 0, repeat_days = 0, day = 0, repeat_months = 0, year = 0;
+    int minutes = 0, repeat_days = 0, day = 0, repeat_months = 0, year = 0, offset_minutes = 0;
     bool repeat_every_year = false;
+    char relative_id[MAX_ID_LEN + 1] = {0};      /* +1 for NULL termination */
     int64_t timestamp = 0;
     trigger_type_t type = TRIGGER_TYPE_INVALID;
     if(json_obj_get_array(jctx, "triggers", &total_triggers) != 0) {
@@ -577,12 +692,34 @@ static esp_err_t esp_rmaker_schedule_parse_trigger(jparse_ctx_t *jctx, esp_rmake
             json_obj_get_int(jctx, "yy", &year);
             json_obj_get_bool(jctx, "r", &repeat_every_year);
         }
+        /* Sunrise and sunset use "d" for the days, along with the offset */
+        if (json_obj_get_int(jctx, "srise", &offset_minutes) == 0) {
+            type = TRIGGER_TYPE_SUNRISE;
+        } else if (json_obj_get_int(jctx, "sset", &offset_minutes) == 0) {
+            type = TRIGGER_TYPE_SUNSET;
+        }
+        /* Relative uses "m" for the minutes after the other schedule */
+        if (json_obj_get_string(jctx, "rel", relative_id, sizeof(relative_id)) == 0) {
+            type = TRIGGER_TYPE_RELATIVE;
+        }
 
         json_obj_get_int64(jctx, "ts", &timestamp);
         json_arr_leave_object(jctx);
     }
     json_obj_leave_array(jctx);
 
+    if (((type == TRIGGER_TYPE_SUNRISE) || (type == TRIGGER_TYPE_SUNSET)) &&
+            ((offset_minutes < -MAX_SOLAR_OFFSET_MINUTES) || (offset_minutes > MAX_SOLAR_OFFSET_MINUTES))) {
+        ESP_LOGE(TAG, "Offset of %d minutes from sunrise/sunset out of range", offset_minutes);
+        return ESP_ERR_INVALID_ARG;
+    }
+    /* The schedules loaded from NVS are added one by one, so the other schedule may just not be there yet */
+    if ((type == TRIGGER_TYPE_RELATIVE) && (src != ESP_RMAKER_REQ_SRC_INIT) &&
+            !esp_rmaker_schedule_get_schedule_from_id(relative_id)) {
+        ESP_LOGE(TAG, "Schedule with id %s, for the relative trigger, not found", relative_id);
+        return ESP_ERR_NOT_FOUND;
+    }
+
     trigger->type = type;
     trigger->minutes = minutes;
     trigger->day.repeat_days = repeat_days;
@@ -590,6 +727,8 @@ static esp_err_t esp_rmaker_schedule_parse_trigger(jparse_ctx_t *jctx, esp_rmake
     trigger->date.repeat_months = repeat_months;
     trigger->date.year = year;
     trigger->date.repeat_every_year = repeat_every_year;
+    trigger->solar.offset_minutes = offset_minutes;
+    strlcpy(trigger->relative.id, relative_id, sizeof(trigger->relative.id));
     trigger->next_timestamp = timestamp;
     return ESP_OK;
 }
@@ -614,7 +753,8 @@ static esp_rmaker_schedule_t *esp_rmaker_schedule_find_or_create(jparse_ctx_t *j
         }
 
         /* This is a new schedule. Fill it. */
-        schedule = (esp_rmaker_schedule_t *)calloc(1, sizeof(esp_rmaker_schedule_t));
+        schedule = (esp_rmaker_schedule_t *)esp_rmaker_mem_calloc(ESP_RMAKER_MEM_SCHEDULE,
+                1, sizeof(esp_rmaker_schedule_t));
         if (!schedule) {
             ESP_LOGE(TAG, "Couldn't allocate schedule with id: %s", id);
             return NULL;
@@ -649,7 +789,15 @@ static esp_err_t esp_rmaker_schedule_perform_operation(esp_rmaker_schedule_t *sc
     switch (operation) {
         case OPERATION_ADD:
             if (schedule_priv_data->total_schedules < MAX_SCHEDULES) {
-                esp_rmaker_schedule_operation_add(schedule);
+                err = esp_rmaker_schedule_operation_add(schedule);
+                if (err != ESP_OK) {
+                    ESP_LOGE(TAG, "Failed to add schedule with id %s", schedule->id);
+                    if (schedule->handle) {
+                        esp_rmaker_schedule_remove(schedule);
+                    }
+                    esp_rmaker_schedule_free(schedule);
+                    break;
+                }
                 if (enabled == true) {
                     esp_rmaker_schedule_operation_enable(schedule);
                 }
@@ -739,12 +887,18 @@ static esp_err_t esp_rmaker_schedule_parse_json(void *data, size_t data_len, esp
                 }
             }
 
+            /* Get trigger. This is before the action, so that an invalid trigger leaves an edited schedule as is. */
+            /* There is only one trigger for now. If more triggers are added, then they should be parsed here in a loop */
+            if (esp_rmaker_schedule_parse_trigger(&jctx, &schedule->trigger, src) != ESP_OK) {
+                ESP_LOGE(TAG, "Invalid trigger for schedule with id %s", id);
+                if (operation == OPERATION_ADD) {
+                    esp_rmaker_schedule_free(schedule);
+                }
+                goto cleanup;
+            }
+
             /* Get action */
             esp_rmaker_schedule_parse_action(&jctx, &schedule->action);
-
-            /* Get trigger */
-            /* There is only one trigger for now. If more triggers are added, then they should be parsed here in a loop */
-            esp_rmaker_schedule_parse_trigger(&jctx, &schedule->trigger);
         }
 
         /* Perform operation */
@@ -754,12 +908,13 @@ cleanup:
         json_arr_leave_object(&jctx);
         current_schedule++;
     }
+    json_parse_end(&jctx);
     return ESP_OK;
 }
 
 static char *esp_rmaker_schedule_get_params()
 {
-    char *data = calloc(1, MAX_SCHEDULE_REPORT_SIZE);
+    char *data = esp_rmaker_mem_calloc(ESP_RMAKER_MEM_SCHEDULE, 1, MAX_SCHEDULE_REPORT_SIZE);
     if (!data) {
         ESP_LOGE(TAG, "Failed to allocate %d bytes for schedule", MAX_SCHEDULE_REPORT_SIZE);
         return NULL;
@@ -782,8 +937,19 @@ static char *esp_rmaker_schedule_get_params()
         /* Add trigger */
         json_gen_push_array(&jstr, "triggers");
         json_gen_start_object(&jstr);
-        json_gen_obj_set_int(&jstr, "m", schedule->trigger.minutes);
-        if (schedule->trigger.type == TRIGGER_TYPE_DAYS_OF_WEEK) {
+        if (schedule->trigger.type == TRIGGER_TYPE_SUNRISE || schedule->trigger.type == TRIGGER_TYPE_SUNSET) {
+            json_gen_obj_set_int(&jstr, schedule->trigger.type == TRIGGER_TYPE_SUNRISE ? "srise" : "sset",
+                    schedule->trigger.solar.offset_minutes);
+            json_gen_obj_set_int(&jstr, "d", schedule->trigger.day.repeat_days);
+            if (schedule->trigger.day.repeat_days == 0) {
+                json_gen_obj_set_int(&jstr, "ts", schedule->trigger.next_timestamp);
+            }
+        } else {
+            json_gen_obj_set_int(&jstr, "m", schedule->trigger.minutes);
+        }
+        if (schedule->trigger.type == TRIGGER_TYPE_RELATIVE) {
+            json_gen_obj_set_string(&jstr, "rel", schedule->trigger.relative.id);
+        } else if (schedule->trigger.type == TRIGGER_TYPE_DAYS_OF_WEEK) {
             json_gen_obj_set_int(&jstr, "d", schedule->trigger.day.repeat_days);
             if (schedule->trigger.day.repeat_days == 0) {
                 json_gen_obj_set_int(&jstr, "ts", schedule->trigger.next_timestamp);
@@ -808,7 +974,7 @@ static char *esp_rmaker_schedule_get_params()
     if (json_gen_end_array(&jstr) < 0) {
         ESP_LOGE(TAG, "Buffer size %d not sufficient for reporting Schedule Params.\n"
                 "Please increase CONFIG_ESP_RMAKER_MAX_PARAM_DATA_SIZE", MAX_SCHEDULE_REPORT_SIZE);
-        free(data);
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_SCHEDULE, data);
         return NULL;
     }
     json_gen_str_end(&jstr);
@@ -825,7 +991,7 @@ static esp_err_t esp_rmaker_schedule_report_params(void)
     esp_rmaker_param_t *param = esp_rmaker_device_get_param_by_type(schedule_priv_data->schedule_service, ESP_RMAKER_PARAM_SCHEDULES);
     esp_rmaker_param_update_and_report(param, val);
 
-    free(data);
+    esp_rmaker_mem_free(ESP_RMAKER_MEM_SCHEDULE, data);
     return ESP_OK;
 }
 
@@ -837,7 +1003,7 @@ static esp_err_t write_cb(const esp_rmaker_device_t *device, const esp_rmaker_pa
         return ESP_ERR_INVALID_ARG;
     }
     if (strlen(val.val.s) <= 0) {
-        ESP_LOGI(TAG, "Invalid length for params: %d", strlen(val.val.s));
+        ESP_LOGI(TAG, "Invalid length for params: %d", (int)strlen(val.val.s));
         return ESP_ERR_INVALID_ARG;
     }
     esp_rmaker_schedule_parse_json(val.val.s, strlen(val.val.s), ctx->src);
@@ -850,7 +1016,8 @@ static esp_err_t write_cb(const esp_rmaker_device_t *device, const esp_rmaker_pa
 
 esp_err_t esp_rmaker_schedule_enable(void)
 {
-    schedule_priv_data = (esp_rmaker_schedule_priv_data_t *)calloc(1, sizeof(esp_rmaker_schedule_priv_data_t));
+    schedule_priv_data = (esp_rmaker_schedule_priv_data_t *)esp_rmaker_mem_calloc(ESP_RMAKER_MEM_SCHEDULE,
+            1, sizeof(esp_rmaker_schedule_priv_data_t));
     if (!schedule_priv_data) {
         ESP_LOGE(TAG, "Couldn't allocate schedule_priv_data");
         return ESP_ERR_NO_MEM;
@@ -46,7 +46,7 @@ void *esp_rmaker_storage_get(const char *key)
     }
     size_t required_size = 0;
     if ((err = nvs_get_blob(handle, key, NULL, &required_size)) != ESP_OK) {
-        ESP_LOGD(TAG, "Failed to read key %s with error %d size %d", key, err, required_size);
+        ESP_LOGD(TAG, "Failed to read key %s with error %d size %d", key, err, (int)required_size);
         nvs_close(handle);
         return NULL;
     }
@@ -68,7 +68,7 @@ esp_err_t esp_rmaker_storage_set(const char *key, void *data, size_t len)
         return ESP_FAIL;
     }
     if ((err = nvs_set_blob(handle, key, data, len)) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to write key %s with error %d size %d", key, err, len);
+        ESP_LOGE(TAG, "Failed to write key %s with error %d size %d", key, err, (int)len);
         nvs_close(handle);
         return ESP_FAIL;
     }
@@ -46,7 +46,8 @@ esp_err_t esp_rmaker_get_local_time_str(char *buf, size_t buf_len)
     strftime(strftime_buf, sizeof(strftime_buf), "%c %z[%Z]", &timeinfo);
     size_t print_size = snprintf(buf, buf_len, "%s, DST: %s", strftime_buf, timeinfo.tm_isdst ? "Yes" : "No");
     if (print_size >= buf_len) {
-        ESP_LOGE(TAG, "Buffer size %d insufficient for localtime string. REquired size: %d", buf_len, print_size);
+        ESP_LOGE(TAG, "Buffer size %d insufficient for localtime string. REquired size: %d",
+                (int)buf_len, (int)print_size);
         return ESP_ERR_INVALID_ARG;
     }
     return ESP_OK;
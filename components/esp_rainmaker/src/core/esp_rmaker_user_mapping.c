@@ -22,6 +22,7 @@
 #include <esp_rmaker_mqtt.h>
 #include "esp_rmaker_user_mapping.pb-c.h"
 #include "esp_rmaker_internal.h"
+#include "esp_rmaker_mem.h"
 
 static const char *TAG = "esp_rmaker_user_mapping";
 
@@ -37,12 +38,12 @@ static void esp_rmaker_user_mapping_cleanup_data(esp_rmaker_user_mapping_data_t
 {
     if (data) {
         if (data->user_id) {
-            free(data->user_id);
+            esp_rmaker_mem_free(ESP_RMAKER_MEM_CORE, data->user_id);
         }
         if (data->secret_key) {
-            free(data->secret_key);
+            esp_rmaker_mem_free(ESP_RMAKER_MEM_CORE, data->secret_key);
         }
-        free(data);
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_CORE, data);
     }
 }
 
@@ -86,7 +87,8 @@ static void esp_rmaker_user_mapping_cb(void *priv_data)
     json_gen_str_end(&jstr);
     char publish_topic[100];
     snprintf(publish_topic, sizeof(publish_topic), "node/%s/%s", node_id, USER_MAPPING_TOPIC_SUFFIX);
-    esp_err_t err = esp_rmaker_mqtt_publish(publish_topic, publish_payload, strlen(publish_payload));
+    esp_err_t err = esp_rmaker_mqtt_publish_with_prio(publish_topic, publish_payload, strlen(publish_payload),
+            1, ESP_RMAKER_MQTT_PRIO_CONTROL);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "MQTT Publish Error %d", err);
     }
@@ -95,19 +97,20 @@ static void esp_rmaker_user_mapping_cb(void *priv_data)
 }
 esp_err_t esp_rmaker_start_user_node_mapping(char *user_id, char *secret_key)
 {
-    esp_rmaker_user_mapping_data_t *data = calloc(1, sizeof(esp_rmaker_user_mapping_data_t));
+    esp_rmaker_user_mapping_data_t *data = esp_rmaker_mem_calloc(ESP_RMAKER_MEM_CORE,
+            1, sizeof(esp_rmaker_user_mapping_data_t));
     if (!data) {
         return ESP_FAIL;
     }
-    data->user_id = strdup(user_id);
+    data->user_id = esp_rmaker_mem_strdup(ESP_RMAKER_MEM_CORE, user_id);
     if (!data->user_id) {
         goto user_mapping_error;
     }
-    data->secret_key = strdup(secret_key);
+    data->secret_key = esp_rmaker_mem_strdup(ESP_RMAKER_MEM_CORE, secret_key);
     if (!data->secret_key) {
         goto user_mapping_error;
     }
-    if (esp_rmaker_queue_work(esp_rmaker_user_mapping_cb, data) != ESP_OK) {
+    if (esp_rmaker_queue_work_on_lane(ESP_RMAKER_WORK_LANE_CONTROL, esp_rmaker_user_mapping_cb, data) != ESP_OK) {
         goto user_mapping_error;
     }
     esp_rmaker_user_mapping_prov_deinit();
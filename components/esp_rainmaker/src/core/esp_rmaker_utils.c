@@ -24,6 +24,8 @@ static esp_timer_handle_t reboot_timer;
 
 static void esp_rmaker_reboot_cb(void *priv)
 {
+    /* Write any param values still pending to be stored, before rebooting */
+    esp_rmaker_param_store_flush();
     esp_restart();
 }
 
@@ -56,6 +58,7 @@ esp_err_t esp_rmaker_wifi_reset(uint8_t seconds)
 
 esp_err_t esp_rmaker_factory_reset(uint8_t seconds)
 {
+    esp_rmaker_param_store_discard();
     nvs_flash_deinit();
     nvs_flash_erase();
     esp_rmaker_post_event(RMAKER_EVENT_FACTORY_RESET, NULL, 0);
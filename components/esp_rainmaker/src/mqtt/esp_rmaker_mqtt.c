@@ -17,98 +17,96 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/event_groups.h>
+#include <freertos/semphr.h>
 #include <esp_log.h>
-#include <mqtt_client.h>
+#include <esp_timer.h>
 #include <esp_rmaker_core.h>
 #include <esp_rmaker_mqtt.h>
+#include <esp_rmaker_mqtt_transport.h>
 #include <esp_rmaker_internal.h>
+#ifdef CONFIG_IDF_TARGET_LINUX
+#include <esp_rmaker_mqtt_loopback.h>
+#endif /* CONFIG_IDF_TARGET_LINUX */
 
-#include <esp_idf_version.h>
-#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 1, 0)
-// Features supported in 4.1
-
-#ifdef CONFIG_ESP_RMAKER_MQTT_PORT_443
-#define ESP_RMAKER_MQTT_USE_PORT_443
-#endif
-
-#else
-
-#ifdef CONFIG_ESP_RMAKER_MQTT_PORT_443
-#warning "Port 443 not supported in idf versions below 4.1. Using 8883 instead."
-#endif
-
-#endif /* !IDF4.1 */
+#include "esp_rmaker_mqtt_router.h"
+#include "esp_rmaker_mqtt_reassembly.h"
+#include "esp_rmaker_mqtt_sched.h"
+#ifdef CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE
+#include "esp_rmaker_mqtt_queue.h"
+#endif /* CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE */
+#include "esp_rmaker_mem.h"
 
 static const char *TAG = "esp_rmaker_mqtt";
 
-#define MAX_MQTT_SUBSCRIPTIONS      5
-
-typedef struct {
-    char *topic;
-    esp_rmaker_mqtt_subscribe_cb_t cb;
-    void *priv;
-} esp_rmaker_mqtt_subscription_t;
-
 typedef struct {
-    esp_mqtt_client_handle_t mqtt_client;
+    const esp_rmaker_mqtt_transport_t *transport;
+    void *transport_handle;
     esp_rmaker_mqtt_config_t *config;
-    esp_rmaker_mqtt_subscription_t *subscriptions[MAX_MQTT_SUBSCRIPTIONS];
+    esp_rmaker_mqtt_router_t *router;
+    bool connected;
+#ifdef CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE
+    /* Set on connection, till all the messages in the offline queue are published. New messages are queued
+     * behind those meanwhile, so that they do not overtake them.
+     */
+    bool replay_pending;
+    /* Set while a queued message is being published, so that only one task does that at a time */
+    bool replaying;
+    esp_timer_handle_t replay_timer;
+#endif /* CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE */
+    /* Protects the publish scheduler, the offline queue and the connected state. This should never be
+     * held while calling the transport APIs, since the transport may hold its own lock while invoking
+     * the esp_rmaker_mqtt_transport_on_*() functions, which need this lock.
+     */
+    SemaphoreHandle_t lock;
 } esp_rmaker_mqtt_data_t;
 esp_rmaker_mqtt_data_t *mqtt_data;
+#ifdef CONFIG_IDF_TARGET_LINUX
+/* There is no ESP-MQTT client on the host build */
+static const esp_rmaker_mqtt_transport_t *mqtt_transport = &esp_rmaker_mqtt_loopback_transport;
+#else
+static const esp_rmaker_mqtt_transport_t *mqtt_transport = &esp_rmaker_mqtt_esp_mqtt_transport;
+#endif /* !CONFIG_IDF_TARGET_LINUX */
 
 const int MQTT_CONNECTED_EVENT = BIT1;
 static EventGroupHandle_t mqtt_event_group;
 
-typedef struct {
-    char *data;
-    char *topic;
-} esp_rmaker_mqtt_long_data_t;
-
-static void esp_rmaker_mqtt_subscribe_callback(const char *topic, int topic_len, const char *data, int data_len)
+esp_err_t esp_rmaker_mqtt_subscribe(const char *topic, esp_rmaker_mqtt_subscribe_cb_t cb, void *priv_data)
 {
-    esp_rmaker_mqtt_subscription_t **subscriptions = mqtt_data->subscriptions;
-    int i;
-    for (i = 0; i < MAX_MQTT_SUBSCRIPTIONS; i++) {
-        if (subscriptions[i]) {
-            if ((strncmp(topic, subscriptions[i]->topic, topic_len) == 0)
-                    && (topic_len == strlen(subscriptions[i]->topic))) {
-                subscriptions[i]->cb(subscriptions[i]->topic, (void *)data, data_len, subscriptions[i]->priv);
-            }
-        }
+    if ( !mqtt_data || !topic || !cb) {
+        return ESP_FAIL;
     }
+    esp_err_t err = esp_rmaker_mqtt_router_add(mqtt_data->router, topic, cb, priv_data);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add subscription for topic %s. Error %d", topic, err);
+        return ESP_FAIL;
+    }
+    int ret = mqtt_data->transport->subscribe(mqtt_data->transport_handle, topic, 1);
+    if (ret < 0) {
+        /* Only the subscription added above. Others on the same topic should stay. */
+        esp_rmaker_mqtt_router_remove_cb(mqtt_data->router, topic, cb, priv_data);
+        return ESP_FAIL;
+    }
+    ESP_LOGD(TAG, "Subscribed to topic: %s", topic);
+    return ESP_OK;
 }
 
-esp_err_t esp_rmaker_mqtt_subscribe(const char *topic, esp_rmaker_mqtt_subscribe_cb_t cb, void *priv_data)
+esp_err_t esp_rmaker_mqtt_subscribe_stream(const char *topic, esp_rmaker_mqtt_stream_cb_t cb, void *priv_data)
 {
     if ( !mqtt_data || !topic || !cb) {
         return ESP_FAIL;
     }
-    int i;
-    for (i = 0; i < MAX_MQTT_SUBSCRIPTIONS; i++) {
-        if (!mqtt_data->subscriptions[i]) {
-            esp_rmaker_mqtt_subscription_t *subscription = calloc(1, sizeof(esp_rmaker_mqtt_subscription_t));
-            if (!subscription) {
-                return ESP_FAIL;
-            }
-            subscription->topic = strdup(topic);
-            if (!subscription->topic) {
-                free(subscription);
-                return ESP_FAIL;
-            }
-            int ret = esp_mqtt_client_subscribe(mqtt_data->mqtt_client, subscription->topic, 1);
-            if (ret < 0) {
-                free(subscription->topic);
-                free(subscription);
-                return ESP_FAIL;
-            }
-            subscription->priv = priv_data;
-            subscription->cb = cb;
-            mqtt_data->subscriptions[i] = subscription;
-            ESP_LOGD(TAG, "Subscribed to topic: %s", topic);
-            return ESP_OK;
-        }
+    esp_err_t err = esp_rmaker_mqtt_router_add_stream(mqtt_data->router, topic, cb, priv_data);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add streaming subscription for topic %s. Error %d", topic, err);
+        return ESP_FAIL;
     }
-    return ESP_FAIL;
+    int ret = mqtt_data->transport->subscribe(mqtt_data->transport_handle, topic, 1);
+    if (ret < 0) {
+        esp_rmaker_mqtt_router_remove_stream_cb(mqtt_data->router, topic, cb, priv_data);
+        return ESP_FAIL;
+    }
+    ESP_LOGD(TAG, "Subscribed to topic: %s", topic);
+    return ESP_OK;
 }
 
 esp_err_t esp_rmaker_mqtt_unsubscribe(const char *topic)
@@ -116,147 +114,261 @@ esp_err_t esp_rmaker_mqtt_unsubscribe(const char *topic)
     if (!mqtt_data || !topic) {
         return ESP_FAIL;
     }
-    int ret = esp_mqtt_client_unsubscribe(mqtt_data->mqtt_client, topic);
+    int ret = mqtt_data->transport->unsubscribe(mqtt_data->transport_handle, topic);
     if (ret < 0) {
         ESP_LOGW(TAG, "Could not unsubscribe from topic: %s", topic);
     }
-    esp_rmaker_mqtt_subscription_t **subscriptions = mqtt_data->subscriptions;
-    int i;
-    for (i = 0; i < MAX_MQTT_SUBSCRIPTIONS; i++) {
-        if (subscriptions[i]) {
-            if (strncmp(topic, subscriptions[i]->topic, strlen(topic)) == 0) {
-                free(subscriptions[i]->topic);
-                free(subscriptions[i]);
-                subscriptions[i] = NULL;
-                return ESP_OK;
-            }
-        }
+    if (esp_rmaker_mqtt_router_remove(mqtt_data->router, topic) != ESP_OK) {
+        return ESP_FAIL;
     }
-    return ESP_FAIL;
+    return ESP_OK;
 }
 
-esp_err_t esp_rmaker_mqtt_publish(const char *topic, void *data, size_t data_len)
+#ifdef CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE
+/* Delay after which publishing the messages queued while disconnected is retried, if it fails. The
+ * acknowledgements for other messages, if any, trigger a retry as well.
+ */
+#define REPLAY_RETRY_DELAY_US   (5 * 1000 * 1000LL)
+
+static void esp_rmaker_mqtt_replay_retry(void)
 {
-    if (!mqtt_data || !topic || !data) {
-        return ESP_FAIL;
+    if (mqtt_data->replay_timer) {
+        /* Returns an error if the timer isn't running, which can be ignored */
+        esp_timer_stop(mqtt_data->replay_timer);
+        esp_timer_start_once(mqtt_data->replay_timer, REPLAY_RETRY_DELAY_US);
     }
-    ESP_LOGD(TAG, "Publishing to %s", topic);
-    int ret = esp_mqtt_client_publish(mqtt_data->mqtt_client, topic, data, data_len, 1, 0);
-    if (ret < 0) {
-        ESP_LOGE(TAG, "MQTT Publish failed");
-        return ESP_FAIL;
-    }
-    return ESP_OK;
 }
 
-static esp_rmaker_mqtt_long_data_t *esp_rmaker_mqtt_free_long_data(esp_rmaker_mqtt_long_data_t *long_data)
+/* Publish the messages queued while disconnected, oldest first. The lock is not held while publishing, as the
+ * transport APIs may get called from any task here.
+ */
+static void esp_rmaker_mqtt_replay_queued(void)
 {
-    if (long_data) {
-        if (long_data->topic) {
-            free(long_data->topic);
+    while (1) {
+        char *msg = NULL;
+        size_t msg_len = 0;
+        xSemaphoreTake(mqtt_data->lock, portMAX_DELAY);
+        if (!mqtt_data->connected || !mqtt_data->replay_pending || mqtt_data->replaying) {
+            xSemaphoreGive(mqtt_data->lock);
+            return;
+        }
+        esp_err_t err = esp_rmaker_mqtt_queue_take(&msg, &msg_len);
+        if (err == ESP_OK) {
+            mqtt_data->replaying = true;
+        } else if (err == ESP_ERR_NOT_FOUND) {
+            mqtt_data->replay_pending = false;
+        }
+        xSemaphoreGive(mqtt_data->lock);
+        if (err == ESP_ERR_NOT_FOUND) {
+            ESP_LOGD(TAG, "Published all the messages queued while disconnected.");
+            return;
+        } else if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to get queued message. Will retry.");
+            esp_rmaker_mqtt_replay_retry();
+            return;
+        }
+        size_t topic_len = strlen(msg);
+        ESP_LOGD(TAG, "Publishing queued message to %s", msg);
+        int msg_id = mqtt_data->transport->publish(mqtt_data->transport_handle, msg, msg + topic_len + 1,
+                msg_len - topic_len - 1, 1);
+        if (msg_id < 0) {
+            ESP_LOGW(TAG, "Failed to publish queued message on %s. Will retry.", msg);
         }
-        if (long_data->data) {
-            free(long_data->data);
+        xSemaphoreTake(mqtt_data->lock, portMAX_DELAY);
+        mqtt_data->replaying = false;
+        if (msg_id < 0) {
+            esp_rmaker_mqtt_queue_putback(msg, msg_len);
         }
-        free(long_data);
+        xSemaphoreGive(mqtt_data->lock);
+        if (msg_id < 0) {
+            esp_rmaker_mqtt_replay_retry();
+            return;
+        }
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, msg);
     }
-    return NULL;
 }
 
-static esp_rmaker_mqtt_long_data_t *esp_rmaker_mqtt_manage_long_data(esp_rmaker_mqtt_long_data_t *long_data,
-        esp_mqtt_event_handle_t event)
+static void esp_rmaker_mqtt_replay_timer_cb(void *priv)
+{
+    esp_rmaker_mqtt_replay_queued();
+}
+#endif /* CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE */
+
+/* Publish as many of the messages queued by the scheduler as possible */
+static void esp_rmaker_mqtt_sched_drain(void)
 {
-    if (event->topic) {
-        /* This is new data. Free any earlier data, if present. */
-        esp_rmaker_mqtt_free_long_data(long_data);
-        long_data = calloc(1, sizeof(esp_rmaker_mqtt_long_data_t));
-        if (!long_data) {
-            ESP_LOGE(TAG, "Could not allocate memory for esp_rmaker_mqtt_long_data_t");
-            return NULL;
+    while (1) {
+        int slot;
+        xSemaphoreTake(mqtt_data->lock, portMAX_DELAY);
+        esp_rmaker_mqtt_sched_msg_t *msg = esp_rmaker_mqtt_sched_next(&slot);
+        xSemaphoreGive(mqtt_data->lock);
+        if (!msg) {
+            return;
         }
-        long_data->data = calloc(1, event->total_data_len);
-        if (!long_data->data) {
-            ESP_LOGE(TAG, "Could not allocate %d bytes for received data.", event->total_data_len);
-            return esp_rmaker_mqtt_free_long_data(long_data);
+        ESP_LOGD(TAG, "Publishing queued message to %s", msg->topic);
+        int msg_id = mqtt_data->transport->publish(mqtt_data->transport_handle, msg->topic, msg->data,
+                msg->data_len, msg->qos);
+        xSemaphoreTake(mqtt_data->lock, portMAX_DELAY);
+        esp_rmaker_mqtt_sched_sent(slot, msg_id);
+        if (msg_id < 0) {
+            esp_rmaker_mqtt_sched_requeue(msg);
         }
-        long_data->topic = strndup(event->topic, event->topic_len);
-        if (!long_data->topic) {
-            ESP_LOGE(TAG, "Could not allocate %d bytes for received topic.", event->topic_len);
-            return esp_rmaker_mqtt_free_long_data(long_data);
+        xSemaphoreGive(mqtt_data->lock);
+        if (msg_id < 0) {
+            ESP_LOGW(TAG, "Failed to publish queued message on %s. Will retry.", msg->topic);
+            return;
         }
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, msg);
     }
-    if (long_data) {
-        memcpy(long_data->data + event->current_data_offset, event->data, event->data_len);
+}
 
-        if ((event->current_data_offset + event->data_len) == event->total_data_len) {
-            esp_rmaker_mqtt_subscribe_callback(long_data->topic, strlen(long_data->topic),
-                        long_data->data, event->total_data_len);
-            return esp_rmaker_mqtt_free_long_data(long_data);
+esp_err_t esp_rmaker_mqtt_publish_with_prio(const char *topic, void *data, size_t data_len,
+        uint8_t qos, esp_rmaker_mqtt_prio_t prio)
+{
+    if (!mqtt_data || !topic || !data || (qos > 1) || (prio >= ESP_RMAKER_MQTT_PRIO_MAX)) {
+        return ESP_FAIL;
+    }
+    xSemaphoreTake(mqtt_data->lock, portMAX_DELAY);
+#ifdef CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE
+    if (!mqtt_data->connected) {
+        esp_err_t err = ESP_FAIL;
+        if (qos > 0) {
+            ESP_LOGD(TAG, "Queueing message on %s till MQTT reconnects", topic);
+            err = esp_rmaker_mqtt_queue_add(topic, data, data_len);
+        } else {
+            ESP_LOGD(TAG, "MQTT not connected. Dropping QoS 0 message on %s", topic);
         }
+        xSemaphoreGive(mqtt_data->lock);
+        return err;
+    }
+    if (mqtt_data->replay_pending && (qos > 0)) {
+        ESP_LOGD(TAG, "Queueing message on %s behind the ones queued while disconnected", topic);
+        esp_err_t err = esp_rmaker_mqtt_queue_add(topic, data, data_len);
+        xSemaphoreGive(mqtt_data->lock);
+        esp_rmaker_mqtt_replay_queued();
+        return err;
+    }
+#endif /* CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE */
+    int slot;
+    esp_err_t err = esp_rmaker_mqtt_sched_reserve(qos, prio, &slot);
+    if (err != ESP_OK) {
+        err = esp_rmaker_mqtt_sched_enqueue(topic, data, data_len, qos, prio);
+        xSemaphoreGive(mqtt_data->lock);
+        /* Messages may have got queued while the acknowledgements for all the ones in flight came in */
+        esp_rmaker_mqtt_sched_drain();
+        return err;
+    }
+    xSemaphoreGive(mqtt_data->lock);
+    ESP_LOGD(TAG, "Publishing to %s", topic);
+    int msg_id = mqtt_data->transport->publish(mqtt_data->transport_handle, topic, data, data_len, qos);
+    xSemaphoreTake(mqtt_data->lock, portMAX_DELAY);
+    esp_rmaker_mqtt_sched_sent(slot, msg_id);
+    xSemaphoreGive(mqtt_data->lock);
+    if (msg_id < 0) {
+        ESP_LOGE(TAG, "MQTT Publish failed");
+        return ESP_FAIL;
     }
-    return long_data;
+    return ESP_OK;
 }
 
-static esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event)
+esp_err_t esp_rmaker_mqtt_publish(const char *topic, void *data, size_t data_len)
 {
-    switch (event->event_id) {
-        case MQTT_EVENT_CONNECTED:
-            ESP_LOGI(TAG, "MQTT Connected");
-            /* Resubscribe to all topics after reconnection */
-            for (int i = 0; i < MAX_MQTT_SUBSCRIPTIONS; i++) {
-                if (mqtt_data->subscriptions[i]) {
-                    esp_mqtt_client_subscribe(event->client, mqtt_data->subscriptions[i]->topic, 1);
-                }
-            }
-            xEventGroupSetBits(mqtt_event_group, MQTT_CONNECTED_EVENT);
-            esp_rmaker_post_event(RMAKER_EVENT_MQTT_CONNECTED, NULL, 0);
-            break;
-        case MQTT_EVENT_DISCONNECTED:
-            ESP_LOGW(TAG, "MQTT Disconnected. Will try reconnecting in a while...");
-            esp_rmaker_post_event(RMAKER_EVENT_MQTT_DISCONNECTED, NULL, 0);
-            break;
+    return esp_rmaker_mqtt_publish_with_prio(topic, data, data_len, 1, ESP_RMAKER_MQTT_PRIO_STATE);
+}
 
-        case MQTT_EVENT_SUBSCRIBED:
-            ESP_LOGD(TAG, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
-            break;
-        case MQTT_EVENT_UNSUBSCRIBED:
-            ESP_LOGD(TAG, "MQTT_EVENT_UNSUBSCRIBED, msg_id=%d", event->msg_id);
-            break;
-        case MQTT_EVENT_PUBLISHED:
-            ESP_LOGD(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
-            esp_rmaker_post_event(RMAKER_EVENT_MQTT_PUBLISHED,
-                    &event->msg_id, sizeof(event->msg_id));
-            break;
-        case MQTT_EVENT_DATA: {
-            ESP_LOGD(TAG, "MQTT_EVENT_DATA");
-            static esp_rmaker_mqtt_long_data_t *long_data;
-            /* Topic can be NULL, for data longer than the MQTT buffer */
-            if (event->topic) {
-                ESP_LOGD(TAG, "TOPIC=%.*s\r\n", event->topic_len, event->topic);
-            }
-            ESP_LOGD(TAG, "DATA=%.*s\r\n", event->data_len, event->data);
-            if (event->data_len == event->total_data_len) {
-                /* If long_data still exists, it means there was some issue getting the
-                 * long data, and so, it needs to be freed up.
-                 */
-                if (long_data) {
-                    long_data = esp_rmaker_mqtt_free_long_data(long_data);
-                }
-                esp_rmaker_mqtt_subscribe_callback(event->topic, event->topic_len, event->data, event->data_len);
-            } else {
-                long_data = esp_rmaker_mqtt_manage_long_data(long_data, event);
-            }
-            break;
-        }
-        case MQTT_EVENT_ERROR:
-            ESP_LOGE(TAG, "MQTT_EVENT_ERROR");
-            break;
-        default:
-            ESP_LOGD(TAG, "Other event id:%d", event->event_id);
-            break;
+esp_err_t esp_rmaker_mqtt_get_outbox_stats(esp_rmaker_mqtt_outbox_stats_t *stats)
+{
+    if (!mqtt_data || !stats) {
+        return ESP_ERR_INVALID_ARG;
     }
+    xSemaphoreTake(mqtt_data->lock, portMAX_DELAY);
+    esp_rmaker_mqtt_sched_get_stats(stats);
+    xSemaphoreGive(mqtt_data->lock);
     return ESP_OK;
 }
+
+bool esp_rmaker_mqtt_is_connected(void)
+{
+    return mqtt_data && mqtt_data->connected;
+}
+
+#ifdef CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE
+/* Move the messages queued by the scheduler to the offline queue, on a disconnection */
+static void esp_rmaker_mqtt_sched_flush(esp_rmaker_mqtt_sched_msg_t *msg, void *priv)
+{
+    if (msg->qos > 0) {
+        esp_rmaker_mqtt_queue_add(msg->topic, msg->data, msg->data_len);
+    }
+}
+#endif /* CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE */
+
+static void esp_rmaker_mqtt_set_connected(bool connected)
+{
+    xSemaphoreTake(mqtt_data->lock, portMAX_DELAY);
+#ifdef CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE
+    /* The messages queued while disconnected get published before any new messages, which are queued
+     * behind them till then. See esp_rmaker_mqtt_replay_queued().
+     */
+    if (connected) {
+        mqtt_data->replay_pending = true;
+    } else {
+        esp_rmaker_mqtt_sched_reset(esp_rmaker_mqtt_sched_flush, NULL);
+    }
+#else
+    if (!connected) {
+        esp_rmaker_mqtt_sched_reset(NULL, NULL);
+    }
+#endif /* !CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE */
+    mqtt_data->connected = connected;
+    xSemaphoreGive(mqtt_data->lock);
+}
+
+static void esp_rmaker_mqtt_resubscribe(const char *topic, void *priv)
+{
+    mqtt_data->transport->subscribe(mqtt_data->transport_handle, topic, 1);
+}
+
+void esp_rmaker_mqtt_transport_on_connected(void)
+{
+    ESP_LOGI(TAG, "MQTT Connected");
+    /* Resubscribe to all topics after reconnection */
+    esp_rmaker_mqtt_router_foreach(mqtt_data->router, esp_rmaker_mqtt_resubscribe, NULL);
+    esp_rmaker_mqtt_set_connected(true);
+#ifdef CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE
+    esp_rmaker_mqtt_replay_queued();
+#endif /* CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE */
+    esp_rmaker_mqtt_sched_drain();
+    xEventGroupSetBits(mqtt_event_group, MQTT_CONNECTED_EVENT);
+    esp_rmaker_post_event(RMAKER_EVENT_MQTT_CONNECTED, NULL, 0);
+}
+
+void esp_rmaker_mqtt_transport_on_disconnected(void)
+{
+    ESP_LOGW(TAG, "MQTT Disconnected. Will try reconnecting in a while...");
+    esp_rmaker_mqtt_set_connected(false);
+    esp_rmaker_mqtt_reassembly_reset();
+    esp_rmaker_post_event(RMAKER_EVENT_MQTT_DISCONNECTED, NULL, 0);
+}
+
+void esp_rmaker_mqtt_transport_on_published(int msg_id)
+{
+    xSemaphoreTake(mqtt_data->lock, portMAX_DELAY);
+    esp_rmaker_mqtt_sched_published(msg_id);
+    xSemaphoreGive(mqtt_data->lock);
+#ifdef CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE
+    esp_rmaker_mqtt_replay_queued();
+#endif /* CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE */
+    esp_rmaker_mqtt_sched_drain();
+    esp_rmaker_post_event(RMAKER_EVENT_MQTT_PUBLISHED, &msg_id, sizeof(msg_id));
+}
+
+void esp_rmaker_mqtt_transport_on_data(int msg_id, const char *topic, size_t topic_len,
+        const char *data, size_t data_len, size_t offset, size_t total_len)
+{
+    esp_rmaker_mqtt_reassembly_handle_data(mqtt_data->router, msg_id, topic, topic_len,
+            data, data_len, offset, total_len);
+}
+
 esp_err_t esp_rmaker_mqtt_connect(void)
 {
     if (!mqtt_data) {
@@ -264,9 +376,9 @@ esp_err_t esp_rmaker_mqtt_connect(void)
     }
     ESP_LOGI(TAG, "Connecting to %s", mqtt_data->config->mqtt_host);
     mqtt_event_group = xEventGroupCreate();
-    esp_err_t ret = esp_mqtt_client_start(mqtt_data->mqtt_client);
+    esp_err_t ret = mqtt_data->transport->connect(mqtt_data->transport_handle);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "esp_mqtt_client_start() failed with err = %d", ret);
+        ESP_LOGE(TAG, "Failed to start %s transport. Error %d", mqtt_data->transport->name, ret);
         return ret;
     }
     ESP_LOGI(TAG, "Waiting for MQTT connection. This may take time.");
@@ -274,17 +386,20 @@ esp_err_t esp_rmaker_mqtt_connect(void)
     return ESP_OK;
 }
 
+static void esp_rmaker_mqtt_client_unsubscribe(const char *topic, void *priv)
+{
+    if (mqtt_data->transport->unsubscribe(mqtt_data->transport_handle, topic) < 0) {
+        ESP_LOGW(TAG, "Could not unsubscribe from topic: %s", topic);
+    }
+}
+
 static void esp_rmaker_mqtt_unsubscribe_all()
 {
     if (!mqtt_data) {
         return;
     }
-    int i;
-    for (i = 0; i < MAX_MQTT_SUBSCRIPTIONS; i++) {
-        if (mqtt_data->subscriptions[i]) {
-            esp_rmaker_mqtt_unsubscribe(mqtt_data->subscriptions[i]->topic);
-        }
-    }
+    esp_rmaker_mqtt_router_foreach(mqtt_data->router, esp_rmaker_mqtt_client_unsubscribe, NULL);
+    esp_rmaker_mqtt_router_clear(mqtt_data->router);
 }
 
 esp_err_t esp_rmaker_mqtt_disconnect(void)
@@ -293,7 +408,8 @@ esp_err_t esp_rmaker_mqtt_disconnect(void)
         return ESP_FAIL;
     }
     esp_rmaker_mqtt_unsubscribe_all();
-    esp_err_t err = esp_mqtt_client_stop(mqtt_data->mqtt_client);
+    esp_err_t err = mqtt_data->transport->disconnect(mqtt_data->transport_handle);
+    esp_rmaker_mqtt_set_connected(false);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to disconnect from MQTT");
     } else {
@@ -301,9 +417,20 @@ esp_err_t esp_rmaker_mqtt_disconnect(void)
     }
     return err;
 }
-#ifdef ESP_RMAKER_MQTT_USE_PORT_443
-static const char *alpn_protocols[] = { "x-amzn-mqtt-ca", NULL };
-#endif /* ESP_RMAKER_MQTT_USE_PORT_443 */
+esp_err_t esp_rmaker_mqtt_set_transport(const esp_rmaker_mqtt_transport_t *transport)
+{
+    if (mqtt_data) {
+        ESP_LOGE(TAG, "MQTT transport cannot be changed after initialisation.");
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!transport || !transport->init || !transport->connect || !transport->disconnect ||
+            !transport->publish || !transport->subscribe || !transport->unsubscribe) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    mqtt_transport = transport;
+    return ESP_OK;
+}
+
 esp_err_t esp_rmaker_mqtt_init(esp_rmaker_mqtt_config_t *config)
 {
     if (mqtt_data) {
@@ -311,30 +438,51 @@ esp_err_t esp_rmaker_mqtt_init(esp_rmaker_mqtt_config_t *config)
         return ESP_OK;
     }
     ESP_LOGI(TAG, "Initialising MQTT");
-    mqtt_data = calloc(1, sizeof(esp_rmaker_mqtt_data_t));
+    mqtt_data = esp_rmaker_mem_calloc(ESP_RMAKER_MEM_MQTT, 1, sizeof(esp_rmaker_mqtt_data_t));
     if (!mqtt_data) {
         return ESP_FAIL;
     }
     mqtt_data->config = config;
-    const esp_mqtt_client_config_t mqtt_client_cfg = {
-        .host = config->mqtt_host,
-#ifdef ESP_RMAKER_MQTT_USE_PORT_443
-        .port = 443,
-        .alpn_protos = alpn_protocols,
-#else
-        .port = 8883,
-#endif /* !ESP_RMAKER_MQTT_USE_PORT_443 */
-        .cert_pem = (const char *)config->server_cert,
-        .client_cert_pem = (const char *)config->client_cert,
-        .client_key_pem = (const char *)config->client_key,
-        .client_id = (const char *)config->client_id,
-        .keepalive = 120,
-        .event_handle = mqtt_event_handler,
-        .transport = MQTT_TRANSPORT_OVER_SSL,
-#ifdef CONFIG_RMAKER_MQTT_PERSISTENT_SESSION
-        .disable_clean_session = 1,
-#endif /* CONFIG_RMAKER_MQTT_PERSISTENT_SESSION */
+    mqtt_data->router = esp_rmaker_mqtt_router_create();
+    if (!mqtt_data->router) {
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, mqtt_data);
+        mqtt_data = NULL;
+        return ESP_FAIL;
+    }
+    mqtt_data->lock = xSemaphoreCreateMutex();
+    if (!mqtt_data->lock) {
+        esp_rmaker_mqtt_router_delete(mqtt_data->router);
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, mqtt_data);
+        mqtt_data = NULL;
+        return ESP_FAIL;
+    }
+#ifdef CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE
+    esp_rmaker_mqtt_queue_init();
+    esp_timer_create_args_t replay_timer_conf = {
+        .callback = esp_rmaker_mqtt_replay_timer_cb,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "rmaker_mqtt_replay"
     };
-    mqtt_data->mqtt_client = esp_mqtt_client_init(&mqtt_client_cfg);
+    if (esp_timer_create(&replay_timer_conf, &mqtt_data->replay_timer) != ESP_OK) {
+        /* Publishing the queued messages will still be retried on acknowledgements and reconnections */
+        ESP_LOGW(TAG, "Failed to create MQTT replay timer.");
+        mqtt_data->replay_timer = NULL;
+    }
+#endif /* CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE */
+    mqtt_data->transport = mqtt_transport;
+    mqtt_data->transport_handle = mqtt_transport->init(config);
+    if (!mqtt_data->transport_handle) {
+        ESP_LOGE(TAG, "Failed to initialise %s transport.", mqtt_transport->name);
+#ifdef CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE
+        if (mqtt_data->replay_timer) {
+            esp_timer_delete(mqtt_data->replay_timer);
+        }
+#endif /* CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE */
+        vSemaphoreDelete(mqtt_data->lock);
+        esp_rmaker_mqtt_router_delete(mqtt_data->router);
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, mqtt_data);
+        mqtt_data = NULL;
+        return ESP_FAIL;
+    }
     return ESP_OK;
 }
@@ -0,0 +1,137 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <sdkconfig.h>
+#include <esp_log.h>
+#include <mqtt_client.h>
+#include <esp_rmaker_mqtt_transport.h>
+
+#include <esp_idf_version.h>
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 1, 0)
+// Features supported in 4.1
+
+#ifdef CONFIG_ESP_RMAKER_MQTT_PORT_443
+#define ESP_RMAKER_MQTT_USE_PORT_443
+#endif
+
+#else
+
+#ifdef CONFIG_ESP_RMAKER_MQTT_PORT_443
+#warning "Port 443 not supported in idf versions below 4.1. Using 8883 instead."
+#endif
+
+#endif /* !IDF4.1 */
+
+static const char *TAG = "esp_rmaker_mqtt_esp_mqtt";
+
+static esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event)
+{
+    switch (event->event_id) {
+        case MQTT_EVENT_CONNECTED:
+            esp_rmaker_mqtt_transport_on_connected();
+            break;
+        case MQTT_EVENT_DISCONNECTED:
+            esp_rmaker_mqtt_transport_on_disconnected();
+            break;
+        case MQTT_EVENT_SUBSCRIBED:
+            ESP_LOGD(TAG, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
+            break;
+        case MQTT_EVENT_UNSUBSCRIBED:
+            ESP_LOGD(TAG, "MQTT_EVENT_UNSUBSCRIBED, msg_id=%d", event->msg_id);
+            break;
+        case MQTT_EVENT_PUBLISHED:
+            ESP_LOGD(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+            esp_rmaker_mqtt_transport_on_published(event->msg_id);
+            break;
+        case MQTT_EVENT_DATA:
+            ESP_LOGD(TAG, "MQTT_EVENT_DATA");
+            /* Topic can be NULL, for data longer than the MQTT buffer */
+            if (event->topic) {
+                ESP_LOGD(TAG, "TOPIC=%.*s\r\n", event->topic_len, event->topic);
+            }
+            ESP_LOGD(TAG, "DATA=%.*s\r\n", event->data_len, event->data);
+            esp_rmaker_mqtt_transport_on_data(event->msg_id, event->topic, event->topic_len,
+                    event->data, event->data_len, event->current_data_offset, event->total_data_len);
+            break;
+        case MQTT_EVENT_ERROR:
+            ESP_LOGE(TAG, "MQTT_EVENT_ERROR");
+            break;
+        default:
+            ESP_LOGD(TAG, "Other event id:%d", event->event_id);
+            break;
+    }
+    return ESP_OK;
+}
+
+#ifdef ESP_RMAKER_MQTT_USE_PORT_443
+static const char *alpn_protocols[] = { "x-amzn-mqtt-ca", NULL };
+#endif /* ESP_RMAKER_MQTT_USE_PORT_443 */
+static void *esp_rmaker_mqtt_esp_mqtt_init(esp_rmaker_mqtt_config_t *config)
+{
+    const esp_mqtt_client_config_t mqtt_client_cfg = {
+        .host = config->mqtt_host,
+#ifdef ESP_RMAKER_MQTT_USE_PORT_443
+        .port = 443,
+        .alpn_protos = alpn_protocols,
+#else
+        .port = 8883,
+#endif /* !ESP_RMAKER_MQTT_USE_PORT_443 */
+        .cert_pem = (const char *)config->server_cert,
+        .client_cert_pem = (const char *)config->client_cert,
+        .client_key_pem = (const char *)config->client_key,
+        .client_id = (const char *)config->client_id,
+        .keepalive = 120,
+        .event_handle = mqtt_event_handler,
+        .transport = MQTT_TRANSPORT_OVER_SSL,
+#ifdef CONFIG_RMAKER_MQTT_PERSISTENT_SESSION
+        .disable_clean_session = 1,
+#endif /* CONFIG_RMAKER_MQTT_PERSISTENT_SESSION */
+    };
+    return esp_mqtt_client_init(&mqtt_client_cfg);
+}
+
+static esp_err_t esp_rmaker_mqtt_esp_mqtt_connect(void *handle)
+{
+    return esp_mqtt_client_start((esp_mqtt_client_handle_t)handle);
+}
+
+static esp_err_t esp_rmaker_mqtt_esp_mqtt_disconnect(void *handle)
+{
+    return esp_mqtt_client_stop((esp_mqtt_client_handle_t)handle);
+}
+
+static int esp_rmaker_mqtt_esp_mqtt_publish(void *handle, const char *topic, const void *data, size_t data_len,
+        int qos)
+{
+    return esp_mqtt_client_publish((esp_mqtt_client_handle_t)handle, topic, data, data_len, qos, 0);
+}
+
+static int esp_rmaker_mqtt_esp_mqtt_subscribe(void *handle, const char *topic, int qos)
+{
+    return esp_mqtt_client_subscribe((esp_mqtt_client_handle_t)handle, topic, qos);
+}
+
+static int esp_rmaker_mqtt_esp_mqtt_unsubscribe(void *handle, const char *topic)
+{
+    return esp_mqtt_client_unsubscribe((esp_mqtt_client_handle_t)handle, topic);
+}
+
+const esp_rmaker_mqtt_transport_t esp_rmaker_mqtt_esp_mqtt_transport = {
+    .name = "esp-mqtt",
+    .init = esp_rmaker_mqtt_esp_mqtt_init,
+    .connect = esp_rmaker_mqtt_esp_mqtt_connect,
+    .disconnect = esp_rmaker_mqtt_esp_mqtt_disconnect,
+    .publish = esp_rmaker_mqtt_esp_mqtt_publish,
+    .subscribe = esp_rmaker_mqtt_esp_mqtt_subscribe,
+    .unsubscribe = esp_rmaker_mqtt_esp_mqtt_unsubscribe,
+};
@@ -0,0 +1,340 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <esp_log.h>
+#include <esp_rmaker_mqtt_loopback.h>
+
+#include "esp_rmaker_mqtt_router.h"
+#include "esp_rmaker_mem.h"
+
+static const char *TAG = "esp_rmaker_mqtt_loopback";
+
+typedef enum {
+    LOOPBACK_EVENT_DATA,
+    LOOPBACK_EVENT_PUBLISHED,
+} esp_rmaker_mqtt_loopback_event_type_t;
+
+/* A pending event. For data events, the topic (NULL terminated) and data are held
+ * in the same allocation.
+ */
+typedef struct esp_rmaker_mqtt_loopback_event {
+    struct esp_rmaker_mqtt_loopback_event *next;
+    esp_rmaker_mqtt_loopback_event_type_t type;
+    int msg_id;
+    char *topic;
+    size_t data_len;
+    char data[0];
+} esp_rmaker_mqtt_loopback_event_t;
+
+typedef struct {
+    /* Holds the topic filters subscribed to by the node */
+    esp_rmaker_mqtt_router_t *subscriptions;
+    SemaphoreHandle_t lock;
+    bool connected;
+    int next_msg_id;
+    esp_rmaker_mqtt_loopback_event_t *events_head;
+    esp_rmaker_mqtt_loopback_event_t *events_tail;
+    esp_rmaker_mqtt_loopback_publish_cb_t publish_cb;
+    void *publish_cb_priv;
+    size_t fragment_size;
+} esp_rmaker_mqtt_loopback_t;
+
+static esp_rmaker_mqtt_loopback_t *loopback;
+
+static int esp_rmaker_mqtt_loopback_get_msg_id(void)
+{
+    int msg_id = loopback->next_msg_id++;
+    if (loopback->next_msg_id <= 0) {
+        loopback->next_msg_id = 1;
+    }
+    return msg_id;
+}
+
+/* Should be called with the lock held */
+static esp_err_t esp_rmaker_mqtt_loopback_add_event(esp_rmaker_mqtt_loopback_event_type_t type, int msg_id,
+        const char *topic, const void *data, size_t data_len)
+{
+    size_t topic_len = topic ? strlen(topic) : 0;
+    esp_rmaker_mqtt_loopback_event_t *event = esp_rmaker_mem_calloc(ESP_RMAKER_MEM_MQTT,
+            1, sizeof(esp_rmaker_mqtt_loopback_event_t) + data_len + topic_len + 1);
+    if (!event) {
+        ESP_LOGE(TAG, "Failed to allocate memory for event.");
+        return ESP_ERR_NO_MEM;
+    }
+    event->type = type;
+    event->msg_id = msg_id;
+    if (data_len) {
+        memcpy(event->data, data, data_len);
+    }
+    event->data_len = data_len;
+    event->topic = event->data + data_len;
+    if (topic_len) {
+        memcpy(event->topic, topic, topic_len);
+    }
+    if (loopback->events_tail) {
+        loopback->events_tail->next = event;
+    } else {
+        loopback->events_head = event;
+    }
+    loopback->events_tail = event;
+    return ESP_OK;
+}
+
+/* Should be called with the lock held */
+static void esp_rmaker_mqtt_loopback_clear_events(void)
+{
+    while (loopback->events_head) {
+        esp_rmaker_mqtt_loopback_event_t *event = loopback->events_head;
+        loopback->events_head = event->next;
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, event);
+    }
+    loopback->events_tail = NULL;
+}
+
+static bool esp_rmaker_mqtt_loopback_is_subscribed(const char *topic)
+{
+    return esp_rmaker_mqtt_router_count(loopback->subscriptions, topic, strlen(topic), false) > 0;
+}
+
+/* Subscriptions are held in a router, just for matching the topics. This never gets invoked. */
+static void esp_rmaker_mqtt_loopback_subscription_cb(const char *topic, void *payload, size_t payload_len,
+        void *priv_data)
+{
+}
+
+static void *esp_rmaker_mqtt_loopback_init(esp_rmaker_mqtt_config_t *config)
+{
+    if (loopback) {
+        return loopback;
+    }
+    loopback = esp_rmaker_mem_calloc(ESP_RMAKER_MEM_MQTT, 1, sizeof(esp_rmaker_mqtt_loopback_t));
+    if (!loopback) {
+        return NULL;
+    }
+    loopback->subscriptions = esp_rmaker_mqtt_router_create();
+    loopback->lock = xSemaphoreCreateMutex();
+    if (!loopback->subscriptions || !loopback->lock) {
+        if (loopback->subscriptions) {
+            esp_rmaker_mqtt_router_delete(loopback->subscriptions);
+        }
+        if (loopback->lock) {
+            vSemaphoreDelete(loopback->lock);
+        }
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, loopback);
+        loopback = NULL;
+        return NULL;
+    }
+    loopback->next_msg_id = 1;
+    return loopback;
+}
+
+static esp_err_t esp_rmaker_mqtt_loopback_connect(void *handle)
+{
+    return esp_rmaker_mqtt_loopback_restore_connection();
+}
+
+static esp_err_t esp_rmaker_mqtt_loopback_disconnect(void *handle)
+{
+    xSemaphoreTake(loopback->lock, portMAX_DELAY);
+    loopback->connected = false;
+    esp_rmaker_mqtt_loopback_clear_events();
+    xSemaphoreGive(loopback->lock);
+    return ESP_OK;
+}
+
+static int esp_rmaker_mqtt_loopback_publish(void *handle, const char *topic, const void *data, size_t data_len,
+        int qos)
+{
+    xSemaphoreTake(loopback->lock, portMAX_DELAY);
+    if (!loopback->connected) {
+        xSemaphoreGive(loopback->lock);
+        return -1;
+    }
+    int msg_id = (qos > 0) ? esp_rmaker_mqtt_loopback_get_msg_id() : 0;
+    esp_rmaker_mqtt_loopback_publish_cb_t publish_cb = loopback->publish_cb;
+    void *publish_cb_priv = loopback->publish_cb_priv;
+    /* Like a real broker, deliver the message back to the node, if it has subscribed to the topic */
+    if (esp_rmaker_mqtt_loopback_is_subscribed(topic)) {
+        esp_rmaker_mqtt_loopback_add_event(LOOPBACK_EVENT_DATA, esp_rmaker_mqtt_loopback_get_msg_id(),
+                topic, data, data_len);
+    }
+    if (msg_id > 0) {
+        esp_rmaker_mqtt_loopback_add_event(LOOPBACK_EVENT_PUBLISHED, msg_id, NULL, NULL, 0);
+    }
+    xSemaphoreGive(loopback->lock);
+    if (publish_cb) {
+        publish_cb(topic, data, data_len, qos, publish_cb_priv);
+    }
+    return msg_id;
+}
+
+static int esp_rmaker_mqtt_loopback_subscribe(void *handle, const char *topic, int qos)
+{
+    xSemaphoreTake(loopback->lock, portMAX_DELAY);
+    /* Subscribing again to the same filter just replaces the earlier subscription */
+    esp_rmaker_mqtt_router_remove(loopback->subscriptions, topic);
+    int msg_id = -1;
+    if (esp_rmaker_mqtt_router_add(loopback->subscriptions, topic,
+                esp_rmaker_mqtt_loopback_subscription_cb, NULL) == ESP_OK) {
+        msg_id = esp_rmaker_mqtt_loopback_get_msg_id();
+    }
+    xSemaphoreGive(loopback->lock);
+    return msg_id;
+}
+
+static int esp_rmaker_mqtt_loopback_unsubscribe(void *handle, const char *topic)
+{
+    xSemaphoreTake(loopback->lock, portMAX_DELAY);
+    int msg_id = -1;
+    if (esp_rmaker_mqtt_router_remove(loopback->subscriptions, topic) == ESP_OK) {
+        msg_id = esp_rmaker_mqtt_loopback_get_msg_id();
+    }
+    xSemaphoreGive(loopback->lock);
+    return msg_id;
+}
+
+const esp_rmaker_mqtt_transport_t esp_rmaker_mqtt_loopback_transport = {
+    .name = "loopback",
+    .init = esp_rmaker_mqtt_loopback_init,
+    .connect = esp_rmaker_mqtt_loopback_connect,
+    .disconnect = esp_rmaker_mqtt_loopback_disconnect,
+    .publish = esp_rmaker_mqtt_loopback_publish,
+    .subscribe = esp_rmaker_mqtt_loopback_subscribe,
+    .unsubscribe = esp_rmaker_mqtt_loopback_unsubscribe,
+};
+
+esp_err_t esp_rmaker_mqtt_loopback_set_publish_cb(esp_rmaker_mqtt_loopback_publish_cb_t cb, void *priv_data)
+{
+    if (!loopback) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(loopback->lock, portMAX_DELAY);
+    loopback->publish_cb = cb;
+    loopback->publish_cb_priv = priv_data;
+    xSemaphoreGive(loopback->lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_mqtt_loopback_inject(const char *topic, const void *data, size_t data_len)
+{
+    if (!topic || (!data && data_len)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!loopback) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err;
+    xSemaphoreTake(loopback->lock, portMAX_DELAY);
+    if (!loopback->connected) {
+        err = ESP_ERR_INVALID_STATE;
+    } else if (!esp_rmaker_mqtt_loopback_is_subscribed(topic)) {
+        err = ESP_ERR_NOT_FOUND;
+    } else {
+        err = esp_rmaker_mqtt_loopback_add_event(LOOPBACK_EVENT_DATA, esp_rmaker_mqtt_loopback_get_msg_id(),
+                topic, data, data_len);
+    }
+    xSemaphoreGive(loopback->lock);
+    return err;
+}
+
+esp_err_t esp_rmaker_mqtt_loopback_set_fragment_size(size_t fragment_size)
+{
+    if (!loopback) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    loopback->fragment_size = fragment_size;
+    return ESP_OK;
+}
+
+static void esp_rmaker_mqtt_loopback_deliver_data(esp_rmaker_mqtt_loopback_event_t *event)
+{
+    size_t topic_len = strlen(event->topic);
+    size_t fragment_size = loopback->fragment_size ? loopback->fragment_size : event->data_len;
+    size_t offset = 0;
+    /* Like the ESP-MQTT client, pass the topic only with the first fragment */
+    do {
+        size_t len = event->data_len - offset;
+        if (len > fragment_size) {
+            len = fragment_size;
+        }
+        esp_rmaker_mqtt_transport_on_data(event->msg_id, offset ? NULL : event->topic, offset ? 0 : topic_len,
+                event->data + offset, len, offset, event->data_len);
+        offset += len;
+    } while (offset < event->data_len);
+}
+
+int esp_rmaker_mqtt_loopback_process(void)
+{
+    if (!loopback) {
+        return 0;
+    }
+    int count = 0;
+    while (1) {
+        xSemaphoreTake(loopback->lock, portMAX_DELAY);
+        esp_rmaker_mqtt_loopback_event_t *event = loopback->events_head;
+        if (event) {
+            loopback->events_head = event->next;
+            if (!loopback->events_head) {
+                loopback->events_tail = NULL;
+            }
+        }
+        xSemaphoreGive(loopback->lock);
+        if (!event) {
+            break;
+        }
+        if (event->type == LOOPBACK_EVENT_DATA) {
+            esp_rmaker_mqtt_loopback_deliver_data(event);
+        } else {
+            esp_rmaker_mqtt_transport_on_published(event->msg_id);
+        }
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, event);
+        count++;
+    }
+    return count;
+}
+
+esp_err_t esp_rmaker_mqtt_loopback_drop_connection(void)
+{
+    if (!loopback) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(loopback->lock, portMAX_DELAY);
+    bool was_connected = loopback->connected;
+    loopback->connected = false;
+    esp_rmaker_mqtt_loopback_clear_events();
+    xSemaphoreGive(loopback->lock);
+    if (was_connected) {
+        esp_rmaker_mqtt_transport_on_disconnected();
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_mqtt_loopback_restore_connection(void)
+{
+    if (!loopback) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(loopback->lock, portMAX_DELAY);
+    bool was_connected = loopback->connected;
+    loopback->connected = true;
+    xSemaphoreGive(loopback->lock);
+    if (!was_connected) {
+        esp_rmaker_mqtt_transport_on_connected();
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,305 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sdkconfig.h>
+#include <esp_log.h>
+#ifdef CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE_PERSIST
+#include <nvs.h>
+#endif /* CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE_PERSIST */
+
+#include "esp_rmaker_mqtt_queue.h"
+#include "esp_rmaker_mem.h"
+
+static const char *TAG = "esp_rmaker_mqtt_queue";
+
+#define QUEUE_MAX_MSGS      CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE_LEN
+#define QUEUE_MAX_BYTES     CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE_SIZE
+
+/* A queued message. The topic and data are held in a single allocation, as
+ * the NULL terminated topic, followed by the data.
+ */
+typedef struct {
+    char *msg;
+    size_t msg_len;
+} esp_rmaker_mqtt_queued_msg_t;
+
+static esp_rmaker_mqtt_queued_msg_t ram_queue[QUEUE_MAX_MSGS];
+static int ram_queue_head;
+static int ram_queue_count;
+static size_t ram_queue_bytes;
+
+#ifdef CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE_PERSIST
+#define ESP_RMAKER_NVS_PART_NAME        "nvs"
+#define ESP_RMAKER_NVS_QUEUE_NAMESPACE  "rmaker_mqttq"
+#define NVS_QUEUE_MAX_MSGS              CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE_PERSIST_LEN
+#define NVS_QUEUE_HEAD_KEY              "head"
+#define NVS_QUEUE_TAIL_KEY              "tail"
+
+/* Sequence numbers of the oldest message in NVS, and of the next message to be written.
+ * The message with sequence number n is stored with the key "m<n % NVS_QUEUE_MAX_MSGS>".
+ */
+static uint32_t nvs_queue_head;
+static uint32_t nvs_queue_tail;
+
+static void esp_rmaker_mqtt_queue_nvs_key(uint32_t seq, char *key, size_t key_size)
+{
+    snprintf(key, key_size, "m%u", (unsigned int)(seq % NVS_QUEUE_MAX_MSGS));
+}
+
+static esp_err_t esp_rmaker_mqtt_queue_nvs_save_state(nvs_handle handle)
+{
+    esp_err_t err = nvs_set_u32(handle, NVS_QUEUE_HEAD_KEY, nvs_queue_head);
+    if (err == ESP_OK) {
+        err = nvs_set_u32(handle, NVS_QUEUE_TAIL_KEY, nvs_queue_tail);
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    return err;
+}
+
+static esp_err_t esp_rmaker_mqtt_queue_nvs_add(esp_rmaker_mqtt_queued_msg_t *queued_msg)
+{
+    nvs_handle handle;
+    esp_err_t err = nvs_open_from_partition(ESP_RMAKER_NVS_PART_NAME, ESP_RMAKER_NVS_QUEUE_NAMESPACE,
+            NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if ((nvs_queue_tail - nvs_queue_head) >= NVS_QUEUE_MAX_MSGS) {
+        ESP_LOGW(TAG, "Offline queue full. Dropping oldest message.");
+        nvs_queue_head++;
+    }
+    char key[16];
+    esp_rmaker_mqtt_queue_nvs_key(nvs_queue_tail, key, sizeof(key));
+    err = nvs_set_blob(handle, key, queued_msg->msg, queued_msg->msg_len);
+    if (err == ESP_OK) {
+        nvs_queue_tail++;
+        err = esp_rmaker_mqtt_queue_nvs_save_state(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+
+static esp_err_t esp_rmaker_mqtt_queue_nvs_take(esp_rmaker_mqtt_queued_msg_t *queued_msg)
+{
+    if (nvs_queue_head == nvs_queue_tail) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    nvs_handle handle;
+    esp_err_t err = nvs_open_from_partition(ESP_RMAKER_NVS_PART_NAME, ESP_RMAKER_NVS_QUEUE_NAMESPACE,
+            NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = ESP_ERR_NOT_FOUND;
+    while (nvs_queue_head != nvs_queue_tail) {
+        char key[16];
+        esp_rmaker_mqtt_queue_nvs_key(nvs_queue_head, key, sizeof(key));
+        size_t msg_len = 0;
+        char *msg = NULL;
+        err = nvs_get_blob(handle, key, NULL, &msg_len);
+        if (err == ESP_OK) {
+            msg = esp_rmaker_mem_malloc(ESP_RMAKER_MEM_MQTT, msg_len);
+            err = msg ? nvs_get_blob(handle, key, msg, &msg_len) : ESP_ERR_NO_MEM;
+        }
+        if (err == ESP_ERR_NO_MEM) {
+            /* Leave it in NVS, to be tried again later */
+            break;
+        }
+        nvs_erase_key(handle, key);
+        nvs_queue_head++;
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to read message %s from NVS. Dropping it.", key);
+        } else if (strnlen(msg, msg_len) < msg_len) {
+            queued_msg->msg = msg;
+            queued_msg->msg_len = msg_len;
+            break;
+        } else {
+            ESP_LOGE(TAG, "Invalid message %s in NVS. Dropping it.", key);
+        }
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, msg);
+        err = ESP_ERR_NOT_FOUND;
+    }
+    esp_rmaker_mqtt_queue_nvs_save_state(handle);
+    nvs_close(handle);
+    return err;
+}
+
+/* Add the message to NVS, ahead of all the others there */
+static esp_err_t esp_rmaker_mqtt_queue_nvs_putback(esp_rmaker_mqtt_queued_msg_t *queued_msg)
+{
+    if ((nvs_queue_tail - nvs_queue_head) >= NVS_QUEUE_MAX_MSGS) {
+        return ESP_ERR_NO_MEM;
+    }
+    nvs_handle handle;
+    esp_err_t err = nvs_open_from_partition(ESP_RMAKER_NVS_PART_NAME, ESP_RMAKER_NVS_QUEUE_NAMESPACE,
+            NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (nvs_queue_head == 0) {
+        /* Shift the sequence numbers, without changing the keys, so that they do not wrap around below */
+        nvs_queue_head += NVS_QUEUE_MAX_MSGS;
+        nvs_queue_tail += NVS_QUEUE_MAX_MSGS;
+    }
+    char key[16];
+    esp_rmaker_mqtt_queue_nvs_key(nvs_queue_head - 1, key, sizeof(key));
+    err = nvs_set_blob(handle, key, queued_msg->msg, queued_msg->msg_len);
+    if (err == ESP_OK) {
+        nvs_queue_head--;
+        err = esp_rmaker_mqtt_queue_nvs_save_state(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+#endif /* CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE_PERSIST */
+
+esp_err_t esp_rmaker_mqtt_queue_init(void)
+{
+#ifdef CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE_PERSIST
+    nvs_handle handle;
+    if (nvs_open_from_partition(ESP_RMAKER_NVS_PART_NAME, ESP_RMAKER_NVS_QUEUE_NAMESPACE,
+                NVS_READONLY, &handle) == ESP_OK) {
+        if ((nvs_get_u32(handle, NVS_QUEUE_HEAD_KEY, &nvs_queue_head) != ESP_OK) ||
+                (nvs_get_u32(handle, NVS_QUEUE_TAIL_KEY, &nvs_queue_tail) != ESP_OK) ||
+                ((nvs_queue_tail - nvs_queue_head) > NVS_QUEUE_MAX_MSGS)) {
+            nvs_queue_head = nvs_queue_tail = 0;
+        }
+        nvs_close(handle);
+    }
+    if (nvs_queue_tail != nvs_queue_head) {
+        ESP_LOGI(TAG, "%u messages pending in NVS.", (unsigned int)(nvs_queue_tail - nvs_queue_head));
+    }
+#endif /* CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE_PERSIST */
+    return ESP_OK;
+}
+
+/* Make room for the oldest message in the RAM queue, by moving it to NVS, or just dropping it */
+static void esp_rmaker_mqtt_queue_evict(void)
+{
+    esp_rmaker_mqtt_queued_msg_t *queued_msg = &ram_queue[ram_queue_head];
+#ifdef CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE_PERSIST
+    if (esp_rmaker_mqtt_queue_nvs_add(queued_msg) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to move message to NVS. Dropping it.");
+    }
+#else
+    ESP_LOGW(TAG, "Offline queue full. Dropping message on %s", queued_msg->msg);
+#endif /* !CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE_PERSIST */
+    esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, queued_msg->msg);
+    ram_queue_bytes -= queued_msg->msg_len;
+    queued_msg->msg = NULL;
+    ram_queue_head = (ram_queue_head + 1) % QUEUE_MAX_MSGS;
+    ram_queue_count--;
+}
+
+esp_err_t esp_rmaker_mqtt_queue_add(const char *topic, const void *data, size_t data_len)
+{
+    if (!topic || (!data && data_len)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t topic_len = strlen(topic);
+    size_t msg_len = topic_len + 1 + data_len;
+    char *msg = esp_rmaker_mem_malloc(ESP_RMAKER_MEM_MQTT, msg_len);
+    if (!msg) {
+        ESP_LOGE(TAG, "Failed to allocate %d bytes for queueing message.", (int)msg_len);
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(msg, topic, topic_len + 1);
+    if (data_len) {
+        memcpy(msg + topic_len + 1, data, data_len);
+    }
+    /* A message larger than the queue size is held alone, after making room by dropping all the older ones */
+    while (ram_queue_count &&
+            ((ram_queue_count == QUEUE_MAX_MSGS) || ((ram_queue_bytes + msg_len) > QUEUE_MAX_BYTES))) {
+        esp_rmaker_mqtt_queue_evict();
+    }
+    esp_rmaker_mqtt_queued_msg_t *queued_msg = &ram_queue[(ram_queue_head + ram_queue_count) % QUEUE_MAX_MSGS];
+    queued_msg->msg = msg;
+    queued_msg->msg_len = msg_len;
+    ram_queue_count++;
+    ram_queue_bytes += msg_len;
+    ESP_LOGD(TAG, "Queued message on %s. %d messages pending.", topic, ram_queue_count);
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_mqtt_queue_take(char **msg, size_t *msg_len)
+{
+    if (!msg || !msg_len) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_rmaker_mqtt_queued_msg_t queued_msg;
+#ifdef CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE_PERSIST
+    /* The messages in NVS are always older than the ones in RAM */
+    esp_err_t err = esp_rmaker_mqtt_queue_nvs_take(&queued_msg);
+    if (err != ESP_ERR_NOT_FOUND) {
+        if (err == ESP_OK) {
+            *msg = queued_msg.msg;
+            *msg_len = queued_msg.msg_len;
+        }
+        return err;
+    }
+#endif /* CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE_PERSIST */
+    if (!ram_queue_count) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    queued_msg = ram_queue[ram_queue_head];
+    ram_queue[ram_queue_head].msg = NULL;
+    ram_queue_head = (ram_queue_head + 1) % QUEUE_MAX_MSGS;
+    ram_queue_count--;
+    ram_queue_bytes -= queued_msg.msg_len;
+    *msg = queued_msg.msg;
+    *msg_len = queued_msg.msg_len;
+    return ESP_OK;
+}
+
+void esp_rmaker_mqtt_queue_putback(char *msg, size_t msg_len)
+{
+    if (!msg) {
+        return;
+    }
+    esp_rmaker_mqtt_queued_msg_t queued_msg = {
+        .msg = msg,
+        .msg_len = msg_len,
+    };
+    /* Like in esp_rmaker_mqtt_queue_add(), an empty queue can take a message of any size */
+    bool ram_full = ram_queue_count &&
+            ((ram_queue_count == QUEUE_MAX_MSGS) || ((ram_queue_bytes + msg_len) > QUEUE_MAX_BYTES));
+#ifdef CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE_PERSIST
+    /* If messages got moved to NVS since this one was taken out, it has to go to NVS as well, since those
+     * get published before the ones in RAM.
+     */
+    if (ram_full || (nvs_queue_head != nvs_queue_tail)) {
+        if (esp_rmaker_mqtt_queue_nvs_putback(&queued_msg) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to put back message on %s to NVS. Dropping it.", msg);
+        }
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, msg);
+        return;
+    }
+#else
+    if (ram_full) {
+        ESP_LOGW(TAG, "Offline queue full. Dropping message on %s", msg);
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, msg);
+        return;
+    }
+#endif /* !CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE_PERSIST */
+    ram_queue_head = (ram_queue_head + QUEUE_MAX_MSGS - 1) % QUEUE_MAX_MSGS;
+    ram_queue[ram_queue_head] = queued_msg;
+    ram_queue_count++;
+    ram_queue_bytes += msg_len;
+}
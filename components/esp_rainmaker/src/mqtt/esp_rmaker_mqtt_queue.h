@@ -0,0 +1,41 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include <stddef.h>
+#include <esp_err.h>
+
+/* Queue for the messages published while MQTT is disconnected, so that they can be published,
+ * in the same order, once it reconnects. The messages are held in a bounded RAM queue. When that
+ * gets full, the oldest messages are either dropped, or moved to NVS, if
+ * CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE_PERSIST is enabled. The messages in NVS are retained across
+ * reboots as well.
+ *
+ * None of these are thread safe and so, the caller should serialise the calls.
+ */
+
+esp_err_t esp_rmaker_mqtt_queue_init(void);
+
+/* Add a copy of the message to the queue */
+esp_err_t esp_rmaker_mqtt_queue_add(const char *topic, const void *data, size_t data_len);
+
+/* Take out the oldest queued message, so that it can be published without holding the caller's lock.
+ * *msg has the NULL terminated topic, followed by the data. It should be freed once published, or put back
+ * using esp_rmaker_mqtt_queue_putback(). Returns ESP_ERR_NOT_FOUND if the queue is empty.
+ */
+esp_err_t esp_rmaker_mqtt_queue_take(char **msg, size_t *msg_len);
+
+/* Put back a message taken out by esp_rmaker_mqtt_queue_take(), ahead of all the others. The message is
+ * dropped (and freed) if there is no room for it anymore.
+ */
+void esp_rmaker_mqtt_queue_putback(char *msg, size_t msg_len);
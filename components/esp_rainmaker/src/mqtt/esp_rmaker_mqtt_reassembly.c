@@ -0,0 +1,188 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <esp_log.h>
+
+#include "esp_rmaker_mqtt_reassembly.h"
+#include "esp_rmaker_mem.h"
+
+static const char *TAG = "esp_rmaker_mqtt_reassembly";
+
+/* Number of fragmented messages which can be in progress at a time */
+#define REASSEMBLY_SLOTS            2
+#define REASSEMBLY_MAX_TOPIC_LEN    128
+
+/* Size classes of the reassembly buffers. A buffer of each class is retained once allocated,
+ * so that the heap does not get hit (and fragmented) for every long message. Messages longer
+ * than the largest class get a buffer of the exact size, which is freed right after use.
+ */
+static const size_t buf_classes[] = {512, 2048, 8192};
+#define REASSEMBLY_BUF_CLASSES      (sizeof(buf_classes) / sizeof(buf_classes[0]))
+static char *free_bufs[REASSEMBLY_BUF_CLASSES];
+
+typedef struct {
+    bool in_use;
+    int msg_id;
+    char topic[REASSEMBLY_MAX_TOPIC_LEN];
+    size_t topic_len;
+    size_t total_len;
+    size_t received;
+    /* Set if there are regular subscriptions for the message, which need the reassembled data */
+    char *data;
+    int buf_class;
+    /* Set if there are streaming subscriptions for the message */
+    bool stream;
+} esp_rmaker_mqtt_reassembly_slot_t;
+
+static esp_rmaker_mqtt_reassembly_slot_t slots[REASSEMBLY_SLOTS];
+
+static char *esp_rmaker_mqtt_reassembly_buf_get(size_t len, int *buf_class)
+{
+    for (int i = 0; i < REASSEMBLY_BUF_CLASSES; i++) {
+        if (len <= buf_classes[i]) {
+            *buf_class = i;
+            if (free_bufs[i]) {
+                char *buf = free_bufs[i];
+                free_bufs[i] = NULL;
+                return buf;
+            }
+            return esp_rmaker_mem_malloc(ESP_RMAKER_MEM_MQTT, buf_classes[i]);
+        }
+    }
+    *buf_class = -1;
+    return esp_rmaker_mem_malloc(ESP_RMAKER_MEM_MQTT, len);
+}
+
+static void esp_rmaker_mqtt_reassembly_buf_put(char *buf, int buf_class)
+{
+    if ((buf_class >= 0) && !free_bufs[buf_class]) {
+        free_bufs[buf_class] = buf;
+    } else {
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, buf);
+    }
+}
+
+static void esp_rmaker_mqtt_reassembly_slot_release(esp_rmaker_mqtt_reassembly_slot_t *slot)
+{
+    if (slot->data) {
+        esp_rmaker_mqtt_reassembly_buf_put(slot->data, slot->buf_class);
+    }
+    memset(slot, 0, sizeof(esp_rmaker_mqtt_reassembly_slot_t));
+}
+
+static esp_rmaker_mqtt_reassembly_slot_t *esp_rmaker_mqtt_reassembly_slot_find(int msg_id)
+{
+    for (int i = 0; i < REASSEMBLY_SLOTS; i++) {
+        if (slots[i].in_use && (slots[i].msg_id == msg_id)) {
+            return &slots[i];
+        }
+    }
+    return NULL;
+}
+
+static esp_rmaker_mqtt_reassembly_slot_t *esp_rmaker_mqtt_reassembly_slot_get(esp_rmaker_mqtt_router_t *router,
+        int msg_id, const char *topic, size_t topic_len, size_t total_len)
+{
+    esp_rmaker_mqtt_reassembly_slot_t *slot = NULL;
+    for (int i = 0; i < REASSEMBLY_SLOTS; i++) {
+        if (!slots[i].in_use) {
+            slot = &slots[i];
+            break;
+        }
+    }
+    if (!slot) {
+        ESP_LOGE(TAG, "Too many fragmented messages in progress. Dropping message on %.*s",
+                (int)topic_len, topic);
+        return NULL;
+    }
+    if (topic_len >= REASSEMBLY_MAX_TOPIC_LEN) {
+        ESP_LOGE(TAG, "Topic too long for fragmented message. Dropping message on %.*s", (int)topic_len, topic);
+        return NULL;
+    }
+    slot->stream = esp_rmaker_mqtt_router_count(router, topic, topic_len, true) > 0;
+    if (esp_rmaker_mqtt_router_count(router, topic, topic_len, false) > 0) {
+        slot->data = esp_rmaker_mqtt_reassembly_buf_get(total_len, &slot->buf_class);
+        if (!slot->data) {
+            ESP_LOGE(TAG, "Could not allocate %d bytes for received data.", (int)total_len);
+        }
+    }
+    if (!slot->stream && !slot->data) {
+        return NULL;
+    }
+    memcpy(slot->topic, topic, topic_len);
+    slot->topic_len = topic_len;
+    slot->msg_id = msg_id;
+    slot->total_len = total_len;
+    slot->in_use = true;
+    return slot;
+}
+
+void esp_rmaker_mqtt_reassembly_handle_data(esp_rmaker_mqtt_router_t *router, int msg_id,
+        const char *topic, size_t topic_len, const char *data, size_t data_len, size_t offset, size_t total_len)
+{
+    esp_rmaker_mqtt_reassembly_slot_t *slot = esp_rmaker_mqtt_reassembly_slot_find(msg_id);
+    /* The first fragment (or the complete message) has the topic */
+    if (topic) {
+        /* If a slot still exists for this message id, it means there was some issue getting the
+         * earlier message, and so, it needs to be freed up.
+         */
+        if (slot) {
+            ESP_LOGW(TAG, "Dropping incomplete message on %.*s", (int)slot->topic_len, slot->topic);
+            esp_rmaker_mqtt_reassembly_slot_release(slot);
+        }
+        if ((offset == 0) && (data_len == total_len)) {
+            esp_rmaker_mqtt_router_dispatch_stream(router, topic, topic_len, (void *)data, data_len, 0, total_len);
+            esp_rmaker_mqtt_router_dispatch(router, topic, topic_len, (void *)data, data_len);
+            return;
+        }
+        slot = esp_rmaker_mqtt_reassembly_slot_get(router, msg_id, topic, topic_len, total_len);
+        if (!slot) {
+            return;
+        }
+    } else if (!slot) {
+        ESP_LOGD(TAG, "Ignoring fragment of message id %d", msg_id);
+        return;
+    }
+    if ((offset != slot->received) || (data_len > slot->total_len - slot->received)) {
+        ESP_LOGE(TAG, "Unexpected fragment at offset %d. Dropping message on %.*s", (int)offset,
+                (int)slot->topic_len, slot->topic);
+        esp_rmaker_mqtt_reassembly_slot_release(slot);
+        return;
+    }
+    if (slot->stream) {
+        esp_rmaker_mqtt_router_dispatch_stream(router, slot->topic, slot->topic_len, (void *)data, data_len,
+                offset, slot->total_len);
+    }
+    if (slot->data) {
+        memcpy(slot->data + offset, data, data_len);
+    }
+    slot->received += data_len;
+    if (slot->received == slot->total_len) {
+        if (slot->data) {
+            esp_rmaker_mqtt_router_dispatch(router, slot->topic, slot->topic_len, slot->data, slot->total_len);
+        }
+        esp_rmaker_mqtt_reassembly_slot_release(slot);
+    }
+}
+
+void esp_rmaker_mqtt_reassembly_reset(void)
+{
+    for (int i = 0; i < REASSEMBLY_SLOTS; i++) {
+        if (slots[i].in_use) {
+            esp_rmaker_mqtt_reassembly_slot_release(&slots[i]);
+        }
+    }
+}
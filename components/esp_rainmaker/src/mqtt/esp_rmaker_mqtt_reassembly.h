@@ -0,0 +1,29 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include <stddef.h>
+#include "esp_rmaker_mqtt_router.h"
+
+/* Handle the data received for a message, which may be the complete message, or a fragment of it.
+ * The fragments are passed on to the streaming subscriptions as they arrive, and reassembled for the
+ * regular ones, using buffers from a pool. The fragments of a message are identified by the message id.
+ * topic is required only for the first fragment.
+ *
+ * This should always be called from the same task (typically, the MQTT client's task).
+ */
+void esp_rmaker_mqtt_reassembly_handle_data(esp_rmaker_mqtt_router_t *router, int msg_id,
+        const char *topic, size_t topic_len, const char *data, size_t data_len, size_t offset, size_t total_len);
+
+/* Drop any partially received messages, Eg. on a disconnection */
+void esp_rmaker_mqtt_reassembly_reset(void);
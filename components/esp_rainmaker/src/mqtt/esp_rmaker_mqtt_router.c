@@ -0,0 +1,530 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <esp_log.h>
+
+#include "esp_rmaker_mqtt_router.h"
+#include "esp_rmaker_mem.h"
+
+static const char *TAG = "esp_rmaker_mqtt_router";
+
+/* Maximum number of subscriptions which can match a single message */
+#define MQTT_ROUTER_MAX_MATCHES     8
+
+typedef struct esp_rmaker_mqtt_route {
+    /* Each route owns a copy of its filter, so that it stays valid while the callback runs,
+     * even if the tree node gets removed meanwhile.
+     */
+    char *filter;
+    /* Only one of these is set, as per the type of subscription */
+    esp_rmaker_mqtt_subscribe_cb_t cb;
+    esp_rmaker_mqtt_stream_cb_t stream_cb;
+    void *priv;
+    /* Number of dispatches currently holding this route */
+    uint16_t refcount;
+    bool removed;
+    struct esp_rmaker_mqtt_route *next;
+} esp_rmaker_mqtt_route_t;
+
+typedef struct esp_rmaker_mqtt_router_node {
+    /* Topic level represented by this node. NULL for the root */
+    char *level;
+    esp_rmaker_mqtt_route_t *routes;
+    struct esp_rmaker_mqtt_router_node *parent;
+    struct esp_rmaker_mqtt_router_node *children;
+    struct esp_rmaker_mqtt_router_node *next;
+} esp_rmaker_mqtt_router_node_t;
+
+struct esp_rmaker_mqtt_router {
+    esp_rmaker_mqtt_router_node_t root;
+    SemaphoreHandle_t lock;
+};
+
+typedef struct {
+    /* Whether to match the streaming subscriptions or the regular ones */
+    bool stream;
+    /* Set if the matching routes should not be collected, but just counted */
+    bool count_only;
+    esp_rmaker_mqtt_route_t *routes[MQTT_ROUTER_MAX_MATCHES];
+    int count;
+    /* Set if any of the matches is due to a wildcard */
+    bool wildcard;
+    /* Total number of matches, including the ones which did not fit */
+    int total;
+} esp_rmaker_mqtt_router_matches_t;
+
+static bool esp_rmaker_mqtt_router_filter_is_valid(const char *filter)
+{
+    if (!filter || !*filter) {
+        return false;
+    }
+    const char *level = filter;
+    while (1) {
+        const char *end = strchr(level, '/');
+        size_t len = end ? (size_t)(end - level) : strlen(level);
+        /* Wildcards have to occupy an entire level, and '#' has to be the last level */
+        for (size_t i = 0; i < len; i++) {
+            if (((level[i] == '+') || (level[i] == '#')) && (len != 1)) {
+                return false;
+            }
+        }
+        if ((len == 1) && (level[0] == '#') && end) {
+            return false;
+        }
+        if (!end) {
+            return true;
+        }
+        level = end + 1;
+    }
+}
+
+static esp_rmaker_mqtt_router_node_t *esp_rmaker_mqtt_router_find_child(esp_rmaker_mqtt_router_node_t *node,
+        const char *level, size_t len)
+{
+    esp_rmaker_mqtt_router_node_t *child = node->children;
+    while (child) {
+        if ((strncmp(child->level, level, len) == 0) && (child->level[len] == '\0')) {
+            return child;
+        }
+        child = child->next;
+    }
+    return NULL;
+}
+
+/* Get the node for the given filter, creating the missing nodes if required */
+static esp_rmaker_mqtt_router_node_t *esp_rmaker_mqtt_router_get_node(esp_rmaker_mqtt_router_t *router,
+        const char *filter, bool create)
+{
+    esp_rmaker_mqtt_router_node_t *node = &router->root;
+    const char *level = filter;
+    while (node) {
+        const char *end = strchr(level, '/');
+        size_t len = end ? (size_t)(end - level) : strlen(level);
+        esp_rmaker_mqtt_router_node_t *child = esp_rmaker_mqtt_router_find_child(node, level, len);
+        if (!child && create) {
+            child = esp_rmaker_mem_calloc(ESP_RMAKER_MEM_MQTT, 1, sizeof(esp_rmaker_mqtt_router_node_t));
+            if (!child) {
+                return NULL;
+            }
+            child->level = esp_rmaker_mem_strndup(ESP_RMAKER_MEM_MQTT, level, len);
+            if (!child->level) {
+                esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, child);
+                return NULL;
+            }
+            child->parent = node;
+            child->next = node->children;
+            node->children = child;
+        }
+        node = child;
+        if (!end) {
+            break;
+        }
+        level = end + 1;
+    }
+    return node;
+}
+
+static void esp_rmaker_mqtt_route_free(esp_rmaker_mqtt_route_t *route)
+{
+    esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, route->filter);
+    esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, route);
+}
+
+/* Detach all the routes of a node. Routes still being dispatched are freed once the dispatch is done */
+static void esp_rmaker_mqtt_router_node_remove_routes(esp_rmaker_mqtt_router_node_t *node)
+{
+    esp_rmaker_mqtt_route_t *route = node->routes;
+    while (route) {
+        esp_rmaker_mqtt_route_t *next = route->next;
+        if (route->refcount) {
+            route->removed = true;
+        } else {
+            esp_rmaker_mqtt_route_free(route);
+        }
+        route = next;
+    }
+    node->routes = NULL;
+}
+
+/* Free the node and all the nodes above it which are no longer required */
+static void esp_rmaker_mqtt_router_prune(esp_rmaker_mqtt_router_node_t *node)
+{
+    while (node->parent && !node->routes && !node->children) {
+        esp_rmaker_mqtt_router_node_t *parent = node->parent;
+        esp_rmaker_mqtt_router_node_t **prev_next = &parent->children;
+        while (*prev_next != node) {
+            prev_next = &(*prev_next)->next;
+        }
+        *prev_next = node->next;
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, node->level);
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, node);
+        node = parent;
+    }
+}
+
+static void esp_rmaker_mqtt_router_free_children(esp_rmaker_mqtt_router_node_t *node)
+{
+    esp_rmaker_mqtt_router_node_t *child = node->children;
+    while (child) {
+        esp_rmaker_mqtt_router_node_t *next = child->next;
+        esp_rmaker_mqtt_router_free_children(child);
+        esp_rmaker_mqtt_router_node_remove_routes(child);
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, child->level);
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, child);
+        child = next;
+    }
+    node->children = NULL;
+}
+
+esp_rmaker_mqtt_router_t *esp_rmaker_mqtt_router_create(void)
+{
+    esp_rmaker_mqtt_router_t *router = esp_rmaker_mem_calloc(ESP_RMAKER_MEM_MQTT, 1, sizeof(esp_rmaker_mqtt_router_t));
+    if (!router) {
+        ESP_LOGE(TAG, "Failed to allocate memory for MQTT router.");
+        return NULL;
+    }
+    router->lock = xSemaphoreCreateMutex();
+    if (!router->lock) {
+        ESP_LOGE(TAG, "Failed to create MQTT router lock.");
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, router);
+        return NULL;
+    }
+    return router;
+}
+
+void esp_rmaker_mqtt_router_delete(esp_rmaker_mqtt_router_t *router)
+{
+    if (router) {
+        esp_rmaker_mqtt_router_clear(router);
+        vSemaphoreDelete(router->lock);
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, router);
+    }
+}
+
+static esp_err_t esp_rmaker_mqtt_router_add_route(esp_rmaker_mqtt_router_t *router, const char *filter,
+        esp_rmaker_mqtt_subscribe_cb_t cb, esp_rmaker_mqtt_stream_cb_t stream_cb, void *priv)
+{
+    if (!router || (!cb && !stream_cb) || !esp_rmaker_mqtt_router_filter_is_valid(filter)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_rmaker_mqtt_route_t *route = esp_rmaker_mem_calloc(ESP_RMAKER_MEM_MQTT, 1, sizeof(esp_rmaker_mqtt_route_t));
+    if (!route) {
+        return ESP_ERR_NO_MEM;
+    }
+    route->filter = esp_rmaker_mem_strdup(ESP_RMAKER_MEM_MQTT, filter);
+    if (!route->filter) {
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, route);
+        return ESP_ERR_NO_MEM;
+    }
+    route->cb = cb;
+    route->stream_cb = stream_cb;
+    route->priv = priv;
+    xSemaphoreTake(router->lock, portMAX_DELAY);
+    esp_rmaker_mqtt_router_node_t *node = esp_rmaker_mqtt_router_get_node(router, filter, true);
+    if (node) {
+        /* Append, so that the callbacks get invoked in the order of subscription */
+        esp_rmaker_mqtt_route_t **prev_next = &node->routes;
+        while (*prev_next) {
+            prev_next = &(*prev_next)->next;
+        }
+        *prev_next = route;
+    }
+    xSemaphoreGive(router->lock);
+    if (!node) {
+        esp_rmaker_mqtt_route_free(route);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_mqtt_router_add(esp_rmaker_mqtt_router_t *router, const char *filter,
+        esp_rmaker_mqtt_subscribe_cb_t cb, void *priv)
+{
+    return esp_rmaker_mqtt_router_add_route(router, filter, cb, NULL, priv);
+}
+
+esp_err_t esp_rmaker_mqtt_router_add_stream(esp_rmaker_mqtt_router_t *router, const char *filter,
+        esp_rmaker_mqtt_stream_cb_t stream_cb, void *priv)
+{
+    return esp_rmaker_mqtt_router_add_route(router, filter, NULL, stream_cb, priv);
+}
+
+esp_err_t esp_rmaker_mqtt_router_remove(esp_rmaker_mqtt_router_t *router, const char *filter)
+{
+    if (!router || !filter) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    xSemaphoreTake(router->lock, portMAX_DELAY);
+    esp_rmaker_mqtt_router_node_t *node = esp_rmaker_mqtt_router_get_node(router, filter, false);
+    if (node && node->routes) {
+        esp_rmaker_mqtt_router_node_remove_routes(node);
+        esp_rmaker_mqtt_router_prune(node);
+        err = ESP_OK;
+    }
+    xSemaphoreGive(router->lock);
+    return err;
+}
+
+static esp_err_t esp_rmaker_mqtt_router_remove_route(esp_rmaker_mqtt_router_t *router, const char *filter,
+        esp_rmaker_mqtt_subscribe_cb_t cb, esp_rmaker_mqtt_stream_cb_t stream_cb, void *priv)
+{
+    if (!router || !filter) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(router->lock, portMAX_DELAY);
+    esp_rmaker_mqtt_router_node_t *node = esp_rmaker_mqtt_router_get_node(router, filter, false);
+    /* Removing the last matching route, which is the one added most recently */
+    esp_rmaker_mqtt_route_t **route_prev_next = NULL;
+    for (esp_rmaker_mqtt_route_t **prev_next = node ? &node->routes : NULL; prev_next && *prev_next;
+            prev_next = &(*prev_next)->next) {
+        esp_rmaker_mqtt_route_t *route = *prev_next;
+        if ((route->cb == cb) && (route->stream_cb == stream_cb) && (route->priv == priv)) {
+            route_prev_next = prev_next;
+        }
+    }
+    if (!route_prev_next) {
+        xSemaphoreGive(router->lock);
+        return ESP_ERR_NOT_FOUND;
+    }
+    esp_rmaker_mqtt_route_t *route = *route_prev_next;
+    *route_prev_next = route->next;
+    if (route->refcount) {
+        route->removed = true;
+    } else {
+        esp_rmaker_mqtt_route_free(route);
+    }
+    esp_rmaker_mqtt_router_prune(node);
+    xSemaphoreGive(router->lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_mqtt_router_remove_cb(esp_rmaker_mqtt_router_t *router, const char *filter,
+        esp_rmaker_mqtt_subscribe_cb_t cb, void *priv)
+{
+    return esp_rmaker_mqtt_router_remove_route(router, filter, cb, NULL, priv);
+}
+
+esp_err_t esp_rmaker_mqtt_router_remove_stream_cb(esp_rmaker_mqtt_router_t *router, const char *filter,
+        esp_rmaker_mqtt_stream_cb_t stream_cb, void *priv)
+{
+    return esp_rmaker_mqtt_router_remove_route(router, filter, NULL, stream_cb, priv);
+}
+
+void esp_rmaker_mqtt_router_clear(esp_rmaker_mqtt_router_t *router)
+{
+    if (!router) {
+        return;
+    }
+    xSemaphoreTake(router->lock, portMAX_DELAY);
+    esp_rmaker_mqtt_router_free_children(&router->root);
+    xSemaphoreGive(router->lock);
+}
+
+/* Copy the filters having subscriptions into the array, if given, and return their number */
+static int esp_rmaker_mqtt_router_get_filters(esp_rmaker_mqtt_router_node_t *node, char **filters, int count)
+{
+    for (esp_rmaker_mqtt_router_node_t *child = node->children; child; child = child->next) {
+        if (child->routes) {
+            if (filters) {
+                filters[count] = esp_rmaker_mem_strdup(ESP_RMAKER_MEM_MQTT, child->routes->filter);
+            }
+            count++;
+        }
+        count = esp_rmaker_mqtt_router_get_filters(child, filters, count);
+    }
+    return count;
+}
+
+void esp_rmaker_mqtt_router_foreach(esp_rmaker_mqtt_router_t *router, esp_rmaker_mqtt_router_foreach_cb_t cb,
+        void *priv)
+{
+    if (!router || !cb) {
+        return;
+    }
+    /* The callbacks are invoked on a copy of the filters, without the router lock. They typically call the
+     * transport, which may hold its own lock while dispatching messages through the router.
+     */
+    xSemaphoreTake(router->lock, portMAX_DELAY);
+    int count = esp_rmaker_mqtt_router_get_filters(&router->root, NULL, 0);
+    char **filters = count ? esp_rmaker_mem_calloc(ESP_RMAKER_MEM_MQTT, count, sizeof(char *)) : NULL;
+    if (filters) {
+        esp_rmaker_mqtt_router_get_filters(&router->root, filters, 0);
+    }
+    xSemaphoreGive(router->lock);
+    if (count && !filters) {
+        ESP_LOGE(TAG, "Failed to allocate memory for %d topic filters.", count);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        if (filters[i]) {
+            cb(filters[i], priv);
+            esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, filters[i]);
+        } else {
+            ESP_LOGE(TAG, "Failed to allocate memory for topic filter.");
+        }
+    }
+    esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, filters);
+}
+
+static void esp_rmaker_mqtt_router_add_matches(esp_rmaker_mqtt_router_matches_t *matches,
+        esp_rmaker_mqtt_router_node_t *node, bool wildcard)
+{
+    for (esp_rmaker_mqtt_route_t *route = node->routes; route; route = route->next) {
+        if ((route->stream_cb != NULL) != matches->stream) {
+            continue;
+        }
+        matches->total++;
+        if (!matches->count_only && (matches->count < MQTT_ROUTER_MAX_MATCHES)) {
+            route->refcount++;
+            matches->routes[matches->count++] = route;
+            matches->wildcard |= wildcard;
+        }
+    }
+}
+
+/* Match the topic levels starting at "topic" against the children of the given node */
+static void esp_rmaker_mqtt_router_match(esp_rmaker_mqtt_router_node_t *node, const char *topic,
+        const char *topic_end, bool wildcard, esp_rmaker_mqtt_router_matches_t *matches)
+{
+    const char *level_end = memchr(topic, '/', topic_end - topic);
+    bool last_level = !level_end;
+    if (last_level) {
+        level_end = topic_end;
+    }
+    size_t len = level_end - topic;
+    for (esp_rmaker_mqtt_router_node_t *child = node->children; child; child = child->next) {
+        if ((child->level[0] == '#') && (child->level[1] == '\0')) {
+            /* Matches this level and all the levels below */
+            esp_rmaker_mqtt_router_add_matches(matches, child, true);
+            continue;
+        }
+        bool single_wildcard = (child->level[0] == '+') && (child->level[1] == '\0');
+        if (!single_wildcard && ((strncmp(child->level, topic, len) != 0) || (child->level[len] != '\0'))) {
+            continue;
+        }
+        if (!last_level) {
+            esp_rmaker_mqtt_router_match(child, level_end + 1, topic_end, wildcard || single_wildcard, matches);
+            continue;
+        }
+        esp_rmaker_mqtt_router_add_matches(matches, child, wildcard || single_wildcard);
+        /* "a/#" matches "a" as well */
+        esp_rmaker_mqtt_router_node_t *multi_wildcard = esp_rmaker_mqtt_router_find_child(child, "#", 1);
+        if (multi_wildcard) {
+            esp_rmaker_mqtt_router_add_matches(matches, multi_wildcard, true);
+        }
+    }
+}
+
+static void esp_rmaker_mqtt_router_find_matches(esp_rmaker_mqtt_router_t *router, const char *topic,
+        size_t topic_len, esp_rmaker_mqtt_router_matches_t *matches)
+{
+    xSemaphoreTake(router->lock, portMAX_DELAY);
+    /* As per the MQTT spec, topics starting with '$' do not match filters starting with wildcards.
+     * None of the RainMaker topics start with '$', so such topics are just not handled at all.
+     */
+    if (topic[0] != '$') {
+        esp_rmaker_mqtt_router_match(&router->root, topic, topic + topic_len, false, matches);
+    }
+    xSemaphoreGive(router->lock);
+    if (matches->total > matches->count && !matches->count_only) {
+        ESP_LOGW(TAG, "Only %d of the %d subscriptions for %.*s invoked.", matches->count, matches->total,
+                (int)topic_len, topic);
+    }
+}
+
+static void esp_rmaker_mqtt_router_release_matches(esp_rmaker_mqtt_router_t *router,
+        esp_rmaker_mqtt_router_matches_t *matches)
+{
+    xSemaphoreTake(router->lock, portMAX_DELAY);
+    for (int i = 0; i < matches->count; i++) {
+        esp_rmaker_mqtt_route_t *route = matches->routes[i];
+        if ((--route->refcount == 0) && route->removed) {
+            esp_rmaker_mqtt_route_free(route);
+        }
+    }
+    xSemaphoreGive(router->lock);
+}
+
+/* Invoke the callbacks of all the matching subscriptions of the given type.
+ * offset and total_len are applicable only for the streaming subscriptions.
+ */
+static int esp_rmaker_mqtt_router_dispatch_matches(esp_rmaker_mqtt_router_t *router, bool stream,
+        const char *topic, size_t topic_len, void *data, size_t data_len, size_t offset, size_t total_len)
+{
+    if (!router || !topic || !topic_len) {
+        return 0;
+    }
+    esp_rmaker_mqtt_router_matches_t matches = {
+        .stream = stream,
+    };
+    esp_rmaker_mqtt_router_find_matches(router, topic, topic_len, &matches);
+    /* The actual topic is passed to the callbacks of wildcard subscriptions, and the filter otherwise */
+    char *topic_str = NULL;
+    if (matches.wildcard) {
+        topic_str = esp_rmaker_mem_strndup(ESP_RMAKER_MEM_MQTT, topic, topic_len);
+        if (!topic_str) {
+            ESP_LOGE(TAG, "Failed to allocate memory for topic.");
+        }
+    }
+    for (int i = 0; i < matches.count; i++) {
+        esp_rmaker_mqtt_route_t *route = matches.routes[i];
+        /* Skip the routes which were removed by the earlier callbacks */
+        if (route->removed) {
+            continue;
+        }
+        const char *cb_topic = topic_str ? topic_str : route->filter;
+        if (stream) {
+            route->stream_cb(cb_topic, data, data_len, offset, total_len, route->priv);
+        } else {
+            route->cb(cb_topic, data, data_len, route->priv);
+        }
+    }
+    if (topic_str) {
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, topic_str);
+    }
+    esp_rmaker_mqtt_router_release_matches(router, &matches);
+    return matches.total;
+}
+
+int esp_rmaker_mqtt_router_dispatch(esp_rmaker_mqtt_router_t *router, const char *topic, size_t topic_len,
+        void *data, size_t data_len)
+{
+    return esp_rmaker_mqtt_router_dispatch_matches(router, false, topic, topic_len, data, data_len, 0, data_len);
+}
+
+int esp_rmaker_mqtt_router_dispatch_stream(esp_rmaker_mqtt_router_t *router, const char *topic, size_t topic_len,
+        void *data, size_t data_len, size_t offset, size_t total_len)
+{
+    return esp_rmaker_mqtt_router_dispatch_matches(router, true, topic, topic_len, data, data_len,
+            offset, total_len);
+}
+
+int esp_rmaker_mqtt_router_count(esp_rmaker_mqtt_router_t *router, const char *topic, size_t topic_len,
+        bool stream)
+{
+    if (!router || !topic || !topic_len) {
+        return 0;
+    }
+    esp_rmaker_mqtt_router_matches_t matches = {
+        .stream = stream,
+        .count_only = true,
+    };
+    esp_rmaker_mqtt_router_find_matches(router, topic, topic_len, &matches);
+    return matches.total;
+}
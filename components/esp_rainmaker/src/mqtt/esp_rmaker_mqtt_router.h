@@ -0,0 +1,80 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include <stddef.h>
+#include <stdbool.h>
+#include <esp_err.h>
+#include <esp_rmaker_mqtt.h>
+
+/* Routes the received MQTT messages to the subscribers, based on their topic filters.
+ * The filters are held in a tree with one level of the topic per node, so a message is
+ * dispatched by walking down the tree once, irrespective of the number of subscriptions.
+ * The MQTT wildcards, '+' (single level) and '#' (multi level) are supported.
+ */
+typedef struct esp_rmaker_mqtt_router esp_rmaker_mqtt_router_t;
+
+/** Callback for esp_rmaker_mqtt_router_foreach() */
+typedef void (*esp_rmaker_mqtt_router_foreach_cb_t)(const char *filter, void *priv);
+
+esp_rmaker_mqtt_router_t *esp_rmaker_mqtt_router_create(void);
+void esp_rmaker_mqtt_router_delete(esp_rmaker_mqtt_router_t *router);
+
+/* Add a subscription. There can be multiple subscriptions for the same filter */
+esp_err_t esp_rmaker_mqtt_router_add(esp_rmaker_mqtt_router_t *router, const char *filter,
+        esp_rmaker_mqtt_subscribe_cb_t cb, void *priv);
+
+/* Add a streaming subscription. Messages are passed on to these as they are received, fragment by
+ * fragment, instead of being reassembled first.
+ */
+esp_err_t esp_rmaker_mqtt_router_add_stream(esp_rmaker_mqtt_router_t *router, const char *filter,
+        esp_rmaker_mqtt_stream_cb_t stream_cb, void *priv);
+
+/* Remove all the subscriptions for the given filter. Returns ESP_ERR_NOT_FOUND if there were none.
+ * This is safe even while a message is being dispatched. The callbacks being invoked will still
+ * complete, but the removed subscriptions will not be invoked thereafter.
+ */
+esp_err_t esp_rmaker_mqtt_router_remove(esp_rmaker_mqtt_router_t *router, const char *filter);
+
+/* Remove just one subscription for the given filter, having the same callback and private data. If there are
+ * multiple such subscriptions, the one added last is removed. Returns ESP_ERR_NOT_FOUND if there were none.
+ */
+esp_err_t esp_rmaker_mqtt_router_remove_cb(esp_rmaker_mqtt_router_t *router, const char *filter,
+        esp_rmaker_mqtt_subscribe_cb_t cb, void *priv);
+
+/* Same as esp_rmaker_mqtt_router_remove_cb(), but for a streaming subscription */
+esp_err_t esp_rmaker_mqtt_router_remove_stream_cb(esp_rmaker_mqtt_router_t *router, const char *filter,
+        esp_rmaker_mqtt_stream_cb_t stream_cb, void *priv);
+
+/* Remove all the subscriptions */
+void esp_rmaker_mqtt_router_clear(esp_rmaker_mqtt_router_t *router);
+
+/* Invoke cb once for every filter having subscriptions. The router is not locked while cb runs, so it can call
+ * the transport APIs.
+ */
+void esp_rmaker_mqtt_router_foreach(esp_rmaker_mqtt_router_t *router, esp_rmaker_mqtt_router_foreach_cb_t cb,
+        void *priv);
+
+/* Invoke the callbacks of all the regular subscriptions matching the topic. The router is not locked while
+ * the callbacks run, and so, they can subscribe/unsubscribe. Returns the number of matching subscriptions.
+ */
+int esp_rmaker_mqtt_router_dispatch(esp_rmaker_mqtt_router_t *router, const char *topic, size_t topic_len,
+        void *data, size_t data_len);
+
+/* Same as esp_rmaker_mqtt_router_dispatch(), but for a fragment of a message, and the streaming subscriptions */
+int esp_rmaker_mqtt_router_dispatch_stream(esp_rmaker_mqtt_router_t *router, const char *topic, size_t topic_len,
+        void *data, size_t data_len, size_t offset, size_t total_len);
+
+/* Get the number of streaming or regular subscriptions matching the topic */
+int esp_rmaker_mqtt_router_count(esp_rmaker_mqtt_router_t *router, const char *topic, size_t topic_len,
+        bool stream);
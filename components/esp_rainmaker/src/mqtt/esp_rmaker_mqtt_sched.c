@@ -0,0 +1,233 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <string.h>
+#include <sdkconfig.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include "esp_rmaker_mqtt_sched.h"
+#include "esp_rmaker_mem.h"
+
+static const char *TAG = "esp_rmaker_mqtt_sched";
+
+#define SCHED_MAX_INFLIGHT      CONFIG_ESP_RMAKER_MQTT_MAX_INFLIGHT
+#define SCHED_MAX_QUEUED_BYTES  CONFIG_ESP_RMAKER_MQTT_PUBLISH_QUEUE_SIZE
+/* Time after which a message awaiting acknowledgement stops counting towards the limit,
+ * in case the acknowledgement never comes (Eg. if the MQTT client drops the message).
+ */
+#define SCHED_INFLIGHT_TIMEOUT_US   (30 * 1000 * 1000LL)
+
+/* Values for the inflight slots, other than the message ids */
+#define SLOT_FREE       0
+#define SLOT_RESERVED   -1
+
+typedef struct {
+    esp_rmaker_mqtt_sched_msg_t *head;
+    esp_rmaker_mqtt_sched_msg_t *tail;
+    uint32_t count;
+} esp_rmaker_mqtt_sched_queue_t;
+
+static esp_rmaker_mqtt_sched_queue_t sched_queues[ESP_RMAKER_MQTT_PRIO_MAX];
+static size_t sched_queued_bytes;
+static uint32_t sched_seq;
+/* Message ids of the QoS 1 messages awaiting acknowledgement */
+static int inflight_msg_ids[SCHED_MAX_INFLIGHT];
+static int64_t inflight_sent_time[SCHED_MAX_INFLIGHT];
+static int inflight_count;
+
+/* Reserve a slot for a message of the given QoS, if it can be sent right now */
+static bool esp_rmaker_mqtt_sched_reserve_slot(int qos, int *slot)
+{
+    if (qos == 0) {
+        *slot = ESP_RMAKER_MQTT_SCHED_NO_SLOT;
+        return true;
+    }
+    if (inflight_count == SCHED_MAX_INFLIGHT) {
+        int64_t now = esp_timer_get_time();
+        for (int i = 0; i < SCHED_MAX_INFLIGHT; i++) {
+            if ((inflight_msg_ids[i] > 0) && ((now - inflight_sent_time[i]) > SCHED_INFLIGHT_TIMEOUT_US)) {
+                ESP_LOGW(TAG, "No acknowledgement for message id %d.", inflight_msg_ids[i]);
+                inflight_msg_ids[i] = SLOT_FREE;
+                inflight_count--;
+            }
+        }
+    }
+    for (int i = 0; i < SCHED_MAX_INFLIGHT; i++) {
+        if (inflight_msg_ids[i] == SLOT_FREE) {
+            inflight_msg_ids[i] = SLOT_RESERVED;
+            inflight_count++;
+            *slot = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+esp_err_t esp_rmaker_mqtt_sched_reserve(int qos, esp_rmaker_mqtt_prio_t prio, int *slot)
+{
+    /* Send right away only if that will not make the message overtake any of higher or same priority */
+    for (int i = 0; i <= prio; i++) {
+        if (sched_queues[i].head) {
+            return ESP_ERR_NOT_FOUND;
+        }
+    }
+    return esp_rmaker_mqtt_sched_reserve_slot(qos, slot) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+void esp_rmaker_mqtt_sched_sent(int slot, int msg_id)
+{
+    if ((slot < 0) || (slot >= SCHED_MAX_INFLIGHT) || (inflight_msg_ids[slot] != SLOT_RESERVED)) {
+        return;
+    }
+    if (msg_id > 0) {
+        inflight_msg_ids[slot] = msg_id;
+        inflight_sent_time[slot] = esp_timer_get_time();
+    } else {
+        inflight_msg_ids[slot] = SLOT_FREE;
+        inflight_count--;
+    }
+}
+
+esp_err_t esp_rmaker_mqtt_sched_enqueue(const char *topic, void *data, size_t data_len, int qos,
+        esp_rmaker_mqtt_prio_t prio)
+{
+    /* A message larger than the limit is still accepted if nothing else is queued, else it could never be sent */
+    if (sched_queued_bytes && ((sched_queued_bytes + data_len) > SCHED_MAX_QUEUED_BYTES)) {
+        ESP_LOGW(TAG, "Publish queue full. Rejecting message on %s", topic);
+        return ESP_ERR_NO_MEM;
+    }
+    size_t topic_len = strlen(topic);
+    esp_rmaker_mqtt_sched_msg_t *msg = esp_rmaker_mem_malloc(ESP_RMAKER_MEM_MQTT,
+            sizeof(esp_rmaker_mqtt_sched_msg_t) + data_len + topic_len + 1);
+    if (!msg) {
+        ESP_LOGE(TAG, "Failed to allocate memory for queueing message on %s", topic);
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(msg->data, data, data_len);
+    msg->topic = msg->data + data_len;
+    memcpy(msg->topic, topic, topic_len + 1);
+    msg->data_len = data_len;
+    msg->qos = qos;
+    msg->prio = prio;
+    msg->seq = sched_seq++;
+    msg->next = NULL;
+    esp_rmaker_mqtt_sched_queue_t *queue = &sched_queues[prio];
+    if (queue->tail) {
+        queue->tail->next = msg;
+    } else {
+        queue->head = msg;
+    }
+    queue->tail = msg;
+    queue->count++;
+    sched_queued_bytes += data_len;
+    ESP_LOGD(TAG, "Queued message on %s with priority %d", topic, prio);
+    return ESP_OK;
+}
+
+static esp_rmaker_mqtt_sched_msg_t *esp_rmaker_mqtt_sched_dequeue(esp_rmaker_mqtt_sched_queue_t *queue)
+{
+    esp_rmaker_mqtt_sched_msg_t *msg = queue->head;
+    queue->head = msg->next;
+    if (!queue->head) {
+        queue->tail = NULL;
+    }
+    msg->next = NULL;
+    queue->count--;
+    sched_queued_bytes -= msg->data_len;
+    return msg;
+}
+
+esp_rmaker_mqtt_sched_msg_t *esp_rmaker_mqtt_sched_next(int *slot)
+{
+    for (int i = 0; i < ESP_RMAKER_MQTT_PRIO_MAX; i++) {
+        esp_rmaker_mqtt_sched_queue_t *queue = &sched_queues[i];
+        if (queue->head) {
+            /* Lower priority messages have to wait, even if they could be sent right now */
+            if (!esp_rmaker_mqtt_sched_reserve_slot(queue->head->qos, slot)) {
+                return NULL;
+            }
+            return esp_rmaker_mqtt_sched_dequeue(queue);
+        }
+    }
+    return NULL;
+}
+
+void esp_rmaker_mqtt_sched_requeue(esp_rmaker_mqtt_sched_msg_t *msg)
+{
+    esp_rmaker_mqtt_sched_queue_t *queue = &sched_queues[msg->prio];
+    msg->next = queue->head;
+    queue->head = msg;
+    if (!queue->tail) {
+        queue->tail = msg;
+    }
+    queue->count++;
+    sched_queued_bytes += msg->data_len;
+}
+
+void esp_rmaker_mqtt_sched_published(int msg_id)
+{
+    if (msg_id <= 0) {
+        return;
+    }
+    for (int i = 0; i < SCHED_MAX_INFLIGHT; i++) {
+        if (inflight_msg_ids[i] == msg_id) {
+            inflight_msg_ids[i] = SLOT_FREE;
+            inflight_count--;
+            return;
+        }
+    }
+}
+
+void esp_rmaker_mqtt_sched_reset(esp_rmaker_mqtt_sched_flush_t flush, void *priv)
+{
+    /* Slots reserved for messages being sent right now are retained, so that esp_rmaker_mqtt_sched_sent()
+     * does not get confused.
+     */
+    for (int i = 0; i < SCHED_MAX_INFLIGHT; i++) {
+        if (inflight_msg_ids[i] > 0) {
+            inflight_msg_ids[i] = SLOT_FREE;
+            inflight_count--;
+        }
+    }
+    /* Each queue is in the order of queueing, even with the requeued messages, which were at its head.
+     * So, the oldest message overall is at the head of one of them.
+     */
+    while (1) {
+        esp_rmaker_mqtt_sched_queue_t *oldest = NULL;
+        for (int i = 0; i < ESP_RMAKER_MQTT_PRIO_MAX; i++) {
+            esp_rmaker_mqtt_sched_queue_t *queue = &sched_queues[i];
+            if (queue->head && (!oldest || ((int32_t)(queue->head->seq - oldest->head->seq) < 0))) {
+                oldest = queue;
+            }
+        }
+        if (!oldest) {
+            break;
+        }
+        esp_rmaker_mqtt_sched_msg_t *msg = esp_rmaker_mqtt_sched_dequeue(oldest);
+        if (flush) {
+            flush(msg, priv);
+        }
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_MQTT, msg);
+    }
+}
+
+void esp_rmaker_mqtt_sched_get_stats(esp_rmaker_mqtt_outbox_stats_t *stats)
+{
+    stats->inflight = inflight_count;
+    stats->queued_bytes = sched_queued_bytes;
+    for (int i = 0; i < ESP_RMAKER_MQTT_PRIO_MAX; i++) {
+        stats->queued[i] = sched_queues[i].count;
+    }
+}
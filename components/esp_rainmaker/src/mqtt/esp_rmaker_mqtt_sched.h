@@ -0,0 +1,85 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include <esp_rmaker_mqtt.h>
+
+/* Publish scheduler, in front of the MQTT client. The number of QoS 1 messages awaiting an
+ * acknowledgement from the broker is limited to CONFIG_ESP_RMAKER_MQTT_MAX_INFLIGHT. Messages
+ * published beyond that are queued, one queue per priority, and are sent as the acknowledgements
+ * come in, highest priority first. So, a burst of low priority messages cannot hold up a high
+ * priority one for longer than the time for a single acknowledgement.
+ *
+ * The messages are not sent from within the scheduler. The caller reserves a slot using
+ * esp_rmaker_mqtt_sched_reserve() or esp_rmaker_mqtt_sched_next(), sends the message, and then
+ * reports the result using esp_rmaker_mqtt_sched_sent(). So, the caller need not hold its lock
+ * while the message is being sent.
+ *
+ * None of these are thread safe and so, the caller should serialise the calls.
+ */
+
+/* Slot for QoS 0 messages, which do not wait for an acknowledgement */
+#define ESP_RMAKER_MQTT_SCHED_NO_SLOT   -1
+
+/* A queued message. The topic (NULL terminated) is held in the same allocation, after the data */
+typedef struct esp_rmaker_mqtt_sched_msg {
+    struct esp_rmaker_mqtt_sched_msg *next;
+    char *topic;
+    size_t data_len;
+    int qos;
+    esp_rmaker_mqtt_prio_t prio;
+    /* Order in which the messages were queued, across all the priorities */
+    uint32_t seq;
+    char data[0];
+} esp_rmaker_mqtt_sched_msg_t;
+
+/* Function to take over the queued messages on esp_rmaker_mqtt_sched_reset() */
+typedef void (*esp_rmaker_mqtt_sched_flush_t)(esp_rmaker_mqtt_sched_msg_t *msg, void *priv);
+
+/* Check if a new message of the given QoS and priority can be sent right away, and if so, reserve
+ * a slot for it. Returns ESP_ERR_NOT_FOUND if no slot is available now, and the message should be
+ * queued instead.
+ */
+esp_err_t esp_rmaker_mqtt_sched_reserve(int qos, esp_rmaker_mqtt_prio_t prio, int *slot);
+
+/* Report the result of sending a message for which the slot was reserved. msg_id is the value
+ * returned by the MQTT client. A negative value indicates failure, and frees up the slot.
+ */
+void esp_rmaker_mqtt_sched_sent(int slot, int msg_id);
+
+/* Queue a copy of the message. Returns ESP_ERR_NO_MEM if the queue is full. A message larger than the queue size
+ * is accepted only when the queue is empty.
+ */
+esp_err_t esp_rmaker_mqtt_sched_enqueue(const char *topic, void *data, size_t data_len, int qos,
+        esp_rmaker_mqtt_prio_t prio);
+
+/* Take out the highest priority queued message, if it can be sent right away, and reserve a slot for it.
+ * The message should be freed using free() once sent, or put back using esp_rmaker_mqtt_sched_requeue().
+ */
+esp_rmaker_mqtt_sched_msg_t *esp_rmaker_mqtt_sched_next(int *slot);
+
+/* Put back a message taken out by esp_rmaker_mqtt_sched_next(), at the head of its queue */
+void esp_rmaker_mqtt_sched_requeue(esp_rmaker_mqtt_sched_msg_t *msg);
+
+/* Mark the message as acknowledged by the broker */
+void esp_rmaker_mqtt_sched_published(int msg_id);
+
+/* Forget all the messages awaiting acknowledgements, and pass on the queued messages, in the order in
+ * which they were queued, to flush (which may be NULL, to just drop them).
+ */
+void esp_rmaker_mqtt_sched_reset(esp_rmaker_mqtt_sched_flush_t flush, void *priv);
+
+void esp_rmaker_mqtt_sched_get_stats(esp_rmaker_mqtt_outbox_stats_t *stats);
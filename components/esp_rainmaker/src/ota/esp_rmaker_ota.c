@@ -24,6 +24,7 @@
 
 #include <esp_rmaker_utils.h>
 #include "esp_rmaker_ota_internal.h"
+#include "esp_rmaker_mem.h"
 
 static const char *TAG = "esp_rmaker_ota";
 
@@ -250,7 +251,7 @@ esp_err_t esp_rmaker_ota_enable(esp_rmaker_ota_config_t *ota_config, esp_rmaker_
         ESP_LOGE(TAG, "OTA already initialised");
         return ESP_FAIL;
     }
-    esp_rmaker_ota_t *ota = calloc(1, sizeof(esp_rmaker_ota_t));
+    esp_rmaker_ota_t *ota = esp_rmaker_mem_calloc(ESP_RMAKER_MEM_OTA, 1, sizeof(esp_rmaker_ota_t));
     if (!ota) {
         ESP_LOGE(TAG, "Failed to allocate memory for esp_rmaker_ota_t");
         return ESP_ERR_NO_MEM;
@@ -292,7 +293,7 @@ esp_err_t esp_rmaker_ota_enable(esp_rmaker_ota_config_t *ota_config, esp_rmaker_
     if (err == ESP_OK) {
         ota_init_done = true;
     } else {
-        free(ota);
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_OTA, ota);
         ESP_LOGE(TAG, "Failed to enable OTA");
     }
     return err;
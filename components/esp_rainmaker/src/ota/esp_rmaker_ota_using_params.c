@@ -24,6 +24,7 @@
 
 #include "esp_rmaker_ota_internal.h"
 #include "esp_rmaker_mqtt.h"
+#include "esp_rmaker_mem.h"
 
 static const char *TAG = "esp_rmaker_ota_using_params";
 
@@ -32,7 +33,7 @@ static const char *TAG = "esp_rmaker_ota_using_params";
 void esp_rmaker_ota_finish_using_params(esp_rmaker_ota_t *ota)
 {
     if (ota->url) {
-        free(ota->url);
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_OTA, ota->url);
         ota->url = NULL;
     }
     ota->filesize = 0;
@@ -57,15 +58,15 @@ static esp_err_t esp_rmaker_ota_service_cb(const esp_rmaker_device_t *device, co
         ESP_LOGI(TAG, "Received value = %s for %s - %s",
                 val.val.s, esp_rmaker_device_get_name(device), esp_rmaker_param_get_name(param));
         if (ota->url) {
-            free(ota->url);
+            esp_rmaker_mem_free(ESP_RMAKER_MEM_OTA, ota->url);
             ota->url = NULL;
         }
-        ota->url = strdup(val.val.s);
+        ota->url = esp_rmaker_mem_strdup(ESP_RMAKER_MEM_OTA, val.val.s);
         if (ota->url) {
             ota->filesize = 0;
             ota->ota_in_progress = true;
             ota->transient_priv = (void *)device;
-            if (esp_rmaker_queue_work(esp_rmaker_ota_common_cb, ota) != ESP_OK) {
+            if (esp_rmaker_queue_work_on_lane(ESP_RMAKER_WORK_LANE_JOB, esp_rmaker_ota_common_cb, ota) != ESP_OK) {
                 esp_rmaker_ota_finish_using_params(ota);
             } else {
                 return ESP_OK;
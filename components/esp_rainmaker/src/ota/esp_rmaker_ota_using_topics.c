@@ -22,6 +22,7 @@
 
 #include "esp_rmaker_ota_internal.h"
 #include "esp_rmaker_mqtt.h"
+#include "esp_rmaker_mem.h"
 
 #ifdef CONFIG_ESP_RMAKER_OTA_AUTOFETCH
 #include <esp_timer.h>
@@ -71,12 +72,12 @@ esp_err_t esp_rmaker_ota_report_status_using_topics(esp_rmaker_ota_handle_t ota_
 void esp_rmaker_ota_finish_using_topics(esp_rmaker_ota_t *ota)
 {
     if (ota->url) {
-        free(ota->url);
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_OTA, ota->url);
         ota->url = NULL;
     }
     ota->filesize = 0;
     if (ota->transient_priv) {
-        free(ota->transient_priv);
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_OTA, ota->transient_priv);
         ota->transient_priv = NULL;
     }
     ota->ota_in_progress = false;
@@ -120,7 +121,7 @@ static void ota_url_handler(const char *topic, void *payload, size_t payload_len
         goto end;
     }
     len++; /* Increment for NULL character */
-    ota_job_id = calloc(1, len);
+    ota_job_id = esp_rmaker_mem_calloc(ESP_RMAKER_MEM_OTA, 1, len);
     if (!ota_job_id) {
         ESP_LOGE(TAG, "Aborted. OTA Updated ID memory allocation failed");
         esp_rmaker_ota_report_status(ota_handle, OTA_STATUS_FAILED, "Aborted. OTA Updated ID memory allocation failed");
@@ -137,7 +138,7 @@ static void ota_url_handler(const char *topic, void *payload, size_t payload_len
         goto end;
     }
     len++; /* Increment for NULL character */
-    url = calloc(1, len);
+    url = esp_rmaker_mem_calloc(ESP_RMAKER_MEM_OTA, 1, len);
     if (!url) {
         ESP_LOGE(TAG, "Aborted. URL memory allocation failed");
         esp_rmaker_ota_report_status(ota_handle, OTA_STATUS_FAILED, "Aborted. URL memory allocation failed");
@@ -152,12 +153,12 @@ static void ota_url_handler(const char *topic, void *payload, size_t payload_len
 
     json_parse_end(&jctx);
     if (ota->url) {
-        free(ota->url);
+        esp_rmaker_mem_free(ESP_RMAKER_MEM_OTA, ota->url);
     }
     ota->url = url;
     ota->filesize = filesize;
     ota->ota_in_progress = true;
-    if (esp_rmaker_queue_work(esp_rmaker_ota_common_cb, ota) != ESP_OK) {
+    if (esp_rmaker_queue_work_on_lane(ESP_RMAKER_WORK_LANE_JOB, esp_rmaker_ota_common_cb, ota) != ESP_OK) {
         esp_rmaker_ota_finish_using_topics(ota);
     }
     return;
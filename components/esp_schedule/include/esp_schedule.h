@@ -19,6 +19,8 @@ extern "C" {
 #endif
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
 
 /** Schedule Handle */
 typedef void *esp_schedule_handle_t;
@@ -28,7 +30,8 @@ typedef void *esp_schedule_handle_t;
 
 /** Callback for schedule trigger
  *
- * This callback is called when the schedule is triggered.
+ * This callback is called when the schedule is triggered. It is invoked from the esp_timer task, and so, should not
+ * block for long. Defer any time consuming work to another task.
  *
  * @param[in] handle Schedule handle.
  * @param[in] priv_data Pointer to the private data passed while creating/editing the schedule.
@@ -51,9 +54,12 @@ typedef enum esp_schedule_type {
     ESP_SCHEDULE_TYPE_INVALID = 0,
     ESP_SCHEDULE_TYPE_DAYS_OF_WEEK,
     ESP_SCHEDULE_TYPE_DATE,
+    ESP_SCHEDULE_TYPE_SUNRISE,
+    ESP_SCHEDULE_TYPE_SUNSET,
+    ESP_SCHEDULE_TYPE_RELATIVE,
 } esp_schedule_type_t;
 
-/** Schedule days. Used for ESP_SCHEDULE_TYPE_DAYS_OF_WEEK. */
+/** Schedule days. Used for ESP_SCHEDULE_TYPE_DAYS_OF_WEEK, ESP_SCHEDULE_TYPE_SUNRISE and ESP_SCHEDULE_TYPE_SUNSET. */
 typedef enum esp_schedule_days {
     ESP_SCHEDULE_DAY_ONCE      = 0,
     ESP_SCHEDULE_DAY_EVERYDAY  = 0b1111111,
@@ -88,11 +94,11 @@ typedef enum esp_schedule_months {
 typedef struct esp_schedule_trigger {
     /** Type of schedule */
     esp_schedule_type_t type;
-    /** Hours in 24 hour format. Accepted values: 0-23 */
+    /** Hours in 24 hour format. Accepted values: 0-23. Not used for the sunrise, sunset and relative types. */
     uint8_t hours;
-    /** Minutes in the given hour. Accepted values: 0-59. */
+    /** Minutes in the given hour. Accepted values: 0-59. Not used for the sunrise, sunset and relative types. */
     uint8_t minutes;
-    /** For type ESP_SCHEDULE_TYPE_DAYS_OF_WEEK */
+    /** For types ESP_SCHEDULE_TYPE_DAYS_OF_WEEK, ESP_SCHEDULE_TYPE_SUNRISE and ESP_SCHEDULE_TYPE_SUNSET */
     struct {
         /** 'OR' list of esp_schedule_days_t */
         uint8_t repeat_days;
@@ -108,6 +114,29 @@ typedef struct esp_schedule_trigger {
         /** If the schedule is to be repeated every year. */
         bool repeat_every_year;
     } date;
+    /** For types ESP_SCHEDULE_TYPE_SUNRISE and ESP_SCHEDULE_TYPE_SUNSET. The days are in day.repeat_days, with
+     * ESP_SCHEDULE_DAY_ONCE for the next sunrise or sunset. The days on which the sun does not rise or set, as
+     * in the polar day and night, are skipped.
+     */
+    struct {
+        /** Minutes after the sunrise or sunset. Negative for before. */
+        int16_t offset_minutes;
+        /** Latitude in degrees. Positive for north. */
+        float latitude;
+        /** Longitude in degrees. Positive for east. */
+        float longitude;
+    } solar;
+    /** For type ESP_SCHEDULE_TYPE_RELATIVE. The schedule triggers every time the other schedule triggers, after
+     * the given delay. If the other schedule triggers again before that, the delay starts over. Enabling the
+     * schedule fails with ESP_ERR_INVALID_ARG if the other schedule follows it, directly or through other
+     * relative schedules.
+     */
+    struct {
+        /** Name of the other schedule */
+        char name[MAX_SCHEDULE_NAME_LEN + 1];
+        /** Minutes after the other schedule triggers. The schedule triggers at least a second after it. */
+        uint16_t delay_minutes;
+    } relative;
 } esp_schedule_trigger_t;
 
 /** Schedule config */
@@ -132,6 +161,9 @@ typedef struct esp_schedule_config {
  * Note: After calling this API, the pointers to the callbacks should be updated for all the schedules by calling
  * esp_schedule_get() followed by esp_schedule_edit() with the correct callbacks.
  *
+ * Note: Schedules stored in NVS by the versions before the sunrise, sunset and relative triggers are migrated to
+ * the current layout, and written back. Stored schedules of any other size cannot be read, and are removed from NVS.
+ *
  * @param[in] enable_nvs If NVS is to be enabled or not.
  * @param[in] nvs_partition (Optional) The NVS partition to be used. If NULL is passed, the default partition is used.
  * @param[out] schedule_count Number of active schedules found in NVS.
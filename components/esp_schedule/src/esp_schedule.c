@@ -12,324 +12,461 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <stdlib.h>
 #include <string.h>
 #include <esp_log.h>
 #include <esp_sntp.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include "esp_schedule_internal.h"
 
 static const char *TAG = "esp_schedule";
 
 #define SECONDS_TILL_2020 ((2020 - 1970) * 365 * 24 * 3600)
-#define SECONDS_IN_DAY (60 * 60 * 24)
 
 static bool init_done = false;
 
-static int esp_schedule_get_no_of_days(esp_schedule_t *schedule, struct tm *current_time, struct tm *schedule_time)
+/* All the enabled schedules share a single one shot timer. They are kept in a binary min-heap ordered by their next
+ * trigger time, so that the timer is only ever armed for the schedule at the top, and enabling or disabling a
+ * schedule is O(log n) in the number of enabled schedules.
+ *
+ * This is an esp_timer rather than a FreeRTOS software timer, as the esp_timer APIs never block. So, the timer can be
+ * re-armed with schedule_lock held, even from its callback, which takes the lock too. With a FreeRTOS timer, the
+ * commands go through the timer task's queue, which is drained by the very task that could be waiting for the lock.
+ *
+ * The heap is protected by schedule_lock. The trigger and timestamp callbacks are invoked without holding the lock,
+ * so that they can use the esp_schedule APIs. While the callbacks of a schedule are running, it is tracked in
+ * firing_schedule, so that deleting it from the callbacks (or another task) defers the free till they return.
+ */
+#define HEAP_INITIAL_SIZE 8
+/* The timer is re-armed at least this often, even if the next schedule is further away. This catches up with any
+ * changes in the system time.
+ */
+#define TIMER_MAX_PERIOD_SECONDS (60 * 60)
+
+static esp_timer_handle_t schedule_timer;
+static SemaphoreHandle_t schedule_lock;
+static esp_schedule_t **schedule_heap;
+static size_t heap_count;
+static size_t heap_size;
+static esp_schedule_t *firing_schedule;
+static bool firing_schedule_disabled;
+static bool firing_schedule_deleted;
+/* Enabled relative schedules, waiting for the schedules they follow to trigger */
+static esp_schedule_t *relative_list;
+
+/* Should be called with schedule_lock held */
+static esp_err_t esp_schedule_update_next_time(esp_schedule_t *schedule)
 {
-    /* for day, monday = 0, sunday = 6. */
-    int next_day = 0;
-    /* struct tm has tm_wday with sunday as 0. Whereas we have monday as 0. Converting struct tm to our format */
-    int today = ((current_time->tm_wday + 7 - 1) % 7);
-
-    esp_schedule_days_t today_bit = 1 << today;
-    uint8_t repeat_days = schedule->trigger.day.repeat_days;
-    int current_seconds = (current_time->tm_hour * 60 + current_time->tm_min) * 60 + current_time->tm_sec;
-    int schedule_seconds = (schedule_time->tm_hour * 60 + schedule_time->tm_min) * 60;
-
-    /* Handling for one time schedule */
-    if (repeat_days == ESP_SCHEDULE_DAY_ONCE) {
-        if (schedule_seconds > current_seconds) {
-            /* The schedule is today and is yet to go off */
-            return 0;
-        } else {
-            /* The schedule is tomorrow */
-            return 1;
-        }
-    }
+    time_t now, next;
+    char time_str[64];
 
-    /* Handling for repeating schedules */
-    /* Check if it is today */
-    if ((repeat_days & today_bit)) {
-        if (schedule_seconds > current_seconds) {
-            /* The schedule is today and is yet to go off. */
-            return 0;
-        }
-    }
-    /* Check if it is this week or next week */
-    if ((repeat_days & (today_bit ^ 0xFF)) > today_bit) {
-        /* Next schedule is yet to come in this week */
-        next_day = ffs(repeat_days & (0xFF << (today + 1))) - 1;
-        return (next_day - today);
-    } else {
-        /* First scheduled day of the next week */
-        next_day = ffs(repeat_days) - 1;
-        if (next_day == today) {
-            /* Same day, next week */
-            return 7;
-        }
-        return (7 - today + next_day);
+    time(&now);
+    if (esp_schedule_calendar_get_next(&schedule->trigger, now, &next) != ESP_OK) {
+        ESP_LOGE(TAG, "Schedule %s does not trigger again", schedule->name);
+        return ESP_ERR_NOT_FOUND;
     }
 
-    ESP_LOGE(TAG, "No of days could not be found. This should not happen.");
-    return 0;
+    esp_schedule_calendar_time_to_str(next, time_str, sizeof(time_str));
+    ESP_LOGI(TAG, "Schedule %s will be active on: %s", schedule->name, time_str);
+
+    schedule->next_scheduled_time_diff = next - now;
+    /* For one time schedules to check for expiry after a reboot. If NVS is enabled, this should be stored in NVS. */
+    schedule->next_scheduled_time_utc = next;
+    return ESP_OK;
 }
 
-static uint8_t esp_schedule_get_next_month(esp_schedule_t *schedule, struct tm *current_time, struct tm *schedule_time)
+static bool esp_schedule_is_expired(esp_schedule_t *schedule)
 {
-    int current_seconds = (current_time->tm_hour * 60 + current_time->tm_min) * 60 + current_time->tm_sec;
-    int schedule_seconds = (schedule_time->tm_hour * 60 + schedule_time->tm_min) * 60;
-    /* +1 is because struct tm has months starting from 0, whereas we have them starting from 1 */
-    uint8_t current_month = current_time->tm_mon + 1;
-    /* -1 because month_bit starts from 0b1. So for January, it should be 1 << 0. And current_month starts from 1. */
-    uint16_t current_month_bit = 1 << (current_month - 1);
-    uint8_t next_schedule_month = 0;
-    uint16_t repeat_months = schedule->trigger.date.repeat_months;
-
-    /* Check if month is not specified */
-    if (repeat_months == ESP_SCHEDULE_MONTH_ONCE) {
-        if (schedule->trigger.date.day == current_time->tm_mday) {
-            /* The schedule day is same. Check if time has already passed */
-            if (schedule_seconds > current_seconds) {
-                /* The schedule is today and is yet to go off */
-                return current_month;
-            } else {
-                /* Today's time has passed */
-                return (current_month + 1);
+    time_t current_timestamp = 0;
+    time(&current_timestamp);
+
+    if (schedule->trigger.type == ESP_SCHEDULE_TYPE_DAYS_OF_WEEK || schedule->trigger.type == ESP_SCHEDULE_TYPE_SUNRISE
+            || schedule->trigger.type == ESP_SCHEDULE_TYPE_SUNSET) {
+        if (schedule->trigger.day.repeat_days == ESP_SCHEDULE_DAY_ONCE) {
+            if (schedule->next_scheduled_time_utc > 0 && schedule->next_scheduled_time_utc <= current_timestamp) {
+                /* One time schedule has expired */
+                return true;
             }
-        } else if (schedule->trigger.date.day > current_time->tm_mday) {
-            /* The day is yet to come in this month */
-            return current_month;
-        } else {
-            /* The day has passed in the current month */
-            return (current_month + 1);
         }
-    }
-
-    /* Check if schedule is not this year itself, it is in future. */
-    if (schedule->trigger.date.year > (current_time->tm_year + 1900)) {
-        /* Find first schedule month of next year */
-        next_schedule_month = ffs(repeat_months);
-        /* Year will be handled by the caller. So no need to add any additional months */
-        return next_schedule_month;
-    }
-
-    /* Check if schedule is this month and is yet to come */
-    if (current_month_bit & repeat_months) {
-        if (schedule->trigger.date.day == current_time->tm_mday) {
-            /* The schedule day is same. Check if time has already passed */
-            if (schedule_seconds > current_seconds) {
-                /* The schedule is today and is yet to go off */
-                return current_month;
+    } else if (schedule->trigger.type == ESP_SCHEDULE_TYPE_DATE) {
+        if (schedule->trigger.date.repeat_months == 0) {
+            if (schedule->next_scheduled_time_utc > 0 && schedule->next_scheduled_time_utc <= current_timestamp) {
+                /* One time schedule has expired */
+                return true;
+            } else {
+                return false;
             }
         }
-        if (schedule->trigger.date.day > current_time->tm_mday) {
-            /* The day is yet to come in this month */
-            return current_month;
+        if (schedule->trigger.date.repeat_every_year == true) {
+            return false;
         }
-    }
 
-    /* Check if schedule is this year */
-    if ((repeat_months & (current_month_bit ^ 0xFFFF)) > current_month_bit) {
-        /* Next schedule month is yet to come in this year */
-        next_schedule_month = ffs(repeat_months & (0xFFFF << (current_month)));
-        return next_schedule_month;
-    }
+        /* For expiry, just check the last month of the repeat_months. */
+        xSemaphoreTake(schedule_lock, portMAX_DELAY);
+        time_t schedule_timestamp = esp_schedule_calendar_local_to_utc(schedule->trigger.date.year,
+                fls(schedule->trigger.date.repeat_months), schedule->trigger.date.day,
+                (schedule->trigger.hours * 60 + schedule->trigger.minutes) * 60);
+        xSemaphoreGive(schedule_lock);
 
-    /* Check if schedule is for this year and does not repeat */
-    if (!schedule->trigger.date.repeat_every_year) {
-        if (schedule->trigger.date.year <= (current_time->tm_year + 1900)) {
-            ESP_LOGE(TAG, "Schedule does not repeat next year, but get_next_month has been called.");
-            return 0;
+        if (schedule_timestamp < current_timestamp) {
+            return true;
         }
     }
-
-    /* Schedule is not this year */
-    /* Find first schedule month of next year */
-    next_schedule_month = ffs(repeat_months);
-    /* +12 because the schedule is next year */
-    return (next_schedule_month + 12);
+    return false;
 }
 
-static uint16_t esp_schedule_get_next_year(esp_schedule_t *schedule, struct tm *current_time, struct tm *schedule_time)
+static inline bool esp_schedule_heap_before(size_t a, size_t b)
 {
-    uint16_t current_year = current_time->tm_year + 1900;
-    uint16_t schedule_year = schedule->trigger.date.year;
-    if (schedule_year > current_year) {
-        return schedule_year;
-    }
-    /* If the schedule is set to repeat_every_year, we return the current year */
-    /* If the schedule has already passed in this year, we still return current year, as the additional months will be handled in get_next_month */
-    return current_year;
+    return schedule_heap[a]->next_scheduled_time_utc < schedule_heap[b]->next_scheduled_time_utc;
 }
 
-static uint32_t esp_schedule_get_next_schedule_time_diff(esp_schedule_t *schedule)
+static inline void esp_schedule_heap_swap(size_t a, size_t b)
 {
-    struct tm current_time, schedule_time;
-    time_t now;
-    char time_str[64];
-    int32_t time_diff;
-
-    /* Get current time */
-    time(&now);
-    localtime_r(&now, &current_time);
+    esp_schedule_t *schedule = schedule_heap[a];
+    schedule_heap[a] = schedule_heap[b];
+    schedule_heap[b] = schedule;
+    schedule_heap[a]->heap_index = a;
+    schedule_heap[b]->heap_index = b;
+}
 
-    /* Get schedule time */
-    localtime_r(&now, &schedule_time);
-    schedule_time.tm_sec = 0;
-    schedule_time.tm_min = schedule->trigger.minutes;
-    schedule_time.tm_hour = schedule->trigger.hours;
-    mktime(&schedule_time);
+static size_t esp_schedule_heap_sift_up(size_t index)
+{
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!esp_schedule_heap_before(index, parent)) {
+            break;
+        }
+        esp_schedule_heap_swap(index, parent);
+        index = parent;
+    }
+    return index;
+}
 
-    /* Adjust schedule day */
-    if (schedule->trigger.type == ESP_SCHEDULE_TYPE_DAYS_OF_WEEK) {
-        int no_of_days = 0;
-        no_of_days = esp_schedule_get_no_of_days(schedule, &current_time, &schedule_time);
-        schedule_time.tm_sec += no_of_days * SECONDS_IN_DAY;
-    }
-    if (schedule->trigger.type == ESP_SCHEDULE_TYPE_DATE) {
-        schedule_time.tm_mday = schedule->trigger.date.day;
-        schedule_time.tm_mon = esp_schedule_get_next_month(schedule, &current_time, &schedule_time) - 1;
-        schedule_time.tm_year = esp_schedule_get_next_year(schedule, &current_time, &schedule_time) - 1900;
-        if (schedule_time.tm_mon < 0) {
-            ESP_LOGE(TAG, "Invalid month found: %d. Setting it to next month.", schedule_time.tm_mon);
-            schedule_time.tm_mon = current_time.tm_mon + 1;
+static size_t esp_schedule_heap_sift_down(size_t index)
+{
+    while (1) {
+        size_t smallest = index;
+        size_t left = 2 * index + 1;
+        size_t right = left + 1;
+        if (left < heap_count && esp_schedule_heap_before(left, smallest)) {
+            smallest = left;
         }
-        if (schedule_time.tm_mon >= 12) {
-            schedule_time.tm_year += schedule_time.tm_mon / 12;
-            schedule_time.tm_mon = schedule_time.tm_mon % 12;
+        if (right < heap_count && esp_schedule_heap_before(right, smallest)) {
+            smallest = right;
         }
+        if (smallest == index) {
+            break;
+        }
+        esp_schedule_heap_swap(index, smallest);
+        index = smallest;
     }
-    mktime(&schedule_time);
+    return index;
+}
 
-    /* Adjust time according to DST */
-    time_t dst_adjust = 0;
-    if (!current_time.tm_isdst && schedule_time.tm_isdst) {
-        dst_adjust = -3600;
-    } else if (current_time.tm_isdst && !schedule_time.tm_isdst ) {
-        dst_adjust = 3600;
+/* Should be called with schedule_lock held. Adds the schedule to the heap, or moves it to its new position if it is
+ * already there and its next_scheduled_time_utc has changed.
+ */
+static esp_err_t esp_schedule_heap_update(esp_schedule_t *schedule)
+{
+    if (schedule->heap_index >= 0) {
+        size_t index = esp_schedule_heap_sift_up(schedule->heap_index);
+        esp_schedule_heap_sift_down(index);
+        return ESP_OK;
+    }
+    if (heap_count == heap_size) {
+        size_t new_size = heap_size ? heap_size * 2 : HEAP_INITIAL_SIZE;
+        esp_schedule_t **new_heap = (esp_schedule_t **)realloc(schedule_heap, new_size * sizeof(esp_schedule_t *));
+        if (new_heap == NULL) {
+            ESP_LOGE(TAG, "Could not grow the schedule heap to %d entries", (int)new_size);
+            return ESP_ERR_NO_MEM;
+        }
+        schedule_heap = new_heap;
+        heap_size = new_size;
     }
-    ESP_LOGD(TAG, "DST adjust seconds: %ld", dst_adjust);
-    schedule_time.tm_sec += dst_adjust;
-    mktime(&schedule_time);
-
-    /* Print schedule time */
-    memset(time_str, 0, sizeof(time_str));
-    strftime(time_str, sizeof(time_str), "%c %z[%Z]", &schedule_time);
-    ESP_LOGI(TAG, "Schedule %s will be active on: %s. DST: %s", schedule->name, time_str, schedule_time.tm_isdst ? "Yes" : "No");
-
-    /* Calculate difference */
-    time_diff = difftime((mktime(&schedule_time)), mktime(&current_time));
+    schedule_heap[heap_count] = schedule;
+    schedule->heap_index = heap_count;
+    heap_count++;
+    esp_schedule_heap_sift_up(schedule->heap_index);
+    return ESP_OK;
+}
 
-    /* For one time schedules to check for expiry after a reboot. If NVS is enabled, this should be stored in NVS. */
-    schedule->next_scheduled_time_utc = mktime(&schedule_time);
+/* Should be called with schedule_lock held */
+static void esp_schedule_heap_remove(esp_schedule_t *schedule)
+{
+    if (schedule->heap_index < 0) {
+        return;
+    }
+    size_t index = schedule->heap_index;
+    heap_count--;
+    if (index != heap_count) {
+        esp_schedule_heap_swap(index, heap_count);
+        index = esp_schedule_heap_sift_up(index);
+        esp_schedule_heap_sift_down(index);
+    }
+    schedule->heap_index = -1;
+}
 
-    return time_diff;
+/* Should be called with schedule_lock held. Arms the timer for the schedule at the top of the heap. */
+static void esp_schedule_timer_rearm(void)
+{
+    /* This fails if the timer is not running, which is fine */
+    esp_timer_stop(schedule_timer);
+    if (heap_count == 0) {
+        return;
+    }
+    time_t current_time = 0;
+    time(&current_time);
+    time_t time_diff = schedule_heap[0]->next_scheduled_time_utc - current_time;
+    if (time_diff > TIMER_MAX_PERIOD_SECONDS) {
+        time_diff = TIMER_MAX_PERIOD_SECONDS;
+    }
+    uint64_t timeout_us = 1000;
+    if (time_diff > 0) {
+        timeout_us = (uint64_t)time_diff * 1000 * 1000;
+    }
+    if (esp_timer_start_once(schedule_timer, timeout_us) != ESP_OK) {
+        ESP_LOGE(TAG, "Could not start the schedule timer");
+    }
 }
 
-static bool esp_schedule_is_expired(esp_schedule_t *schedule)
+/* Should be called with schedule_lock held */
+static void esp_schedule_relative_remove(esp_schedule_t *schedule)
 {
-    time_t current_timestamp = 0;
-    struct tm current_time = {0};
-    time(&current_timestamp);
-    localtime_r(&current_timestamp, &current_time);
+    if (!schedule->relative_enabled) {
+        return;
+    }
+    esp_schedule_t **prev = &relative_list;
+    while (*prev && *prev != schedule) {
+        prev = &(*prev)->relative_next;
+    }
+    if (*prev) {
+        *prev = schedule->relative_next;
+    }
+    schedule->relative_next = NULL;
+    schedule->relative_enabled = false;
+}
 
-    if (schedule->trigger.type == ESP_SCHEDULE_TYPE_DAYS_OF_WEEK) {
-        if (schedule->trigger.day.repeat_days == ESP_SCHEDULE_DAY_ONCE) {
-            if (schedule->next_scheduled_time_utc > 0 && schedule->next_scheduled_time_utc <= current_timestamp) {
-                /* One time schedule has expired */
-                return true;
-            }
+/* Should be called with schedule_lock held. Checks if the relative schedule would end up following itself,
+ * directly or through the enabled relative schedules, Eg. A after B and B after A. Such schedules would keep
+ * triggering each other forever.
+ */
+static bool esp_schedule_relative_is_cycle(esp_schedule_t *schedule)
+{
+    size_t relative_count = 0;
+    for (esp_schedule_t *other = relative_list; other; other = other->relative_next) {
+        relative_count++;
+    }
+    const char *name = schedule->trigger.relative.name;
+    /* A chain longer than the list would have to go through a cycle which does not include this schedule. That
+     * is not possible, since each schedule is checked when enabled, but this ensures that the walk ends.
+     */
+    for (size_t i = 0; i <= relative_count; i++) {
+        if (strncmp(name, schedule->name, sizeof(schedule->name)) == 0) {
+            return true;
         }
-    } else if (schedule->trigger.type == ESP_SCHEDULE_TYPE_DATE) {
-        if (schedule->trigger.date.repeat_months == 0) {
-            if (schedule->next_scheduled_time_utc > 0 && schedule->next_scheduled_time_utc <= current_timestamp) {
-                /* One time schedule has expired */
-                return true;
-            } else {
-                return false;
-            }
+        esp_schedule_t *other = relative_list;
+        while (other && (other == schedule || strncmp(other->name, name, sizeof(other->name)) != 0)) {
+            other = other->relative_next;
         }
-        if (schedule->trigger.date.repeat_every_year == true) {
+        if (!other) {
             return false;
         }
+        name = other->trigger.relative.name;
+    }
+    return false;
+}
 
-        struct tm schedule_time = {0};
-        localtime_r(&current_timestamp, &schedule_time);
-        schedule_time.tm_sec = 0;
-        schedule_time.tm_min = schedule->trigger.minutes;
-        schedule_time.tm_hour = schedule->trigger.hours;
-        schedule_time.tm_mday = schedule->trigger.date.day;
-        /* For expiry, just check the last month of the repeat_months. */
-        /* '-1' because struct tm has months starting from 0 and we have months starting from 1. */
-        schedule_time.tm_mon = fls(schedule->trigger.date.repeat_months) - 1;
-        /* '-1900' because struct tm has number of years after 1900 */
-        schedule_time.tm_year = schedule->trigger.date.year - 1900;
-        time_t schedule_timestamp = mktime(&schedule_time);
-
-        if (schedule_timestamp < current_timestamp) {
-            return true;
+/* Should be called with schedule_lock held. Starts the delay of the relative schedules which follow the schedule
+ * which has triggered.
+ */
+static void esp_schedule_relative_start(esp_schedule_t *triggered, time_t current_time)
+{
+    for (esp_schedule_t *schedule = relative_list; schedule; schedule = schedule->relative_next) {
+        if (schedule == triggered || strncmp(schedule->trigger.relative.name, triggered->name,
+                sizeof(schedule->trigger.relative.name)) != 0) {
+            continue;
+        }
+        uint32_t delay = schedule->trigger.relative.delay_minutes * 60;
+        /* At least a second later, so that it triggers from the next timer callback, rather than from this one.
+         * Relative schedules which follow each other are rejected when enabled, in esp_schedule_start_timer().
+         */
+        schedule->next_scheduled_time_diff = delay ? delay : 1;
+        schedule->next_scheduled_time_utc = current_time + schedule->next_scheduled_time_diff;
+        if (esp_schedule_heap_update(schedule) != ESP_OK) {
+            ESP_LOGE(TAG, "Could not start schedule %s after %s", schedule->name, triggered->name);
+            continue;
         }
+        ESP_LOGI(TAG, "Schedule %s will trigger in %u seconds, after %s", schedule->name,
+                schedule->next_scheduled_time_diff, triggered->name);
     }
-    return false;
 }
 
 static void esp_schedule_stop_timer(esp_schedule_t *schedule)
 {
-    xTimerStop(schedule->timer, portMAX_DELAY);
+    xSemaphoreTake(schedule_lock, portMAX_DELAY);
+    bool was_first = (schedule->heap_index == 0);
+    esp_schedule_heap_remove(schedule);
+    esp_schedule_relative_remove(schedule);
+    if (schedule == firing_schedule) {
+        firing_schedule_disabled = true;
+    }
+    if (was_first) {
+        esp_schedule_timer_rearm();
+    }
+    xSemaphoreGive(schedule_lock);
 }
 
-static void esp_schedule_start_timer(esp_schedule_t *schedule)
+static esp_err_t esp_schedule_start_timer(esp_schedule_t *schedule)
 {
     time_t current_time = 0;
     time(&current_time);
     if (current_time < SECONDS_TILL_2020) {
         ESP_LOGE(TAG, "Time is not updated");
-        return;
+        return ESP_OK;
+    }
+
+    xSemaphoreTake(schedule_lock, portMAX_DELAY);
+    if (schedule->trigger.type == ESP_SCHEDULE_TYPE_RELATIVE) {
+        if (esp_schedule_relative_is_cycle(schedule)) {
+            xSemaphoreGive(schedule_lock);
+            ESP_LOGE(TAG, "Schedule %s cannot follow %s, which follows it.", schedule->name,
+                    schedule->trigger.relative.name);
+            /* It may have been enabled earlier, for another schedule, before being edited */
+            esp_schedule_stop_timer(schedule);
+            return ESP_ERR_INVALID_ARG;
+        }
+        /* This gets added to the timer heap when the other schedule triggers */
+        if (!schedule->relative_enabled) {
+            schedule->relative_enabled = true;
+            schedule->relative_next = relative_list;
+            relative_list = schedule;
+        }
+        xSemaphoreGive(schedule_lock);
+        ESP_LOGI(TAG, "Schedule %s will trigger %d minutes after %s", schedule->name,
+                schedule->trigger.relative.delay_minutes, schedule->trigger.relative.name);
+        return ESP_OK;
+    }
+    bool was_first = (schedule->heap_index == 0);
+    esp_err_t err = esp_schedule_update_next_time(schedule);
+    if (err == ESP_OK) {
+        err = esp_schedule_heap_update(schedule);
+    } else {
+        esp_schedule_heap_remove(schedule);
     }
-
-    schedule->next_scheduled_time_diff = esp_schedule_get_next_schedule_time_diff(schedule);
-    ESP_LOGI(TAG, "Starting a timer for %u seconds for schedule %s", schedule->next_scheduled_time_diff, schedule->name);
+    if (was_first || schedule->heap_index == 0) {
+        esp_schedule_timer_rearm();
+    }
+    xSemaphoreGive(schedule_lock);
+    if (err != ESP_OK) {
+        return err;
+    }
+    ESP_LOGI(TAG, "Schedule %s will trigger in %u seconds", schedule->name, schedule->next_scheduled_time_diff);
 
     if (schedule->timestamp_cb) {
         schedule->timestamp_cb((esp_schedule_handle_t)schedule, schedule->next_scheduled_time_utc, schedule->priv_data);
     }
-
-    xTimerStop(schedule->timer, portMAX_DELAY);
-    xTimerChangePeriod(schedule->timer, (schedule->next_scheduled_time_diff * 1000) / portTICK_PERIOD_MS, portMAX_DELAY);
+    return ESP_OK;
 }
 
-static void esp_schedule_common_timer_cb(TimerHandle_t timer)
+/* Should be called with schedule_lock held. Returns true if the firing schedule was deleted, and has been freed. */
+static bool esp_schedule_firing_done(esp_schedule_t *schedule)
 {
-    void *priv_data = pvTimerGetTimerID(timer);
-    if (priv_data == NULL) {
-        return;
-    }
-    esp_schedule_t *schedule = (esp_schedule_t *)priv_data;
-    ESP_LOGI(TAG, "Schedule %s triggered", schedule->name);
-    if (schedule->trigger_cb) {
-        schedule->trigger_cb((esp_schedule_handle_t)schedule, schedule->priv_data);
+    bool deleted = firing_schedule_deleted;
+    firing_schedule = NULL;
+    firing_schedule_deleted = false;
+    if (deleted) {
+        free(schedule);
     }
-    if (esp_schedule_is_expired(schedule)) {
-        /* Not deleting the schedule here. Just not starting it again. */
-        return;
+    return deleted;
+}
+
+static void esp_schedule_common_timer_cb(void *arg)
+{
+    xSemaphoreTake(schedule_lock, portMAX_DELAY);
+    while (heap_count > 0) {
+        time_t current_time = 0;
+        time(&current_time);
+        esp_schedule_t *schedule = schedule_heap[0];
+        if (schedule->next_scheduled_time_utc > current_time) {
+            break;
+        }
+        esp_schedule_heap_remove(schedule);
+        esp_schedule_relative_start(schedule, current_time);
+        firing_schedule = schedule;
+        firing_schedule_disabled = false;
+        xSemaphoreGive(schedule_lock);
+
+        ESP_LOGI(TAG, "Schedule %s triggered", schedule->name);
+        if (schedule->trigger_cb) {
+            schedule->trigger_cb((esp_schedule_handle_t)schedule, schedule->priv_data);
+        }
+        bool expired = esp_schedule_is_expired(schedule);
+
+        xSemaphoreTake(schedule_lock, portMAX_DELAY);
+        if (firing_schedule_deleted || firing_schedule_disabled || schedule->heap_index >= 0 || expired
+                || schedule->trigger.type == ESP_SCHEDULE_TYPE_RELATIVE) {
+            /* Deleted, disabled or enabled again from the callback, or not repeating. Not deleting expired
+             * schedules here. Just not starting them again. Relative schedules get started again when the other
+             * schedule triggers.
+             */
+            esp_schedule_firing_done(schedule);
+            continue;
+        }
+        if (esp_schedule_update_next_time(schedule) != ESP_OK || esp_schedule_heap_update(schedule) != ESP_OK) {
+            ESP_LOGE(TAG, "Could not start schedule %s again", schedule->name);
+            esp_schedule_firing_done(schedule);
+            continue;
+        }
+        if (schedule->timestamp_cb) {
+            xSemaphoreGive(schedule_lock);
+            schedule->timestamp_cb((esp_schedule_handle_t)schedule, schedule->next_scheduled_time_utc,
+                    schedule->priv_data);
+            xSemaphoreTake(schedule_lock, portMAX_DELAY);
+        }
+        esp_schedule_firing_done(schedule);
     }
-    esp_schedule_start_timer(schedule);
+    esp_schedule_timer_rearm();
+    xSemaphoreGive(schedule_lock);
 }
 
-static void esp_schedule_delete_timer(esp_schedule_t *schedule)
+static esp_err_t esp_schedule_timer_init(void)
 {
-    xTimerDelete(schedule->timer, portMAX_DELAY);
+    if (schedule_timer) {
+        return ESP_OK;
+    }
+    schedule_lock = xSemaphoreCreateMutex();
+    if (schedule_lock == NULL) {
+        ESP_LOGE(TAG, "Could not create the schedule lock");
+        return ESP_ERR_NO_MEM;
+    }
+    esp_timer_create_args_t timer_args = {
+        .callback = esp_schedule_common_timer_cb,
+        .name = "schedule",
+    };
+    if (esp_timer_create(&timer_args, &schedule_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Could not create the schedule timer");
+        schedule_timer = NULL;
+        vSemaphoreDelete(schedule_lock);
+        schedule_lock = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
 }
 
 static void esp_schedule_create_timer(esp_schedule_t *schedule)
 {
-    if (esp_schedule_nvs_is_enabled()) {
+    if (esp_schedule_nvs_is_enabled() && schedule->trigger.type != ESP_SCHEDULE_TYPE_RELATIVE) {
         /* This is just used for calculating next_scheduled_time_utc for ESP_SCHEDULE_DAY_ONCE (in case of ESP_SCHEDULE_TYPE_DAYS_OF_WEEK) or for ESP_SCHEDULE_MONTH_ONCE (in case of ESP_SCHEDULE_TYPE_DATE), and only used when NVS is enabled. And if NVS is enabled, time will already be synced and the time will be correctly calculated. */
-        schedule->next_scheduled_time_diff = esp_schedule_get_next_schedule_time_diff(schedule);
-    }
-
-    /* Temporarily setting the timer for 1 (anything greater than 0) tick. This will get changed when xTimerChangePeriod() is called. */
-    schedule->timer = xTimerCreate("schedule", 1, pdFALSE, (void *)schedule, esp_schedule_common_timer_cb);
+        xSemaphoreTake(schedule_lock, portMAX_DELAY);
+        esp_schedule_update_next_time(schedule);
+        xSemaphoreGive(schedule_lock);
+    }
+    /* The schedule gets added to the timer heap when it is enabled */
+    schedule->heap_index = -1;
+    schedule->relative_enabled = false;
+    schedule->relative_next = NULL;
 }
 
 esp_err_t esp_schedule_get(esp_schedule_handle_t handle, esp_schedule_config_t *schedule_config)
@@ -353,6 +490,12 @@ esp_err_t esp_schedule_get(esp_schedule_handle_t handle, esp_schedule_config_t *
         schedule_config->trigger.date.repeat_months = schedule->trigger.date.repeat_months;
         schedule_config->trigger.date.year = schedule->trigger.date.year;
         schedule_config->trigger.date.repeat_every_year = schedule->trigger.date.repeat_every_year;
+    } else if (schedule->trigger.type == ESP_SCHEDULE_TYPE_SUNRISE
+            || schedule->trigger.type == ESP_SCHEDULE_TYPE_SUNSET) {
+        schedule_config->trigger.day.repeat_days = schedule->trigger.day.repeat_days;
+        schedule_config->trigger.solar = schedule->trigger.solar;
+    } else if (schedule->trigger.type == ESP_SCHEDULE_TYPE_RELATIVE) {
+        schedule_config->trigger.relative = schedule->trigger.relative;
     }
 
     schedule_config->trigger_cb = schedule->trigger_cb;
@@ -367,8 +510,7 @@ esp_err_t esp_schedule_enable(esp_schedule_handle_t handle)
         return ESP_ERR_INVALID_ARG;
     }
     esp_schedule_t *schedule = (esp_schedule_t *)handle;
-    esp_schedule_start_timer(schedule);
-    return ESP_OK;
+    return esp_schedule_start_timer(schedule);
 }
 
 esp_err_t esp_schedule_disable(esp_schedule_handle_t handle)
@@ -395,6 +537,12 @@ static esp_err_t esp_schedule_set(esp_schedule_t *schedule, esp_schedule_config_
         schedule->trigger.date.repeat_months = schedule_config->trigger.date.repeat_months;
         schedule->trigger.date.year = schedule_config->trigger.date.year;
         schedule->trigger.date.repeat_every_year = schedule_config->trigger.date.repeat_every_year;
+    } else if (schedule->trigger.type == ESP_SCHEDULE_TYPE_SUNRISE
+            || schedule->trigger.type == ESP_SCHEDULE_TYPE_SUNSET) {
+        schedule->trigger.day.repeat_days = schedule_config->trigger.day.repeat_days;
+        schedule->trigger.solar = schedule_config->trigger.solar;
+    } else if (schedule->trigger.type == ESP_SCHEDULE_TYPE_RELATIVE) {
+        schedule->trigger.relative = schedule_config->trigger.relative;
     }
 
     schedule->trigger_cb = schedule_config->trigger_cb;
@@ -427,11 +575,20 @@ esp_err_t esp_schedule_delete(esp_schedule_handle_t handle)
     }
     esp_schedule_t *schedule = (esp_schedule_t *)handle;
     ESP_LOGI(TAG, "Deleting schedule %s", schedule->name);
-    if (schedule->timer) {
-        esp_schedule_stop_timer(schedule);
-        esp_schedule_delete_timer(schedule);
-    }
     esp_schedule_nvs_remove(schedule);
+    xSemaphoreTake(schedule_lock, portMAX_DELAY);
+    bool was_first = (schedule->heap_index == 0);
+    esp_schedule_heap_remove(schedule);
+    esp_schedule_relative_remove(schedule);
+    if (was_first) {
+        esp_schedule_timer_rearm();
+    }
+    if (schedule == firing_schedule) {
+        /* The callbacks of this schedule are running. It will be freed once they return. */
+        firing_schedule_deleted = true;
+        schedule = NULL;
+    }
+    xSemaphoreGive(schedule_lock);
     free(schedule);
     return ESP_OK;
 }
@@ -462,6 +619,10 @@ esp_schedule_handle_t esp_schedule_create(esp_schedule_config_t *schedule_config
 
 esp_schedule_handle_t *esp_schedule_init(bool enable_nvs, char *nvs_partition, uint8_t *schedule_count)
 {
+    if (esp_schedule_timer_init() != ESP_OK) {
+        return NULL;
+    }
+
     if (!sntp_enabled()) {
         ESP_LOGI(TAG, "Initializing SNTP");
         sntp_setoperatingmode(SNTP_OPMODE_POLL);
@@ -493,7 +654,9 @@ esp_schedule_handle_t *esp_schedule_init(bool enable_nvs, char *nvs_partition, u
     for (size_t handle_count = 0; handle_count < *schedule_count; handle_count++) {
         schedule = (esp_schedule_t *)handle_list[handle_count];
         schedule->trigger_cb = NULL;
-        schedule->timer = NULL;
+        schedule->heap_index = -1;
+        schedule->relative_enabled = false;
+        schedule->relative_next = NULL;
         /* Check for ONCE and expired schedules and delete them. */
         if (esp_schedule_is_expired(schedule)) {
             /* This schedule has already expired. */
@@ -0,0 +1,389 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/* Calendar arithmetic for the schedules
+ *
+ * The next trigger time of a schedule is worked out on the local date and time, as days since the epoch and
+ * seconds of the day, instead of going through localtime_r() and mktime() for every candidate. The conversion
+ * between the local time and UTC uses the UTC offsets (DST transitions) of the active timezone, which are looked
+ * up once with localtime_r() and cached, for about two years from when they are first needed. They are looked up
+ * again when the TZ changes or the cached period runs out.
+ *
+ * The sunrise and sunset times are as per the sunrise equation, which is accurate to about a minute for the
+ * latitudes at which the sun rises and sets every day.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <esp_log.h>
+#include "esp_schedule_internal.h"
+
+static const char *TAG = "esp_schedule_cal";
+
+#define SECONDS_IN_DAY (60 * 60 * 24)
+/* Step for looking for the DST transitions. Transitions less than this apart could be missed. */
+#define TZ_SCAN_STEP (7 * SECONDS_IN_DAY)
+/* Period covered by the cached transitions, and the period after which they are looked up again. This keeps at
+ * least a year of transitions ahead of the current time.
+ */
+#define TZ_CACHE_PERIOD (2 * 366 * SECONDS_IN_DAY)
+#define TZ_CACHE_REFRESH (366 * SECONDS_IN_DAY)
+#define TZ_MAX_TRANSITIONS 8
+#define TZ_MAX_LEN 64
+/* Days to look ahead for a sunrise or sunset, beyond any polar day or night */
+#define SOLAR_MAX_DAYS 370
+/* 2000-01-01 12:00 UTC, the epoch of the sunrise equation */
+#define J2000_TIME 946728000
+#define J2000_DAYS 10957
+#define DEG_TO_RAD(deg) ((deg) * M_PI / 180.0)
+#define RAD_TO_DEG(rad) ((rad) * 180.0 / M_PI)
+
+typedef struct {
+    /* Time at which the offset changes */
+    time_t time;
+    /* UTC offset in seconds, from this time onwards */
+    int32_t offset;
+} tz_transition_t;
+
+typedef struct {
+    bool valid;
+    char tz[TZ_MAX_LEN];
+    time_t start;
+    time_t end;
+    /* UTC offset at start */
+    int32_t offset;
+    uint8_t transition_count;
+    tz_transition_t transitions[TZ_MAX_TRANSITIONS];
+} tz_cache_t;
+
+static tz_cache_t tz_cache;
+
+static inline int64_t floor_div(int64_t a, int64_t b)
+{
+    return (a >= 0) ? (a / b) : -((-a + b - 1) / b);
+}
+
+/* Days since 1970-01-01 for the given proleptic Gregorian date. The day can be beyond the end of the month, in
+ * which case the date rolls over to the next month, like it would with mktime().
+ */
+static int32_t days_from_civil(int32_t year, int32_t month, int32_t day)
+{
+    year -= (month <= 2);
+    int32_t era = (year >= 0 ? year : year - 399) / 400;
+    uint32_t year_of_era = (uint32_t)(year - era * 400);
+    uint32_t day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5;
+    uint32_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + (int32_t)day_of_era - 719468 + (day - 1);
+}
+
+/* Same as days_from_civil(), but the month can also be beyond December, in which case the date rolls over to the
+ * next year.
+ */
+static int32_t days_from_date(int32_t year, int32_t month, int32_t day)
+{
+    int32_t years = (int32_t)floor_div(month - 1, 12);
+    return days_from_civil(year + years, month - years * 12, day);
+}
+
+static void civil_from_days(int32_t days, int32_t *year, int32_t *month, int32_t *day)
+{
+    days += 719468;
+    int32_t era = (days >= 0 ? days : days - 146096) / 146097;
+    uint32_t day_of_era = (uint32_t)(days - era * 146097);
+    uint32_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    uint32_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    uint32_t mp = (5 * day_of_year + 2) / 153;
+    *day = day_of_year - (153 * mp + 2) / 5 + 1;
+    *month = mp < 10 ? mp + 3 : mp - 9;
+    *year = (int32_t)year_of_era + era * 400 + (*month <= 2);
+}
+
+/* UTC offset at the given time, as per localtime_r() */
+static int32_t tz_get_offset_slow(time_t time)
+{
+    struct tm local_time;
+    localtime_r(&time, &local_time);
+    int64_t local_seconds = (int64_t)days_from_civil(local_time.tm_year + 1900, local_time.tm_mon + 1,
+            local_time.tm_mday) * SECONDS_IN_DAY + (local_time.tm_hour * 60 + local_time.tm_min) * 60
+            + local_time.tm_sec;
+    return (int32_t)(local_seconds - time);
+}
+
+/* Finds the time between start (exclusive) and end (inclusive) at which the offset changes from start_offset */
+static time_t tz_find_transition(time_t start, time_t end, int32_t start_offset)
+{
+    while (end - start > 1) {
+        time_t mid = start + (end - start) / 2;
+        if (tz_get_offset_slow(mid) == start_offset) {
+            start = mid;
+        } else {
+            end = mid;
+        }
+    }
+    return end;
+}
+
+static void tz_cache_update(time_t now)
+{
+    const char *tz = getenv("TZ");
+    if (!tz) {
+        tz = "";
+    }
+    if (tz_cache.valid && (strcmp(tz_cache.tz, tz) == 0) && (now >= tz_cache.start)
+            && (now < tz_cache.start + TZ_CACHE_REFRESH)) {
+        return;
+    }
+    tz_cache.valid = false;
+    if (strlen(tz) >= sizeof(tz_cache.tz)) {
+        /* Not caching. All the offsets will be looked up with localtime_r() */
+        ESP_LOGW(TAG, "TZ too long to cache the DST transitions");
+        return;
+    }
+    strcpy(tz_cache.tz, tz);
+    /* Starting a day earlier, since the local times looked up can be behind the UTC time */
+    tz_cache.start = now - SECONDS_IN_DAY;
+    tz_cache.end = tz_cache.start + TZ_CACHE_PERIOD;
+    tz_cache.offset = tz_get_offset_slow(tz_cache.start);
+    tz_cache.transition_count = 0;
+
+    time_t prev_time = tz_cache.start;
+    int32_t prev_offset = tz_cache.offset;
+    while (prev_time < tz_cache.end) {
+        time_t time = prev_time + TZ_SCAN_STEP;
+        if (time > tz_cache.end) {
+            time = tz_cache.end;
+        }
+        int32_t offset = tz_get_offset_slow(time);
+        if (offset != prev_offset) {
+            if (tz_cache.transition_count == TZ_MAX_TRANSITIONS) {
+                /* Ending the cached period here. Times beyond are looked up with localtime_r() */
+                tz_cache.end = prev_time;
+                break;
+            }
+            tz_transition_t *transition = &tz_cache.transitions[tz_cache.transition_count++];
+            transition->time = tz_find_transition(prev_time, time, prev_offset);
+            transition->offset = offset;
+        }
+        prev_time = time;
+        prev_offset = offset;
+    }
+    tz_cache.valid = true;
+    ESP_LOGD(TAG, "Cached %d DST transitions for TZ \"%s\"", tz_cache.transition_count, tz);
+}
+
+static int32_t tz_get_offset(time_t time)
+{
+    if (!tz_cache.valid || time < tz_cache.start || time >= tz_cache.end) {
+        return tz_get_offset_slow(time);
+    }
+    int32_t offset = tz_cache.offset;
+    for (int i = 0; i < tz_cache.transition_count && tz_cache.transitions[i].time <= time; i++) {
+        offset = tz_cache.transitions[i].offset;
+    }
+    return offset;
+}
+
+/* Converts the local time, given as seconds since the epoch as if it were UTC, to UTC. A local time which occurs
+ * twice when the clocks go back is taken as the first one. A local time which does not exist since the clocks go
+ * forward is moved ahead by the length of the gap, like mktime() does with tm_isdst = -1.
+ */
+static time_t tz_local_to_utc(int64_t local_seconds)
+{
+    int32_t offset_before = tz_get_offset(local_seconds - SECONDS_IN_DAY);
+    int32_t offset_after = tz_get_offset(local_seconds + SECONDS_IN_DAY);
+    if (offset_before == offset_after) {
+        return local_seconds - offset_before;
+    }
+    /* There is a transition around this time */
+    if (tz_get_offset(local_seconds - offset_before) == offset_before) {
+        return local_seconds - offset_before;
+    }
+    if (tz_get_offset(local_seconds - offset_after) == offset_after) {
+        return local_seconds - offset_after;
+    }
+    return local_seconds - offset_before;
+}
+
+time_t esp_schedule_calendar_local_to_utc(int year, int month, int day, int seconds)
+{
+    /* The TZ could have changed since the cache was last updated */
+    tz_cache_update(time(NULL));
+    return tz_local_to_utc((int64_t)days_from_date(year, month, day) * SECONDS_IN_DAY + seconds);
+}
+
+/* Returns the first trigger time after now for the given local day, or 0 */
+static time_t esp_schedule_calendar_try(int32_t days, int32_t seconds, time_t now)
+{
+    time_t time = tz_local_to_utc((int64_t)days * SECONDS_IN_DAY + seconds);
+    return (time > now) ? time : 0;
+}
+
+static time_t esp_schedule_calendar_next_day_of_week(const esp_schedule_trigger_t *trigger, int32_t today,
+        int32_t seconds, time_t now)
+{
+    /* Monday is 0. 1970-01-01 was a Thursday. */
+    int weekday = (int)((today + 3) - floor_div(today + 3, 7) * 7);
+    uint16_t repeat_days = trigger->day.repeat_days & ESP_SCHEDULE_DAY_EVERYDAY;
+    if (repeat_days == ESP_SCHEDULE_DAY_ONCE) {
+        /* Today or tomorrow, whichever is first */
+        repeat_days = ESP_SCHEDULE_DAY_EVERYDAY;
+    }
+    /* Rotating the days so that bit n is set if the schedule is on the nth day from today, with bit 7 being the
+     * same day next week.
+     */
+    uint16_t days = ((repeat_days | (repeat_days << 7)) >> weekday) & 0xFF;
+    while (days) {
+        int day = ffs(days) - 1;
+        time_t time = esp_schedule_calendar_try(today + day, seconds, now);
+        if (time) {
+            return time;
+        }
+        days &= ~(1 << day);
+    }
+    return 0;
+}
+
+/* Time of the sunrise or sunset on the given day. Returns false if the sun does not rise or set on that day. */
+static bool esp_schedule_calendar_solar_event(int32_t days, double latitude, double longitude, bool sunrise,
+        time_t *time)
+{
+    /* Days since J2000 of the mean solar noon at the longitude */
+    double mean_noon = (days - J2000_DAYS) - longitude / 360.0;
+    double anomaly = DEG_TO_RAD(357.5291 + 0.98560028 * mean_noon);
+    double center = 1.9148 * sin(anomaly) + 0.0200 * sin(2 * anomaly) + 0.0003 * sin(3 * anomaly);
+    double ecliptic_longitude = DEG_TO_RAD(RAD_TO_DEG(anomaly) + center + 180.0 + 102.9372);
+    double noon = mean_noon + 0.0053 * sin(anomaly) - 0.0069 * sin(2 * ecliptic_longitude);
+    double sin_declination = sin(ecliptic_longitude) * sin(DEG_TO_RAD(23.4397));
+    double cos_declination = cos(asin(sin_declination));
+    double cos_hour_angle = (sin(DEG_TO_RAD(-0.833)) - sin(DEG_TO_RAD(latitude)) * sin_declination)
+            / (cos(DEG_TO_RAD(latitude)) * cos_declination);
+    if (cos_hour_angle < -1.0 || cos_hour_angle > 1.0) {
+        /* Polar day or night */
+        return false;
+    }
+    double hour_angle = RAD_TO_DEG(acos(cos_hour_angle));
+    double event = noon + (sunrise ? -hour_angle : hour_angle) / 360.0;
+    *time = J2000_TIME + (time_t)llround(event * SECONDS_IN_DAY);
+    return true;
+}
+
+static time_t esp_schedule_calendar_next_solar(const esp_schedule_trigger_t *trigger, int32_t today, time_t now)
+{
+    /* Monday is 0. 1970-01-01 was a Thursday. */
+    int weekday = (int)((today + 3) - floor_div(today + 3, 7) * 7);
+    uint8_t repeat_days = trigger->day.repeat_days & ESP_SCHEDULE_DAY_EVERYDAY;
+    if (repeat_days == ESP_SCHEDULE_DAY_ONCE) {
+        repeat_days = ESP_SCHEDULE_DAY_EVERYDAY;
+    }
+    bool sunrise = (trigger->type == ESP_SCHEDULE_TYPE_SUNRISE);
+    /* Starting from yesterday, since the offset can take its sunset past midnight */
+    for (int day = -1; day <= SOLAR_MAX_DAYS; day++) {
+        if (!(repeat_days & (1 << ((weekday + day + 7) % 7)))) {
+            continue;
+        }
+        time_t time;
+        if (!esp_schedule_calendar_solar_event(today + day, trigger->solar.latitude, trigger->solar.longitude,
+                    sunrise, &time)) {
+            continue;
+        }
+        time += trigger->solar.offset_minutes * 60;
+        if (time > now) {
+            return time;
+        }
+    }
+    return 0;
+}
+
+static time_t esp_schedule_calendar_next_date(const esp_schedule_trigger_t *trigger, int32_t today,
+        int32_t seconds, time_t now)
+{
+    int32_t year, month, day;
+    civil_from_days(today, &year, &month, &day);
+    uint16_t repeat_months = trigger->date.repeat_months & 0xFFF;
+    int32_t schedule_year = trigger->date.year;
+    time_t time;
+
+    if (repeat_months == ESP_SCHEDULE_MONTH_ONCE) {
+        /* This month or the next one, whichever is first. In the year of the schedule, if that is later. */
+        if (schedule_year > year) {
+            year = schedule_year;
+        }
+        for (int i = 0; i < 2; i++) {
+            time = esp_schedule_calendar_try(days_from_date(year, month + i, trigger->date.day), seconds, now);
+            if (time) {
+                return time;
+            }
+        }
+        return 0;
+    }
+
+    /* Going through the months from the current one, or from the start of the year of the schedule, if that is
+     * later. The loop covers two years, since the day might have passed in the only month of the schedule.
+     */
+    if (schedule_year > year) {
+        year = schedule_year;
+        month = 1;
+    }
+    int32_t last_year = trigger->date.repeat_every_year ? year + 1 : schedule_year;
+    for (; year <= last_year; year++, month = 1) {
+        for (; month <= 12; month++) {
+            if (!(repeat_months & (1 << (month - 1)))) {
+                continue;
+            }
+            time = esp_schedule_calendar_try(days_from_civil(year, month, trigger->date.day), seconds, now);
+            if (time) {
+                return time;
+            }
+        }
+    }
+    return 0;
+}
+
+esp_err_t esp_schedule_calendar_get_next(const esp_schedule_trigger_t *trigger, time_t now, time_t *next)
+{
+    tz_cache_update(now);
+    int64_t local_now = (int64_t)now + tz_get_offset(now);
+    int32_t today = (int32_t)floor_div(local_now, SECONDS_IN_DAY);
+    int32_t seconds = (trigger->hours * 60 + trigger->minutes) * 60;
+
+    time_t time = 0;
+    if (trigger->type == ESP_SCHEDULE_TYPE_DAYS_OF_WEEK) {
+        time = esp_schedule_calendar_next_day_of_week(trigger, today, seconds, now);
+    } else if (trigger->type == ESP_SCHEDULE_TYPE_DATE) {
+        time = esp_schedule_calendar_next_date(trigger, today, seconds, now);
+    } else if (trigger->type == ESP_SCHEDULE_TYPE_SUNRISE || trigger->type == ESP_SCHEDULE_TYPE_SUNSET) {
+        time = esp_schedule_calendar_next_solar(trigger, today, now);
+    }
+    if (time == 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *next = time;
+    return ESP_OK;
+}
+
+void esp_schedule_calendar_time_to_str(time_t time, char *buf, size_t buf_size)
+{
+    int32_t offset = tz_get_offset(time);
+    int64_t local_seconds = (int64_t)time + offset;
+    int32_t days = (int32_t)floor_div(local_seconds, SECONDS_IN_DAY);
+    int32_t seconds = (int32_t)(local_seconds - (int64_t)days * SECONDS_IN_DAY);
+    int32_t year, month, day;
+    civil_from_days(days, &year, &month, &day);
+    snprintf(buf, buf_size, "%04d-%02d-%02d %02d:%02d:%02d UTC%c%02d:%02d", year, month, day, seconds / 3600,
+            (seconds / 60) % 60, seconds % 60, offset < 0 ? '-' : '+', abs(offset) / 3600, (abs(offset) / 60) % 60);
+}
@@ -15,7 +15,6 @@
 #pragma once
 
 #include <freertos/FreeRTOS.h>
-#include <freertos/timers.h>
 #include <esp_schedule.h>
 
 typedef struct esp_schedule {
@@ -23,10 +22,18 @@ typedef struct esp_schedule {
     esp_schedule_trigger_t trigger;
     time_t next_scheduled_time_utc;
     uint32_t next_scheduled_time_diff;
-    TimerHandle_t timer;
+    /* Position of the schedule in the timer heap, or -1 if it is not enabled. This is in the place of the timer
+     * handle which each schedule used to have, so that the layout of the schedules stored in NVS does not change.
+     */
+    int32_t heap_index;
     esp_schedule_trigger_cb_t trigger_cb;
     esp_schedule_timestamp_cb_t timestamp_cb;
     void *priv_data;
+    /* For ESP_SCHEDULE_TYPE_RELATIVE. Enabled relative schedules are in a list, waiting for the other schedule to
+     * trigger. These are not valid for the schedules read from NVS.
+     */
+    bool relative_enabled;
+    struct esp_schedule *relative_next;
 } esp_schedule_t;
 
 esp_err_t esp_schedule_nvs_add(esp_schedule_t *schedule);
@@ -34,3 +41,8 @@ esp_err_t esp_schedule_nvs_remove(esp_schedule_t *schedule);
 esp_schedule_handle_t *esp_schedule_nvs_get_all(uint8_t *schedule_count);
 bool esp_schedule_nvs_is_enabled(void);
 esp_err_t esp_schedule_nvs_init(char *nvs_partition);
+
+/* Calendar. These are not thread safe, and are called with the schedule lock held. */
+esp_err_t esp_schedule_calendar_get_next(const esp_schedule_trigger_t *trigger, time_t now, time_t *next);
+time_t esp_schedule_calendar_local_to_utc(int year, int month, int day, int seconds);
+void esp_schedule_calendar_time_to_str(time_t time, char *buf, size_t buf_size);
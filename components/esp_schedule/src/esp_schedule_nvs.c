@@ -22,6 +22,33 @@ static const char *TAG = "esp_schedule_nvs";
 #define ESP_SCHEDULE_NVS_NAMESPACE "schd"
 #define ESP_SCHEDULE_COUNT_KEY "schd_count"
 
+/* Layout of the schedules stored by the versions before the sunrise, sunset and relative triggers. The trigger
+ * grew with those, moving the fields after it.
+ */
+typedef struct {
+    char name[MAX_SCHEDULE_NAME_LEN + 1];
+    struct {
+        esp_schedule_type_t type;
+        uint8_t hours;
+        uint8_t minutes;
+        struct {
+            uint8_t repeat_days;
+        } day;
+        struct {
+            uint8_t day;
+            uint16_t repeat_months;
+            uint16_t year;
+            bool repeat_every_year;
+        } date;
+    } trigger;
+    time_t next_scheduled_time_utc;
+    uint32_t next_scheduled_time_diff;
+    void *timer;
+    esp_schedule_trigger_cb_t trigger_cb;
+    esp_schedule_timestamp_cb_t timestamp_cb;
+    void *priv_data;
+} esp_schedule_v1_t;
+
 static char *esp_schedule_nvs_partition = NULL;
 static bool nvs_enabled = false;
 
@@ -110,7 +137,7 @@ esp_err_t esp_schedule_nvs_remove_all(void)
     return ESP_OK;
 }
 
-esp_err_t esp_schedule_nvs_remove(esp_schedule_t *schedule)
+static esp_err_t esp_schedule_nvs_remove_key(const char *nvs_key)
 {
     if (!nvs_enabled) {
         ESP_LOGD(TAG, "NVS not enabled. Not removing from NVS.");
@@ -122,7 +149,7 @@ esp_err_t esp_schedule_nvs_remove(esp_schedule_t *schedule)
         ESP_LOGE(TAG, "NVS open failed with error %d", err);
         return err;
     }
-    err = nvs_erase_key(nvs_handle, schedule->name);
+    err = nvs_erase_key(nvs_handle, nvs_key);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "NVS set failed with error %d", err);
         nvs_close(nvs_handle);
@@ -143,10 +170,15 @@ esp_err_t esp_schedule_nvs_remove(esp_schedule_t *schedule)
         return err;
     }
     nvs_close(nvs_handle);
-    ESP_LOGI(TAG, "Schedule %s removed from NVS", schedule->name);
+    ESP_LOGI(TAG, "Schedule %s removed from NVS", nvs_key);
     return ESP_OK;
 }
 
+esp_err_t esp_schedule_nvs_remove(esp_schedule_t *schedule)
+{
+    return esp_schedule_nvs_remove_key(schedule->name);
+}
+
 static uint8_t esp_schedule_nvs_get_count(void)
 {
     if (!nvs_enabled) {
@@ -171,6 +203,25 @@ static uint8_t esp_schedule_nvs_get_count(void)
     return schedule_count;
 }
 
+static void esp_schedule_nvs_migrate_v1(esp_schedule_v1_t *old_schedule, esp_schedule_t *schedule)
+{
+    memset(schedule, 0, sizeof(esp_schedule_t));
+    memcpy(schedule->name, old_schedule->name, sizeof(schedule->name));
+    schedule->trigger.type = old_schedule->trigger.type;
+    schedule->trigger.hours = old_schedule->trigger.hours;
+    schedule->trigger.minutes = old_schedule->trigger.minutes;
+    schedule->trigger.day.repeat_days = old_schedule->trigger.day.repeat_days;
+    schedule->trigger.date.day = old_schedule->trigger.date.day;
+    schedule->trigger.date.repeat_months = old_schedule->trigger.date.repeat_months;
+    schedule->trigger.date.year = old_schedule->trigger.date.year;
+    schedule->trigger.date.repeat_every_year = old_schedule->trigger.date.repeat_every_year;
+    schedule->next_scheduled_time_utc = old_schedule->next_scheduled_time_utc;
+    schedule->next_scheduled_time_diff = old_schedule->next_scheduled_time_diff;
+    schedule->heap_index = -1;
+    schedule->timestamp_cb = old_schedule->timestamp_cb;
+    schedule->priv_data = old_schedule->priv_data;
+}
+
 static esp_schedule_handle_t esp_schedule_nvs_get(char *nvs_key)
 {
     if (!nvs_enabled) {
@@ -179,7 +230,7 @@ static esp_schedule_handle_t esp_schedule_nvs_get(char *nvs_key)
     }
     size_t buf_size;
     nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open_from_partition(esp_schedule_nvs_partition, ESP_SCHEDULE_NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    esp_err_t err = nvs_open_from_partition(esp_schedule_nvs_partition, ESP_SCHEDULE_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "NVS open failed with error %d", err);
         return NULL;
@@ -190,13 +241,34 @@ static esp_schedule_handle_t esp_schedule_nvs_get(char *nvs_key)
         nvs_close(nvs_handle);
         return NULL;
     }
-    esp_schedule_t *schedule = (esp_schedule_t *)malloc(buf_size);
+    if (buf_size != sizeof(esp_schedule_t) && buf_size != sizeof(esp_schedule_v1_t)) {
+        /* Not a layout that can be read. Removing it, so that it does not stay behind, taking up a schedule. */
+        ESP_LOGE(TAG, "Schedule %s in NVS has an invalid size %d. Expected %d. Removing it.", nvs_key,
+                (int)buf_size, (int)sizeof(esp_schedule_t));
+        nvs_close(nvs_handle);
+        esp_schedule_nvs_remove_key(nvs_key);
+        return NULL;
+    }
+    esp_schedule_t *schedule = (esp_schedule_t *)malloc(sizeof(esp_schedule_t));
     if (schedule == NULL) {
         ESP_LOGE(TAG, "Could not allocate handle");
         nvs_close(nvs_handle);
         return NULL;
     }
-    err = nvs_get_blob(nvs_handle, nvs_key, schedule, &buf_size);
+    if (buf_size == sizeof(esp_schedule_t)) {
+        err = nvs_get_blob(nvs_handle, nvs_key, schedule, &buf_size);
+    } else {
+        esp_schedule_v1_t old_schedule;
+        err = nvs_get_blob(nvs_handle, nvs_key, &old_schedule, &buf_size);
+        if (err == ESP_OK) {
+            ESP_LOGI(TAG, "Migrating schedule %s in NVS to the new layout", nvs_key);
+            esp_schedule_nvs_migrate_v1(&old_schedule, schedule);
+            /* Failing to write it back is not fatal. The migration will just be done again the next time. */
+            if (nvs_set_blob(nvs_handle, nvs_key, schedule, sizeof(esp_schedule_t)) != ESP_OK) {
+                ESP_LOGW(TAG, "Could not write back the migrated schedule %s", nvs_key);
+            }
+        }
+    }
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "NVS set failed with error %d", err);
         nvs_close(nvs_handle);
@@ -226,23 +298,45 @@ esp_schedule_handle_t *esp_schedule_nvs_get_all(uint8_t *schedule_count)
         *schedule_count = 0;
         return NULL;
     }
-    int handle_count = 0;
+    /* Getting the keys first, since the schedules in an old layout get written back, and the invalid ones get
+     * removed, which should not be done while iterating.
+     */
+    char (*keys)[NVS_KEY_NAME_MAX_SIZE] = malloc(NVS_KEY_NAME_MAX_SIZE * (*schedule_count));
+    if (keys == NULL) {
+        ESP_LOGE(TAG, "Could not allocate schedule keys");
+        free(handle_list);
+        *schedule_count = 0;
+        return NULL;
+    }
+    int key_count = 0;
     nvs_entry_info_t nvs_entry;
     nvs_iterator_t nvs_iterator = nvs_entry_find(esp_schedule_nvs_partition, ESP_SCHEDULE_NVS_NAMESPACE, NVS_TYPE_BLOB);
     if (nvs_iterator == NULL) {
         ESP_LOGE(TAG, "No entry found in NVS");
-        return NULL;;
+        free(keys);
+        free(handle_list);
+        *schedule_count = 0;
+        return NULL;
     }
-    while (nvs_iterator != NULL) {
+    while (nvs_iterator != NULL && key_count < *schedule_count) {
         nvs_entry_info(nvs_iterator, &nvs_entry);
         ESP_LOGI(TAG, "Found schedule in NVS with key: %s", nvs_entry.key);
-        handle_list[handle_count] = esp_schedule_nvs_get(nvs_entry.key);
+        strlcpy(keys[key_count++], nvs_entry.key, NVS_KEY_NAME_MAX_SIZE);
+        nvs_iterator = nvs_entry_next(nvs_iterator);
+    }
+    if (nvs_iterator != NULL) {
+        ESP_LOGW(TAG, "More schedules found in NVS than the count %d", *schedule_count);
+        nvs_release_iterator(nvs_iterator);
+    }
+    int handle_count = 0;
+    for (int i = 0; i < key_count; i++) {
+        handle_list[handle_count] = esp_schedule_nvs_get(keys[i]);
         if (handle_list[handle_count] != NULL) {
             /* Increase count only if nvs_get was successful */
             handle_count++;
         }
-        nvs_iterator = nvs_entry_next(nvs_iterator);
     }
+    free(keys);
     *schedule_count = handle_count;
     ESP_LOGI(TAG, "Found %d schedules in NVS", *schedule_count);
     return handle_list;
@@ -0,0 +1,112 @@
+/*
+ * Heap accounting for the host benchmarks
+ *
+ * The allocation functions of glibc are replaced by ones which count the calls and track the bytes
+ * in use, before passing them on to the glibc implementations. Since the functions are replaced for
+ * the whole process, this also covers the allocations made within the C library, Eg. by strdup().
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <malloc.h>
+#include "bench_alloc.h"
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+static uint64_t alloc_count;
+static uint64_t alloc_bytes;
+static size_t in_use;
+static size_t peak;
+
+static void bench_alloc_account(void *ptr, size_t size)
+{
+    if (!ptr) {
+        return;
+    }
+    __atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&alloc_bytes, size, __ATOMIC_RELAXED);
+    size_t now = __atomic_add_fetch(&in_use, malloc_usable_size(ptr), __ATOMIC_RELAXED);
+    size_t cur_peak = __atomic_load_n(&peak, __ATOMIC_RELAXED);
+    while (now > cur_peak && !__atomic_compare_exchange_n(&peak, &cur_peak, now, true,
+                __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static void bench_alloc_release(void *ptr)
+{
+    if (ptr) {
+        __atomic_fetch_sub(&in_use, malloc_usable_size(ptr), __ATOMIC_RELAXED);
+    }
+}
+
+void *malloc(size_t size)
+{
+    void *ptr = __libc_malloc(size);
+    bench_alloc_account(ptr, size);
+    return ptr;
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    void *ptr = __libc_calloc(nmemb, size);
+    bench_alloc_account(ptr, nmemb * size);
+    return ptr;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    size_t old_size = ptr ? malloc_usable_size(ptr) : 0;
+    void *new_ptr = __libc_realloc(ptr, size);
+    if (new_ptr || size == 0) {
+        /* The old block is gone, either way */
+        __atomic_fetch_sub(&in_use, old_size, __ATOMIC_RELAXED);
+    }
+    bench_alloc_account(new_ptr, size);
+    return new_ptr;
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    void *ptr = __libc_memalign(alignment, size);
+    bench_alloc_account(ptr, size);
+    return ptr;
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    void *ptr = memalign(alignment, size);
+    if (!ptr) {
+        return ENOMEM;
+    }
+    *memptr = ptr;
+    return 0;
+}
+
+void free(void *ptr)
+{
+    bench_alloc_release(ptr);
+    __libc_free(ptr);
+}
+
+void bench_alloc_get_stats(bench_alloc_stats_t *stats)
+{
+    stats->allocs = __atomic_load_n(&alloc_count, __ATOMIC_RELAXED);
+    stats->alloc_bytes = __atomic_load_n(&alloc_bytes, __ATOMIC_RELAXED);
+    stats->in_use = __atomic_load_n(&in_use, __ATOMIC_RELAXED);
+    stats->peak = __atomic_load_n(&peak, __ATOMIC_RELAXED);
+}
+
+void bench_alloc_reset_peak(void)
+{
+    __atomic_store_n(&peak, __atomic_load_n(&in_use, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+}
@@ -0,0 +1,23 @@
+/*
+ * Heap accounting for the host benchmarks
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct {
+    /* Number of calls to malloc(), calloc(), realloc() and the aligned variants */
+    uint64_t allocs;
+    /* Total bytes requested by those calls */
+    uint64_t alloc_bytes;
+    /* Bytes currently allocated, as per malloc_usable_size() */
+    size_t in_use;
+    /* Highest value of in_use since the last bench_alloc_reset_peak() */
+    size_t peak;
+} bench_alloc_stats_t;
+
+/* Get the heap statistics of the process, including all threads */
+void bench_alloc_get_stats(bench_alloc_stats_t *stats);
+
+/* Reset the peak to the bytes currently in use */
+void bench_alloc_reset_peak(void);
@@ -0,0 +1,476 @@
+/*
+ * Microbenchmarks for the param and node config hot paths of ESP RainMaker
+ *
+ * Builds a synthetic node of N devices with M params each, of mixed types, and measures the time,
+ * the heap allocations and the peak heap usage per operation for:
+ *
+ *   node_params     esp_rmaker_get_node_params(), i.e. encoding the values of all the params
+ *   node_config     esp_rmaker_get_node_config()
+ *   set_params      esp_rmaker_handle_set_params() with a value for every param, each of which is
+ *                   then updated and reported by the write callback, as an application would do
+ *   schedule_parse  esp_rmaker_handle_set_params() for adding, and then removing, the maximum number
+ *                   of schedules (CONFIG_ESP_RMAKER_SCHEDULING_MAX_SCHEDULES)
+ *
+ * The core is initialised, but not started, so nothing is published. The reported changes are held
+ * back, as they would be while MQTT is disconnected.
+ *
+ * Usage: esp_rmaker_bench [-d devices] [-p params per device] [-n iterations] [-b benchmark] [-j] [-v]
+ *
+ * With -j, each result is printed as a JSON object on a line of its own, for regression tracking.
+ * Otherwise, the results are followed by the heap usage of each RainMaker subsystem, if
+ * CONFIG_ESP_RMAKER_MEM_STATS is enabled.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <ftw.h>
+#include <time.h>
+#include <esp_log.h>
+#include <esp_event.h>
+#include <nvs.h>
+#include <nvs_flash.h>
+#include <esp_rmaker_core.h>
+#include <esp_rmaker_schedule.h>
+#include <esp_rmaker_standard_params.h>
+#include <esp_rmaker_internal.h>
+#include <esp_rmaker_mem.h>
+#include "bench_alloc.h"
+
+#define BENCH_DEF_DEVICES       4
+#define BENCH_DEF_PARAMS        8
+#define BENCH_DEF_ITERATIONS    1000
+#define BENCH_WARMUP_ITERATIONS 10
+#define BENCH_DEVICE_TYPE       "esp.device.bench"
+#define BENCH_PARAM_TYPE        "esp.param.bench"
+
+static const char *TAG = "esp_rmaker_bench";
+
+typedef struct {
+    int devices;
+    int params;
+    esp_rmaker_device_t **device_list;
+    /* Payloads for setting all the params to the A and B values respectively */
+    char *set_params_payload[2];
+    size_t set_params_len[2];
+    char *schedule_add_payload;
+    char *schedule_remove_payload;
+} bench_node_t;
+
+typedef esp_err_t (*bench_fn_t)(bench_node_t *node, int iteration, size_t *payload_len);
+
+typedef struct {
+    const char *name;
+    bench_fn_t fn;
+} bench_t;
+
+static bench_node_t bench_node;
+
+static esp_err_t bench_write_cb(const esp_rmaker_device_t *device, const esp_rmaker_param_t *param,
+        const esp_rmaker_param_val_t val, void *priv_data, esp_rmaker_write_ctx_t *ctx)
+{
+    return esp_rmaker_param_update_and_report(param, val);
+}
+
+/* Value of the given param for the A (set == 0) or B (set == 1) payload. The types cycle through
+ * boolean, integer, float and string.
+ */
+static esp_rmaker_param_val_t bench_param_val(int device, int param, int set, char *buf, size_t buf_size)
+{
+    switch (param % 4) {
+        case 0:
+            return esp_rmaker_bool(set);
+        case 1:
+            return esp_rmaker_int((device * 10 + param + set) % 100);
+        case 2:
+            return esp_rmaker_float(param * 0.5f + set * 0.25f);
+        default:
+            snprintf(buf, buf_size, "value-%c-%d-%d", set ? 'b' : 'a', device, param);
+            return esp_rmaker_str(buf);
+    }
+}
+
+static esp_err_t bench_node_set_values(bench_node_t *node, int set)
+{
+    char buf[32];
+    for (int d = 0; d < node->devices; d++) {
+        for (int p = 0; p < node->params; p++) {
+            char name[24];
+            snprintf(name, sizeof(name), "param_%d", p);
+            esp_rmaker_param_t *param = esp_rmaker_device_get_param_by_name(node->device_list[d], name);
+            if (esp_rmaker_param_update_and_report(param, bench_param_val(d, p, set, buf, sizeof(buf))) != ESP_OK) {
+                return ESP_FAIL;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t bench_node_create_devices(bench_node_t *node, const esp_rmaker_node_t *rmaker_node)
+{
+    char buf[32];
+    node->device_list = calloc(node->devices, sizeof(esp_rmaker_device_t *));
+    if (!node->device_list) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (int d = 0; d < node->devices; d++) {
+        char name[24];
+        snprintf(name, sizeof(name), "Device %d", d);
+        esp_rmaker_device_t *device = esp_rmaker_device_create(name, BENCH_DEVICE_TYPE, NULL);
+        if (!device) {
+            return ESP_FAIL;
+        }
+        esp_rmaker_device_add_cb(device, bench_write_cb, NULL);
+        for (int p = 0; p < node->params; p++) {
+            snprintf(name, sizeof(name), "param_%d", p);
+            esp_rmaker_param_t *param = esp_rmaker_param_create(name, BENCH_PARAM_TYPE,
+                    bench_param_val(d, p, 0, buf, sizeof(buf)), PROP_FLAG_READ | PROP_FLAG_WRITE);
+            if (!param) {
+                return ESP_FAIL;
+            }
+            if (p % 4 == 1) {
+                esp_rmaker_param_add_bounds(param, esp_rmaker_int(0), esp_rmaker_int(100), esp_rmaker_int(1));
+            }
+            esp_rmaker_device_add_param(device, param);
+        }
+        if (esp_rmaker_node_add_device(rmaker_node, device) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        node->device_list[d] = device;
+    }
+    return ESP_OK;
+}
+
+/* Build the payloads for the set_params benchmark, by encoding the node params, with all the params
+ * set to the A and B values in turn. This uses the encoding configured for the node, JSON or CBOR.
+ */
+static esp_err_t bench_node_create_set_params_payloads(bench_node_t *node)
+{
+    for (int set = 1; set >= 0; set--) {
+        if (bench_node_set_values(node, set) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        node->set_params_payload[set] = esp_rmaker_get_node_params(&node->set_params_len[set]);
+        if (!node->set_params_payload[set]) {
+            return ESP_FAIL;
+        }
+    }
+    return ESP_OK;
+}
+
+static char *bench_schedules_payload(bench_node_t *node, bool add)
+{
+    size_t size = 128 + CONFIG_ESP_RMAKER_SCHEDULING_MAX_SCHEDULES * 192;
+    char *payload = calloc(1, size);
+    if (!payload) {
+        return NULL;
+    }
+    const char *device = node->devices ? esp_rmaker_device_get_name(node->device_list[0]) : "Device 0";
+    int len = snprintf(payload, size, "{\"Schedule\":{\"%s\":[", ESP_RMAKER_DEF_SCHEDULE_NAME);
+    for (int i = 0; i < CONFIG_ESP_RMAKER_SCHEDULING_MAX_SCHEDULES; i++) {
+        if (add) {
+            len += snprintf(payload + len, size - len, "%s{\"id\":\"bs%02d\",\"name\":\"Bench %d\","
+                    "\"operation\":\"add\",\"triggers\":[{\"m\":%d,\"d\":127}],"
+                    "\"action\":{\"%s\":{\"param_0\":true}}}",
+                    i ? "," : "", i, i, (i * 97) % 1440, device);
+        } else {
+            len += snprintf(payload + len, size - len, "%s{\"id\":\"bs%02d\",\"operation\":\"remove\"}",
+                    i ? "," : "", i);
+        }
+    }
+    snprintf(payload + len, size - len, "]}}");
+    return payload;
+}
+
+static esp_err_t bench_node_params(bench_node_t *node, int iteration, size_t *payload_len)
+{
+    char *params = esp_rmaker_get_node_params(payload_len);
+    if (!params) {
+        return ESP_FAIL;
+    }
+    esp_rmaker_mem_free(ESP_RMAKER_MEM_PARAM, params);
+    return ESP_OK;
+}
+
+static esp_err_t bench_node_config(bench_node_t *node, int iteration, size_t *payload_len)
+{
+    char *config = esp_rmaker_get_node_config();
+    if (!config) {
+        return ESP_FAIL;
+    }
+    *payload_len = strlen(config);
+    esp_rmaker_mem_free(ESP_RMAKER_MEM_CORE, config);
+    return ESP_OK;
+}
+
+static esp_err_t bench_set_params(bench_node_t *node, int iteration, size_t *payload_len)
+{
+    /* Alternate between the two sets of values, so that every param changes every time */
+    int set = iteration & 1;
+    *payload_len = node->set_params_len[set];
+    return esp_rmaker_handle_set_params(node->set_params_payload[set], node->set_params_len[set],
+            ESP_RMAKER_REQ_SRC_CLOUD);
+}
+
+static esp_err_t bench_schedule_parse(bench_node_t *node, int iteration, size_t *payload_len)
+{
+    size_t add_len = strlen(node->schedule_add_payload);
+    size_t remove_len = strlen(node->schedule_remove_payload);
+    *payload_len = add_len + remove_len;
+    if (esp_rmaker_handle_set_params(node->schedule_add_payload, add_len, ESP_RMAKER_REQ_SRC_CLOUD) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return esp_rmaker_handle_set_params(node->schedule_remove_payload, remove_len, ESP_RMAKER_REQ_SRC_CLOUD);
+}
+
+static const bench_t benchmarks[] = {
+    { "node_params", bench_node_params },
+    { "node_config", bench_node_config },
+    { "set_params", bench_set_params },
+    { "schedule_parse", bench_schedule_parse },
+};
+
+static const bench_t *bench_find(const char *name)
+{
+    for (int i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+        if (strcmp(name, benchmarks[i].name) == 0) {
+            return &benchmarks[i];
+        }
+    }
+    return NULL;
+}
+
+static int64_t bench_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static esp_err_t bench_run(const bench_t *bench, bench_node_t *node, int iterations, bool json)
+{
+    size_t payload_len = 0;
+    for (int i = 0; i < BENCH_WARMUP_ITERATIONS; i++) {
+        if (bench->fn(node, i, &payload_len) != ESP_OK) {
+            ESP_LOGE(TAG, "Benchmark %s failed", bench->name);
+            return ESP_FAIL;
+        }
+    }
+    bench_alloc_stats_t start, end;
+    bench_alloc_reset_peak();
+    bench_alloc_get_stats(&start);
+    int64_t start_time = bench_time_ns();
+    for (int i = 0; i < iterations; i++) {
+        if (bench->fn(node, i, &payload_len) != ESP_OK) {
+            ESP_LOGE(TAG, "Benchmark %s failed", bench->name);
+            return ESP_FAIL;
+        }
+    }
+    int64_t elapsed = bench_time_ns() - start_time;
+    bench_alloc_get_stats(&end);
+
+    double ns_per_op = (double)elapsed / iterations;
+    double allocs_per_op = (double)(end.allocs - start.allocs) / iterations;
+    double bytes_per_op = (double)(end.alloc_bytes - start.alloc_bytes) / iterations;
+    size_t peak_heap = end.peak - start.in_use;
+#ifdef CONFIG_ESP_RMAKER_PARAM_CBOR
+    const char *encoding = "cbor";
+#else
+    const char *encoding = "json";
+#endif /* !CONFIG_ESP_RMAKER_PARAM_CBOR */
+    if (json) {
+        printf("{\"benchmark\":\"%s\",\"devices\":%d,\"params\":%d,\"encoding\":\"%s\",\"iterations\":%d,"
+                "\"ns_per_op\":%.1f,\"allocs_per_op\":%.2f,\"alloc_bytes_per_op\":%.1f,"
+                "\"peak_heap_bytes\":%zu,\"payload_bytes\":%zu}\n",
+                bench->name, node->devices, node->params, encoding, iterations,
+                ns_per_op, allocs_per_op, bytes_per_op, peak_heap, payload_len);
+    } else {
+        printf("%-16s %11.1f %10.2f %12.1f %10zu %9zu\n", bench->name, ns_per_op, allocs_per_op,
+                bytes_per_op, peak_heap, payload_len);
+    }
+    fflush(stdout);
+    return ESP_OK;
+}
+
+#ifdef CONFIG_ESP_RMAKER_MEM_STATS
+/* The heap usage of the node itself, and the peaks reached by the benchmarks, per subsystem */
+static void bench_print_mem_stats(void)
+{
+    printf("\n%-16s %10s %10s %10s %12s\n", "subsystem", "cur bytes", "peak bytes", "cur allocs", "total allocs");
+    for (int i = 0; i < ESP_RMAKER_MEM_TAG_MAX; i++) {
+        esp_rmaker_mem_stats_t stats;
+        esp_rmaker_mem_get_stats(i, &stats);
+        printf("%-16s %10u %10u %10u %12u\n", esp_rmaker_mem_tag_name(i), stats.cur_bytes, stats.peak_bytes,
+                stats.cur_allocs, stats.total_allocs);
+    }
+}
+#endif /* CONFIG_ESP_RMAKER_MEM_STATS */
+
+static esp_err_t bench_set_creds(void)
+{
+    static const char *creds[][2] = {
+        { "node_id", "bench-node" },
+        { "client_cert", "-" },
+        { "client_key", "-" },
+        { "mqtt_host", "loopback" },
+    };
+    nvs_handle_t handle;
+    esp_err_t err = nvs_flash_init_partition(CONFIG_ESP_RMAKER_FACTORY_PARTITION_NAME);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_open_from_partition(CONFIG_ESP_RMAKER_FACTORY_PARTITION_NAME, "rmaker_creds", NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    for (int i = 0; (i < sizeof(creds) / sizeof(creds[0])) && (err == ESP_OK); i++) {
+        err = nvs_set_blob(handle, creds[i][0], creds[i][1], strlen(creds[i][1]));
+    }
+    nvs_close(handle);
+    return err;
+}
+
+static esp_err_t bench_node_init(bench_node_t *node)
+{
+    if (bench_set_creds() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to store the node credentials");
+        return ESP_FAIL;
+    }
+    esp_rmaker_config_t config = {
+        .enable_time_sync = false,
+    };
+    esp_rmaker_node_t *rmaker_node = esp_rmaker_node_init(&config, "Bench Node", "Benchmark");
+    if (!rmaker_node) {
+        return ESP_FAIL;
+    }
+    if (bench_node_create_devices(node, rmaker_node) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create the devices");
+        return ESP_FAIL;
+    }
+    if (bench_node_create_set_params_payloads(node) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to encode the node params. They may not fit in CONFIG_ESP_RMAKER_MAX_PARAM_DATA_SIZE (%d).",
+                CONFIG_ESP_RMAKER_MAX_PARAM_DATA_SIZE);
+        return ESP_FAIL;
+    }
+    /* Enabled only after creating the set params payloads, so that those do not include schedules */
+    if (esp_rmaker_schedule_enable() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to enable schedules");
+        return ESP_FAIL;
+    }
+    node->schedule_add_payload = bench_schedules_payload(node, true);
+    node->schedule_remove_payload = bench_schedules_payload(node, false);
+    if (!node->schedule_add_payload || !node->schedule_remove_payload) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+static int bench_remove_cb(const char *path, const struct stat *sb, int flag, struct FTW *ftwbuf)
+{
+    return remove(path);
+}
+
+static void bench_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-d devices] [-p params per device] [-n iterations] [-b benchmark] [-j] [-v]\n", prog);
+    fprintf(stderr, "Benchmarks:");
+    for (int i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+        fprintf(stderr, " %s", benchmarks[i].name);
+    }
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = BENCH_DEF_ITERATIONS;
+    const char *only = NULL;
+    bool json = false;
+    bool verbose = false;
+    int opt;
+
+    bench_node.devices = BENCH_DEF_DEVICES;
+    bench_node.params = BENCH_DEF_PARAMS;
+    while ((opt = getopt(argc, argv, "d:p:n:b:jvh")) != -1) {
+        switch (opt) {
+            case 'd':
+                bench_node.devices = atoi(optarg);
+                break;
+            case 'p':
+                bench_node.params = atoi(optarg);
+                break;
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            case 'b':
+                only = optarg;
+                break;
+            case 'j':
+                json = true;
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                bench_usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (only && !bench_find(only)) {
+        bench_usage(argv[0]);
+        return 1;
+    }
+    if (bench_node.devices < 1 || bench_node.params < 1 || iterations < 1) {
+        bench_usage(argv[0]);
+        return 1;
+    }
+    if (!verbose) {
+        esp_log_level_set("*", ESP_LOG_WARN);
+    }
+
+    /* Keep the NVS data of each run separate, unless a directory is given */
+    char nvs_dir[] = "/tmp/esp_rmaker_bench.XXXXXX";
+    bool remove_nvs_dir = false;
+    if (!getenv("NVS_HOST_DIR")) {
+        if (!mkdtemp(nvs_dir)) {
+            perror("mkdtemp");
+            return 1;
+        }
+        nvs_flash_host_set_dir(nvs_dir);
+        remove_nvs_dir = true;
+    }
+    esp_event_loop_create_default();
+    nvs_flash_init();
+
+    int ret = 0;
+    if (bench_node_init(&bench_node) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialise the node");
+        ret = 1;
+        goto exit;
+    }
+    if (!json) {
+        printf("%d devices x %d params, %d iterations\n", bench_node.devices, bench_node.params, iterations);
+        printf("%-16s %11s %10s %12s %10s %9s\n", "benchmark", "ns/op", "allocs/op", "bytes/op",
+                "peak heap", "payload");
+    }
+    for (int i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+        if (only && strcmp(only, benchmarks[i].name) != 0) {
+            continue;
+        }
+        if (bench_run(&benchmarks[i], &bench_node, iterations, json) != ESP_OK) {
+            ret = 1;
+        }
+    }
+#ifdef CONFIG_ESP_RMAKER_MEM_STATS
+    if (!json) {
+        bench_print_mem_stats();
+    }
+#endif /* CONFIG_ESP_RMAKER_MEM_STATS */
+exit:
+    if (remove_nvs_dir) {
+        nftw(nvs_dir, bench_remove_cb, 16, FTW_DEPTH | FTW_PHYS);
+    }
+    /* The core and its timers are not torn down. Just exit. */
+    return ret;
+}
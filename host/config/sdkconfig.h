@@ -0,0 +1,44 @@
+/*
+ * Configuration for the host (Linux) build of ESP RainMaker.
+ *
+ * This takes the place of the sdkconfig.h generated by ESP-IDF from the Kconfig options.
+ * The values are the Kconfig defaults, except for the features which cannot work on the
+ * host (claiming, user mapping during provisioning and local control), which are disabled,
+ * the MQTT loopback transport, which is enabled and used by default, the per subsystem
+ * heap usage statistics and the node model arena, which are enabled for the benchmarks, and
+ * the second work queue worker, which is enabled since the host is never single core.
+ */
+#pragma once
+
+#define CONFIG_IDF_TARGET "linux"
+#define CONFIG_IDF_TARGET_LINUX 1
+#define CONFIG_LOG_DEFAULT_LEVEL 3
+#define CONFIG_FREERTOS_HZ 1000
+
+#define CONFIG_ESP_RMAKER_TASK_STACK 4096
+#define CONFIG_ESP_RMAKER_TASK_PRIORITY 5
+#define CONFIG_ESP_RMAKER_WORK_QUEUE_SIZE 8
+#define CONFIG_ESP_RMAKER_WORK_JOB_TASK 1
+#define CONFIG_ESP_RMAKER_WORK_SECOND_WORKER 1
+#define CONFIG_ESP_RMAKER_NODE_CONFIG_CHUNK_SIZE 256
+#define CONFIG_ESP_RMAKER_MAX_PARAM_DATA_SIZE 1024
+#define CONFIG_ESP_RMAKER_PARAM_REPORT_MIN_INTERVAL 0
+#define CONFIG_ESP_RMAKER_PARAM_REPORT_MAX_LATENCY 0
+#define CONFIG_ESP_RMAKER_PARAM_SKIP_UNCHANGED 1
+#define CONFIG_ESP_RMAKER_PARAM_STORE_DELAY 1000
+#define CONFIG_ESP_RMAKER_FACTORY_PARTITION_NAME "fctry"
+#define CONFIG_ESP_RMAKER_MQTT_MAX_INFLIGHT 4
+#define CONFIG_ESP_RMAKER_MQTT_PUBLISH_QUEUE_SIZE 8192
+#define CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE 1
+#define CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE_LEN 8
+#define CONFIG_ESP_RMAKER_MQTT_OFFLINE_QUEUE_SIZE 4096
+#define CONFIG_ESP_RMAKER_MQTT_LOOPBACK 1
+#define CONFIG_ESP_RMAKER_MQTT_PORT_8883 1
+#define CONFIG_ESP_RMAKER_MQTT_PORT 2
+#define CONFIG_ESP_RMAKER_DEF_TIMEZONE "Asia/Shanghai"
+#define CONFIG_ESP_RMAKER_SNTP_SERVER_NAME "pool.ntp.org"
+#define CONFIG_ESP_RMAKER_DISABLE_USER_MAPPING_PROV 1
+#define CONFIG_ESP_RMAKER_MEM_STATS 1
+#define CONFIG_ESP_RMAKER_MODEL_ARENA 1
+#define CONFIG_ESP_RMAKER_MODEL_ARENA_CHUNK_SIZE 1024
+#define CONFIG_ESP_RMAKER_SCHEDULING_MAX_SCHEDULES 5
@@ -0,0 +1,21 @@
+/*
+ * Host (Linux) shim for esp_heap_caps.h
+ *
+ * Only the queries used by ESP RainMaker are provided, on top of the glibc allocator.
+ */
+#pragma once
+#include <stddef.h>
+#include <malloc.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline size_t heap_caps_get_allocated_size(void *ptr)
+{
+    return malloc_usable_size(ptr);
+}
+
+#ifdef __cplusplus
+}
+#endif
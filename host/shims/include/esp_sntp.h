@@ -0,0 +1,5 @@
+/*
+ * Host (Linux) shim for esp_sntp.h
+ */
+#pragma once
+#include <sntp.h>
@@ -0,0 +1,17 @@
+/*
+ * Host (Linux) shim for esp_system.h
+ */
+#pragma once
+#include <stdint.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Exits the process, since there is nothing to restart */
+void esp_restart(void) __attribute__((noreturn));
+
+#ifdef __cplusplus
+}
+#endif
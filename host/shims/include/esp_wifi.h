@@ -0,0 +1,34 @@
+/*
+ * Host (Linux) shim for esp_wifi.h
+ *
+ * There is no Wi-Fi on the host. The application posts IP_EVENT_STA_GOT_IP itself, to let the
+ * ESP RainMaker core proceed to the MQTT connection.
+ */
+#pragma once
+#include <stdint.h>
+#include <esp_err.h>
+#include <esp_event.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    WIFI_IF_STA = 0,
+    WIFI_IF_AP,
+} wifi_interface_t;
+
+ESP_EVENT_DECLARE_BASE(IP_EVENT);
+
+typedef enum {
+    IP_EVENT_STA_GOT_IP,
+    IP_EVENT_STA_LOST_IP,
+} ip_event_t;
+
+/* Returns a fixed, locally administered MAC address */
+esp_err_t esp_wifi_get_mac(wifi_interface_t ifx, uint8_t mac[6]);
+esp_err_t esp_wifi_restore(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,28 @@
+/*
+ * Host (Linux) shim for freertos/semphr.h
+ *
+ * Like in FreeRTOS, semaphores are queues with items of size 0. Mutexes do not track their owner,
+ * and so, there is no priority inheritance, and recursive mutexes are not supported.
+ */
+#pragma once
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t uxMaxCount, UBaseType_t uxInitialCount);
+
+#define xSemaphoreTake(xSemaphore, xBlockTime)  xQueueReceive(xSemaphore, NULL, xBlockTime)
+#define xSemaphoreGive(xSemaphore)              xQueueSendToBack(xSemaphore, NULL, 0)
+#define vSemaphoreDelete(xSemaphore)            vQueueDelete(xSemaphore)
+#define uxSemaphoreGetCount(xSemaphore)         uxQueueMessagesWaiting(xSemaphore)
+
+#ifdef __cplusplus
+}
+#endif
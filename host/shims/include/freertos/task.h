@@ -0,0 +1,25 @@
+/*
+ * Host (Linux) shim for freertos/task.h
+ *
+ * Tasks are detached POSIX threads. A task can delete only itself.
+ */
+#pragma once
+#include <freertos/FreeRTOS.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*TaskFunction_t)(void *);
+typedef struct host_task *TaskHandle_t;
+
+BaseType_t xTaskCreate(TaskFunction_t pvTaskCode, const char * const pcName, const uint32_t usStackDepth,
+        void * const pvParameters, UBaseType_t uxPriority, TaskHandle_t * const pvCreatedTask);
+/* Only NULL (the calling task) is supported */
+void vTaskDelete(TaskHandle_t xTaskToDelete);
+void vTaskDelay(const TickType_t xTicksToDelay);
+TickType_t xTaskGetTickCount(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,5 @@
+/*
+ * Host (Linux) shim for lwip/apps/sntp.h
+ */
+#pragma once
+#include <sntp.h>
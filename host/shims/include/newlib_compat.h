@@ -0,0 +1,14 @@
+/*
+ * BSD functions provided by newlib on the target, but not by glibc.
+ * This is force included in all the host builds of the components.
+ */
+#pragma once
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __GLIBC__
+int fls(int i);
+#if !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char *dst, const char *src, size_t size);
+#endif
+#endif /* __GLIBC__ */
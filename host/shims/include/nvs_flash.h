@@ -0,0 +1,33 @@
+/*
+ * Host (Linux) shim for nvs_flash.h
+ */
+#pragma once
+#include <esp_err.h>
+#include <nvs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_init_partition(const char *partition_label);
+esp_err_t nvs_flash_deinit(void);
+esp_err_t nvs_flash_deinit_partition(const char *partition_label);
+esp_err_t nvs_flash_erase(void);
+esp_err_t nvs_flash_erase_partition(const char *part_name);
+
+/** Set the directory holding the NVS partitions (host only)
+ *
+ * This should be called before initialising any partition. The default is the value of the
+ * NVS_HOST_DIR environment variable if set, else "nvs_host" in the current directory.
+ *
+ * @param[in] path Path of the directory. It is created if required.
+ *
+ * @return ESP_OK on success.
+ * @return ESP_ERR_INVALID_STATE if any partition is already initialised.
+ */
+esp_err_t nvs_flash_host_set_dir(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,31 @@
+/*
+ * Host (Linux) shim for the SNTP APIs
+ *
+ * The host clock is assumed to be in sync already. These just track whether SNTP has been
+ * initialised, and no sync notifications are delivered.
+ */
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SNTP_OPMODE_POLL        0
+#define SNTP_OPMODE_LISTENONLY  1
+
+typedef void (*sntp_sync_time_cb_t)(struct timeval *tv);
+
+void sntp_setoperatingmode(uint8_t operating_mode);
+void sntp_setservername(uint8_t idx, const char *server);
+void sntp_init(void);
+void sntp_stop(void);
+uint8_t sntp_enabled(void);
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,127 @@
+/*
+ * Host (Linux) shim for the default event loop
+ *
+ * Handlers are invoked synchronously from esp_event_post(), without holding the lock, so that they
+ * can register or unregister handlers, and post further events.
+ */
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <esp_event.h>
+
+typedef struct host_event_handler {
+    struct host_event_handler *next;
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void *arg;
+} host_event_handler_t;
+
+static pthread_mutex_t event_lock = PTHREAD_MUTEX_INITIALIZER;
+static host_event_handler_t *event_handlers;
+static int event_handler_count;
+static bool default_loop_created;
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    pthread_mutex_lock(&event_lock);
+    esp_err_t err = default_loop_created ? ESP_ERR_INVALID_STATE : ESP_OK;
+    default_loop_created = true;
+    pthread_mutex_unlock(&event_lock);
+    return err;
+}
+
+esp_err_t esp_event_loop_delete_default(void)
+{
+    pthread_mutex_lock(&event_lock);
+    while (event_handlers) {
+        host_event_handler_t *entry = event_handlers;
+        event_handlers = entry->next;
+        free(entry);
+    }
+    event_handler_count = 0;
+    default_loop_created = false;
+    pthread_mutex_unlock(&event_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id,
+        esp_event_handler_t event_handler, void *event_handler_arg)
+{
+    if (!event_handler || (event_base == ESP_EVENT_ANY_BASE && event_id != ESP_EVENT_ANY_ID)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&event_lock);
+    if (!default_loop_created) {
+        pthread_mutex_unlock(&event_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    host_event_handler_t **prev = &event_handlers;
+    for (; *prev; prev = &(*prev)->next) {
+        /* Registering the same handler again just updates the argument */
+        if ((*prev)->base == event_base && (*prev)->id == event_id && (*prev)->handler == event_handler) {
+            (*prev)->arg = event_handler_arg;
+            pthread_mutex_unlock(&event_lock);
+            return ESP_OK;
+        }
+    }
+    host_event_handler_t *entry = calloc(1, sizeof(host_event_handler_t));
+    if (!entry) {
+        pthread_mutex_unlock(&event_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    entry->base = event_base;
+    entry->id = event_id;
+    entry->handler = event_handler;
+    entry->arg = event_handler_arg;
+    *prev = entry;
+    event_handler_count++;
+    pthread_mutex_unlock(&event_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_unregister(esp_event_base_t event_base, int32_t event_id,
+        esp_event_handler_t event_handler)
+{
+    pthread_mutex_lock(&event_lock);
+    for (host_event_handler_t **prev = &event_handlers; *prev; prev = &(*prev)->next) {
+        host_event_handler_t *entry = *prev;
+        if (entry->base == event_base && entry->id == event_id && entry->handler == event_handler) {
+            *prev = entry->next;
+            free(entry);
+            event_handler_count--;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&event_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id, void *event_data,
+        size_t event_data_size, TickType_t ticks_to_wait)
+{
+    pthread_mutex_lock(&event_lock);
+    if (!default_loop_created) {
+        pthread_mutex_unlock(&event_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    /* Take a snapshot of the matching handlers, to invoke them without the lock */
+    host_event_handler_t *matched = malloc((event_handler_count + 1) * sizeof(host_event_handler_t));
+    if (!matched) {
+        pthread_mutex_unlock(&event_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    int count = 0;
+    for (host_event_handler_t *entry = event_handlers; entry; entry = entry->next) {
+        if ((entry->base == ESP_EVENT_ANY_BASE || entry->base == event_base) &&
+                (entry->id == ESP_EVENT_ANY_ID || entry->id == event_id)) {
+            matched[count++] = *entry;
+        }
+    }
+    pthread_mutex_unlock(&event_lock);
+    for (int i = 0; i < count; i++) {
+        matched[i].handler(matched[i].arg, event_base, event_id, event_data);
+    }
+    free(matched);
+    return ESP_OK;
+}
@@ -0,0 +1,78 @@
+/*
+ * Host (Linux) shim for esp_log
+ */
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <pthread.h>
+#include <esp_log.h>
+#include "host_common.h"
+
+#define HOST_LOG_MAX_TAG_LEVELS 16
+
+typedef struct {
+    char tag[32];
+    esp_log_level_t level;
+} host_log_tag_level_t;
+
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static esp_log_level_t log_default_level = CONFIG_LOG_DEFAULT_LEVEL;
+static host_log_tag_level_t log_tag_levels[HOST_LOG_MAX_TAG_LEVELS];
+static int log_tag_level_count;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    pthread_mutex_lock(&log_lock);
+    if (strcmp(tag, "*") == 0) {
+        log_default_level = level;
+        log_tag_level_count = 0;
+        pthread_mutex_unlock(&log_lock);
+        return;
+    }
+    int i;
+    for (i = 0; i < log_tag_level_count; i++) {
+        if (strcmp(log_tag_levels[i].tag, tag) == 0) {
+            break;
+        }
+    }
+    if (i == HOST_LOG_MAX_TAG_LEVELS) {
+        fprintf(stderr, "Cannot set the log level for more than %d tags\n", HOST_LOG_MAX_TAG_LEVELS);
+    } else {
+        strncpy(log_tag_levels[i].tag, tag, sizeof(log_tag_levels[i].tag) - 1);
+        log_tag_levels[i].level = level;
+        if (i == log_tag_level_count) {
+            log_tag_level_count++;
+        }
+    }
+    pthread_mutex_unlock(&log_lock);
+}
+
+static esp_log_level_t esp_log_level_get(const char *tag)
+{
+    pthread_mutex_lock(&log_lock);
+    esp_log_level_t level = log_default_level;
+    for (int i = 0; i < log_tag_level_count; i++) {
+        if (strcmp(log_tag_levels[i].tag, tag) == 0) {
+            level = log_tag_levels[i].level;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&log_lock);
+    return level;
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return (uint32_t)(host_time_us() / 1000);
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    if (level > esp_log_level_get(tag)) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
@@ -0,0 +1,84 @@
+/*
+ * Host (Linux) shims for the system level APIs: restart, application description, Wi-Fi and SNTP
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <esp_system.h>
+#include <esp_ota_ops.h>
+#include <esp_wifi.h>
+#include <sntp.h>
+
+#ifndef HOST_APP_VERSION
+#define HOST_APP_VERSION "1.0"
+#endif
+#ifndef HOST_APP_PROJECT_NAME
+#define HOST_APP_PROJECT_NAME "esp_rainmaker_host"
+#endif
+
+void esp_restart(void)
+{
+    printf("Restart requested. Exiting.\n");
+    fflush(stdout);
+    exit(0);
+}
+
+const esp_app_desc_t *esp_ota_get_app_description(void)
+{
+    static esp_app_desc_t app_desc = {
+        .version = HOST_APP_VERSION,
+        .project_name = HOST_APP_PROJECT_NAME,
+        .time = __TIME__,
+        .date = __DATE__,
+        .idf_ver = "host",
+    };
+    return &app_desc;
+}
+
+/* Stands in for the MQTT server certificate, embedded into the firmware on the target.
+ * It is not used by the loopback transport.
+ */
+const char host_mqtt_server_crt[] __asm__("_binary_mqtt_server_crt_start") = "";
+
+ESP_EVENT_DEFINE_BASE(IP_EVENT);
+
+esp_err_t esp_wifi_get_mac(wifi_interface_t ifx, uint8_t mac[6])
+{
+    const uint8_t host_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 + ifx };
+    memcpy(mac, host_mac, sizeof(host_mac));
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_restore(void)
+{
+    return ESP_OK;
+}
+
+static uint8_t sntp_is_enabled;
+
+void sntp_setoperatingmode(uint8_t operating_mode)
+{
+}
+
+void sntp_setservername(uint8_t idx, const char *server)
+{
+}
+
+void sntp_init(void)
+{
+    sntp_is_enabled = 1;
+}
+
+void sntp_stop(void)
+{
+    sntp_is_enabled = 0;
+}
+
+uint8_t sntp_enabled(void)
+{
+    return sntp_is_enabled;
+}
+
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback)
+{
+}
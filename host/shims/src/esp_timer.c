@@ -0,0 +1,77 @@
+/*
+ * Host (Linux) shim for esp_timer
+ */
+#include <stdlib.h>
+#include <esp_timer.h>
+#include "host_common.h"
+#include "host_timer_service.h"
+
+struct esp_timer {
+    host_timer_service_timer_t service_timer;
+    const char *name;
+};
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    if (!create_args || !create_args->callback || !out_handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_timer_handle_t timer = calloc(1, sizeof(struct esp_timer));
+    if (!timer) {
+        return ESP_ERR_NO_MEM;
+    }
+    timer->service_timer.cb = create_args->callback;
+    timer->service_timer.arg = create_args->arg;
+    timer->name = create_args->name;
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    if (!timer) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (host_timer_service_is_armed(&timer->service_timer)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    host_timer_service_arm(&timer->service_timer, timeout_us, 0);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    if (!timer || period == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (host_timer_service_is_armed(&timer->service_timer)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    host_timer_service_arm(&timer->service_timer, period, period);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!timer) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return host_timer_service_disarm(&timer->service_timer) ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    if (!timer) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (host_timer_service_is_armed(&timer->service_timer)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    host_timer_service_delete(&timer->service_timer);
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return host_time_us();
+}
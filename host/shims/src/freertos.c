@@ -0,0 +1,387 @@
+/*
+ * Host (Linux) shim for FreeRTOS, on top of POSIX threads
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/event_groups.h>
+#include <freertos/timers.h>
+#include "host_common.h"
+#include "host_timer_service.h"
+
+/* Tasks */
+
+struct host_task {
+    TaskFunction_t fn;
+    void *param;
+    char name[16];
+};
+
+static __thread struct host_task *current_task;
+
+static void *host_task_entry(void *arg)
+{
+    current_task = arg;
+    pthread_setname_np(pthread_self(), current_task->name);
+    current_task->fn(current_task->param);
+    /* FreeRTOS tasks should not return, but end the thread just like vTaskDelete(NULL) */
+    free(current_task);
+    current_task = NULL;
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pvTaskCode, const char * const pcName, const uint32_t usStackDepth,
+        void * const pvParameters, UBaseType_t uxPriority, TaskHandle_t * const pvCreatedTask)
+{
+    struct host_task *task = calloc(1, sizeof(struct host_task));
+    if (!task) {
+        return pdFAIL;
+    }
+    task->fn = pvTaskCode;
+    task->param = pvParameters;
+    strncpy(task->name, pcName ? pcName : "", sizeof(task->name) - 1);
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int ret = pthread_create(&thread, &attr, host_task_entry, task);
+    pthread_attr_destroy(&attr);
+    if (ret != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    if (pvCreatedTask) {
+        *pvCreatedTask = task;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete)
+{
+    if (xTaskToDelete && (xTaskToDelete != current_task)) {
+        fprintf(stderr, "vTaskDelete() is supported only for the calling task\n");
+        return;
+    }
+    free(current_task);
+    current_task = NULL;
+    pthread_exit(NULL);
+}
+
+void vTaskDelay(const TickType_t xTicksToDelay)
+{
+    int64_t delay_us = (int64_t)xTicksToDelay * portTICK_PERIOD_MS * 1000;
+    struct timespec ts = {
+        .tv_sec = delay_us / 1000000LL,
+        .tv_nsec = (delay_us % 1000000LL) * 1000,
+    };
+    while (nanosleep(&ts, &ts) != 0);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(host_time_us() / (portTICK_PERIOD_MS * 1000));
+}
+
+/* Queues, and semaphores, which are queues with items of size 0 */
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;
+    uint8_t storage[0];
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize)
+{
+    if (uxQueueLength == 0) {
+        return NULL;
+    }
+    QueueHandle_t queue = calloc(1, sizeof(struct host_queue) + uxQueueLength * uxItemSize);
+    if (!queue) {
+        return NULL;
+    }
+    pthread_mutex_init(&queue->lock, NULL);
+    host_cond_init(&queue->not_empty);
+    host_cond_init(&queue->not_full);
+    queue->length = uxQueueLength;
+    queue->item_size = uxItemSize;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t xQueue)
+{
+    if (!xQueue) {
+        return;
+    }
+    pthread_mutex_destroy(&xQueue->lock);
+    pthread_cond_destroy(&xQueue->not_empty);
+    pthread_cond_destroy(&xQueue->not_full);
+    free(xQueue);
+}
+
+static BaseType_t host_queue_send(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait, bool to_front)
+{
+    struct timespec deadline;
+    bool has_deadline = host_ticks_to_deadline(ticks_to_wait, &deadline);
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->length) {
+        if (ticks_to_wait == 0 ||
+                !host_cond_wait(&queue->not_full, &queue->lock, has_deadline ? &deadline : NULL)) {
+            pthread_mutex_unlock(&queue->lock);
+            return pdFAIL;
+        }
+    }
+    UBaseType_t index;
+    if (to_front) {
+        queue->head = (queue->head + queue->length - 1) % queue->length;
+        index = queue->head;
+    } else {
+        index = (queue->head + queue->count) % queue->length;
+    }
+    if (queue->item_size) {
+        memcpy(queue->storage + index * queue->item_size, item, queue->item_size);
+    }
+    queue->count++;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+    return pdPASS;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait)
+{
+    return host_queue_send(xQueue, pvItemToQueue, xTicksToWait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait)
+{
+    return host_queue_send(xQueue, pvItemToQueue, xTicksToWait, true);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait)
+{
+    struct timespec deadline;
+    bool has_deadline = host_ticks_to_deadline(xTicksToWait, &deadline);
+    pthread_mutex_lock(&xQueue->lock);
+    while (xQueue->count == 0) {
+        if (xTicksToWait == 0 ||
+                !host_cond_wait(&xQueue->not_empty, &xQueue->lock, has_deadline ? &deadline : NULL)) {
+            pthread_mutex_unlock(&xQueue->lock);
+            return pdFALSE;
+        }
+    }
+    if (xQueue->item_size && pvBuffer) {
+        memcpy(pvBuffer, xQueue->storage + xQueue->head * xQueue->item_size, xQueue->item_size);
+    }
+    xQueue->head = (xQueue->head + 1) % xQueue->length;
+    xQueue->count--;
+    pthread_cond_signal(&xQueue->not_full);
+    pthread_mutex_unlock(&xQueue->lock);
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue)
+{
+    pthread_mutex_lock(&xQueue->lock);
+    UBaseType_t count = xQueue->count;
+    pthread_mutex_unlock(&xQueue->lock);
+    return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t xQueue)
+{
+    pthread_mutex_lock(&xQueue->lock);
+    UBaseType_t spaces = xQueue->length - xQueue->count;
+    pthread_mutex_unlock(&xQueue->lock);
+    return spaces;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t uxMaxCount, UBaseType_t uxInitialCount)
+{
+    if (uxInitialCount > uxMaxCount) {
+        return NULL;
+    }
+    SemaphoreHandle_t semaphore = xQueueCreate(uxMaxCount, 0);
+    if (semaphore) {
+        semaphore->count = uxInitialCount;
+    }
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+/* Event groups */
+
+struct host_event_group {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    EventBits_t bits;
+};
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    EventGroupHandle_t event_group = calloc(1, sizeof(struct host_event_group));
+    if (!event_group) {
+        return NULL;
+    }
+    pthread_mutex_init(&event_group->lock, NULL);
+    host_cond_init(&event_group->changed);
+    return event_group;
+}
+
+void vEventGroupDelete(EventGroupHandle_t xEventGroup)
+{
+    if (!xEventGroup) {
+        return;
+    }
+    pthread_mutex_destroy(&xEventGroup->lock);
+    pthread_cond_destroy(&xEventGroup->changed);
+    free(xEventGroup);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToSet)
+{
+    pthread_mutex_lock(&xEventGroup->lock);
+    xEventGroup->bits |= uxBitsToSet;
+    EventBits_t bits = xEventGroup->bits;
+    pthread_cond_broadcast(&xEventGroup->changed);
+    pthread_mutex_unlock(&xEventGroup->lock);
+    return bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToClear)
+{
+    pthread_mutex_lock(&xEventGroup->lock);
+    EventBits_t bits = xEventGroup->bits;
+    xEventGroup->bits &= ~uxBitsToClear;
+    pthread_mutex_unlock(&xEventGroup->lock);
+    return bits;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t xEventGroup)
+{
+    pthread_mutex_lock(&xEventGroup->lock);
+    EventBits_t bits = xEventGroup->bits;
+    pthread_mutex_unlock(&xEventGroup->lock);
+    return bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToWaitFor,
+        const BaseType_t xClearOnExit, const BaseType_t xWaitForAllBits, TickType_t xTicksToWait)
+{
+    struct timespec deadline;
+    bool has_deadline = host_ticks_to_deadline(xTicksToWait, &deadline);
+    pthread_mutex_lock(&xEventGroup->lock);
+    while (1) {
+        EventBits_t matched = xEventGroup->bits & uxBitsToWaitFor;
+        if (xWaitForAllBits ? (matched == uxBitsToWaitFor) : (matched != 0)) {
+            EventBits_t bits = xEventGroup->bits;
+            if (xClearOnExit) {
+                xEventGroup->bits &= ~uxBitsToWaitFor;
+            }
+            pthread_mutex_unlock(&xEventGroup->lock);
+            return bits;
+        }
+        if (xTicksToWait == 0 ||
+                !host_cond_wait(&xEventGroup->changed, &xEventGroup->lock, has_deadline ? &deadline : NULL)) {
+            break;
+        }
+    }
+    EventBits_t bits = xEventGroup->bits;
+    pthread_mutex_unlock(&xEventGroup->lock);
+    return bits;
+}
+
+/* Software timers */
+
+struct host_timer {
+    host_timer_service_timer_t service_timer;
+    TickType_t period;
+    bool auto_reload;
+    void *id;
+    TimerCallbackFunction_t cb;
+};
+
+static void host_timer_cb(void *arg)
+{
+    TimerHandle_t timer = arg;
+    timer->cb(timer);
+}
+
+TimerHandle_t xTimerCreate(const char * const pcTimerName, const TickType_t xTimerPeriodInTicks,
+        const UBaseType_t uxAutoReload, void * const pvTimerID, TimerCallbackFunction_t pxCallbackFunction)
+{
+    if (xTimerPeriodInTicks == 0 || !pxCallbackFunction) {
+        return NULL;
+    }
+    TimerHandle_t timer = calloc(1, sizeof(struct host_timer));
+    if (!timer) {
+        return NULL;
+    }
+    timer->service_timer.cb = host_timer_cb;
+    timer->service_timer.arg = timer;
+    timer->period = xTimerPeriodInTicks;
+    timer->auto_reload = uxAutoReload;
+    timer->id = pvTimerID;
+    timer->cb = pxCallbackFunction;
+    return timer;
+}
+
+BaseType_t xTimerStart(TimerHandle_t xTimer, TickType_t xTicksToWait)
+{
+    int64_t period_us = (int64_t)xTimer->period * portTICK_PERIOD_MS * 1000;
+    host_timer_service_arm(&xTimer->service_timer, period_us, xTimer->auto_reload ? period_us : 0);
+    return pdPASS;
+}
+
+BaseType_t xTimerStop(TimerHandle_t xTimer, TickType_t xTicksToWait)
+{
+    host_timer_service_disarm(&xTimer->service_timer);
+    return pdPASS;
+}
+
+BaseType_t xTimerReset(TimerHandle_t xTimer, TickType_t xTicksToWait)
+{
+    return xTimerStart(xTimer, xTicksToWait);
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t xTimer, TickType_t xNewPeriod, TickType_t xTicksToWait)
+{
+    if (xNewPeriod == 0) {
+        return pdFAIL;
+    }
+    /* Like in FreeRTOS, this also starts the timer */
+    xTimer->period = xNewPeriod;
+    return xTimerStart(xTimer, xTicksToWait);
+}
+
+BaseType_t xTimerDelete(TimerHandle_t xTimer, TickType_t xTicksToWait)
+{
+    host_timer_service_delete(&xTimer->service_timer);
+    return pdPASS;
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t xTimer)
+{
+    return host_timer_service_is_armed(&xTimer->service_timer) ? pdTRUE : pdFALSE;
+}
+
+void *pvTimerGetTimerID(const TimerHandle_t xTimer)
+{
+    return xTimer->id;
+}
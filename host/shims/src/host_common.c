@@ -0,0 +1,45 @@
+/*
+ * Helpers shared by the host (Linux) shims
+ */
+#include <errno.h>
+#include "host_common.h"
+
+int64_t host_time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+void host_cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+void host_us_to_deadline(int64_t time_us, struct timespec *deadline)
+{
+    deadline->tv_sec = time_us / 1000000LL;
+    deadline->tv_nsec = (time_us % 1000000LL) * 1000;
+}
+
+bool host_ticks_to_deadline(TickType_t ticks, struct timespec *deadline)
+{
+    if (ticks == portMAX_DELAY) {
+        return false;
+    }
+    host_us_to_deadline(host_time_us() + (int64_t)ticks * portTICK_PERIOD_MS * 1000, deadline);
+    return true;
+}
+
+bool host_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *deadline)
+{
+    if (!deadline) {
+        pthread_cond_wait(cond, mutex);
+        return true;
+    }
+    return pthread_cond_timedwait(cond, mutex, deadline) != ETIMEDOUT;
+}
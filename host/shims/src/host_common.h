@@ -0,0 +1,26 @@
+/*
+ * Helpers shared by the host (Linux) shims
+ */
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+#include <freertos/FreeRTOS.h>
+
+/* Microseconds on the monotonic clock */
+int64_t host_time_us(void);
+
+/* Initialise a condition variable using the monotonic clock, as used by the helpers below */
+void host_cond_init(pthread_cond_t *cond);
+
+/* Get the deadline for waiting for the given number of ticks. Returns false for portMAX_DELAY,
+ * i.e. if there is no deadline.
+ */
+bool host_ticks_to_deadline(TickType_t ticks, struct timespec *deadline);
+
+/* Get the deadline for waiting till the given time, in microseconds on the monotonic clock */
+void host_us_to_deadline(int64_t time_us, struct timespec *deadline);
+
+/* Wait on the condition variable, till the deadline (if any). Returns false on timeout. */
+bool host_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *deadline);
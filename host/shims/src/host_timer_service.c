@@ -0,0 +1,130 @@
+/*
+ * Timer thread shared by the FreeRTOS software timers and esp_timer shims
+ *
+ * Armed timers are held in a list sorted by the expiry time. Callbacks are invoked from the timer
+ * thread, without holding the lock, so that they can use the timer APIs.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "host_common.h"
+#include "host_timer_service.h"
+
+static pthread_once_t timer_service_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t timer_service_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t timer_service_cond;
+static host_timer_service_timer_t *armed_timers;
+/* Timer whose callback is running */
+static host_timer_service_timer_t *running_timer;
+
+/* Should be called with the lock held */
+static void host_timer_service_insert(host_timer_service_timer_t *timer)
+{
+    host_timer_service_timer_t **prev = &armed_timers;
+    while (*prev && ((*prev)->expiry_us <= timer->expiry_us)) {
+        prev = &(*prev)->next;
+    }
+    timer->next = *prev;
+    *prev = timer;
+    timer->armed = true;
+}
+
+/* Should be called with the lock held */
+static bool host_timer_service_remove(host_timer_service_timer_t *timer)
+{
+    if (!timer->armed) {
+        return false;
+    }
+    host_timer_service_timer_t **prev = &armed_timers;
+    while (*prev && (*prev != timer)) {
+        prev = &(*prev)->next;
+    }
+    if (*prev) {
+        *prev = timer->next;
+    }
+    timer->next = NULL;
+    timer->armed = false;
+    return true;
+}
+
+static void *host_timer_service_task(void *arg)
+{
+    pthread_mutex_lock(&timer_service_lock);
+    while (1) {
+        if (!armed_timers) {
+            host_cond_wait(&timer_service_cond, &timer_service_lock, NULL);
+            continue;
+        }
+        host_timer_service_timer_t *timer = armed_timers;
+        if (timer->expiry_us > host_time_us()) {
+            struct timespec deadline;
+            host_us_to_deadline(timer->expiry_us, &deadline);
+            host_cond_wait(&timer_service_cond, &timer_service_lock, &deadline);
+            continue;
+        }
+        host_timer_service_remove(timer);
+        if (timer->period_us) {
+            timer->expiry_us += timer->period_us;
+            host_timer_service_insert(timer);
+        }
+        running_timer = timer;
+        pthread_mutex_unlock(&timer_service_lock);
+        timer->cb(timer->arg);
+        pthread_mutex_lock(&timer_service_lock);
+        running_timer = NULL;
+        if (timer->delete_pending) {
+            free(timer);
+        }
+    }
+    return NULL;
+}
+
+static void host_timer_service_start(void)
+{
+    host_cond_init(&timer_service_cond);
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, host_timer_service_task, NULL) != 0) {
+        fprintf(stderr, "Failed to create timer thread\n");
+        abort();
+    }
+    pthread_detach(thread);
+}
+
+void host_timer_service_arm(host_timer_service_timer_t *timer, int64_t timeout_us, int64_t period_us)
+{
+    pthread_once(&timer_service_once, host_timer_service_start);
+    pthread_mutex_lock(&timer_service_lock);
+    host_timer_service_remove(timer);
+    timer->expiry_us = host_time_us() + timeout_us;
+    timer->period_us = period_us;
+    host_timer_service_insert(timer);
+    pthread_cond_signal(&timer_service_cond);
+    pthread_mutex_unlock(&timer_service_lock);
+}
+
+bool host_timer_service_disarm(host_timer_service_timer_t *timer)
+{
+    pthread_mutex_lock(&timer_service_lock);
+    bool was_armed = host_timer_service_remove(timer);
+    pthread_mutex_unlock(&timer_service_lock);
+    return was_armed;
+}
+
+bool host_timer_service_is_armed(host_timer_service_timer_t *timer)
+{
+    pthread_mutex_lock(&timer_service_lock);
+    bool armed = timer->armed;
+    pthread_mutex_unlock(&timer_service_lock);
+    return armed;
+}
+
+void host_timer_service_delete(host_timer_service_timer_t *timer)
+{
+    pthread_mutex_lock(&timer_service_lock);
+    host_timer_service_remove(timer);
+    if (timer == running_timer) {
+        timer->delete_pending = true;
+    } else {
+        free(timer);
+    }
+    pthread_mutex_unlock(&timer_service_lock);
+}
@@ -0,0 +1,35 @@
+/*
+ * Timer thread shared by the FreeRTOS software timers and esp_timer shims
+ */
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef void (*host_timer_service_cb_t)(void *arg);
+
+/* This should be the first member of the structures for the timers, since host_timer_service_delete()
+ * frees it.
+ */
+typedef struct host_timer_service_timer {
+    struct host_timer_service_timer *next;
+    host_timer_service_cb_t cb;
+    void *arg;
+    int64_t expiry_us;
+    /* 0 for one shot timers */
+    int64_t period_us;
+    bool armed;
+    bool delete_pending;
+} host_timer_service_timer_t;
+
+/* Arm the timer to expire after timeout_us, and then every period_us, if that is non zero.
+ * If already armed, the timer is re-armed.
+ */
+void host_timer_service_arm(host_timer_service_timer_t *timer, int64_t timeout_us, int64_t period_us);
+
+/* Disarm the timer. Returns whether it was armed. */
+bool host_timer_service_disarm(host_timer_service_timer_t *timer);
+
+bool host_timer_service_is_armed(host_timer_service_timer_t *timer);
+
+/* Disarm and free the timer. If its callback is running, it is freed once that returns. */
+void host_timer_service_delete(host_timer_service_timer_t *timer);
@@ -0,0 +1,25 @@
+/*
+ * BSD functions provided by newlib on the target, but not by glibc
+ */
+#include "newlib_compat.h"
+
+#ifdef __GLIBC__
+/* Find the last (most significant) bit set, with the bits numbered from 1 */
+int fls(int i)
+{
+    return i ? (int)(sizeof(int) * 8) - __builtin_clz((unsigned int)i) : 0;
+}
+
+#if !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size) {
+        size_t copy_len = (len >= size) ? size - 1 : len;
+        memcpy(dst, src, copy_len);
+        dst[copy_len] = '\0';
+    }
+    return len;
+}
+#endif
+#endif /* __GLIBC__ */
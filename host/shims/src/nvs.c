@@ -0,0 +1,554 @@
+/*
+ * Host (Linux) shim for NVS, backed by files
+ *
+ * Each key is a file <storage dir>/<partition>/<namespace>/<key>, holding a byte for the type,
+ * followed by the value. Writes go to a temporary file which is then renamed, so that a key is
+ * never left partially written.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <limits.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <nvs.h>
+#include <nvs_flash.h>
+
+#define HOST_NVS_DEFAULT_DIR        "nvs_host"
+#define HOST_NVS_MAX_PARTITIONS     8
+#define HOST_NVS_MAX_HANDLES        64
+#define HOST_NVS_NAME_MAX_LEN       15
+
+typedef struct {
+    bool in_use;
+    bool read_only;
+    char path[PATH_MAX];
+} host_nvs_handle_t;
+
+struct nvs_opaque_iterator_t {
+    nvs_entry_info_t *entries;
+    int count;
+    int index;
+};
+
+static pthread_mutex_t nvs_lock = PTHREAD_MUTEX_INITIALIZER;
+static char nvs_dir[PATH_MAX];
+static char nvs_partitions[HOST_NVS_MAX_PARTITIONS][NVS_PART_NAME_MAX_SIZE];
+static host_nvs_handle_t nvs_handles[HOST_NVS_MAX_HANDLES];
+
+static bool host_nvs_name_is_valid(const char *name)
+{
+    return name && name[0] && (strlen(name) <= HOST_NVS_NAME_MAX_LEN) && !strchr(name, '/') &&
+            (strcmp(name, ".") != 0) && (strcmp(name, "..") != 0);
+}
+
+static int host_nvs_mkdir(const char *path)
+{
+    char tmp[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s", path);
+    for (char *p = tmp + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            mkdir(tmp, 0755);
+            *p = '/';
+        }
+    }
+    if (mkdir(tmp, 0755) != 0 && errno != EEXIST) {
+        return -1;
+    }
+    return 0;
+}
+
+/* Should be called with the lock held */
+static const char *host_nvs_get_dir(void)
+{
+    if (!nvs_dir[0]) {
+        const char *dir = getenv("NVS_HOST_DIR");
+        snprintf(nvs_dir, sizeof(nvs_dir), "%s", dir ? dir : HOST_NVS_DEFAULT_DIR);
+    }
+    return nvs_dir;
+}
+
+/* Should be called with the lock held */
+static int host_nvs_find_partition(const char *part_name)
+{
+    for (int i = 0; i < HOST_NVS_MAX_PARTITIONS; i++) {
+        if (strcmp(nvs_partitions[i], part_name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int host_nvs_remove_dir(const char *path)
+{
+    DIR *dir = opendir(path);
+    if (!dir) {
+        return (errno == ENOENT) ? 0 : -1;
+    }
+    struct dirent *entry;
+    int ret = 0;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        char child[PATH_MAX];
+        snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+        struct stat st;
+        if (stat(child, &st) == 0 && S_ISDIR(st.st_mode)) {
+            ret |= host_nvs_remove_dir(child);
+        } else {
+            ret |= unlink(child);
+        }
+    }
+    closedir(dir);
+    return ret | rmdir(path);
+}
+
+esp_err_t nvs_flash_host_set_dir(const char *path)
+{
+    if (!path) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&nvs_lock);
+    for (int i = 0; i < HOST_NVS_MAX_PARTITIONS; i++) {
+        if (nvs_partitions[i][0]) {
+            pthread_mutex_unlock(&nvs_lock);
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    snprintf(nvs_dir, sizeof(nvs_dir), "%s", path);
+    pthread_mutex_unlock(&nvs_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_init_partition(const char *partition_label)
+{
+    if (!partition_label || !partition_label[0] || strlen(partition_label) >= NVS_PART_NAME_MAX_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&nvs_lock);
+    if (host_nvs_find_partition(partition_label) >= 0) {
+        pthread_mutex_unlock(&nvs_lock);
+        return ESP_OK;
+    }
+    int index = host_nvs_find_partition("");
+    if (index < 0) {
+        pthread_mutex_unlock(&nvs_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    char path[PATH_MAX];
+    if ((snprintf(path, sizeof(path), "%s/%s", host_nvs_get_dir(), partition_label) >= sizeof(path)) ||
+            (host_nvs_mkdir(path) != 0)) {
+        pthread_mutex_unlock(&nvs_lock);
+        return ESP_ERR_NVS_PART_NOT_FOUND;
+    }
+    strcpy(nvs_partitions[index], partition_label);
+    pthread_mutex_unlock(&nvs_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    return nvs_flash_init_partition(NVS_DEFAULT_PART_NAME);
+}
+
+esp_err_t nvs_flash_deinit_partition(const char *partition_label)
+{
+    pthread_mutex_lock(&nvs_lock);
+    int index = partition_label ? host_nvs_find_partition(partition_label) : -1;
+    if (index >= 0) {
+        nvs_partitions[index][0] = '\0';
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return (index >= 0) ? ESP_OK : ESP_ERR_NVS_NOT_INITIALIZED;
+}
+
+esp_err_t nvs_flash_deinit(void)
+{
+    return nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME);
+}
+
+esp_err_t nvs_flash_erase_partition(const char *part_name)
+{
+    if (!part_name) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&nvs_lock);
+    if (host_nvs_find_partition(part_name) >= 0) {
+        /* Like on the target, an initialised partition cannot be erased */
+        pthread_mutex_unlock(&nvs_lock);
+        return ESP_ERR_NVS_INVALID_STATE;
+    }
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/%s", host_nvs_get_dir(), part_name) >= sizeof(path)) {
+        pthread_mutex_unlock(&nvs_lock);
+        return ESP_ERR_NVS_PART_NOT_FOUND;
+    }
+    int ret = host_nvs_remove_dir(path);
+    pthread_mutex_unlock(&nvs_lock);
+    return (ret == 0) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    return nvs_flash_erase_partition(NVS_DEFAULT_PART_NAME);
+}
+
+esp_err_t nvs_open_from_partition(const char *part_name, const char *name, nvs_open_mode_t open_mode,
+        nvs_handle_t *out_handle)
+{
+    if (!part_name || !out_handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!host_nvs_name_is_valid(name)) {
+        return ESP_ERR_NVS_INVALID_NAME;
+    }
+    pthread_mutex_lock(&nvs_lock);
+    if (host_nvs_find_partition(part_name) < 0) {
+        pthread_mutex_unlock(&nvs_lock);
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    int index;
+    for (index = 0; index < HOST_NVS_MAX_HANDLES; index++) {
+        if (!nvs_handles[index].in_use) {
+            break;
+        }
+    }
+    if (index == HOST_NVS_MAX_HANDLES) {
+        pthread_mutex_unlock(&nvs_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    host_nvs_handle_t *handle = &nvs_handles[index];
+    if (snprintf(handle->path, sizeof(handle->path), "%s/%s/%s", host_nvs_get_dir(), part_name, name) >=
+            sizeof(handle->path)) {
+        pthread_mutex_unlock(&nvs_lock);
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    struct stat st;
+    if (stat(handle->path, &st) != 0) {
+        /* Like on the target, a namespace is created only when opened for writing */
+        if (open_mode == NVS_READONLY || host_nvs_mkdir(handle->path) != 0) {
+            pthread_mutex_unlock(&nvs_lock);
+            return ESP_ERR_NVS_NOT_FOUND;
+        }
+    }
+    handle->in_use = true;
+    handle->read_only = (open_mode == NVS_READONLY);
+    *out_handle = index + 1;
+    pthread_mutex_unlock(&nvs_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    return nvs_open_from_partition(NVS_DEFAULT_PART_NAME, name, open_mode, out_handle);
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    pthread_mutex_lock(&nvs_lock);
+    if (handle > 0 && handle <= HOST_NVS_MAX_HANDLES) {
+        nvs_handles[handle - 1].in_use = false;
+    }
+    pthread_mutex_unlock(&nvs_lock);
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return ESP_OK;
+}
+
+/* Get the path of the file for the key. Since the handles are reused only after nvs_close(),
+ * the path can be used without the lock.
+ */
+static esp_err_t host_nvs_get_key_path(nvs_handle_t handle, const char *key, bool write, char *path, size_t len)
+{
+    if (handle == 0 || handle > HOST_NVS_MAX_HANDLES || !nvs_handles[handle - 1].in_use) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (write && nvs_handles[handle - 1].read_only) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    if (key && !host_nvs_name_is_valid(key)) {
+        return (key && strlen(key) > HOST_NVS_NAME_MAX_LEN) ? ESP_ERR_NVS_KEY_TOO_LONG : ESP_ERR_NVS_INVALID_NAME;
+    }
+    if (snprintf(path, len, "%s/%s", nvs_handles[handle - 1].path, key ? key : "") >= len) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t host_nvs_set(nvs_handle_t handle, const char *key, nvs_type_t type, const void *value, size_t len)
+{
+    char path[PATH_MAX];
+    esp_err_t err = host_nvs_get_key_path(handle, key, true, path, sizeof(path));
+    if (err != ESP_OK) {
+        return err;
+    }
+    char tmp_path[PATH_MAX + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *f = fopen(tmp_path, "wb");
+    if (!f) {
+        return ESP_FAIL;
+    }
+    uint8_t type_byte = type;
+    bool ok = (fwrite(&type_byte, 1, 1, f) == 1) && (len == 0 || fwrite(value, 1, len, f) == len);
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    return ESP_OK;
+}
+
+/* Read the value of the key. If value is NULL, just the length is returned. */
+static esp_err_t host_nvs_get(nvs_handle_t handle, const char *key, nvs_type_t type, void *value, size_t *len)
+{
+    char path[PATH_MAX];
+    esp_err_t err = host_nvs_get_key_path(handle, key, false, path, sizeof(path));
+    if (err != ESP_OK) {
+        return err;
+    }
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    uint8_t type_byte = 0;
+    fseek(f, 0, SEEK_END);
+    long file_len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (file_len < 1 || fread(&type_byte, 1, 1, f) != 1 || type_byte != type) {
+        /* Like on the target, a key of another type is not found */
+        fclose(f);
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    size_t value_len = file_len - 1;
+    if (!value) {
+        *len = value_len;
+        fclose(f);
+        return ESP_OK;
+    }
+    if (*len < value_len) {
+        *len = value_len;
+        fclose(f);
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    bool ok = (value_len == 0) || (fread(value, 1, value_len, f) == value_len);
+    fclose(f);
+    *len = value_len;
+    return ok ? ESP_OK : ESP_FAIL;
+}
+
+/* Fixed size integers */
+static esp_err_t host_nvs_get_int(nvs_handle_t handle, const char *key, nvs_type_t type, void *value, size_t size)
+{
+    if (!value) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t len = size;
+    esp_err_t err = host_nvs_get(handle, key, type, value, &len);
+    if (err == ESP_OK && len != size) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    return err;
+}
+
+#define HOST_NVS_INT_FUNCS(suffix, c_type, nvs_type)                                        \
+esp_err_t nvs_set_##suffix(nvs_handle_t handle, const char *key, c_type value)             \
+{                                                                                           \
+    return host_nvs_set(handle, key, nvs_type, &value, sizeof(value));                     \
+}                                                                                           \
+esp_err_t nvs_get_##suffix(nvs_handle_t handle, const char *key, c_type *out_value)        \
+{                                                                                           \
+    return host_nvs_get_int(handle, key, nvs_type, out_value, sizeof(*out_value));         \
+}
+
+HOST_NVS_INT_FUNCS(i8, int8_t, NVS_TYPE_I8)
+HOST_NVS_INT_FUNCS(u8, uint8_t, NVS_TYPE_U8)
+HOST_NVS_INT_FUNCS(i16, int16_t, NVS_TYPE_I16)
+HOST_NVS_INT_FUNCS(u16, uint16_t, NVS_TYPE_U16)
+HOST_NVS_INT_FUNCS(i32, int32_t, NVS_TYPE_I32)
+HOST_NVS_INT_FUNCS(u32, uint32_t, NVS_TYPE_U32)
+HOST_NVS_INT_FUNCS(i64, int64_t, NVS_TYPE_I64)
+HOST_NVS_INT_FUNCS(u64, uint64_t, NVS_TYPE_U64)
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    if (!value) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return host_nvs_set(handle, key, NVS_TYPE_STR, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    if (!value && length) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return host_nvs_set(handle, key, NVS_TYPE_BLOB, value, length);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length)
+{
+    if (!length) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return host_nvs_get(handle, key, NVS_TYPE_STR, out_value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    if (!length) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return host_nvs_get(handle, key, NVS_TYPE_BLOB, out_value, length);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    char path[PATH_MAX];
+    esp_err_t err = host_nvs_get_key_path(handle, key, true, path, sizeof(path));
+    if (err != ESP_OK) {
+        return err;
+    }
+    return (unlink(path) == 0) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+    char path[PATH_MAX];
+    esp_err_t err = host_nvs_get_key_path(handle, NULL, true, path, sizeof(path));
+    if (err != ESP_OK) {
+        return err;
+    }
+    DIR *dir = opendir(path);
+    if (!dir) {
+        return ESP_OK;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (host_nvs_name_is_valid(entry->d_name)) {
+            char key_path[PATH_MAX + NVS_KEY_NAME_MAX_SIZE];
+            if (snprintf(key_path, sizeof(key_path), "%s%s", path, entry->d_name) < sizeof(key_path)) {
+                unlink(key_path);
+            }
+        }
+    }
+    closedir(dir);
+    return ESP_OK;
+}
+
+/* Add the entries of a namespace to the iterator */
+static void host_nvs_find_in_namespace(struct nvs_opaque_iterator_t *it, const char *part_path,
+        const char *namespace_name, nvs_type_t type)
+{
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/%s", part_path, namespace_name) >= sizeof(path)) {
+        return;
+    }
+    DIR *dir = opendir(path);
+    if (!dir) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (!host_nvs_name_is_valid(entry->d_name)) {
+            continue;
+        }
+        char key_path[PATH_MAX + NVS_KEY_NAME_MAX_SIZE];
+        if (snprintf(key_path, sizeof(key_path), "%s/%s", path, entry->d_name) >= sizeof(key_path)) {
+            continue;
+        }
+        FILE *f = fopen(key_path, "rb");
+        uint8_t type_byte;
+        if (!f) {
+            continue;
+        }
+        size_t read_len = fread(&type_byte, 1, 1, f);
+        fclose(f);
+        if (read_len != 1 || (type != NVS_TYPE_ANY && type_byte != type)) {
+            continue;
+        }
+        nvs_entry_info_t *entries = realloc(it->entries, (it->count + 1) * sizeof(nvs_entry_info_t));
+        if (!entries) {
+            break;
+        }
+        it->entries = entries;
+        nvs_entry_info_t *info = &it->entries[it->count++];
+        memset(info, 0, sizeof(nvs_entry_info_t));
+        /* The names have been validated, and so, fit */
+        memcpy(info->namespace_name, namespace_name, strnlen(namespace_name, sizeof(info->namespace_name) - 1));
+        memcpy(info->key, entry->d_name, strnlen(entry->d_name, sizeof(info->key) - 1));
+        info->type = type_byte;
+    }
+    closedir(dir);
+}
+
+nvs_iterator_t nvs_entry_find(const char *part_name, const char *namespace_name, nvs_type_t type)
+{
+    if (!part_name) {
+        return NULL;
+    }
+    struct nvs_opaque_iterator_t *it = calloc(1, sizeof(struct nvs_opaque_iterator_t));
+    if (!it) {
+        return NULL;
+    }
+    char part_path[PATH_MAX];
+    pthread_mutex_lock(&nvs_lock);
+    bool initialised = (host_nvs_find_partition(part_name) >= 0) &&
+            (snprintf(part_path, sizeof(part_path), "%s/%s", host_nvs_get_dir(), part_name) < sizeof(part_path));
+    pthread_mutex_unlock(&nvs_lock);
+    if (initialised) {
+        if (namespace_name) {
+            host_nvs_find_in_namespace(it, part_path, namespace_name, type);
+        } else {
+            DIR *dir = opendir(part_path);
+            struct dirent *entry;
+            while (dir && (entry = readdir(dir)) != NULL) {
+                if (host_nvs_name_is_valid(entry->d_name)) {
+                    host_nvs_find_in_namespace(it, part_path, entry->d_name, type);
+                }
+            }
+            if (dir) {
+                closedir(dir);
+            }
+        }
+    }
+    if (it->count == 0) {
+        nvs_release_iterator(it);
+        return NULL;
+    }
+    return it;
+}
+
+nvs_iterator_t nvs_entry_next(nvs_iterator_t iterator)
+{
+    if (!iterator) {
+        return NULL;
+    }
+    if (++iterator->index >= iterator->count) {
+        nvs_release_iterator(iterator);
+        return NULL;
+    }
+    return iterator;
+}
+
+void nvs_entry_info(nvs_iterator_t iterator, nvs_entry_info_t *out_info)
+{
+    if (iterator && out_info) {
+        *out_info = iterator->entries[iterator->index];
+    }
+}
+
+void nvs_release_iterator(nvs_iterator_t iterator)
+{
+    if (iterator) {
+        free(iterator->entries);
+        free(iterator);
+    }
+}
@@ -0,0 +1,25 @@
+/*
+ * Helpers for the host tests
+ *
+ * Each test is an executable which exits with a non-zero status on the first failed check, so that it
+ * can be run by ctest.
+ */
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TEST_ASSERT(cond) do {                                                          \
+        if (!(cond)) {                                                                  \
+            fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #cond);    \
+            exit(1);                                                                    \
+        }                                                                               \
+    } while (0)
+
+#define TEST_ASSERT_EQUAL_INT(expected, actual) do {                                    \
+        long long _e = (expected), _a = (actual);                                       \
+        if (_e != _a) {                                                                 \
+            fprintf(stderr, "%s:%d: Expected %s to be %lld, got %lld\n", __FILE__,     \
+                    __LINE__, #actual, _e, _a);                                         \
+            exit(1);                                                                    \
+        }                                                                               \
+    } while (0)
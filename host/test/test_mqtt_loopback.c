@@ -0,0 +1,243 @@
+/*
+ * Round trip test of the ESP RainMaker core over the MQTT loopback transport
+ *
+ * Runs a node with a single switch, playing the role of the cloud:
+ *
+ *   - Connects, and checks that the node config and the initial params are published.
+ *   - Injects a set params message, and checks that the new value reaches the write callback and
+ *     is reported back.
+ *   - Drops the connection, updates a param, and checks that the report is held back in the offline
+ *     queue, and replayed once the connection is restored.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <esp_log.h>
+#include <esp_event.h>
+#include <esp_wifi.h>
+#include <nvs.h>
+#include <nvs_flash.h>
+#include <esp_rmaker_core.h>
+#include <esp_rmaker_mqtt.h>
+#include <esp_rmaker_mqtt_loopback.h>
+#include <esp_rmaker_standard_devices.h>
+#include <esp_rmaker_standard_params.h>
+#include "host_test.h"
+
+#define TEST_NODE_ID        "loopback-test-node"
+#define TEST_TIMEOUT_MS     5000
+#define TEST_POLL_MS        10
+/* Time for which to check that nothing gets published */
+#define TEST_IDLE_MS        500
+
+static const char *TAG = "test_mqtt_loopback";
+
+/* Last message published on each of the topics of interest, and the number of messages on them */
+typedef struct {
+    const char *suffix;
+    char data[512];
+    int count;
+} test_topic_t;
+
+enum {
+    TOPIC_CONFIG,
+    TOPIC_PARAMS_INIT,
+    TOPIC_PARAMS_LOCAL,
+    TOPIC_MAX,
+};
+
+static test_topic_t topics[TOPIC_MAX] = {
+    [TOPIC_CONFIG] = { .suffix = "config" },
+    [TOPIC_PARAMS_INIT] = { .suffix = "params/local/init" },
+    [TOPIC_PARAMS_LOCAL] = { .suffix = "params/local" },
+};
+static pthread_mutex_t topics_lock = PTHREAD_MUTEX_INITIALIZER;
+static int write_count;
+static bool last_written;
+
+static void test_publish_cb(const char *topic, const void *data, size_t data_len, int qos, void *priv_data)
+{
+    const char *prefix = "node/" TEST_NODE_ID "/";
+    if (strncmp(topic, prefix, strlen(prefix)) != 0) {
+        return;
+    }
+    pthread_mutex_lock(&topics_lock);
+    for (int i = 0; i < TOPIC_MAX; i++) {
+        if (strcmp(topic + strlen(prefix), topics[i].suffix) == 0) {
+            size_t len = data_len < sizeof(topics[i].data) - 1 ? data_len : sizeof(topics[i].data) - 1;
+            memcpy(topics[i].data, data, len);
+            topics[i].data[len] = '\0';
+            topics[i].count++;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&topics_lock);
+}
+
+static int test_topic_count(int topic)
+{
+    pthread_mutex_lock(&topics_lock);
+    int count = topics[topic].count;
+    pthread_mutex_unlock(&topics_lock);
+    return count;
+}
+
+static bool test_topic_contains(int topic, const char *str)
+{
+    pthread_mutex_lock(&topics_lock);
+    bool found = strstr(topics[topic].data, str) != NULL;
+    pthread_mutex_unlock(&topics_lock);
+    return found;
+}
+
+/* Deliver the loopback events till the given number of messages get published on the topic */
+static bool test_wait_for_topic(int topic, int count)
+{
+    for (int elapsed = 0; elapsed < TEST_TIMEOUT_MS; elapsed += TEST_POLL_MS) {
+        esp_rmaker_mqtt_loopback_process();
+        if (test_topic_count(topic) >= count) {
+            return true;
+        }
+        usleep(TEST_POLL_MS * 1000);
+    }
+    return false;
+}
+
+/* Deliver the loopback events for the given time */
+static void test_process_for(int ms)
+{
+    for (int elapsed = 0; elapsed < ms; elapsed += TEST_POLL_MS) {
+        esp_rmaker_mqtt_loopback_process();
+        usleep(TEST_POLL_MS * 1000);
+    }
+}
+
+static esp_err_t test_write_cb(const esp_rmaker_device_t *device, const esp_rmaker_param_t *param,
+        const esp_rmaker_param_val_t val, void *priv_data, esp_rmaker_write_ctx_t *ctx)
+{
+    __atomic_store_n(&last_written, val.val.b, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&write_count, 1, __ATOMIC_SEQ_CST);
+    return esp_rmaker_param_update_and_report(param, val);
+}
+
+static esp_err_t test_set_creds(void)
+{
+    static const char *creds[][2] = {
+        { "node_id", TEST_NODE_ID },
+        { "client_cert", "-" },
+        { "client_key", "-" },
+        { "mqtt_host", "loopback" },
+    };
+    nvs_handle_t handle;
+    esp_err_t err = nvs_flash_init_partition(CONFIG_ESP_RMAKER_FACTORY_PARTITION_NAME);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_open_from_partition(CONFIG_ESP_RMAKER_FACTORY_PARTITION_NAME, "rmaker_creds", NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    for (int i = 0; (i < sizeof(creds) / sizeof(creds[0])) && (err == ESP_OK); i++) {
+        err = nvs_set_blob(handle, creds[i][0], creds[i][1], strlen(creds[i][1]));
+    }
+    nvs_close(handle);
+    return err;
+}
+
+static int test_remove_cb(const char *path, const struct stat *sb, int flag, struct FTW *ftwbuf)
+{
+    return remove(path);
+}
+
+static void test_connect(void)
+{
+    TEST_ASSERT(esp_rmaker_mqtt_loopback_set_publish_cb(test_publish_cb, NULL) == ESP_OK);
+    /* The core proceeds to connect once it gets an IP address, as it would on the target. The event handler
+     * is registered by the core task, so keep posting the event till the connection goes through.
+     */
+    for (int elapsed = 0; !esp_rmaker_mqtt_is_connected() && (elapsed < TEST_TIMEOUT_MS); elapsed += TEST_POLL_MS) {
+        esp_event_post(IP_EVENT, IP_EVENT_STA_GOT_IP, NULL, 0, portMAX_DELAY);
+        usleep(TEST_POLL_MS * 1000);
+    }
+    TEST_ASSERT(test_wait_for_topic(TOPIC_CONFIG, 1));
+    TEST_ASSERT(test_wait_for_topic(TOPIC_PARAMS_INIT, 1));
+    TEST_ASSERT(esp_rmaker_mqtt_is_connected());
+    TEST_ASSERT(test_topic_contains(TOPIC_CONFIG, "\"node_id\":\"" TEST_NODE_ID "\""));
+    TEST_ASSERT(test_topic_contains(TOPIC_PARAMS_INIT, "\"Power\":false"));
+    ESP_LOGI(TAG, "Connected. Node config and initial params published.");
+}
+
+static void test_set_params(void)
+{
+    const char *topic = "node/" TEST_NODE_ID "/params/remote";
+    const char *payload = "{\"Switch\":{\"Power\":true}}";
+    int reports = test_topic_count(TOPIC_PARAMS_LOCAL);
+    /* The node subscribes to the set params topic after publishing the initial params, so retry till then */
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    for (int elapsed = 0; (err == ESP_ERR_NOT_FOUND) && (elapsed < TEST_TIMEOUT_MS); elapsed += TEST_POLL_MS) {
+        err = esp_rmaker_mqtt_loopback_inject(topic, payload, strlen(payload));
+        if (err == ESP_ERR_NOT_FOUND) {
+            usleep(TEST_POLL_MS * 1000);
+        }
+    }
+    TEST_ASSERT(err == ESP_OK);
+    TEST_ASSERT(test_wait_for_topic(TOPIC_PARAMS_LOCAL, reports + 1));
+    TEST_ASSERT_EQUAL_INT(1, __atomic_load_n(&write_count, __ATOMIC_SEQ_CST));
+    TEST_ASSERT(__atomic_load_n(&last_written, __ATOMIC_SEQ_CST));
+    TEST_ASSERT(test_topic_contains(TOPIC_PARAMS_LOCAL, "{\"Switch\":{\"Power\":true}}"));
+    ESP_LOGI(TAG, "Set params delivered, and the new value reported.");
+}
+
+static void test_offline_replay(esp_rmaker_device_t *device)
+{
+    esp_rmaker_param_t *power = esp_rmaker_device_get_param_by_name(device, ESP_RMAKER_DEF_POWER_NAME);
+    TEST_ASSERT(power);
+    int reports = test_topic_count(TOPIC_PARAMS_LOCAL);
+
+    TEST_ASSERT(esp_rmaker_mqtt_loopback_drop_connection() == ESP_OK);
+    TEST_ASSERT(!esp_rmaker_mqtt_is_connected());
+    TEST_ASSERT(esp_rmaker_param_update_and_report(power, esp_rmaker_bool(false)) == ESP_OK);
+    /* Nothing should go out while disconnected */
+    test_process_for(TEST_IDLE_MS);
+    TEST_ASSERT_EQUAL_INT(reports, test_topic_count(TOPIC_PARAMS_LOCAL));
+
+    TEST_ASSERT(esp_rmaker_mqtt_loopback_restore_connection() == ESP_OK);
+    TEST_ASSERT(esp_rmaker_mqtt_is_connected());
+    TEST_ASSERT(test_wait_for_topic(TOPIC_PARAMS_LOCAL, reports + 1));
+    TEST_ASSERT(test_topic_contains(TOPIC_PARAMS_LOCAL, "{\"Switch\":{\"Power\":false}}"));
+    ESP_LOGI(TAG, "Report held back while disconnected, and replayed on reconnection.");
+}
+
+int main(void)
+{
+    char nvs_dir[] = "/tmp/test_mqtt_loopback.XXXXXX";
+    TEST_ASSERT(mkdtemp(nvs_dir));
+    nvs_flash_host_set_dir(nvs_dir);
+    esp_event_loop_create_default();
+    TEST_ASSERT(nvs_flash_init() == ESP_OK);
+    TEST_ASSERT(test_set_creds() == ESP_OK);
+
+    esp_rmaker_config_t config = {
+        .enable_time_sync = false,
+    };
+    esp_rmaker_node_t *node = esp_rmaker_node_init(&config, "Loopback Test", "Test");
+    TEST_ASSERT(node);
+    esp_rmaker_device_t *device = esp_rmaker_switch_device_create("Switch", NULL, false);
+    TEST_ASSERT(device);
+    esp_rmaker_device_add_cb(device, test_write_cb, NULL);
+    TEST_ASSERT(esp_rmaker_node_add_device(node, device) == ESP_OK);
+    TEST_ASSERT(esp_rmaker_start() == ESP_OK);
+
+    test_connect();
+    test_set_params();
+    test_offline_replay(device);
+
+    esp_rmaker_stop();
+    nftw(nvs_dir, test_remove_cb, 16, FTW_DEPTH | FTW_PHYS);
+    printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,543 @@
+/*
+ * Test of the schedule calendar engine
+ *
+ * Checks esp_schedule_calendar_get_next() against the implementation it replaced, which is kept below as the
+ * reference, for the days of week and date schedules:
+ *
+ *   - A sweep over random triggers and times, from 2020 to 2055, for a set of time zones. The results must match
+ *     the reference, except close to the DST changes, where the reference was known to be off by the change.
+ *     There, the results are checked against a minute by minute search instead.
+ *   - Fixed vectors for the cases in which the sweep had found the two differing, with the expected results of
+ *     the calendar engine. When the trigger time falls in the gap as the clocks go forward, the schedule goes off
+ *     after the gap, on the same day.
+ *   - A change of TZ between calls, which must not leave any stale DST transitions behind.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <esp_log.h>
+#include <esp_schedule.h>
+#include "esp_schedule_internal.h"
+#include "host_test.h"
+
+#define SECONDS_IN_DAY      (60 * 60 * 24)
+/* 2020-01-01 00:00:00 UTC, and the number of seconds covered by the sweep after that */
+#define TEST_SWEEP_START    1577836800LL
+#define TEST_SWEEP_SPAN     (35LL * 365 * SECONDS_IN_DAY)
+#define TEST_SWEEP_ITERS    50000
+/* Limit for the minute by minute search */
+#define TEST_SEARCH_DAYS    800
+
+static const char *TAG = "test_schedule_calendar";
+
+static const char *test_tzs[] = {
+    "UTC0",
+    "CST-8",
+    "EST5EDT,M3.2.0,M11.1.0",
+    "CET-1CEST,M3.5.0,M10.5.0/3",
+    "AEST-10AEDT,M10.1.0,M4.1.0/3",
+    "IST-5:30",
+    "NZST-12NZDT,M9.5.0,M4.1.0/3",
+    "<-03>3",
+    "GMT0BST,M3.5.0/1,M10.5.0",
+};
+
+/* Reference: the next schedule time calculation from before the calendar engine, with the current time passed
+ * in, instead of being read with time().
+ */
+static int ref_get_no_of_days(const esp_schedule_trigger_t *trigger, struct tm *current_time,
+        struct tm *schedule_time)
+{
+    /* for day, monday = 0, sunday = 6. */
+    int next_day = 0;
+    /* struct tm has tm_wday with sunday as 0. Whereas we have monday as 0. Converting struct tm to our format */
+    int today = ((current_time->tm_wday + 7 - 1) % 7);
+
+    esp_schedule_days_t today_bit = 1 << today;
+    uint8_t repeat_days = trigger->day.repeat_days;
+    int current_seconds = (current_time->tm_hour * 60 + current_time->tm_min) * 60 + current_time->tm_sec;
+    int schedule_seconds = (schedule_time->tm_hour * 60 + schedule_time->tm_min) * 60;
+
+    /* Handling for one time schedule */
+    if (repeat_days == ESP_SCHEDULE_DAY_ONCE) {
+        if (schedule_seconds > current_seconds) {
+            /* The schedule is today and is yet to go off */
+            return 0;
+        } else {
+            /* The schedule is tomorrow */
+            return 1;
+        }
+    }
+
+    /* Handling for repeating schedules */
+    /* Check if it is today */
+    if ((repeat_days & today_bit)) {
+        if (schedule_seconds > current_seconds) {
+            /* The schedule is today and is yet to go off. */
+            return 0;
+        }
+    }
+    /* Check if it is this week or next week */
+    if ((repeat_days & (today_bit ^ 0xFF)) > today_bit) {
+        /* Next schedule is yet to come in this week */
+        next_day = ffs(repeat_days & (0xFF << (today + 1))) - 1;
+        return (next_day - today);
+    } else {
+        /* First scheduled day of the next week */
+        next_day = ffs(repeat_days) - 1;
+        if (next_day == today) {
+            /* Same day, next week */
+            return 7;
+        }
+        return (7 - today + next_day);
+    }
+
+    ESP_LOGE(TAG, "No of days could not be found. This should not happen.");
+    return 0;
+}
+
+static uint8_t ref_get_next_month(const esp_schedule_trigger_t *trigger, struct tm *current_time,
+        struct tm *schedule_time)
+{
+    int current_seconds = (current_time->tm_hour * 60 + current_time->tm_min) * 60 + current_time->tm_sec;
+    int schedule_seconds = (schedule_time->tm_hour * 60 + schedule_time->tm_min) * 60;
+    /* +1 is because struct tm has months starting from 0, whereas we have them starting from 1 */
+    uint8_t current_month = current_time->tm_mon + 1;
+    /* -1 because month_bit starts from 0b1. So for January, it should be 1 << 0. And current_month starts from 1. */
+    uint16_t current_month_bit = 1 << (current_month - 1);
+    uint8_t next_schedule_month = 0;
+    uint16_t repeat_months = trigger->date.repeat_months;
+
+    /* Check if month is not specified */
+    if (repeat_months == ESP_SCHEDULE_MONTH_ONCE) {
+        if (trigger->date.day == current_time->tm_mday) {
+            /* The schedule day is same. Check if time has already passed */
+            if (schedule_seconds > current_seconds) {
+                /* The schedule is today and is yet to go off */
+                return current_month;
+            } else {
+                /* Today's time has passed */
+                return (current_month + 1);
+            }
+        } else if (trigger->date.day > current_time->tm_mday) {
+            /* The day is yet to come in this month */
+            return current_month;
+        } else {
+            /* The day has passed in the current month */
+            return (current_month + 1);
+        }
+    }
+
+    /* Check if schedule is not this year itself, it is in future. */
+    if (trigger->date.year > (current_time->tm_year + 1900)) {
+        /* Find first schedule month of next year */
+        next_schedule_month = ffs(repeat_months);
+        /* Year will be handled by the caller. So no need to add any additional months */
+        return next_schedule_month;
+    }
+
+    /* Check if schedule is this month and is yet to come */
+    if (current_month_bit & repeat_months) {
+        if (trigger->date.day == current_time->tm_mday) {
+            /* The schedule day is same. Check if time has already passed */
+            if (schedule_seconds > current_seconds) {
+                /* The schedule is today and is yet to go off */
+                return current_month;
+            }
+        }
+        if (trigger->date.day > current_time->tm_mday) {
+            /* The day is yet to come in this month */
+            return current_month;
+        }
+    }
+
+    /* Check if schedule is this year */
+    if ((repeat_months & (current_month_bit ^ 0xFFFF)) > current_month_bit) {
+        /* Next schedule month is yet to come in this year */
+        next_schedule_month = ffs(repeat_months & (0xFFFF << (current_month)));
+        return next_schedule_month;
+    }
+
+    /* Check if schedule is for this year and does not repeat */
+    if (!trigger->date.repeat_every_year) {
+        if (trigger->date.year <= (current_time->tm_year + 1900)) {
+            ESP_LOGE(TAG, "Schedule does not repeat next year, but get_next_month has been called.");
+            return 0;
+        }
+    }
+
+    /* Schedule is not this year */
+    /* Find first schedule month of next year */
+    next_schedule_month = ffs(repeat_months);
+    /* +12 because the schedule is next year */
+    return (next_schedule_month + 12);
+}
+
+static uint16_t ref_get_next_year(const esp_schedule_trigger_t *trigger, struct tm *current_time)
+{
+    uint16_t current_year = current_time->tm_year + 1900;
+    uint16_t schedule_year = trigger->date.year;
+    if (schedule_year > current_year) {
+        return schedule_year;
+    }
+    /* If the schedule is set to repeat_every_year, we return the current year */
+    /* If the schedule has already passed in this year, we still return current year, as the additional months
+     * will be handled in get_next_month
+     */
+    return current_year;
+}
+
+static time_t ref_get_next(const esp_schedule_trigger_t *trigger, time_t now)
+{
+    struct tm current_time, schedule_time;
+
+    /* Get current time */
+    localtime_r(&now, &current_time);
+
+    /* Get schedule time */
+    localtime_r(&now, &schedule_time);
+    schedule_time.tm_sec = 0;
+    schedule_time.tm_min = trigger->minutes;
+    schedule_time.tm_hour = trigger->hours;
+    mktime(&schedule_time);
+
+    /* Adjust schedule day */
+    if (trigger->type == ESP_SCHEDULE_TYPE_DAYS_OF_WEEK) {
+        int no_of_days = 0;
+        no_of_days = ref_get_no_of_days(trigger, &current_time, &schedule_time);
+        schedule_time.tm_sec += no_of_days * SECONDS_IN_DAY;
+    }
+    if (trigger->type == ESP_SCHEDULE_TYPE_DATE) {
+        schedule_time.tm_mday = trigger->date.day;
+        schedule_time.tm_mon = ref_get_next_month(trigger, &current_time, &schedule_time) - 1;
+        schedule_time.tm_year = ref_get_next_year(trigger, &current_time) - 1900;
+        if (schedule_time.tm_mon < 0) {
+            ESP_LOGE(TAG, "Invalid month found: %d. Setting it to next month.", schedule_time.tm_mon);
+            schedule_time.tm_mon = current_time.tm_mon + 1;
+        }
+        if (schedule_time.tm_mon >= 12) {
+            schedule_time.tm_year += schedule_time.tm_mon / 12;
+            schedule_time.tm_mon = schedule_time.tm_mon % 12;
+        }
+    }
+    mktime(&schedule_time);
+
+    /* Adjust time according to DST */
+    time_t dst_adjust = 0;
+    if (!current_time.tm_isdst && schedule_time.tm_isdst) {
+        dst_adjust = -3600;
+    } else if (current_time.tm_isdst && !schedule_time.tm_isdst ) {
+        dst_adjust = 3600;
+    }
+    schedule_time.tm_sec += dst_adjust;
+    return mktime(&schedule_time);
+}
+
+typedef struct {
+    /* Index in test_tzs */
+    int tz;
+    esp_schedule_trigger_t trigger;
+    time_t now;
+    time_t expected;
+} test_vector_t;
+
+#define DAYS_OF_WEEK(h, m, days) { .type = ESP_SCHEDULE_TYPE_DAYS_OF_WEEK, .hours = (h), .minutes = (m), \
+        .day = { .repeat_days = (days) } }
+#define DATE(h, m, d, months, y) { .type = ESP_SCHEDULE_TYPE_DATE, .hours = (h), .minutes = (m), \
+        .date = { .day = (d), .repeat_months = (months), .year = (y), .repeat_every_year = true } }
+
+/* The cases close to the DST changes in which the reference and the calendar engine differ. The comments have the
+ * expected times in the local time.
+ */
+static const test_vector_t test_dst_vectors[] = {
+    { 2, DAYS_OF_WEEK(0, 1, 0x61), 1773003831LL, 1773028860LL }, /* 2026-03-09 00:01:00 UTC-04:00 */
+    { 2, DAYS_OF_WEEK(0, 1, 0x47), 2152210500LL, 2152238460LL }, /* 2038-03-15 00:01:00 UTC-04:00 */
+    { 2, DAYS_OF_WEEK(0, 7, 0x6f), 1867946039LL, 1867982820LL }, /* 2029-03-12 00:07:00 UTC-04:00 */
+    { 2, DATE(2, 51, 8, 0xe0c, 2025), 1766217098LL, 1772956260LL }, /* 2026-03-08 03:51:00 UTC-04:00 */
+    { 2, DATE(2, 4, 13, 0xbf4, 2044), 2337828758LL, 2341465440LL }, /* 2044-03-13 03:04:00 UTC-04:00 */
+    { 2, DAYS_OF_WEEK(2, 55, 0x41), 2656508680LL, 2656569300LL }, /* 2054-03-08 03:55:00 UTC-04:00 */
+    { 2, DATE(0, 27, 16, 0x72f, 2049), 2499387014LL, 2499481620LL }, /* 2049-03-16 00:27:00 UTC-04:00 */
+    { 2, DAYS_OF_WEEK(2, 46, 0x44), 2214978370LL, 2215064760LL }, /* 2040-03-11 03:46:00 UTC-04:00 */
+    { 2, DATE(2, 6, 8, 0x125, 2020), 1580281620LL, 1583651160LL }, /* 2020-03-08 03:06:00 UTC-04:00 */
+    { 2, DATE(2, 29, 12, 0xd65, 2051), 2557137240LL, 2562218940LL }, /* 2051-03-12 03:29:00 UTC-04:00 */
+    { 2, DATE(2, 20, 9, 0x654, 2042), 2272931282LL, 2277962400LL }, /* 2042-03-09 03:20:00 UTC-04:00 */
+    { 2, DAYS_OF_WEEK(2, 36, 0x6e), 2530687260LL, 2530769760LL }, /* 2050-03-13 03:36:00 UTC-04:00 */
+    { 2, DAYS_OF_WEEK(0, 37, 0x42), 1615740029LL, 1615869420LL }, /* 2021-03-16 00:37:00 UTC-04:00 */
+    { 2, DATE(0, 53, 12, 0x000, 2034), 2025804875LL, 2028430380LL }, /* 2034-04-12 00:53:00 UTC-04:00 */
+    { 2, DATE(1, 10, 3, 0x448, 2024), 1730614191LL, 1743657000LL }, /* 2025-04-03 01:10:00 UTC-04:00 */
+    { 2, DATE(0, 25, 6, 0xa18, 2032), 1962862620LL, 1964838300LL }, /* 2032-04-06 00:25:00 UTC-04:00 */
+    { 2, DATE(1, 50, 5, 0x6c6, 2023), 1699166995LL, 1707115800LL }, /* 2024-02-05 01:50:00 UTC-05:00 */
+    { 2, DATE(2, 35, 12, 0x000, 2023), 1678073220LL, 1678606500LL }, /* 2023-03-12 03:35:00 UTC-04:00 */
+    { 2, DAYS_OF_WEEK(0, 36, 0x79), 2183669223LL, 2183690160LL }, /* 2039-03-14 00:36:00 UTC-04:00 */
+    { 2, DAYS_OF_WEEK(2, 38, 0x47), 2593371932LL, 2593669080LL }, /* 2052-03-10 03:38:00 UTC-04:00 */
+    { 3, DATE(0, 50, 21, 0x770, 2047), 2437655531LL, 2442005400LL }, /* 2047-05-21 00:50:00 UTC+02:00 */
+    { 3, DAYS_OF_WEEK(2, 20, 0x54), 1869047857LL, 1869096000LL }, /* 2029-03-25 03:20:00 UTC+02:00 */
+    { 3, DATE(2, 46, 25, 0x414, 2035), 2054361360LL, 2058399960LL }, /* 2035-03-25 03:46:00 UTC+02:00 */
+    { 3, DATE(2, 4, 26, 0x9e5, 2023), 1678112760LL, 1679792640LL }, /* 2023-03-26 03:04:00 UTC+02:00 */
+    { 3, DAYS_OF_WEEK(0, 23, 0x5c), 1932638940LL, 1932848580LL }, /* 2031-04-02 00:23:00 UTC+02:00 */
+    { 3, DATE(0, 7, 6, 0xdf0, 2024), 1711888769LL, 1714946820LL }, /* 2024-05-06 00:07:00 UTC+02:00 */
+    { 3, DATE(2, 57, 28, 0x384, 2021), 1611151560LL, 1616896620LL }, /* 2021-03-28 03:57:00 UTC+02:00 */
+    { 3, DAYS_OF_WEEK(2, 19, 0x45), 2121643220LL, 2121902340LL }, /* 2037-03-29 03:19:00 UTC+02:00 */
+    { 3, DAYS_OF_WEEK(0, 35, 0x7a), 2121934260LL, 2122065300LL }, /* 2037-03-31 00:35:00 UTC+02:00 */
+    { 3, DAYS_OF_WEEK(2, 55, 0x69), 1806119400LL, 1806198900LL }, /* 2027-03-28 03:55:00 UTC+02:00 */
+    { 3, DAYS_OF_WEEK(2, 37, 0x50), 2658332513LL, 2658361020LL }, /* 2054-03-29 03:37:00 UTC+02:00 */
+    { 3, DATE(0, 26, 6, 0xdf3, 2046), 2405559279LL, 2409171960LL }, /* 2046-05-06 00:26:00 UTC+02:00 */
+    { 3, DAYS_OF_WEEK(2, 35, 0x6f), 2090436582LL, 2090453700LL }, /* 2036-03-30 03:35:00 UTC+02:00 */
+    { 4, DATE(0, 30, 12, 0xf0f, 2050), 2548278973LL, 2549107800LL }, /* 2050-10-12 00:30:00 UTC+11:00 */
+    { 4, DATE(2, 15, 5, 0xa63, 2042), 2291264958LL, 2296052100LL }, /* 2042-10-05 03:15:00 UTC+11:00 */
+    { 4, DAYS_OF_WEEK(2, 35, 0x67), 1680366881LL, 1680453300LL }, /* 2023-04-03 02:35:00 UTC+10:00 */
+    { 4, DAYS_OF_WEEK(2, 24, 0x48), 2611616340LL, 2611758240LL }, /* 2052-10-06 03:24:00 UTC+11:00 */
+    { 4, DATE(2, 58, 4, 0xeb6, 2048), 2482286623LL, 2485357080LL }, /* 2048-10-04 03:58:00 UTC+11:00 */
+    { 4, DATE(2, 50, 4, 0x000, 2026), 1788713391LL, 1791046200LL }, /* 2026-10-04 03:50:00 UTC+11:00 */
+    { 4, DATE(2, 29, 2, 0xbe0, 2022), 1664633247LL, 1664641740LL }, /* 2022-10-02 03:29:00 UTC+11:00 */
+    { 4, DATE(0, 37, 19, 0xec5, 2029), 1886059070LL, 1887025020LL }, /* 2029-10-19 00:37:00 UTC+11:00 */
+    { 4, DATE(2, 43, 3, 0xa96, 2027), 1818866699LL, 1822495380LL }, /* 2027-10-03 03:43:00 UTC+11:00 */
+    { 4, DAYS_OF_WEEK(2, 53, 0x44), 2106465517LL, 2106751980LL }, /* 2036-10-05 03:53:00 UTC+11:00 */
+    { 4, DATE(0, 27, 4, 0x01b, 2026), 1791086332LL, 1798982820LL }, /* 2027-01-04 00:27:00 UTC+11:00 */
+    { 4, DATE(0, 58, 4, 0xa4c, 2048), 2485425715LL, 2490616680LL }, /* 2048-12-04 00:58:00 UTC+11:00 */
+    { 4, DATE(0, 22, 13, 0x000, 2035), 2075301768LL, 2075808120LL }, /* 2035-10-13 00:22:00 UTC+11:00 */
+    { 4, DATE(2, 7, 2, 0xa2f, 2050), 2546006820LL, 2548253220LL }, /* 2050-10-02 03:07:00 UTC+11:00 */
+    { 4, DATE(2, 3, 1, 0x000, 2045), 2388051098LL, 2390400180LL }, /* 2045-10-01 03:03:00 UTC+11:00 */
+    { 4, DATE(2, 28, 7, 0xa22, 2029), 1883406553LL, 1885998480LL }, /* 2029-10-07 03:28:00 UTC+11:00 */
+    { 4, DATE(2, 1, 4, 0x000, 2020), 1599694140LL, 1601740860LL }, /* 2020-10-04 03:01:00 UTC+11:00 */
+    { 4, DATE(0, 52, 5, 0x000, 2031), 1948900488LL, 1951566720LL }, /* 2031-11-05 00:52:00 UTC+11:00 */
+    { 4, DATE(2, 44, 5, 0x000, 2053), 2643001500LL, 2643209040LL }, /* 2053-10-05 03:44:00 UTC+11:00 */
+    { 4, DATE(0, 28, 13, 0x11d, 2034), 2043309323LL, 2052221280LL }, /* 2035-01-13 00:28:00 UTC+11:00 */
+    { 4, DATE(0, 54, 7, 0x000, 2020), 1601797646LL, 1601992440LL }, /* 2020-10-07 00:54:00 UTC+11:00 */
+    { 4, DATE(0, 32, 28, 0x0eb, 2053), 2643224160LL, 2653133520LL }, /* 2054-01-28 00:32:00 UTC+11:00 */
+    { 6, DAYS_OF_WEEK(2, 41, 0x56), 2642510509LL, 2642596860LL }, /* 2053-09-28 03:41:00 UTC+13:00 */
+    { 6, DATE(0, 44, 25, 0x31d, 2044), 2358396514LL, 2360922240LL }, /* 2044-10-25 00:44:00 UTC+13:00 */
+    { 6, DAYS_OF_WEEK(2, 20, 0x64), 1664019301LL, 1664029200LL }, /* 2022-09-25 03:20:00 UTC+13:00 */
+    { 6, DATE(2, 46, 27, 0xf01, 2026), 1779870642LL, 1790433960LL }, /* 2026-09-27 03:46:00 UTC+13:00 */
+    { 6, DAYS_OF_WEEK(2, 33, 0x47), 2389444464LL, 2389789980LL }, /* 2045-09-24 03:33:00 UTC+13:00 */
+    { 6, DAYS_OF_WEEK(0, 25, 0x00), 1885431649LL, 1885461900LL }, /* 2029-10-01 00:25:00 UTC+13:00 */
+    { 6, DAYS_OF_WEEK(2, 28, 0x4d), 2216816820LL, 2216903280LL }, /* 2040-04-02 02:28:00 UTC+12:00 */
+    { 6, DAYS_OF_WEEK(2, 31, 0x43), 2169026677LL, 2169037860LL }, /* 2038-09-26 03:31:00 UTC+13:00 */
+    { 6, DAYS_OF_WEEK(2, 7, 0x55), 2673871620LL, 2674044420LL }, /* 2054-09-27 03:07:00 UTC+13:00 */
+    { 6, DATE(0, 0, 8, 0xd02, 2034), 2042669640LL, 2046510000LL }, /* 2034-11-08 00:00:00 UTC+13:00 */
+    { 6, DAYS_OF_WEEK(2, 30, 0x79), 2484662562LL, 2484743400LL }, /* 2048-09-27 03:30:00 UTC+13:00 */
+    { 6, DAYS_OF_WEEK(2, 27, 0x5c), 2516053133LL, 2516192820LL }, /* 2049-09-26 03:27:00 UTC+13:00 */
+    { 6, DATE(2, 36, 25, 0x7fe, 2039), 2200055708LL, 2200487760LL }, /* 2039-09-25 03:36:00 UTC+13:00 */
+    { 6, DATE(2, 11, 27, 0xb90, 2026), 1788713220LL, 1790431860LL }, /* 2026-09-27 03:11:00 UTC+13:00 */
+    { 6, DAYS_OF_WEEK(2, 40, 0x46), 2137329660LL, 2137588800LL }, /* 2037-09-27 03:40:00 UTC+13:00 */
+    { 6, DATE(2, 25, 26, 0x517, 2038), 2165927053LL, 2169037500LL }, /* 2038-09-26 03:25:00 UTC+13:00 */
+    { 6, DATE(0, 18, 27, 0xa8d, 2042), 2295500580LL, 2297935080LL }, /* 2042-10-27 00:18:00 UTC+13:00 */
+    { 6, DATE(0, 16, 25, 0x8ea, 2021), 1632586779LL, 1640344560LL }, /* 2021-12-25 00:16:00 UTC+13:00 */
+    { 6, DATE(2, 27, 29, 0x000, 2041), 2261312939LL, 2263991220LL }, /* 2041-09-29 03:27:00 UTC+13:00 */
+    { 6, DATE(23, 1, 5, 0x772, 2035), 2074682100LL, 2075191260LL }, /* 2035-10-05 23:01:00 UTC+13:00 */
+    { 6, DAYS_OF_WEEK(0, 34, 0x73), 2674101300LL, 2674121640LL }, /* 2054-09-28 00:34:00 UTC+13:00 */
+    { 6, DAYS_OF_WEEK(0, 26, 0x64), 1632600778LL, 1632828360LL }, /* 2021-09-29 00:26:00 UTC+13:00 */
+    { 6, DAYS_OF_WEEK(2, 49, 0x4e), 1979482320LL, 1979736540LL }, /* 2032-09-26 03:49:00 UTC+13:00 */
+    { 6, DAYS_OF_WEEK(2, 9, 0x72), 2200399800LL, 2200486140LL }, /* 2039-09-25 03:09:00 UTC+13:00 */
+    { 6, DAYS_OF_WEEK(2, 25, 0x41), 1600698360LL, 1601130300LL }, /* 2020-09-27 03:25:00 UTC+13:00 */
+    { 8, DATE(1, 20, 29, 0x000, 2026), 1774743918LL, 1774747200LL }, /* 2026-03-29 02:20:00 UTC+01:00 */
+    { 8, DATE(0, 22, 1, 0xd7e, 2051), 2563428381LL, 2563917720LL }, /* 2051-04-01 00:22:00 UTC+01:00 */
+    { 8, DAYS_OF_WEEK(1, 27, 0x5a), 1711796484LL, 1711848420LL }, /* 2024-03-31 02:27:00 UTC+01:00 */
+    { 8, DATE(0, 12, 28, 0x000, 2049), 2500552446LL, 2503177920LL }, /* 2049-04-28 00:12:00 UTC+01:00 */
+    { 8, DAYS_OF_WEEK(1, 9, 0x52), 2342555238LL, 2342653740LL }, /* 2044-03-27 02:09:00 UTC+01:00 */
+    { 8, DAYS_OF_WEEK(1, 21, 0x54), 2342588400LL, 2342654460LL }, /* 2044-03-27 02:21:00 UTC+01:00 */
+};
+
+static void test_set_tz(const char *tz)
+{
+    setenv("TZ", tz, 1);
+    tzset();
+}
+
+/* A simple xorshift generator, so that the sweep is the same everywhere */
+static uint64_t test_rand_state = 0x2545f4914f6cdd1dULL;
+
+static uint32_t test_rand(void)
+{
+    test_rand_state ^= test_rand_state << 13;
+    test_rand_state ^= test_rand_state >> 7;
+    test_rand_state ^= test_rand_state << 17;
+    return (uint32_t)(test_rand_state >> 32);
+}
+
+static bool test_day_matches(const esp_schedule_trigger_t *trigger, const struct tm *local_time)
+{
+    if (trigger->type == ESP_SCHEDULE_TYPE_DAYS_OF_WEEK) {
+        /* Monday is 0 for the schedule, whereas Sunday is 0 for struct tm */
+        int weekday = (local_time->tm_wday + 6) % 7;
+        return !trigger->day.repeat_days || (trigger->day.repeat_days & (1 << weekday));
+    }
+    if (local_time->tm_mday != trigger->date.day) {
+        return false;
+    }
+    return !trigger->date.repeat_months || (trigger->date.repeat_months & (1 << local_time->tm_mon));
+}
+
+static int32_t test_get_offset(time_t time)
+{
+    struct tm local_time;
+    localtime_r(&time, &local_time);
+    return (int32_t)local_time.tm_gmtoff;
+}
+
+/* If the local time at the given time already occurred once that day, before the clocks went back */
+static bool test_is_repeated(time_t time)
+{
+    int32_t back = test_get_offset(time - SECONDS_IN_DAY) - test_get_offset(time);
+    if (back <= 0) {
+        return false;
+    }
+    time_t earlier = time - back;
+    struct tm local_time, earlier_local_time;
+    localtime_r(&time, &local_time);
+    localtime_r(&earlier, &earlier_local_time);
+    return (earlier_local_time.tm_mday == local_time.tm_mday) && (earlier_local_time.tm_hour == local_time.tm_hour)
+            && (earlier_local_time.tm_min == local_time.tm_min);
+}
+
+/* Minute by minute search for the first time after now at which the local time matches the trigger. As with the
+ * calendar engine, a local time which occurs twice as the clocks go back is taken as the first one.
+ */
+static time_t test_search_next(const esp_schedule_trigger_t *trigger, time_t now)
+{
+    for (time_t time = now - now % 60 + 60; time < now + TEST_SEARCH_DAYS * SECONDS_IN_DAY; time += 60) {
+        struct tm local_time;
+        localtime_r(&time, &local_time);
+        if ((local_time.tm_hour == trigger->hours) && (local_time.tm_min == trigger->minutes)
+                && test_day_matches(trigger, &local_time) && !test_is_repeated(time)) {
+            return time;
+        }
+    }
+    return 0;
+}
+
+/* If the UTC offset changes within two days of the given time */
+static bool test_near_dst_change(time_t time)
+{
+    return test_get_offset(time - 2 * SECONDS_IN_DAY) != test_get_offset(time + 2 * SECONDS_IN_DAY);
+}
+
+/* Checks the time got from the calendar engine close to a DST change. It must be the first time at which the local
+ * time matches the trigger. Or, if the trigger time got skipped as the clocks went forward, the time right after the
+ * gap, on the first day before that.
+ */
+static void test_check_near_dst_change(const esp_schedule_trigger_t *trigger, time_t now, time_t next)
+{
+    time_t expected = test_search_next(trigger, now);
+    TEST_ASSERT(next > now);
+    if (next == expected) {
+        return;
+    }
+    TEST_ASSERT(expected == 0 || next < expected);
+    struct tm local_time;
+    localtime_r(&next, &local_time);
+    TEST_ASSERT(test_day_matches(trigger, &local_time));
+    int32_t gap = test_get_offset(next) - test_get_offset(next - SECONDS_IN_DAY);
+    TEST_ASSERT(gap > 0);
+    int32_t seconds = (local_time.tm_hour * 60 + local_time.tm_min) * 60 - gap;
+    TEST_ASSERT_EQUAL_INT((trigger->hours * 60 + trigger->minutes) * 60, seconds);
+}
+
+static void test_random_trigger(esp_schedule_trigger_t *trigger, time_t now)
+{
+    struct tm local_time;
+    localtime_r(&now, &local_time);
+    memset(trigger, 0, sizeof(*trigger));
+    trigger->hours = test_rand() % 24;
+    trigger->minutes = test_rand() % 60;
+    if (test_rand() % 3 == 0) {
+        /* Around the current time */
+        trigger->hours = local_time.tm_hour;
+        int minutes = local_time.tm_min + (int)(test_rand() % 3) - 1;
+        trigger->minutes = (minutes >= 0 && minutes < 60) ? minutes : local_time.tm_min;
+    }
+    if (test_rand() % 2) {
+        trigger->type = ESP_SCHEDULE_TYPE_DAYS_OF_WEEK;
+        trigger->day.repeat_days = test_rand() % 128;
+    } else {
+        trigger->type = ESP_SCHEDULE_TYPE_DATE;
+        /* Leaving out the days which are not there in some months, which the search does not handle */
+        trigger->date.day = ((test_rand() % 3 == 0) && (local_time.tm_mday <= 28)) ? local_time.tm_mday
+                : 1 + test_rand() % 28;
+        trigger->date.repeat_months = (test_rand() % 4 == 0) ? ESP_SCHEDULE_MONTH_ONCE : test_rand() % 4096;
+        trigger->date.year = local_time.tm_year + 1900;
+        trigger->date.repeat_every_year = true;
+    }
+}
+
+static void test_sweep(void)
+{
+    for (int tz = 0; tz < sizeof(test_tzs) / sizeof(test_tzs[0]); tz++) {
+        test_set_tz(test_tzs[tz]);
+        int dst_changes = 0;
+        for (int i = 0; i < TEST_SWEEP_ITERS; i++) {
+            time_t now = TEST_SWEEP_START + (time_t)(((uint64_t)test_rand() << 32 | test_rand()) % TEST_SWEEP_SPAN);
+            if (test_rand() % 4 == 0) {
+                /* Exact minutes too */
+                now -= now % 60;
+            }
+            esp_schedule_trigger_t trigger;
+            test_random_trigger(&trigger, now);
+            time_t next;
+            TEST_ASSERT(esp_schedule_calendar_get_next(&trigger, now, &next) == ESP_OK);
+            time_t ref_next = ref_get_next(&trigger, now);
+            if (next == ref_next) {
+                continue;
+            }
+            TEST_ASSERT(test_near_dst_change(now) || test_near_dst_change(ref_next) || test_near_dst_change(next));
+            test_check_near_dst_change(&trigger, now, next);
+            dst_changes++;
+        }
+        ESP_LOGI(TAG, "%s: %d triggers, %d differing from the reference close to the DST changes", test_tzs[tz],
+                TEST_SWEEP_ITERS, dst_changes);
+    }
+}
+
+static void test_dst_vectors_check(void)
+{
+    for (int i = 0; i < sizeof(test_dst_vectors) / sizeof(test_dst_vectors[0]); i++) {
+        const test_vector_t *vector = &test_dst_vectors[i];
+        test_set_tz(test_tzs[vector->tz]);
+        time_t next;
+        TEST_ASSERT(esp_schedule_calendar_get_next(&vector->trigger, vector->now, &next) == ESP_OK);
+        if (next != vector->expected) {
+            fprintf(stderr, "Vector %d\n", i);
+        }
+        TEST_ASSERT_EQUAL_INT(vector->expected, next);
+        TEST_ASSERT(ref_get_next(&vector->trigger, vector->now) != next);
+        test_check_near_dst_change(&vector->trigger, vector->now, next);
+    }
+    ESP_LOGI(TAG, "%d DST vectors checked", (int)(sizeof(test_dst_vectors) / sizeof(test_dst_vectors[0])));
+}
+
+static void test_tz_change(void)
+{
+    esp_schedule_trigger_t trigger = DAYS_OF_WEEK(12, 0, ESP_SCHEDULE_DAY_EVERYDAY);
+    time_t now = time(NULL);
+    time_t next;
+    /* Gets the DST transitions of this TZ cached */
+    test_set_tz("CET-1CEST,M3.5.0,M10.5.0/3");
+    TEST_ASSERT(esp_schedule_calendar_get_next(&trigger, now, &next) == ESP_OK);
+
+    test_set_tz("EST5EDT,M3.2.0,M11.1.0");
+    time_t later = now + 30 * SECONDS_IN_DAY;
+    struct tm local_time;
+    localtime_r(&later, &local_time);
+    local_time.tm_hour = 12;
+    local_time.tm_min = 0;
+    local_time.tm_sec = 0;
+    local_time.tm_isdst = -1;
+    time_t expected = mktime(&local_time);
+    TEST_ASSERT_EQUAL_INT(expected, esp_schedule_calendar_local_to_utc(local_time.tm_year + 1900,
+            local_time.tm_mon + 1, local_time.tm_mday, 12 * 60 * 60));
+    TEST_ASSERT(esp_schedule_calendar_get_next(&trigger, now, &next) == ESP_OK);
+    TEST_ASSERT_EQUAL_INT(ref_get_next(&trigger, now), next);
+    ESP_LOGI(TAG, "TZ change picked up");
+}
+
+int main(void)
+{
+    test_dst_vectors_check();
+    test_sweep();
+    test_tz_change();
+    printf("PASS\n");
+    return 0;
+}